@@ -0,0 +1,35 @@
+"""Build script of the libSNAP Python extension.
+
+Usage: python setup.py build_ext --inplace
+"""
+
+import os
+
+import numpy
+from setuptools import Extension, setup
+
+ROOT_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+SRC_DIR = os.path.join(ROOT_DIR, "src")
+
+# Defines SNAP_SIZE_USER_HASH (EDM = 7) for both this module and the tools, so they decode alike
+USER_HASH_HEADER = os.path.join(ROOT_DIR, "tools", "user_hash.h")
+
+
+setup(
+    name="snap",
+    version="1.0.0",
+    description="Fast SNAP frame decoding backed by libSNAP",
+    ext_modules=[
+        Extension(
+            "snap",
+            sources=["snapmodule.c", os.path.relpath(os.path.join(SRC_DIR, "snap.c"))],
+            include_dirs=[SRC_DIR, numpy.get_include()],
+            define_macros=[
+                ("SNAP_CRC8_TABLE", None),
+                ("SNAP_CRC16_TABLE", None),
+                ("SNAP_CRC32_TABLE", None),
+            ],
+            extra_compile_args=["-O2", "-include", USER_HASH_HEADER],
+        )
+    ],
+)
@@ -0,0 +1,379 @@
+/**
+ * @file   snapmodule.c
+ * @author Lucas Jadilo
+ * @brief  CPython extension that decodes whole byte streams into NumPy structured arrays.
+ * @details The module exposes a single function, `snap.decode()`, that scans a bytes-like object
+ *          with snap_decodeBuffer() (with the GIL released) and returns one record per frame found.
+ *          The record array owns the memory filled by the decoder, so no extra copy is made.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
+#include <stddef.h>
+#include "snap.h"
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+/**
+ * @brief Decoded frame record. The NumPy dtype built in buildRecordDescr() mirrors this layout.
+ */
+typedef struct record_t
+{
+	int64_t  offset;		/**< @brief Index of the sync byte in the input. */
+	int64_t  dataOffset;	/**< @brief Index of the first payload byte in the input (-1 if the frame has no payload). */
+	uint32_t destAddress;	/**< @brief Destination address (0 if the frame has no destination address). */
+	uint32_t sourceAddress;	/**< @brief Source address (0 if the frame has no source address). */
+	uint32_t protocolFlags;	/**< @brief Protocol specific flags (0 if the frame has no flags). */
+	uint32_t hash;			/**< @brief Received hash value (0 if the frame has no hash). */
+	uint16_t size;			/**< @brief Number of bytes stored by the decoder (full frame size, except on overflow). */
+	uint16_t dataSize;		/**< @brief Payload size, including padding bytes. */
+	int8_t   status;		/**< @brief Final frame status (#snap_status_t). */
+	uint8_t  dab;			/**< @brief DAB bits. */
+	uint8_t  sab;			/**< @brief SAB bits. */
+	uint8_t  pfb;			/**< @brief PFB bits. */
+	uint8_t  ack;			/**< @brief ACK bits. */
+	uint8_t  cmd;			/**< @brief CMD bit. */
+	uint8_t  edm;			/**< @brief EDM bits. */
+	uint8_t  ndb;			/**< @brief NDB bits. */
+} record_t;
+
+/**
+ * @brief Growable array of records. It is filled without holding the GIL, so it uses the raw allocator.
+ */
+typedef struct recordArray_t
+{
+	record_t *records;	/**< @brief Pointer to the first record. */
+	size_t   count;		/**< @brief Number of records stored. */
+	size_t   capacity;	/**< @brief Number of records that fit in the allocated memory. */
+} recordArray_t;
+
+
+/******************************************************************************/
+/*  Private Functions                                                         */
+/******************************************************************************/
+
+
+/**
+ * @brief Append a record to the array, growing it if necessary.
+ * @param[in,out] array Pointer to the record array.
+ * @return Pointer to the new record, or NULL if the allocation failed.
+ */
+static record_t *appendRecord(recordArray_t *array)
+{
+	if(array->count == array->capacity)
+	{
+		const size_t capacity = array->capacity ? (2 * array->capacity) : 1024;
+		record_t *records = PyMem_RawRealloc(array->records, capacity * sizeof(record_t));
+
+		if(records == NULL)
+		{
+			return NULL;
+		}
+
+		array->records = records;
+		array->capacity = capacity;
+	}
+
+	return &array->records[array->count++];
+}
+
+/**
+ * @brief Fill a record with the content of a frame that reached a final status.
+ * @param[out] record Pointer to the record.
+ * @param[in]  frame  Pointer to the frame structure.
+ * @param[in]  offset Index of the sync byte in the input.
+ */
+static void fillRecord(record_t *record, const snap_frame_t *frame, const int64_t offset)
+{
+	snap_header_t header;
+	uint32_t value;
+
+	memset(record, 0, sizeof(*record));
+
+	snap_getField(frame, &header, SNAP_FIELD_HEADER);
+
+	record->offset = offset;
+	record->dataOffset = -1;
+	record->size = frame->size;
+	record->status = frame->status;
+	record->dab = header.dab;
+	record->sab = header.sab;
+	record->pfb = header.pfb;
+	record->ack = header.ack;
+	record->cmd = header.cmd;
+	record->edm = header.edm;
+	record->ndb = header.ndb;
+
+	if(snap_getField(frame, &value, SNAP_FIELD_DEST_ADDRESS) > 0)   record->destAddress = value;
+	if(snap_getField(frame, &value, SNAP_FIELD_SOURCE_ADDRESS) > 0) record->sourceAddress = value;
+	if(snap_getField(frame, &value, SNAP_FIELD_PROTOCOL_FLAGS) > 0) record->protocolFlags = value;
+	if(snap_getField(frame, &value, SNAP_FIELD_HASH) > 0)           record->hash = value;
+
+	if(frame->status != SNAP_STATUS_ERROR_OVERFLOW)
+	{
+		record->dataSize = snap_getDataSize(frame);
+
+		if(record->dataSize)
+		{
+			record->dataOffset = offset + snap_getDataIndex(frame);
+		}
+	}
+}
+
+/**
+ * @brief Scan a byte array and store a record for each frame found.
+ * @details Called without the GIL. After a hash or overflow error, the search is resumed right after
+ *          the sync byte of the bad frame, so a false sync byte never hides the next frame.
+ * @param[in]  data   Pointer to the input bytes.
+ * @param[in]  size   Number of input bytes.
+ * @param[in]  base   Value added to every offset.
+ * @param[in]  errors If false, only valid frames are stored.
+ * @param[out] array  Pointer to the record array.
+ * @param[out] tail   Index of the first byte of a frame left incomplete at the end of the input (size if there is none).
+ * @return 0 on success, -1 if the allocation of a record failed.
+ */
+static int scan(const uint8_t *data, const size_t size, const int64_t base, const bool errors,
+				recordArray_t *array, size_t *tail)
+{
+	uint8_t buffer[SNAP_MAX_SIZE_FRAME];
+	snap_frame_t frame;
+	size_t pos = 0;
+
+	snap_init(&frame, buffer, sizeof(buffer));
+	*tail = size;
+
+	while(pos < size)
+	{
+		pos += snap_decodeBuffer(&frame, &data[pos], size - pos);
+
+		if(frame.status == SNAP_STATUS_INCOMPLETE)
+		{
+			*tail = pos - frame.size;
+			break;
+		}
+
+		if(frame.status == SNAP_STATUS_IDLE)
+		{
+			break;
+		}
+
+		const size_t start = pos - frame.size;
+
+		if(errors || (frame.status == SNAP_STATUS_VALID))
+		{
+			record_t *record = appendRecord(array);
+
+			if(record == NULL)
+			{
+				return -1;
+			}
+
+			fillRecord(record, &frame, base + (int64_t)start);
+		}
+
+		if(frame.status != SNAP_STATUS_VALID)
+		{
+			pos = start + 1;
+		}
+
+		snap_reset(&frame);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Build the NumPy dtype that matches #record_t.
+ * @return New reference to the dtype, or NULL on error.
+ */
+static PyArray_Descr *buildRecordDescr(void)
+{
+	PyArray_Descr *descr = NULL;
+	PyObject *spec = Py_BuildValue(
+		"{s:[ssssssssssssssss],s:[ssssssssssssssss],s:[nnnnnnnnnnnnnnnn],s:n}",
+		"names",
+		"offset", "data_offset", "dest", "source", "flags", "hash", "size", "data_size",
+		"status", "dab", "sab", "pfb", "ack", "cmd", "edm", "ndb",
+		"formats",
+		"<i8", "<i8", "<u4", "<u4", "<u4", "<u4", "<u2", "<u2",
+		"i1", "u1", "u1", "u1", "u1", "u1", "u1", "u1",
+		"offsets",
+		(Py_ssize_t)offsetof(record_t, offset), (Py_ssize_t)offsetof(record_t, dataOffset),
+		(Py_ssize_t)offsetof(record_t, destAddress), (Py_ssize_t)offsetof(record_t, sourceAddress),
+		(Py_ssize_t)offsetof(record_t, protocolFlags), (Py_ssize_t)offsetof(record_t, hash),
+		(Py_ssize_t)offsetof(record_t, size), (Py_ssize_t)offsetof(record_t, dataSize),
+		(Py_ssize_t)offsetof(record_t, status), (Py_ssize_t)offsetof(record_t, dab),
+		(Py_ssize_t)offsetof(record_t, sab), (Py_ssize_t)offsetof(record_t, pfb),
+		(Py_ssize_t)offsetof(record_t, ack), (Py_ssize_t)offsetof(record_t, cmd),
+		(Py_ssize_t)offsetof(record_t, edm), (Py_ssize_t)offsetof(record_t, ndb),
+		"itemsize", (Py_ssize_t)sizeof(record_t));
+
+	if(spec == NULL)
+	{
+		return NULL;
+	}
+
+	PyArray_DescrConverter(spec, &descr);
+	Py_DECREF(spec);
+	return descr;
+}
+
+/**
+ * @brief Capsule destructor that releases the memory of a record array.
+ * @param[in] capsule Capsule that holds the pointer to the first record.
+ */
+static void freeRecords(PyObject *capsule)
+{
+	PyMem_RawFree(PyCapsule_GetPointer(capsule, NULL));
+}
+
+
+/******************************************************************************/
+/*  Module Functions                                                          */
+/******************************************************************************/
+
+
+PyDoc_STRVAR(decode_doc,
+"decode(data, base=0, errors=True) -> (frames, tail)\n"
+"\n"
+"Decode every SNAP frame in a bytes-like object.\n"
+"\n"
+"frames is a NumPy structured array with one record per frame (fields: offset,\n"
+"data_offset, dest, source, flags, hash, size, data_size, status, dab, sab, pfb,\n"
+"ack, cmd, edm, ndb). Offsets are indexes into data plus base. If errors is\n"
+"False, frames with hash or overflow errors are not reported.\n"
+"\n"
+"tail is the index where a frame left incomplete at the end of data starts\n"
+"(len(data) if there is none). To decode a stream in chunks, prepend\n"
+"data[tail:] to the next chunk and pass base + tail as the next base.");
+
+static PyObject *snap_decodeStream(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+	static char *keywords[] = {"data", "base", "errors", NULL};
+	Py_buffer view;
+	long long base = 0;
+	int errors = 1;
+
+	(void)self;
+
+	if(!PyArg_ParseTupleAndKeywords(args, kwargs, "y*|Lp:decode", keywords, &view, &base, &errors))
+	{
+		return NULL;
+	}
+
+	recordArray_t array = {NULL, 0, 0};
+	size_t tail;
+	int ret;
+
+	Py_BEGIN_ALLOW_THREADS
+	ret = scan(view.buf, (size_t)view.len, (int64_t)base, errors != 0, &array, &tail);
+	Py_END_ALLOW_THREADS
+
+	PyBuffer_Release(&view);
+
+	if(ret < 0)
+	{
+		PyMem_RawFree(array.records);
+		return PyErr_NoMemory();
+	}
+
+	PyArray_Descr *descr = buildRecordDescr();
+
+	if(descr == NULL)
+	{
+		PyMem_RawFree(array.records);
+		return NULL;
+	}
+
+	if(array.records == NULL)
+	{
+		npy_intp dims[1] = {0};
+		PyObject *frames = PyArray_Empty(1, dims, descr, 0);	// Steals the descr reference
+		return frames ? Py_BuildValue("(Nn)", frames, (Py_ssize_t)tail) : NULL;
+	}
+
+	PyObject *capsule = PyCapsule_New(array.records, NULL, freeRecords);
+
+	if(capsule == NULL)
+	{
+		Py_DECREF(descr);
+		PyMem_RawFree(array.records);
+		return NULL;
+	}
+
+	npy_intp dims[1] = {(npy_intp)array.count};
+	PyObject *frames = PyArray_NewFromDescr(&PyArray_Type, descr, 1, dims, NULL, array.records, NPY_ARRAY_CARRAY, NULL);
+
+	if(frames == NULL)
+	{
+		Py_DECREF(capsule);
+		return NULL;
+	}
+
+	if(PyArray_SetBaseObject((PyArrayObject *)frames, capsule) < 0)	// Steals the capsule reference
+	{
+		Py_DECREF(frames);
+		return NULL;
+	}
+
+	return Py_BuildValue("(Nn)", frames, (Py_ssize_t)tail);
+}
+
+
+/******************************************************************************/
+/*  Module Definition                                                         */
+/******************************************************************************/
+
+
+static PyMethodDef snapMethods[] =
+{
+	{"decode", (PyCFunction)(void (*)(void))snap_decodeStream, METH_VARARGS | METH_KEYWORDS, decode_doc},
+	{NULL, NULL, 0, NULL}
+};
+
+static struct PyModuleDef snapModule =
+{
+	PyModuleDef_HEAD_INIT,
+	"snap",
+	"Fast SNAP frame decoding backed by libSNAP.",
+	-1,
+	snapMethods,
+	NULL, NULL, NULL, NULL
+};
+
+PyMODINIT_FUNC PyInit_snap(void)
+{
+	import_array();
+
+	PyObject *module = PyModule_Create(&snapModule);
+
+	if(module == NULL)
+	{
+		return NULL;
+	}
+
+	if((PyModule_AddIntConstant(module, "STATUS_VALID", SNAP_STATUS_VALID) < 0) ||
+	   (PyModule_AddIntConstant(module, "STATUS_ERROR_HASH", SNAP_STATUS_ERROR_HASH) < 0) ||
+	   (PyModule_AddIntConstant(module, "STATUS_ERROR_OVERFLOW", SNAP_STATUS_ERROR_OVERFLOW) < 0) ||
+	   (PyModule_AddIntConstant(module, "MAX_SIZE_FRAME", SNAP_MAX_SIZE_FRAME) < 0))
+	{
+		Py_DECREF(module);
+		return NULL;
+	}
+
+	return module;
+}
+
+/******************************** END OF FILE *********************************/
@@ -52,6 +52,70 @@ SOFTWARE.
 	#define SNAP_WEAK	__attribute__((weak))
 #endif
 
+/*
+ * USDT probes (provider "libsnap"), compiled in only if the macro SNAP_ENABLE_PROBES is defined (requires
+ * <sys/sdt.h>, e.g. from systemtap-sdt-dev). Each probe has a semaphore, which the tracer increments while it
+ * is attached, so a probe site costs a load and a branch not taken until then: its arguments (frame pointer,
+ * frame size, EDM and destination address, the last two zero until they are received) are only computed
+ * when the probe is enabled. Otherwise, the probes expand to nothing.
+ */
+#ifdef SNAP_ENABLE_PROBES
+	#define _SDT_HAS_SEMAPHORES	1
+	#include <sys/sdt.h>
+	#define SNAP_PROBE_SEMAPHORE(name)	__extension__ volatile unsigned short libsnap_##name##_semaphore __attribute__((unused, section(".probes"), visibility("hidden")))
+	#define SNAP_PROBE_ENABLED(name)	__builtin_expect(libsnap_##name##_semaphore != 0U, 0)
+	#define SNAP_PROBE(name, frame)		do { if(SNAP_PROBE_ENABLED(name)) { DTRACE_PROBE4(libsnap, name, (frame), (frame)->size, probeEdm(frame), probeDestAddress(frame)); } } while(0)
+#else
+	#define SNAP_PROBE(name, frame)
+#endif
+
+
+#ifdef SNAP_ENABLE_PROBES
+
+/******************************************************************************/
+/*  Private Variables                                                         */
+/******************************************************************************/
+
+
+SNAP_PROBE_SEMAPHORE(sync);
+SNAP_PROBE_SEMAPHORE(header);
+SNAP_PROBE_SEMAPHORE(valid);
+SNAP_PROBE_SEMAPHORE(hash_error);
+SNAP_PROBE_SEMAPHORE(overflow);
+SNAP_PROBE_SEMAPHORE(encapsulate);
+
+
+/******************************************************************************/
+/*  Private Function Definitions                                              */
+/******************************************************************************/
+
+
+/**
+ * @brief Get the EDM of a frame for the probe arguments.
+ * @param[in] frame Pointer to the frame structure.
+ * @return EDM value, or zero if the header is not complete.
+ */
+static uint8_t probeEdm(const snap_frame_t *frame)
+{
+	return (frame->size >= SNAP_MIN_SIZE_FRAME) ? (uint8_t)SNAP_HDB1_EDM(frame->buffer) : 0U;
+}
+
+/**
+ * @brief Get the destination address of a frame for the probe arguments.
+ * @param[in] frame Pointer to the frame structure.
+ * @return Destination address, or zero if it is not complete (or the frame has none).
+ */
+static uint32_t probeDestAddress(const snap_frame_t *frame)
+{
+	uint32_t address = 0;
+
+	snap_getField(frame, &address, SNAP_FIELD_DEST_ADDRESS);
+
+	return address;
+}
+
+#endif	// SNAP_ENABLE_PROBES
+
 
 /******************************************************************************/
 /*  Public Function Definitions                                               */
@@ -66,7 +130,7 @@ SOFTWARE.
 /**
  * @brief Initialize the frame structure.
  * @details A frame structure should be initialized before passing it to other functions.
- *          On success, store the buffer pointer and size, and clear the other frame variables.
+ *          On success, store the buffer pointer and size, and clear the other frame variables (the header whitelist is removed).
  *          On error, the structure remains unchanged.
  * @param[out] frame   Pointer to the frame structure.
  * @param[in]  buffer  Pointer to the array that will store the frame bytes.
@@ -88,6 +152,7 @@ int16_t snap_init(snap_frame_t *frame, uint8_t *buffer, const uint16_t maxSize)
 	frame->buffer = buffer;
 	frame->status = SNAP_STATUS_IDLE;
 	frame->size = 0;
+	frame->whitelist = NULL;
 
 	return (int16_t)frame->maxSize;
 }
@@ -105,9 +170,31 @@ void snap_reset(snap_frame_t *frame)
 	frame->status = SNAP_STATUS_IDLE;
 }
 
+/**
+ * @brief Restrict the headers accepted by the decoder.
+ * @details On buses where only a few frame formats are used, any sync byte found in the noise or in the middle
+ *          of a frame makes the decoder wait for a "frame" of up to #SNAP_MAX_SIZE_FRAME bytes, which may hide the
+ *          real frames that follow. With a whitelist, snap_decode() and snap_decodeBuffer() check the header as
+ *          soon as the HDB1 byte arrives: an unlisted header is dropped at once and the search for a sync byte
+ *          resumes at the HDB2 byte. Dropped headers are not reported (the frame status never leaves
+ *          #SNAP_STATUS_INCOMPLETE for them).
+ *
+ *          The whitelist is an array of #SNAP_SIZE_WHITELIST bytes, filled with #SNAP_WHITELIST_ALLOW(). It is not
+ *          copied, so it must remain valid while the frame is used, and it can be shared by several frames.
+ *          It is kept by snap_reset() and removed by snap_init().
+ * @param[in,out] frame     Pointer to the frame structure.
+ * @param[in]     whitelist Pointer to the whitelist, or NULL to accept any header.
+ */
+void snap_setWhitelist(snap_frame_t *frame, const uint8_t *whitelist)
+{
+	frame->whitelist = whitelist;
+}
+
 /**
  * @brief Detect, decode, validate and store a frame, one byte at a time.
  * @details All input bytes before a sync byte will be ignored.
+ *          If the frame has a whitelist (see snap_setWhitelist()), a frame whose header is not in the list is dropped
+ *          as soon as the HDB1 byte is received, and the HDB2 and HDB1 bytes are searched for a new sync byte.
  *          When a new byte is inserted into the buffer, the frame size and status are updated accordingly.
  *          All input bytes after a valid frame or any error will be ignored.
  *          Prior to decoding a new frame, the frame status must be #SNAP_STATUS_IDLE. This can be achieved with snap_reset().
@@ -126,19 +213,43 @@ int8_t snap_decode(snap_frame_t *frame, const uint8_t newByte)
 				frame->buffer[SNAP_INDEX_SYNC] = newByte;
 				frame->size = 1;
 				frame->status = SNAP_STATUS_INCOMPLETE;
+				SNAP_PROBE(sync, frame);
 			}
 			return frame->status;
 
 		case SNAP_STATUS_INCOMPLETE:
 			frame->buffer[frame->size++] = newByte;
-			if(frame->size >= SNAP_MIN_SIZE_FRAME)
+			if((frame->size == SNAP_MIN_SIZE_FRAME) && (frame->whitelist != NULL) &&
+			   !SNAP_WHITELIST_CHECK(frame->whitelist, SNAP_HDB2(frame->buffer), SNAP_HDB1(frame->buffer)))
+			{
+				if(SNAP_HDB2(frame->buffer) == SNAP_SYNC)
+				{
+					frame->buffer[SNAP_INDEX_HDB2] = SNAP_HDB1(frame->buffer);
+					frame->size = 2;
+				}
+				else if(SNAP_HDB1(frame->buffer) == SNAP_SYNC)
+				{
+					frame->size = 1;
+				}
+				else
+				{
+					snap_reset(frame);
+				}
+			}
+			else if(frame->size >= SNAP_MIN_SIZE_FRAME)
 			{
 				const uint8_t hashSize = SNAP_SIZE_HASH(frame->buffer);
 				const uint16_t fullFrameSize = (uint16_t)(SNAP_INDEX_HASH(frame->buffer) + hashSize);
 
+				if(frame->size == SNAP_MIN_SIZE_FRAME)
+				{
+					SNAP_PROBE(header, frame);
+				}
+
 				if(frame->maxSize < fullFrameSize)
 				{
 					frame->status = SNAP_STATUS_ERROR_OVERFLOW;
+					SNAP_PROBE(overflow, frame);
 				}
 				else if(frame->size >= fullFrameSize)
 				{
@@ -155,6 +266,15 @@ int8_t snap_decode(snap_frame_t *frame, const uint8_t newByte)
 					{
 						frame->status = SNAP_STATUS_VALID;
 					}
+
+					if(frame->status == SNAP_STATUS_VALID)
+					{
+						SNAP_PROBE(valid, frame);
+					}
+					else
+					{
+						SNAP_PROBE(hash_error, frame);
+					}
 				}
 			}
 			return frame->status;
@@ -164,6 +284,75 @@ int8_t snap_decode(snap_frame_t *frame, const uint8_t newByte)
 	}
 }
 
+/**
+ * @brief Decode a block of bytes, stopping as soon as the frame is complete or an error occurs.
+ * @details The result is the same as calling snap_decode() for each byte of the block until the
+ *          frame status changes to #SNAP_STATUS_VALID, #SNAP_STATUS_ERROR_HASH or #SNAP_STATUS_ERROR_OVERFLOW,
+ *          but it is much faster for large blocks: bytes before the sync byte are skipped without
+ *          touching the frame structure, and once the header is known, the rest of the frame is copied
+ *          in a single pass and the hash value is calculated only once.
+ *          When the function returns with a final status, the frame occupies the last frame->size bytes
+ *          consumed (i.e. the sync byte is at index `returnValue - frame->size`), provided that the frame
+ *          started in this block. This makes it easy to resume the search right after a false sync byte.
+ * @param[in,out] frame Pointer to the frame structure.
+ * @param[in]     data  Pointer to the bytes to be decoded.
+ * @param[in]     size  Number of bytes in the array.
+ * @return Number of bytes consumed from the array. It is less than size only if the frame reached a final status.
+ */
+size_t snap_decodeBuffer(snap_frame_t *frame, const uint8_t *data, const size_t size)
+{
+	size_t i = 0;
+
+	while(i < size)
+	{
+		if(frame->status == SNAP_STATUS_IDLE)
+		{
+			while(data[i] != SNAP_SYNC)
+			{
+				if(++i == size)
+				{
+					return size;
+				}
+			}
+
+			snap_decode(frame, data[i++]);
+		}
+		else if(frame->status == SNAP_STATUS_INCOMPLETE)
+		{
+			const uint_fast16_t remaining = (frame->size < SNAP_MIN_SIZE_FRAME) ? 1U :
+				(uint_fast16_t)(SNAP_INDEX_HASH(frame->buffer) + SNAP_SIZE_HASH(frame->buffer) - frame->size);
+
+			if(remaining > 1)	// Copy everything but the last byte, which goes through snap_decode() to validate the frame
+			{
+				uint_fast16_t count = (uint_fast16_t)(remaining - 1);
+
+				if(count > size - i)
+				{
+					count = (uint_fast16_t)(size - i);
+				}
+
+				for(uint_fast16_t j = 0; j < count; j++)
+				{
+					frame->buffer[frame->size + j] = data[i + j];
+				}
+
+				frame->size = (uint16_t)(frame->size + count);
+				i += count;
+			}
+			else
+			{
+				snap_decode(frame, data[i++]);
+			}
+		}
+		else	// Valid frame or error
+		{
+			break;
+		}
+	}
+
+	return i;
+}
+
 /**
  * @brief Encapsulate a new frame into the buffer (if there is enough space).
  *        Update the frame status and size according to the result.
@@ -263,6 +452,7 @@ int8_t snap_encapsulate(snap_frame_t *frame, snap_fields_t *fields)
 	}
 
 	frame->status = SNAP_STATUS_VALID;
+	SNAP_PROBE(encapsulate, frame);
 	return frame->status;
 }
 
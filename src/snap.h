@@ -47,6 +47,7 @@ SOFTWARE.
 /******************************************************************************/
 
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -174,6 +175,17 @@ SOFTWARE.
 #define SNAP_SYNC				(0x54U)	/**< @brief Value of the sync byte. It is the first byte of every frame. */
 #define SNAP_PADDING			(0x00U)	/**< @brief Value of the byte used in payload padding (when the payload size is greater than the actual data size). */
 
+/**
+ * @}
+ * @name Header whitelist (see snap_setWhitelist())
+ * @{
+ */
+
+#define SNAP_SIZE_WHITELIST	(65536U / 8U)	/**< @brief Size of a header whitelist: one bit per header, bit (HDB2 * 256 + HDB1) is set if the header is allowed. */
+
+#define SNAP_WHITELIST_ALLOW(pWhitelist, hdb2, hdb1)	((pWhitelist)[((unsigned int)(hdb2) << 5) | ((unsigned int)(hdb1) >> 3)] |= (uint8_t)(1U << ((unsigned int)(hdb1) & 7U)))	/**< @brief Allow a header in a whitelist. @param pWhitelist Pointer to the whitelist (uint8_t[#SNAP_SIZE_WHITELIST]). @param hdb2 HDB2 byte. @param hdb1 HDB1 byte. */
+#define SNAP_WHITELIST_CHECK(pWhitelist, hdb2, hdb1)	(((pWhitelist)[((unsigned int)(hdb2) << 5) | ((unsigned int)(hdb1) >> 3)] >> ((unsigned int)(hdb1) & 7U)) & 1U)				/**< @brief Check if a header is allowed in a whitelist (1 = allowed). @param pWhitelist Pointer to the whitelist (const uint8_t*). @param hdb2 HDB2 byte. @param hdb1 HDB1 byte. */
+
 /**
  * @}
  * @defgroup uc User Convenience
@@ -420,10 +432,11 @@ typedef struct snap_fields_t
  */
 typedef struct snap_frame_t
 {
-	uint8_t  *buffer;	/**< @brief Pointer to the array that stores all the bytes of the frame. */
-	uint16_t maxSize;	/**< @brief Maximum number of bytes that can be stored in the buffer. */
-	uint16_t size;		/**< @brief Current size of the frame (it may be incomplete). */
-	int8_t   status;	/**< @brief Status of the frame, used primarily in the decoding process. It can assume any value from #snap_status_t. */
+	uint8_t       *buffer;		/**< @brief Pointer to the array that stores all the bytes of the frame. */
+	uint16_t      maxSize;		/**< @brief Maximum number of bytes that can be stored in the buffer. */
+	uint16_t      size;			/**< @brief Current size of the frame (it may be incomplete). */
+	int8_t        status;		/**< @brief Status of the frame, used primarily in the decoding process. It can assume any value from #snap_status_t. */
+	const uint8_t *whitelist;	/**< @brief Headers accepted by the decoder (#SNAP_SIZE_WHITELIST bytes), or NULL to accept any header. See snap_setWhitelist(). */
 } snap_frame_t;
 
 /**
@@ -448,8 +461,12 @@ int16_t snap_init(snap_frame_t *frame, uint8_t *buffer, uint16_t maxSize);
 
 void snap_reset(snap_frame_t *frame);
 
+void snap_setWhitelist(snap_frame_t *frame, const uint8_t *whitelist);
+
 int8_t snap_decode(snap_frame_t *frame, uint8_t newByte);
 
+size_t snap_decodeBuffer(snap_frame_t *frame, const uint8_t *data, size_t size);
+
 int8_t snap_encapsulate(snap_frame_t *frame, snap_fields_t *fields);
 
 int16_t snap_getField(const snap_frame_t *frame, void *fieldContent, uint8_t fieldType);
@@ -0,0 +1,344 @@
+/*
+Copyright (c) 2022 Lucas Jadilo
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file   snap_cobs.c
+ * @author Lucas Jadilo
+ * @brief  Source file of the COBS framing mode, an optional module of the libSNAP library.
+ */
+
+/**
+ * @addtogroup cobs
+ * @{
+ */
+
+
+/******************************************************************************/
+/*  Private Includes                                                          */
+/******************************************************************************/
+
+
+#include <stddef.h>
+#include <string.h>
+#include "snap_cobs.h"
+
+
+/******************************************************************************/
+/*  Private Macros                                                            */
+/******************************************************************************/
+
+
+#define MAX_RUN		(254U)						// Most non-zero bytes encoded by one code byte.
+#define ONES		(0x0101010101010101ULL)		// Lowest bit of each byte of a word.
+#define HIGHS		(0x8080808080808080ULL)		// Highest bit of each byte of a word.
+
+
+/******************************************************************************/
+/*  Private Function Definitions                                              */
+/******************************************************************************/
+
+
+/**
+ * @brief Find the first zero byte of an array, 8 bytes at a time.
+ * @param[in] data Pointer to the array.
+ * @param[in] size Number of bytes in the array.
+ * @return Index of the first zero byte, or size if there is none.
+ */
+static size_t findZero(const uint8_t *data, const size_t size)
+{
+	size_t i = 0;
+
+	for(; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+	{
+		uint64_t word;
+
+		memcpy(&word, &data[i], sizeof(word));
+
+		if((word - ONES) & ~word & HIGHS)	// Nonzero if and only if the word has a zero byte
+		{
+			break;
+		}
+	}
+
+	while((i < size) && (data[i] != 0))
+	{
+		i++;
+	}
+
+	return i;
+}
+
+/**
+ * @brief Decode a COBS packet.
+ * @param[in]  packet  Pointer to the packet (without the delimiter).
+ * @param[in]  size    Number of bytes in the packet.
+ * @param[out] data    Pointer to the array that will store the decoded bytes.
+ * @param[in]  maxSize Size of the array. The bytes beyond it are counted, but not stored.
+ * @return Number of decoded bytes, or SIZE_MAX if the packet is not valid COBS.
+ */
+static size_t unstuff(const uint8_t *packet, const size_t size, uint8_t *data, const size_t maxSize)
+{
+	size_t in = 0, out = 0;
+
+	while(in < size)
+	{
+		const size_t code = packet[in++];
+		const size_t run = code - 1U;
+
+		if((code == 0) || (run > size - in) || (findZero(&packet[in], run) != run))
+		{
+			return SIZE_MAX;
+		}
+
+		if(out < maxSize)
+		{
+			memcpy(&data[out], &packet[in], (run < maxSize - out) ? run : maxSize - out);
+		}
+
+		in += run;
+		out += run;
+
+		if((code <= MAX_RUN) && (in < size))	// A run shorter than the maximum ends with a zero byte, except the last one
+		{
+			if(out < maxSize)
+			{
+				data[out] = 0;
+			}
+
+			out++;
+		}
+	}
+
+	return out;
+}
+
+
+/******************************************************************************/
+/*  Public Function Definitions                                               */
+/******************************************************************************/
+
+
+/**
+ * @brief Encode an array of bytes (usually a frame) into a COBS packet.
+ * @details The packet has no zero bytes, except for the #SNAP_COBS_DELIMITER that ends it.
+ *          To send a frame, encode frame.buffer with frame.size bytes.
+ * @param[in]  data   Pointer to the bytes to be encoded.
+ * @param[in]  size   Number of bytes in the array.
+ * @param[out] packet Pointer to the array that will store the packet. It must have at least
+ *                    SNAP_COBS_SIZE_PACKET(size) bytes (#SNAP_COBS_MAX_SIZE_PACKET for any frame).
+ *                    It must not overlap the input array.
+ * @return Size of the packet, delimiter included.
+ */
+size_t snap_cobsEncode(const uint8_t *data, const size_t size, uint8_t *packet)
+{
+	uint8_t *out = packet;
+	size_t i = 0;
+
+	while(true)
+	{
+		const size_t limit = (size - i < MAX_RUN) ? size - i : MAX_RUN;
+		const size_t run = findZero(&data[i], limit);
+
+		*out++ = (uint8_t)(run + 1U);
+		memcpy(out, &data[i], run);
+		out += run;
+		i += run;
+
+		if(run < limit)
+		{
+			i++;	// Skip the zero byte, which is implied by the code byte
+		}
+		else if(i == size)
+		{
+			break;
+		}
+	}
+
+	*out++ = SNAP_COBS_DELIMITER;
+
+	return (size_t)(out - packet);
+}
+
+/**
+ * @brief Decode a COBS packet into a frame, and validate it.
+ * @details The packet must hold exactly one frame, starting with its sync byte: unlike snap_decodeBuffer(),
+ *          bytes before or after the frame are an error, since the frame boundaries are known. If the frame
+ *          has a whitelist (see snap_setWhitelist()), an unlisted header is an error as well.
+ *          The frame status is #SNAP_STATUS_IDLE after an error, and it does not need to be reset before the next call.
+ * @param[in,out] frame  Pointer to the frame structure.
+ * @param[in]     packet Pointer to the packet (without the delimiter).
+ * @param[in]     size   Number of bytes in the packet.
+ * @return Frame status after the process, or an error code.
+ * @retval #SNAP_STATUS_VALID          Frame is complete and valid.
+ * @retval #SNAP_STATUS_ERROR_HASH     Frame is complete, but the hash value received does not match the value calculated.
+ * @retval #SNAP_STATUS_ERROR_OVERFLOW Frame does not fit in the frame buffer (only the first bytes are stored).
+ * @retval #SNAP_COBS_ERROR_FORMAT     Error: The packet is not valid COBS, or it does not hold exactly one frame.
+ */
+int8_t snap_cobsDecodeFrame(snap_frame_t *frame, const uint8_t *packet, const size_t size)
+{
+	const size_t length = unstuff(packet, size, frame->buffer, frame->maxSize);
+
+	snap_reset(frame);
+
+	if(length != SIZE_MAX)
+	{
+		const size_t stored = (length < frame->maxSize) ? length : frame->maxSize;
+		const size_t consumed = snap_decodeBuffer(frame, frame->buffer, stored);	// The frame starts at index 0, so it is copied onto itself
+
+		if(frame->size == consumed)
+		{
+			if(frame->status == SNAP_STATUS_ERROR_OVERFLOW)
+			{
+				return frame->status;
+			}
+
+			if(((frame->status == SNAP_STATUS_VALID) || (frame->status == SNAP_STATUS_ERROR_HASH)) && (consumed == length))
+			{
+				return frame->status;
+			}
+		}
+	}
+
+	snap_reset(frame);
+
+	return SNAP_COBS_ERROR_FORMAT;
+}
+
+/**
+ * @brief Initialize the receiver.
+ * @param[out] cobs Pointer to the receiver structure.
+ * @retval 0                      Success.
+ * @retval #SNAP_ERROR_NULL_FRAME Error: Receiver pointer is NULL.
+ */
+int16_t snap_cobsInit(snap_cobs_t *cobs)
+{
+	if(cobs == NULL) return SNAP_ERROR_NULL_FRAME;
+
+	snap_init(&cobs->frame, cobs->frameBuffer, sizeof(cobs->frameBuffer));
+
+	cobs->length = 0;
+	cobs->offset = 0;
+	cobs->stats.bytes = 0;
+	cobs->stats.validFrames = 0;
+	cobs->stats.hashErrors = 0;
+	cobs->stats.overflowErrors = 0;
+	cobs->stats.formatErrors = 0;
+
+	return 0;
+}
+
+/**
+ * @brief Split a block of received bytes into packets, and decode them.
+ * @details Every packet that ends in the block is decoded with snap_cobsDecodeFrame(), straight from the block
+ *          if it also starts there, and every frame found is reported through the callback, in stream order.
+ *          The bytes of a packet that does not end in the block are kept until the next call. Empty packets
+ *          (consecutive delimiters) are ignored, so delimiters can be sent as idle fill. The frame structure
+ *          passed to the callback is only valid during the call.
+ * @param[in,out] cobs     Pointer to the receiver structure.
+ * @param[in]     data     Pointer to the received bytes.
+ * @param[in]     size     Number of bytes in the array.
+ * @param[in]     callback Function called for each frame. It can be NULL (only the counters are updated).
+ * @param[in]     context  Pointer passed to the callback.
+ * @return Number of frames reported.
+ */
+size_t snap_cobsProcess(snap_cobs_t *cobs, const uint8_t *data, const size_t size, const snap_cobsCallback_t callback, void *context)
+{
+	size_t pos = 0, frames = 0;
+
+	cobs->stats.bytes += size;
+
+	while(pos < size)
+	{
+		const uint8_t *end = memchr(&data[pos], SNAP_COBS_DELIMITER, size - pos);
+		const size_t count = (end != NULL) ? (size_t)(end - &data[pos]) : size - pos;
+		const uint8_t *packet = &data[pos];
+		size_t length = count;
+
+		if((cobs->length != 0) || (end == NULL))	// Packet split across calls
+		{
+			if(cobs->length < sizeof(cobs->packet))
+			{
+				const size_t room = sizeof(cobs->packet) - cobs->length;
+
+				memcpy(&cobs->packet[cobs->length], packet, (count < room) ? count : room);
+			}
+
+			cobs->length += count;
+			packet = cobs->packet;
+			length = cobs->length;
+		}
+
+		pos += count;
+
+		if(end == NULL)
+		{
+			break;
+		}
+
+		pos++;	// Delimiter
+		cobs->length = 0;
+
+		if(length == 0)
+		{
+			continue;
+		}
+
+		const int8_t status = (length <= sizeof(cobs->packet)) ? snap_cobsDecodeFrame(&cobs->frame, packet, length) : SNAP_COBS_ERROR_FORMAT;
+
+		if(status == SNAP_COBS_ERROR_FORMAT)
+		{
+			cobs->stats.formatErrors++;
+			continue;
+		}
+
+		if(status == SNAP_STATUS_VALID)
+		{
+			cobs->stats.validFrames++;
+		}
+		else if(status == SNAP_STATUS_ERROR_HASH)
+		{
+			cobs->stats.hashErrors++;
+		}
+		else
+		{
+			cobs->stats.overflowErrors++;
+		}
+
+		if(callback != NULL)
+		{
+			callback(context, &cobs->frame, cobs->offset + pos - 1U - length);
+		}
+
+		frames++;
+	}
+
+	cobs->offset += size;
+	snap_reset(&cobs->frame);
+
+	return frames;
+}
+
+/**
+ * @}
+ */
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,139 @@
+/*
+Copyright (c) 2022 Lucas Jadilo
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file   snap_cobs.h
+ * @author Lucas Jadilo
+ * @brief  Header file of the COBS framing mode, an optional module of the libSNAP library.
+ */
+
+#ifndef SNAP_COBS_H_
+#define SNAP_COBS_H_
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/**
+ * @defgroup cobs COBS Framing
+ * @ingroup  libSNAP
+ * @brief    Optional transport framing that makes the frame boundaries explicit.
+ * @details  SNAP has no escaping, so the sync byte may appear anywhere in a frame, and a receiver that lost
+ *           the frame boundaries can only find them again by trial and error. In this mode, each standard
+ *           frame is encoded with Consistent Overhead Byte Stuffing (COBS), which removes every zero byte from
+ *           it at the cost of one byte every 254 bytes, and is followed by a zero byte (#SNAP_COBS_DELIMITER).
+ *           Every zero byte received is then a frame boundary: the receiver splits the stream with memchr() and
+ *           never misframes, and a corrupted frame costs exactly one frame.
+ *
+ *           The frames themselves are not changed (sync byte, header and hash included), so this mode can be
+ *           used on a link in place of the raw byte stream when both ends agree on it, e.g. from the link
+ *           configuration, or after a command frame exchanged in the standard mode. The encoder and decoder
+ *           work a machine word at a time: runs of non-zero bytes are found 8 bytes per step and moved with
+ *           memcpy().
+ * @{
+ */
+
+
+/******************************************************************************/
+/*  Public Includes                                                           */
+/******************************************************************************/
+
+
+#include "snap.h"
+
+
+/******************************************************************************/
+/*  Public Macros                                                             */
+/******************************************************************************/
+
+
+#define SNAP_COBS_ERROR_FORMAT	(-9)	/**< @brief The packet is not a COBS-encoded frame (bad encoding, no frame at its start, or extra/missing bytes). */
+
+#define SNAP_COBS_DELIMITER		(0x00U)	/**< @brief Value of the byte that ends every packet. */
+
+#define SNAP_COBS_SIZE_PACKET(size)	((size) + (size) / 254U + 2U)					/**< @brief Largest size of the packet that encodes @p size bytes, delimiter included. @param size Number of bytes to encode. */
+#define SNAP_COBS_MAX_SIZE_PACKET	(SNAP_COBS_SIZE_PACKET(SNAP_MAX_SIZE_FRAME))	/**< @brief Largest size of the packet that encodes a frame, delimiter included. */
+
+
+/******************************************************************************/
+/*  Public Types                                                              */
+/******************************************************************************/
+
+
+/**
+ * @brief Function called for each frame received by snap_cobsProcess().
+ * @param[in] context Pointer passed to snap_cobsProcess().
+ * @param[in] frame   Pointer to the frame structure. The status is #SNAP_STATUS_VALID, #SNAP_STATUS_ERROR_HASH or #SNAP_STATUS_ERROR_OVERFLOW.
+ * @param[in] offset  Position of the first byte of the packet in the stream (number of bytes received before it).
+ */
+typedef void (*snap_cobsCallback_t)(void *context, const snap_frame_t *frame, uint64_t offset);
+
+/**
+ * @brief Counters updated by snap_cobsProcess().
+ */
+typedef struct snap_cobsStats_t
+{
+	uint64_t bytes;				/**< @brief Number of bytes received. */
+	uint64_t validFrames;		/**< @brief Number of frames with status #SNAP_STATUS_VALID. */
+	uint64_t hashErrors;		/**< @brief Number of frames with status #SNAP_STATUS_ERROR_HASH. */
+	uint64_t overflowErrors;	/**< @brief Number of frames with status #SNAP_STATUS_ERROR_OVERFLOW. */
+	uint64_t formatErrors;		/**< @brief Number of packets that are not frames (#SNAP_COBS_ERROR_FORMAT). They are not reported to the callback. */
+} snap_cobsStats_t;
+
+/**
+ * @brief Receiver state.
+ */
+typedef struct snap_cobs_t
+{
+	snap_frame_t     frame;								/**< @brief Frame structure used by the decoder. A whitelist can be set with snap_setWhitelist(). */
+	uint8_t          frameBuffer[SNAP_MAX_SIZE_FRAME];	/**< @brief Buffer of the frame structure. */
+	uint8_t          packet[SNAP_COBS_MAX_SIZE_PACKET];	/**< @brief Packet split across calls. */
+	size_t           length;							/**< @brief Number of bytes of the packet received so far (the bytes beyond the array are dropped). */
+	uint64_t         offset;							/**< @brief Position of the next byte in the stream. */
+	snap_cobsStats_t stats;								/**< @brief Counters. */
+} snap_cobs_t;
+
+
+/******************************************************************************/
+/*  Public Function Declarations                                              */
+/******************************************************************************/
+
+
+size_t snap_cobsEncode(const uint8_t *data, size_t size, uint8_t *packet);
+
+int8_t snap_cobsDecodeFrame(snap_frame_t *frame, const uint8_t *packet, size_t size);
+
+int16_t snap_cobsInit(snap_cobs_t *cobs);
+
+size_t snap_cobsProcess(snap_cobs_t *cobs, const uint8_t *data, size_t size, snap_cobsCallback_t callback, void *context);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif	// SNAP_COBS_H_
+
+/******************************** END OF FILE *********************************/
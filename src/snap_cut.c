@@ -0,0 +1,256 @@
+/*
+Copyright (c) 2022 Lucas Jadilo
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file   snap_cut.c
+ * @author Lucas Jadilo
+ * @brief  Source file of the cut-through forwarder, an optional module of the libSNAP library.
+ */
+
+/**
+ * @addtogroup cut
+ * @{
+ */
+
+
+/******************************************************************************/
+/*  Private Includes                                                          */
+/******************************************************************************/
+
+
+#include <stddef.h>
+#include <string.h>
+#include "snap_cut.h"
+
+
+/******************************************************************************/
+/*  Private Function Definitions                                              */
+/******************************************************************************/
+
+
+/**
+ * @brief Get a value for the last byte of a frame that makes its hash wrong for sure.
+ * @param[in] frame Pointer to the complete frame structure, with status #SNAP_STATUS_ERROR_HASH.
+ * @return Complement of the correct value of the last hash byte.
+ */
+static uint8_t poisonHash(const snap_frame_t *frame)
+{
+	uint32_t hash = 0;
+
+	snap_calculateHash(frame, &hash);
+
+	return (uint8_t)~hash;	// The hash is sent MSB first, so the last byte is the LSB
+}
+
+/**
+ * @brief Update the counters, report a frame with a final status and get ready for the next one.
+ * @param[in,out] cut    Pointer to the forwarder structure.
+ * @param[in]     status Final status of the frame.
+ */
+static void finishFrame(snap_cut_t *cut, const int8_t status)
+{
+	if(status == SNAP_STATUS_VALID)
+	{
+		cut->stats.validFrames++;
+	}
+	else if(status == SNAP_STATUS_ERROR_HASH)
+	{
+		cut->stats.hashErrors++;
+	}
+	else
+	{
+		cut->stats.overflowErrors++;
+	}
+
+	if(cut->callback != NULL)
+	{
+		cut->callback(cut->context, &cut->frame, cut->port);
+	}
+
+	snap_reset(&cut->frame);
+	cut->routed = false;
+	cut->port = SNAP_CUT_NO_PORT;
+}
+
+
+/******************************************************************************/
+/*  Public Function Definitions                                               */
+/******************************************************************************/
+
+
+/**
+ * @brief Initialize the forwarder state of an input port.
+ * @param[out] cut      Pointer to the forwarder structure.
+ * @param[in]  mode     Forwarding mode.
+ * @param[in]  route    Function that decides the route of each frame.
+ * @param[in]  output   Function that sends bytes to an output port.
+ * @param[in]  callback Function called for each frame that reaches a final status. It can be NULL.
+ * @param[in]  context  Pointer passed to the functions.
+ * @retval 0                     Success.
+ * @retval #SNAP_ERROR_NULL_FRAME The forwarder structure, the route function or the output function is NULL.
+ */
+int16_t snap_cutInit(snap_cut_t *cut, const snap_cutMode_t mode, const snap_cutRoute_t route, const snap_cutOutput_t output,
+					 const snap_cutCallback_t callback, void *context)
+{
+	if((cut == NULL) || (route == NULL) || (output == NULL)) return SNAP_ERROR_NULL_FRAME;
+
+	snap_init(&cut->frame, cut->frameBuffer, sizeof(cut->frameBuffer));
+
+	cut->mode = mode;
+	cut->route = route;
+	cut->output = output;
+	cut->callback = callback;
+	cut->context = context;
+	cut->port = SNAP_CUT_NO_PORT;
+	cut->routed = false;
+	memset(&cut->stats, 0, sizeof(cut->stats));
+
+	return 0;
+}
+
+/**
+ * @brief Decode a block of received bytes and forward the frames in it.
+ * @details The frame being received is decoded byte by byte until its header and destination address are
+ *          complete, and then the route function is called once. In cut-through mode, the bytes received
+ *          so far are sent to the chosen port in one output call, and so is every later span of the frame,
+ *          straight from the block, except the last byte: it is sent after the hash check, as received if
+ *          the frame is valid, or changed so that the hash of the outgoing frame is wrong too. In
+ *          store-and-forward mode, the whole frame is sent in one output call once it is valid.
+ *
+ *          Unlike snap_decode(), the search for the next sync byte does not go back into a frame with an
+ *          error, because its bytes may already be forwarded: it resumes right after it.
+ * @param[in,out] cut  Pointer to the forwarder structure.
+ * @param[in]     data Pointer to the received bytes.
+ * @param[in]     size Number of bytes in the array.
+ * @return Number of frames that reached a final status in the block.
+ */
+size_t snap_cutProcess(snap_cut_t *cut, const uint8_t *data, const size_t size)
+{
+	snap_frame_t *frame = &cut->frame;
+	size_t i = 0, frames = 0;
+
+	cut->stats.bytes += size;
+
+	while(i < size)
+	{
+		if(!cut->routed)
+		{
+			if(frame->status == SNAP_STATUS_IDLE)
+			{
+				const uint8_t *sync = memchr(&data[i], SNAP_SYNC, size - i);
+
+				if(sync == NULL)
+				{
+					break;
+				}
+
+				i = (size_t)(sync - data);
+			}
+
+			const int8_t status = snap_decode(frame, data[i++]);
+
+			if(status == SNAP_STATUS_ERROR_OVERFLOW)	// Too large for the buffer: it cannot be checked, so it is never forwarded
+			{
+				finishFrame(cut, status);
+				frames++;
+				continue;
+			}
+
+			if((status == SNAP_STATUS_IDLE) || (frame->size < SNAP_INDEX_DAB + SNAP_HDB2_DAB(frame->buffer)))
+			{
+				continue;
+			}
+
+			cut->routed = true;
+			cut->port = cut->route(cut->context, frame);
+
+			if(status != SNAP_STATUS_INCOMPLETE)	// Frame without payload nor hash: nothing to cut through
+			{
+				if((cut->port >= 0) && (status == SNAP_STATUS_VALID))
+				{
+					cut->output(cut->context, cut->port, frame->buffer, frame->size);
+					cut->stats.forwardedFrames++;
+				}
+
+				finishFrame(cut, status);
+				frames++;
+			}
+			else if((cut->port >= 0) && (cut->mode == SNAP_CUT_MODE_CUT_THROUGH))
+			{
+				cut->output(cut->context, cut->port, frame->buffer, frame->size);
+			}
+
+			continue;
+		}
+
+		const size_t start = i;
+
+		i += snap_decodeBuffer(frame, &data[i], size - i);
+
+		const bool cutThrough = (cut->port >= 0) && (cut->mode == SNAP_CUT_MODE_CUT_THROUGH);
+
+		if(frame->status == SNAP_STATUS_INCOMPLETE)
+		{
+			if(cutThrough)
+			{
+				cut->output(cut->context, cut->port, &data[start], i - start);
+			}
+
+			continue;
+		}
+
+		if(cutThrough)
+		{
+			if(i - 1U > start)
+			{
+				cut->output(cut->context, cut->port, &data[start], i - 1U - start);
+			}
+
+			uint8_t last = data[i - 1U];
+
+			if(frame->status == SNAP_STATUS_ERROR_HASH)
+			{
+				last = poisonHash(frame);
+				cut->stats.poisonedFrames++;
+			}
+
+			cut->output(cut->context, cut->port, &last, 1);
+			cut->stats.forwardedFrames++;
+		}
+		else if((cut->port >= 0) && (frame->status == SNAP_STATUS_VALID))
+		{
+			cut->output(cut->context, cut->port, frame->buffer, frame->size);
+			cut->stats.forwardedFrames++;
+		}
+
+		finishFrame(cut, frame->status);
+		frames++;
+	}
+
+	return frames;
+}
+
+/**
+ * @}
+ */
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,165 @@
+/*
+Copyright (c) 2022 Lucas Jadilo
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file   snap_cut.h
+ * @author Lucas Jadilo
+ * @brief  Header file of the cut-through forwarder, an optional module of the libSNAP library.
+ */
+
+#ifndef SNAP_CUT_H_
+#define SNAP_CUT_H_
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/**
+ * @defgroup cut Cut-Through Forwarding
+ * @ingroup  libSNAP
+ * @brief    Forward frames between ports as their bytes arrive, for gateways and bridges.
+ * @details  A gateway that stores a whole frame before forwarding it delays every frame by its full
+ *           transmission time at each hop (about 45 ms for a 512-byte frame at 115200 baud). In cut-through
+ *           mode, the route of a frame is decided as soon as its header and destination address are decoded,
+ *           and from then on every byte received is passed on to the output port within the same call,
+ *           straight from the input block. Only the last byte of the frame is held back until the hash is
+ *           checked: if the hash is wrong, that byte is replaced by one that is sure to break the hash of the
+ *           outgoing frame, so the next node drops it as it would have dropped the original frame.
+ *           Multi-hop latency is then about one header time per hop instead of one frame time.
+ *
+ *           In store-and-forward mode, the same route decision is made, but a frame is passed on only once it
+ *           is complete and valid, and frames with a hash error are dropped.
+ *
+ *           Every frame also reaches a final status locally and is reported to a callback, whether it was
+ *           forwarded or not (e.g. frames addressed to the gateway itself).
+ * @{
+ */
+
+
+/******************************************************************************/
+/*  Public Includes                                                           */
+/******************************************************************************/
+
+
+#include <stddef.h>
+#include "snap.h"
+
+
+/******************************************************************************/
+/*  Public Macros                                                             */
+/******************************************************************************/
+
+
+#define SNAP_CUT_NO_PORT	(-1)	/**< @brief Route of a frame that is not forwarded. */
+
+
+/******************************************************************************/
+/*  Public Types                                                              */
+/******************************************************************************/
+
+
+/**
+ * @brief Forwarding mode.
+ */
+typedef enum snap_cutMode_t
+{
+	SNAP_CUT_MODE_CUT_THROUGH       = 0,	/**< Forward the bytes as they arrive, once the route is known. */
+	SNAP_CUT_MODE_STORE_AND_FORWARD = 1		/**< Forward complete and valid frames only. */
+} snap_cutMode_t;
+
+/**
+ * @brief Function that decides the route of a frame.
+ * @param[in] context Pointer passed to snap_cutInit().
+ * @param[in] frame   Pointer to the frame structure. The header and the destination address are complete (the
+ *                    status is #SNAP_STATUS_INCOMPLETE, or #SNAP_STATUS_VALID for a frame that ends with them).
+ * @return Output port (0 or more), or #SNAP_CUT_NO_PORT if the frame must not be forwarded.
+ */
+typedef int16_t (*snap_cutRoute_t)(void *context, const snap_frame_t *frame);
+
+/**
+ * @brief Function that sends bytes to an output port.
+ * @param[in] context Pointer passed to snap_cutInit().
+ * @param[in] port    Output port returned by the route function.
+ * @param[in] data    Pointer to the bytes (valid only during the call).
+ * @param[in] size    Number of bytes.
+ */
+typedef void (*snap_cutOutput_t)(void *context, int16_t port, const uint8_t *data, size_t size);
+
+/**
+ * @brief Function called for each frame that reaches a final status.
+ * @param[in] context Pointer passed to snap_cutInit().
+ * @param[in] frame   Pointer to the frame structure. The status is #SNAP_STATUS_VALID, #SNAP_STATUS_ERROR_HASH or #SNAP_STATUS_ERROR_OVERFLOW.
+ * @param[in] port    Output port the frame was forwarded to, or #SNAP_CUT_NO_PORT.
+ */
+typedef void (*snap_cutCallback_t)(void *context, const snap_frame_t *frame, int16_t port);
+
+/**
+ * @brief Counters updated by snap_cutProcess().
+ */
+typedef struct snap_cutStats_t
+{
+	uint64_t bytes;				/**< @brief Number of bytes received. */
+	uint64_t validFrames;		/**< @brief Number of frames with status #SNAP_STATUS_VALID. */
+	uint64_t hashErrors;		/**< @brief Number of frames with status #SNAP_STATUS_ERROR_HASH. */
+	uint64_t overflowErrors;	/**< @brief Number of frames with status #SNAP_STATUS_ERROR_OVERFLOW. */
+	uint64_t forwardedFrames;	/**< @brief Number of frames forwarded (in cut-through mode, including the poisoned ones). */
+	uint64_t poisonedFrames;	/**< @brief Number of frames forwarded with a hash broken on purpose (cut-through mode). */
+} snap_cutStats_t;
+
+/**
+ * @brief Forwarder state of an input port.
+ */
+typedef struct snap_cut_t
+{
+	snap_frame_t       frame;								/**< @brief Frame being received. A whitelist can be set with snap_setWhitelist(). */
+	uint8_t            frameBuffer[SNAP_MAX_SIZE_FRAME];	/**< @brief Buffer of the frame structure. */
+	snap_cutMode_t     mode;								/**< @brief Forwarding mode (it can be changed between frames). */
+	snap_cutRoute_t    route;								/**< @brief Route function. */
+	snap_cutOutput_t   output;								/**< @brief Output function. */
+	snap_cutCallback_t callback;							/**< @brief Callback of the final status (optional). */
+	void               *context;							/**< @brief Pointer passed to the functions. */
+	int16_t            port;								/**< @brief Route of the current frame. */
+	bool               routed;								/**< @brief The route of the current frame has been decided. */
+	snap_cutStats_t    stats;								/**< @brief Counters. */
+} snap_cut_t;
+
+
+/******************************************************************************/
+/*  Public Function Declarations                                              */
+/******************************************************************************/
+
+
+int16_t snap_cutInit(snap_cut_t *cut, snap_cutMode_t mode, snap_cutRoute_t route, snap_cutOutput_t output, snap_cutCallback_t callback, void *context);
+
+size_t snap_cutProcess(snap_cut_t *cut, const uint8_t *data, size_t size);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif	// SNAP_CUT_H_
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,308 @@
+/*
+Copyright (c) 2022 Lucas Jadilo
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file   snap_gather.c
+ * @author Lucas Jadilo
+ * @brief  Source file of the gather encoder, an optional module of the libSNAP library.
+ */
+
+/**
+ * @addtogroup gather
+ * @{
+ */
+
+
+/******************************************************************************/
+/*  Private Includes                                                          */
+/******************************************************************************/
+
+
+#include <string.h>
+#include "snap_gather.h"
+
+
+/******************************************************************************/
+/*  Private Macros                                                            */
+/******************************************************************************/
+
+
+#define MAX_SIZE_DATA	(512U)	// Size of the largest payload (NDB = 14)
+
+
+/******************************************************************************/
+/*  Private Variables                                                         */
+/******************************************************************************/
+
+
+/* CRC of each 4-bit value (the CRCs are computed a nibble at a time, with the parameters of snap.c). */
+
+static const uint8_t tableCrc8[16] =
+{
+	0x00, 0x9D, 0x23, 0xBE, 0x46, 0xDB, 0x65, 0xF8, 0x8C, 0x11, 0xAF, 0x32, 0xCA, 0x57, 0xE9, 0x74
+};
+
+static const uint16_t tableCrc16[16] =
+{
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+static const uint32_t tableCrc32[16] =
+{
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+
+/******************************************************************************/
+/*  Private Function Definitions                                              */
+/******************************************************************************/
+
+
+/**
+ * @brief Resume the hash calculation over the next piece of a frame.
+ * @param[in] edm  EDM value (#SNAP_HDB1_EDM_8BIT_CHECKSUM to #SNAP_HDB1_EDM_32BIT_CRC).
+ * @param[in] hash Hash state after the previous pieces (0 before the first piece, 0xFFFFFFFF for the 32-bit CRC).
+ * @param[in] data Pointer to the piece.
+ * @param[in] size Number of bytes in the piece.
+ * @return Hash state after the piece.
+ */
+static uint32_t updateHash(const uint8_t edm, uint32_t hash, const uint8_t *data, const size_t size)
+{
+	switch(edm)
+	{
+		case SNAP_HDB1_EDM_8BIT_CHECKSUM:
+			for(size_t i = 0; i < size; i++)
+			{
+				hash = (hash + data[i]) & 0xFFU;
+			}
+			break;
+		case SNAP_HDB1_EDM_8BIT_CRC:
+			for(size_t i = 0; i < size; i++)
+			{
+				hash ^= data[i];
+				hash = (hash >> 4) ^ tableCrc8[hash & 0x0FU];
+				hash = (hash >> 4) ^ tableCrc8[hash & 0x0FU];
+			}
+			break;
+		case SNAP_HDB1_EDM_16BIT_CRC:
+			for(size_t i = 0; i < size; i++)
+			{
+				hash = ((hash << 4) & 0xFFFFU) ^ tableCrc16[(hash >> 12) ^ (data[i] >> 4)];
+				hash = ((hash << 4) & 0xFFFFU) ^ tableCrc16[(hash >> 12) ^ (data[i] & 0x0FU)];
+			}
+			break;
+		default:	// SNAP_HDB1_EDM_32BIT_CRC
+			for(size_t i = 0; i < size; i++)
+			{
+				hash ^= data[i];
+				hash = (hash >> 4) ^ tableCrc32[hash & 0x0FU];
+				hash = (hash >> 4) ^ tableCrc32[hash & 0x0FU];
+			}
+			break;
+	}
+
+	return hash;
+}
+
+/**
+ * @brief Calculate the hash value of a frame described by its pieces (the sync byte is not included).
+ * @param[in] edm    EDM value of the frame.
+ * @param[in] pieces Pointer to the pieces: prefix without the sync byte, data and trailer without the hash.
+ * @param[in] count  Number of pieces.
+ * @return Hash value.
+ */
+static uint32_t calculateHash(const uint8_t edm, const snap_gatherPiece_t *pieces, const uint8_t count)
+{
+	if(edm == SNAP_HDB1_EDM_USER_SPECIFIED)
+	{
+		uint8_t bytes[SNAP_MAX_SIZE_FRAME];
+		uint16_t size = 0;
+
+		for(uint8_t i = 0; i < count; i++)
+		{
+			memcpy(&bytes[size], pieces[i].base, pieces[i].length);
+			size = (uint16_t)(size + pieces[i].length);
+		}
+
+		return snap_calculateUserHash(bytes, size);
+	}
+
+	uint32_t hash = (edm == SNAP_HDB1_EDM_32BIT_CRC) ? 0xFFFFFFFFU : 0U;
+
+	for(uint8_t i = 0; i < count; i++)
+	{
+		hash = updateHash(edm, hash, pieces[i].base, pieces[i].length);
+	}
+
+	return (edm == SNAP_HDB1_EDM_32BIT_CRC) ? ~hash : hash;
+}
+
+
+/******************************************************************************/
+/*  Public Function Definitions                                               */
+/******************************************************************************/
+
+
+/**
+ * @brief Build a frame as a list of pieces, without copying the data.
+ * @details The frame is the same as the one built by snap_encapsulate() with the same fields. The data
+ *          piece points to @p fields->data, which must stay unchanged until the frame is sent.
+ * @param[out]    gather Pointer to the gather structure.
+ * @param[in,out] fields Pointer to the structure that contains every data needed to build the frame.
+ *                       Fields that do not match the frame format will be ignored.
+ *                       The NDB value is always ignored because it will be calculated from the data size.
+ *                       If data pointer is NULL or data size is zero, the frame will have no payload.
+ * @return Frame status after the process (value from #snap_status_t).
+ * @retval #SNAP_STATUS_VALID          Frame created successfully.
+ * @retval #SNAP_STATUS_ERROR_OVERFLOW Error: The data has more than 512 bytes. The frame has no pieces.
+ */
+int8_t snap_gatherEncode(snap_gather_t *gather, snap_fields_t *fields)
+{
+	if(fields->data == NULL)
+	{
+		fields->dataSize = 0;
+	}
+
+	if(fields->dataSize > MAX_SIZE_DATA)
+	{
+		gather->count = 0;
+		gather->size = 0;
+		return SNAP_STATUS_ERROR_OVERFLOW;
+	}
+
+	fields->header.ndb = snap_getNdbFromDataSize(fields->dataSize) & SNAP_HDB1_NDB_MASK;
+
+	const uint_fast16_t paddingSize = (uint_fast16_t)(snap_getDataSizeFromNdb(fields->header.ndb) - fields->dataSize);
+	const uint_fast8_t hashSize = snap_getHashSizeFromEdm(fields->header.edm);
+	uint8_t *buffer = gather->buffer;
+	uint_fast16_t size = SNAP_INDEX_DAB;
+
+	buffer[SNAP_INDEX_SYNC] = SNAP_SYNC;
+
+	buffer[SNAP_INDEX_HDB2] = (uint8_t)((fields->header.dab << SNAP_HDB2_DAB_POS) |
+	                                    (fields->header.sab << SNAP_HDB2_SAB_POS) |
+	                                    (fields->header.pfb << SNAP_HDB2_PFB_POS) |
+	                                    (fields->header.ack << SNAP_HDB2_ACK_POS));
+
+	buffer[SNAP_INDEX_HDB1] = (uint8_t)((fields->header.cmd << SNAP_HDB1_CMD_POS) |
+	                                    (fields->header.edm << SNAP_HDB1_EDM_POS) |
+	                                    (fields->header.ndb << SNAP_HDB1_NDB_POS));
+
+	for(uint_fast8_t i = fields->header.dab; i != 0; i--)
+	{
+		buffer[size++] = (fields->destAddress >> ((i - 1) * 8)) & 0xFF;
+	}
+
+	for(uint_fast8_t i = fields->header.sab; i != 0; i--)
+	{
+		buffer[size++] = (fields->sourceAddress >> ((i - 1) * 8)) & 0xFF;
+	}
+
+	for(uint_fast8_t i = fields->header.pfb; i != 0; i--)
+	{
+		buffer[size++] = (fields->protocolFlags >> ((i - 1) * 8)) & 0xFF;
+	}
+
+	if(!fields->paddingAfter)
+	{
+		memset(&buffer[size], SNAP_PADDING, paddingSize);
+		size += paddingSize;
+	}
+
+	uint8_t *trailer = &buffer[size];
+	uint_fast16_t trailerSize = 0;
+
+	if(fields->paddingAfter)
+	{
+		memset(trailer, SNAP_PADDING, paddingSize);
+		trailerSize = paddingSize;
+	}
+
+	gather->count = 0;
+	gather->pieces[gather->count++] = (snap_gatherPiece_t){.base = buffer, .length = size};
+
+	if(fields->dataSize)
+	{
+		gather->pieces[gather->count++] = (snap_gatherPiece_t){.base = fields->data, .length = fields->dataSize};
+	}
+
+	if(trailerSize)
+	{
+		gather->pieces[gather->count++] = (snap_gatherPiece_t){.base = trailer, .length = trailerSize};
+	}
+
+	if(hashSize)
+	{
+		snap_gatherPiece_t pieces[SNAP_GATHER_MAX_PIECES];
+
+		memcpy(pieces, gather->pieces, gather->count * sizeof(snap_gatherPiece_t));
+		pieces[0].base = &buffer[SNAP_INDEX_HDB2];	// Hash calculation does not include the sync byte
+		pieces[0].length--;
+
+		const uint32_t hashValue = calculateHash(fields->header.edm & SNAP_HDB1_EDM_MASK, pieces, gather->count);
+
+		for(uint_fast8_t i = hashSize; i != 0; i--)
+		{
+			trailer[trailerSize++] = (hashValue >> ((i - 1) * 8)) & 0xFF;
+		}
+
+		if(trailerSize == hashSize)
+		{
+			gather->pieces[gather->count++] = (snap_gatherPiece_t){.base = trailer, .length = trailerSize};
+		}
+		else
+		{
+			gather->pieces[gather->count - 1U].length = trailerSize;
+		}
+	}
+
+	gather->size = (uint16_t)(size + fields->dataSize + trailerSize);
+
+	return SNAP_STATUS_VALID;
+}
+
+/**
+ * @brief Copy the pieces of a frame into a contiguous buffer, e.g. for a transport without gather support.
+ * @param[in]  gather Pointer to the gather structure.
+ * @param[out] buffer Pointer to the buffer (it must hold gather->size bytes).
+ * @return Number of bytes copied (gather->size).
+ */
+uint16_t snap_gatherCopy(const snap_gather_t *gather, uint8_t *buffer)
+{
+	size_t size = 0;
+
+	for(uint8_t i = 0; i < gather->count; i++)
+	{
+		memcpy(&buffer[size], gather->pieces[i].base, gather->pieces[i].length);
+		size += gather->pieces[i].length;
+	}
+
+	return (uint16_t)size;
+}
+
+/**
+ * @}
+ */
+
+/******************************** END OF FILE *********************************/
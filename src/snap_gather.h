@@ -0,0 +1,123 @@
+/*
+Copyright (c) 2022 Lucas Jadilo
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file   snap_gather.h
+ * @author Lucas Jadilo
+ * @brief  Header file of the gather encoder, an optional module of the libSNAP library.
+ */
+
+#ifndef SNAP_GATHER_H_
+#define SNAP_GATHER_H_
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/**
+ * @defgroup gather Gather Encoder
+ * @ingroup  libSNAP
+ * @brief    Frame encoder that leaves the data where it is.
+ * @details  snap_encapsulate() writes the whole frame into the frame buffer, so the data is copied once
+ *           before being sent, and once more into the transport buffer. This encoder writes only the bytes
+ *           that surround the data, i.e. the prefix (sync byte, header, addresses, flags and padding before
+ *           the data) and the trailer (padding after the data and hash), into a small buffer, and describes
+ *           the frame as a list of up to #SNAP_GATHER_MAX_PIECES pieces: prefix, data (the caller's array)
+ *           and trailer. The pieces have the members of <tt>struct iovec</tt>, in the same order, so on POSIX
+ *           hosts they can be sent as they are with writev() or a vectored io_uring request.
+ *
+ *           The hash is computed piece by piece, resuming the calculation where the previous piece left it,
+ *           with the standard algorithms of snap_calculateChecksum8(), snap_calculateCrc8(),
+ *           snap_calculateCrc16() and snap_calculateCrc32() (the results are the same, but overrides of those
+ *           functions are not used). The user-specified hash cannot be resumed, so for that method the bytes
+ *           are gathered into a temporary buffer and passed to snap_calculateUserHash().
+ *
+ *           The data must not change until the frame is sent.
+ * @{
+ */
+
+
+/******************************************************************************/
+/*  Public Includes                                                           */
+/******************************************************************************/
+
+
+#include <stddef.h>
+#include "snap.h"
+
+
+/******************************************************************************/
+/*  Public Macros                                                             */
+/******************************************************************************/
+
+
+#define SNAP_GATHER_MAX_PIECES	(3U)	/**< @brief Largest number of pieces of a frame (prefix, data and trailer). */
+
+#define SNAP_GATHER_SIZE_BUFFER	(SNAP_INDEX_DAB + 9U + 255U + 4U)	/**< @brief Size of the buffer of the prefix and trailer = 3 (sync and header) + 9 (addresses and flags) + 255 (padding) + 4 (hash). */
+
+
+/******************************************************************************/
+/*  Public Types                                                              */
+/******************************************************************************/
+
+
+/**
+ * @brief Piece of a frame: a contiguous array of bytes. It has the members of <tt>struct iovec</tt>, in the same order.
+ */
+typedef struct snap_gatherPiece_t
+{
+	const void *base;	/**< @brief Pointer to the first byte. */
+	size_t     length;	/**< @brief Number of bytes. */
+} snap_gatherPiece_t;
+
+/**
+ * @brief Frame described as a list of pieces.
+ */
+typedef struct snap_gather_t
+{
+	uint8_t            buffer[SNAP_GATHER_SIZE_BUFFER];		/**< @brief Prefix, followed by the trailer. */
+	snap_gatherPiece_t pieces[SNAP_GATHER_MAX_PIECES];		/**< @brief Pieces of the frame, in order. Empty pieces are left out. */
+	uint8_t            count;								/**< @brief Number of pieces. */
+	uint16_t           size;								/**< @brief Size of the frame (sum of the piece lengths). */
+} snap_gather_t;
+
+
+/******************************************************************************/
+/*  Public Function Declarations                                              */
+/******************************************************************************/
+
+
+int8_t snap_gatherEncode(snap_gather_t *gather, snap_fields_t *fields);
+
+uint16_t snap_gatherCopy(const snap_gather_t *gather, uint8_t *buffer);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif	// SNAP_GATHER_H_
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,300 @@
+/*
+Copyright (c) 2022 Lucas Jadilo
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file   snap_link.c
+ * @author Lucas Jadilo
+ * @brief  Source file of the link quality estimator, an optional module of the libSNAP library.
+ */
+
+/**
+ * @addtogroup link
+ * @{
+ */
+
+
+/******************************************************************************/
+/*  Private Includes                                                          */
+/******************************************************************************/
+
+
+#include <stddef.h>
+#include "snap_link.h"
+
+
+/******************************************************************************/
+/*  Private Macros                                                            */
+/******************************************************************************/
+
+
+#define EDM_FIRST	(SNAP_HDB1_EDM_8BIT_CHECKSUM)	// Weakest (and cheapest) EDM that can be chosen.
+#define EDM_LAST	(SNAP_HDB1_EDM_32BIT_CRC)		// Strongest (and most expensive) EDM that can be chosen.
+#define Q_BITS		(30U)							// Fraction bits of the probabilities used by snap_linkGetDataSize().
+#define Q_ONE		(1ULL << Q_BITS)
+
+
+/******************************************************************************/
+/*  Private Variables                                                         */
+/******************************************************************************/
+
+
+static const snap_linkConfig_t defaultConfig = {32U, 6U, 4U, 0x3CU, 256U};
+
+/*
+ * Fraction of the corrupted frames that each EDM detects, as -log2 of the fraction it misses. The values are
+ * conservative: a checksum misses reordered bytes and compensating errors, so it is counted below 8 bits.
+ */
+static const uint8_t detectionLog2[8] = {0, 0, 6, 8, 16, 32, 0, 0};
+
+
+/******************************************************************************/
+/*  Private Function Definitions                                              */
+/******************************************************************************/
+
+
+/**
+ * @brief Check if an EDM keeps the rate of undetected corrupted frames within the target.
+ * @param[in] errorRate  Frame error rate, in units of 2^-32.
+ * @param[in] edm        EDM (#EDM_FIRST to #EDM_LAST).
+ * @param[in] targetLog2 Target, as -log2 of the rate of undetected corrupted frames (margin included).
+ * @retval true  errorRate * 2^-detectionLog2[edm] <= 2^-targetLog2.
+ * @retval false Otherwise.
+ */
+static bool meetsTarget(const uint64_t errorRate, const uint8_t edm, const uint_fast8_t targetLog2)
+{
+	const int_fast16_t limitLog2 = (int_fast16_t)(32 + detectionLog2[edm]) - (int_fast16_t)targetLog2;
+
+	if(limitLog2 < 0)  return errorRate == 0;
+	if(limitLog2 > 32) return true;
+
+	return errorRate <= (1ULL << limitLog2);
+}
+
+/**
+ * @brief Find the cheapest allowed EDM that meets the target.
+ * @param[in] link       Pointer to the link structure.
+ * @param[in] targetLog2 Target, as -log2 of the rate of undetected corrupted frames (margin included).
+ * @return EDM, or the strongest allowed EDM if none meets the target.
+ */
+static uint8_t cheapestEdm(const snap_link_t *link, const uint_fast8_t targetLog2)
+{
+	uint8_t strongest = EDM_FIRST;
+
+	for(uint8_t edm = EDM_FIRST; edm <= EDM_LAST; edm++)
+	{
+		if((link->config.edmMask & (1U << edm)) == 0) continue;
+
+		if(meetsTarget(link->errorRate, edm, targetLog2))
+		{
+			return edm;
+		}
+
+		strongest = edm;
+	}
+
+	return strongest;
+}
+
+/**
+ * @brief Raise a probability to an integer power.
+ * @param[in] base     Probability, in units of 2^-#Q_BITS.
+ * @param[in] exponent Power.
+ * @return base^exponent, in units of 2^-#Q_BITS.
+ */
+static uint64_t power(uint64_t base, uint_fast16_t exponent)
+{
+	uint64_t result = Q_ONE;
+
+	while(exponent != 0)
+	{
+		if(exponent & 1U)
+		{
+			result = (result * base) >> Q_BITS;
+		}
+
+		base = (base * base) >> Q_BITS;
+		exponent >>= 1;
+	}
+
+	return result;
+}
+
+
+/******************************************************************************/
+/*  Public Function Definitions                                               */
+/******************************************************************************/
+
+
+/**
+ * @brief Initialize the link state.
+ * @details The error rate starts at zero, and the initial EDM is kept for at least
+ *          #snap_linkConfig_t::holdFrames updates unless errors are reported.
+ * @param[out] link   Pointer to the link structure.
+ * @param[in]  config Pointer to the parameters, or NULL for the defaults (one undetected corrupted frame every
+ *                    2^32 frames, average over 64 updates, margin of 16, any EDM, hold of 256 updates).
+ * @param[in]  edm    Initial EDM (#snap_hdb1_edm_t).
+ * @retval 0                       Success.
+ * @retval #SNAP_ERROR_NULL_FRAME  Error: Link pointer is NULL.
+ * @retval #SNAP_LINK_ERROR_CONFIG Error: A parameter is out of range, or no EDM can be chosen.
+ */
+int16_t snap_linkInit(snap_link_t *link, const snap_linkConfig_t *config, const uint8_t edm)
+{
+	if(link == NULL) return SNAP_ERROR_NULL_FRAME;
+
+	if(config == NULL)
+	{
+		config = &defaultConfig;
+	}
+
+	if((config->targetLog2 == 0) || (config->targetLog2 > 63U) || (config->averageLog2 > 16U) ||
+	   (config->marginLog2 > 16U) || ((config->edmMask & 0x3CU) == 0))
+	{
+		return SNAP_LINK_ERROR_CONFIG;
+	}
+
+	link->config = *config;
+	link->errorRate = 0;
+	link->frameSize = 0;
+	link->frames = 0;
+	link->errors = 0;
+	link->hold = 0;
+	link->edm = edm & SNAP_HDB1_EDM_MASK;
+
+	return 0;
+}
+
+/**
+ * @brief Report the outcome of an exchange with the destination and get the EDM of the next frames.
+ * @param[in,out] link      Pointer to the link structure.
+ * @param[in]     event     Outcome (#snap_linkEvent_t).
+ * @param[in]     frameSize Size of the frame received or sent (0 if unknown, e.g. bytes lost in a resync).
+ * @return EDM that the next frames sent to the destination should use (#snap_hdb1_edm_t).
+ */
+uint8_t snap_linkUpdate(snap_link_t *link, const snap_linkEvent_t event, const uint16_t frameSize)
+{
+	const uint_fast8_t shift = link->config.averageLog2;
+	const uint_fast8_t target = link->config.targetLog2;
+	const bool allowed = (link->edm >= EDM_FIRST) && (link->edm <= EDM_LAST) && (link->config.edmMask & (1U << link->edm));
+
+	// Exponential moving average; the decrease is rounded up, so a clean link reaches zero.
+	if(event != SNAP_LINK_EVENT_VALID)
+	{
+		link->errorRate += (SNAP_LINK_RATE_ONE - link->errorRate) >> shift;
+		link->errors++;
+	}
+	else
+	{
+		link->errorRate -= (link->errorRate + (1ULL << shift) - 1U) >> shift;
+	}
+
+	if(frameSize != 0)
+	{
+		const uint32_t size = (uint32_t)frameSize << 8;
+
+		if(link->frameSize == 0)
+		{
+			link->frameSize = size;
+		}
+		else if(size >= link->frameSize)
+		{
+			link->frameSize += (size - link->frameSize) >> shift;
+		}
+		else
+		{
+			link->frameSize -= (link->frameSize - size) >> shift;
+		}
+	}
+
+	link->frames++;
+
+	if(link->hold < UINT16_MAX)
+	{
+		link->hold++;
+	}
+
+	uint8_t edm = link->edm;
+
+	if(!allowed || !meetsTarget(link->errorRate, link->edm, target))
+	{
+		edm = cheapestEdm(link, (uint_fast8_t)(target + link->config.marginLog2));
+	}
+	else if(link->hold >= link->config.holdFrames)
+	{
+		const uint8_t weaker = cheapestEdm(link, (uint_fast8_t)(target + link->config.marginLog2));
+
+		if(weaker < link->edm)
+		{
+			edm = weaker;
+		}
+	}
+
+	if(edm != link->edm)
+	{
+		link->edm = edm;
+		link->hold = 0;
+	}
+
+	return link->edm;
+}
+
+/**
+ * @brief Get the data size that maximizes the expected goodput to the destination.
+ * @details Each byte is assumed to be corrupted independently, with the probability p given by the average
+ *          error rate and frame size. For each NDB bucket of d data bytes, the expected goodput is
+ *          d / (d + overhead) * (1 - p)^(d + overhead); the largest bucket among the best ones is returned.
+ * @param[in] link        Pointer to the link structure.
+ * @param[in] overhead    Number of bytes of a frame besides the data (sync, header, addresses, flags and hash).
+ * @param[in] maxDataSize Largest data size allowed (e.g. by the frame buffers). Values below 1 are taken as 1.
+ * @return Number of data bytes per frame (1 to 8, 16, 32, 64, 128, 256 or 512). It is 1 if no bucket is expected to deliver anything.
+ */
+uint16_t snap_linkGetDataSize(const snap_link_t *link, const uint16_t overhead, const uint16_t maxDataSize)
+{
+	const uint64_t frameSize = (link->frameSize >= 256U) ? (link->frameSize >> 8) : 1U;
+	const uint64_t byteErrors = ((link->errorRate >> (32U - Q_BITS)) + frameSize / 2U) / frameSize;
+	const uint64_t success = (byteErrors < Q_ONE) ? (Q_ONE - byteErrors) : 0;
+	uint16_t best = 1;
+	uint64_t bestGoodput = 0;
+
+	for(uint8_t ndb = SNAP_HDB1_NDB_1BYTE_DATA; ndb <= SNAP_HDB1_NDB_512BYTE_DATA; ndb++)
+	{
+		const uint16_t dataSize = snap_getDataSizeFromNdb(ndb);
+
+		if((dataSize > maxDataSize) && (ndb != SNAP_HDB1_NDB_1BYTE_DATA)) break;
+
+		const uint_fast16_t size = (uint_fast16_t)(dataSize + overhead);
+		const uint64_t goodput = dataSize * power(success, size) / size;
+
+		if((goodput != 0) && (goodput >= bestGoodput))
+		{
+			best = dataSize;
+			bestGoodput = goodput;
+		}
+	}
+
+	return best;
+}
+
+/**
+ * @}
+ */
+
+/******************************** END OF FILE *********************************/
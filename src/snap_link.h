@@ -0,0 +1,151 @@
+/*
+Copyright (c) 2022 Lucas Jadilo
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file   snap_link.h
+ * @author Lucas Jadilo
+ * @brief  Header file of the link quality estimator, an optional module of the libSNAP library.
+ */
+
+#ifndef SNAP_LINK_H_
+#define SNAP_LINK_H_
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/**
+ * @defgroup link Link Quality
+ * @ingroup  libSNAP
+ * @brief    Estimate the frame error rate of a link and choose the error detection method (EDM) of the next frames.
+ * @details  One #snap_link_t is kept per destination. The outcome of every exchange with that destination
+ *           (frame received, hash error, resync, NACK) is given to snap_linkUpdate(), which keeps a moving
+ *           average of the frame error rate (in fixed point, no floating point is used) and returns the EDM
+ *           that the next frames sent to that destination should use.
+ *
+ *           The policy chooses the cheapest EDM (fewest hash bytes, then least CPU time) whose rate of
+ *           undetected corrupted frames, i.e. the frame error rate times the fraction of corrupted frames the
+ *           EDM fails to detect, stays below the configured target. A stronger EDM only costs bytes, so this is
+ *           also the EDM that maximizes the goodput. To avoid switching back and forth:
+ *           - the link moves to a stronger EDM as soon as the current one misses the target;
+ *           - the link only moves to a weaker EDM after #snap_linkConfig_t::holdFrames updates without
+ *             switches, and if that EDM meets the target with a margin of 2^#snap_linkConfig_t::marginLog2.
+ *
+ *           Only the EDMs with a hash are chosen (8-bit checksum, 8-bit CRC, 16-bit CRC and 32-bit CRC), since
+ *           the library does not implement 3-retransmission or FEC, and the strength of a user-defined hash is
+ *           unknown.
+ *
+ *           The size of the frames is averaged as well, which gives the error rate per byte. From it,
+ *           snap_linkGetDataSize() picks the data size (one of the NDB buckets) that maximizes the expected
+ *           goodput: on a clean link the largest frames waste the fewest bytes in headers and hashes, while on a
+ *           noisy one smaller frames are lost less often. Messages longer than that size should be split into
+ *           chunks of that size by the sender.
+ * @{
+ */
+
+
+/******************************************************************************/
+/*  Public Includes                                                           */
+/******************************************************************************/
+
+
+#include "snap.h"
+
+
+/******************************************************************************/
+/*  Public Macros                                                             */
+/******************************************************************************/
+
+
+#define SNAP_LINK_ERROR_CONFIG	(-8)	/**< @brief Invalid link configuration. */
+
+#define SNAP_LINK_RATE_ONE		(1ULL << 32)	/**< @brief Error rate of a link where every frame is lost (the error rate is a fraction in units of 2^-32). */
+
+#define snap_linkGetEdm(pLink)			((pLink)->edm)			/**< @brief Get the EDM that the next frames should use. @param pLink Pointer to the link structure (#snap_link_t*). */
+#define snap_linkGetErrorRate(pLink)	((pLink)->errorRate)	/**< @brief Get the average frame error rate, in units of 2^-32 (see #SNAP_LINK_RATE_ONE). @param pLink Pointer to the link structure (#snap_link_t*). */
+
+
+/******************************************************************************/
+/*  Public Types                                                              */
+/******************************************************************************/
+
+
+/**
+ * @brief Outcome of an exchange with the destination, given to snap_linkUpdate().
+ */
+typedef enum snap_linkEvent_t
+{
+	SNAP_LINK_EVENT_VALID      = 0,	/**< A valid frame was received from the destination, or it acknowledged a frame (ACK). */
+	SNAP_LINK_EVENT_HASH_ERROR = 1,	/**< A frame was received with a hash error (#SNAP_STATUS_ERROR_HASH). */
+	SNAP_LINK_EVENT_RESYNC     = 2,	/**< The decoder lost the frame boundaries (e.g. #SNAP_STATUS_ERROR_OVERFLOW, or bytes discarded before a sync byte). */
+	SNAP_LINK_EVENT_NACK       = 3	/**< The destination rejected a frame (NACK), or did not answer it. */
+} snap_linkEvent_t;
+
+/**
+ * @brief Parameters of the estimator and of the EDM policy.
+ */
+typedef struct snap_linkConfig_t
+{
+	uint8_t  targetLog2;	/**< @brief Target of at most one undetected corrupted frame every 2^targetLog2 frames (1 to 63). */
+	uint8_t  averageLog2;	/**< @brief The error rate is averaged over about 2^averageLog2 updates (0 to 16). */
+	uint8_t  marginLog2;	/**< @brief A weaker EDM must meet the target 2^marginLog2 times over (0 to 16). */
+	uint8_t  edmMask;		/**< @brief Bit n is set if EDM n can be chosen (only bits 2 to 5 are used; at least one of them must be set). */
+	uint16_t holdFrames;	/**< @brief Minimum number of updates between a switch and a switch to a weaker EDM. */
+} snap_linkConfig_t;
+
+/**
+ * @brief Link state (one per destination).
+ */
+typedef struct snap_link_t
+{
+	snap_linkConfig_t config;		/**< @brief Parameters. */
+	uint64_t          errorRate;	/**< @brief Average frame error rate, in units of 2^-32. */
+	uint32_t          frameSize;	/**< @brief Average size of the frames reported, in units of 1/256 byte (0 if unknown). */
+	uint32_t          frames;		/**< @brief Number of updates. */
+	uint32_t          errors;		/**< @brief Number of updates with an error. */
+	uint16_t          hold;			/**< @brief Number of updates since the last switch (saturated). */
+	uint8_t           edm;			/**< @brief EDM that the next frames should use (#snap_hdb1_edm_t). */
+} snap_link_t;
+
+
+/******************************************************************************/
+/*  Public Function Declarations                                              */
+/******************************************************************************/
+
+
+int16_t snap_linkInit(snap_link_t *link, const snap_linkConfig_t *config, uint8_t edm);
+
+uint8_t snap_linkUpdate(snap_link_t *link, snap_linkEvent_t event, uint16_t frameSize);
+
+uint16_t snap_linkGetDataSize(const snap_link_t *link, uint16_t overhead, uint16_t maxDataSize);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif	// SNAP_LINK_H_
+
+/******************************** END OF FILE *********************************/
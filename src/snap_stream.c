@@ -0,0 +1,223 @@
+/*
+Copyright (c) 2022 Lucas Jadilo
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file   snap_stream.c
+ * @author Lucas Jadilo
+ * @brief  Source file of the stream decoder, an optional module of the libSNAP library.
+ */
+
+/**
+ * @addtogroup stream
+ * @{
+ */
+
+
+/******************************************************************************/
+/*  Private Includes                                                          */
+/******************************************************************************/
+
+
+#include <stddef.h>
+#include "snap_stream.h"
+
+
+/******************************************************************************/
+/*  Private Function Definitions                                              */
+/******************************************************************************/
+
+
+/**
+ * @brief Decode the bytes of the stream buffer and keep an incomplete frame at its beginning.
+ * @param[in,out] stream   Pointer to the stream structure.
+ * @param[in]     length   Number of bytes in the buffer.
+ * @param[in]     callback Function called for each frame. It can be NULL.
+ * @param[in]     context  Pointer passed to the callback.
+ * @return Number of frames reported.
+ */
+static size_t decodeStream(snap_stream_t *stream, const size_t length, const snap_streamCallback_t callback, void *context)
+{
+	snap_frame_t *frame = &stream->frame;
+	size_t pos = 0, tail = length, frames = 0;
+
+	while(pos < length)
+	{
+		pos += snap_decodeBuffer(frame, &stream->buffer[pos], length - pos);
+
+		if(frame->status == SNAP_STATUS_IDLE)
+		{
+			break;
+		}
+
+		if(frame->status == SNAP_STATUS_INCOMPLETE)
+		{
+			tail = pos - frame->size;	// Decoded again on the next call, when more bytes are available
+			break;
+		}
+
+		const size_t start = pos - frame->size;
+
+		if(frame->status == SNAP_STATUS_VALID)
+		{
+			stream->stats.validFrames++;
+		}
+		else
+		{
+			if(frame->status == SNAP_STATUS_ERROR_HASH)
+			{
+				stream->stats.hashErrors++;
+			}
+			else
+			{
+				stream->stats.overflowErrors++;
+			}
+
+			pos = start + 1;
+		}
+
+		if(callback != NULL)
+		{
+			callback(context, frame, stream->offset + start);
+		}
+
+		frames++;
+		snap_reset(frame);
+	}
+
+	snap_reset(frame);
+
+	for(size_t i = tail; i < length; i++)
+	{
+		stream->buffer[i - tail] = stream->buffer[i];
+	}
+
+	stream->length = length - tail;
+	stream->offset += tail;
+
+	return frames;
+}
+
+
+/******************************************************************************/
+/*  Public Function Definitions                                               */
+/******************************************************************************/
+
+
+/**
+ * @brief Initialize the stream decoder.
+ * @param[out] stream   Pointer to the stream structure.
+ * @param[in]  buffer   Pointer to the array that will hold the received bytes.
+ * @param[in]  capacity Size of the array. It must be at least #SNAP_STREAM_MIN_SIZE_BUFFER.
+ *                      Larger arrays mean fewer calls and fewer bytes moved between blocks.
+ * @retval 0                        Success.
+ * @retval #SNAP_ERROR_NULL_FRAME   Error: Stream pointer is NULL.
+ * @retval #SNAP_ERROR_NULL_BUFFER  Error: Buffer pointer is NULL.
+ * @retval #SNAP_ERROR_SHORT_BUFFER Error: capacity is less than #SNAP_STREAM_MIN_SIZE_BUFFER.
+ */
+int16_t snap_streamInit(snap_stream_t *stream, uint8_t *buffer, const size_t capacity)
+{
+	if(stream == NULL)                         return SNAP_ERROR_NULL_FRAME;
+	if(buffer == NULL)                         return SNAP_ERROR_NULL_BUFFER;
+	if(capacity < SNAP_STREAM_MIN_SIZE_BUFFER) return SNAP_ERROR_SHORT_BUFFER;
+
+	snap_init(&stream->frame, stream->frameBuffer, sizeof(stream->frameBuffer));
+
+	stream->buffer = buffer;
+	stream->capacity = capacity;
+	stream->length = 0;
+	stream->offset = 0;
+	stream->stats.bytes = 0;
+	stream->stats.validFrames = 0;
+	stream->stats.hashErrors = 0;
+	stream->stats.overflowErrors = 0;
+
+	return 0;
+}
+
+/**
+ * @brief Get the free space of the stream buffer, where the next bytes should be written.
+ * @param[in]  stream Pointer to the stream structure.
+ * @param[out] space  Pointer to the variable that will store the number of bytes available (never zero).
+ * @return Pointer to the first free byte of the buffer.
+ */
+uint8_t *snap_streamReserve(snap_stream_t *stream, size_t *space)
+{
+	*space = stream->capacity - stream->length;
+	return &stream->buffer[stream->length];
+}
+
+/**
+ * @brief Decode the bytes written into the space returned by snap_streamReserve().
+ * @details Every frame that reaches a final status is reported through the callback, in stream order.
+ *          The frame structure passed to the callback is only valid during the call.
+ * @param[in,out] stream   Pointer to the stream structure.
+ * @param[in]     count    Number of bytes written into the reserved space.
+ * @param[in]     callback Function called for each frame. It can be NULL (only the counters are updated).
+ * @param[in]     context  Pointer passed to the callback.
+ * @return Number of frames reported.
+ */
+size_t snap_streamProcess(snap_stream_t *stream, const size_t count, const snap_streamCallback_t callback, void *context)
+{
+	stream->stats.bytes += count;
+
+	return decodeStream(stream, stream->length + count, callback, context);
+}
+
+/**
+ * @brief Decode the bytes kept in the buffer when the end of the stream is reached.
+ * @details The incomplete frame kept by snap_streamProcess() will never be completed, so it is given up
+ *          (without being reported) and the search is resumed right after its sync byte, as for a frame
+ *          with an invalid hash. This is repeated until the buffer is empty, so every frame hidden by a
+ *          false sync byte near the end of the stream is still reported. The stream can be used again
+ *          afterwards, as if it had just been initialized (the offset and counters are kept).
+ * @param[in,out] stream   Pointer to the stream structure.
+ * @param[in]     callback Function called for each frame. It can be NULL (only the counters are updated).
+ * @param[in]     context  Pointer passed to the callback.
+ * @return Number of frames reported.
+ */
+size_t snap_streamFinish(snap_stream_t *stream, const snap_streamCallback_t callback, void *context)
+{
+	size_t frames = 0;
+
+	while(stream->length > 0)
+	{
+		const size_t length = stream->length - 1;
+
+		for(size_t i = 0; i < length; i++)
+		{
+			stream->buffer[i] = stream->buffer[i + 1];	// Drop the sync byte of the incomplete frame
+		}
+
+		stream->length = 0;
+		stream->offset++;
+
+		frames += decodeStream(stream, length, callback, context);
+	}
+
+	return frames;
+}
+
+/**
+ * @}
+ */
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,129 @@
+/*
+Copyright (c) 2022 Lucas Jadilo
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/**
+ * @file   snap_stream.h
+ * @author Lucas Jadilo
+ * @brief  Header file of the stream decoder, an optional module of the libSNAP library.
+ */
+
+#ifndef SNAP_STREAM_H_
+#define SNAP_STREAM_H_
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/**
+ * @defgroup stream Stream Decoder
+ * @ingroup  libSNAP
+ * @brief    Decode an unbounded byte stream in large blocks with snap_decodeBuffer().
+ * @details  The caller reads bytes directly into the stream buffer (see snap_streamReserve()) and then
+ *           hands them to snap_streamProcess(), which reports every frame that reaches a final status
+ *           through a callback, together with its absolute offset in the stream. A frame left incomplete
+ *           at the end of a block is moved to the beginning of the buffer and completed on the next call.
+ *           After a hash or overflow error, the search is resumed right after the sync byte of the bad
+ *           frame, so a false sync byte never hides the next frame. At the end of the stream,
+ *           snap_streamFinish() gives up the frame still incomplete and reports the frames it was hiding.
+ * @{
+ */
+
+
+/******************************************************************************/
+/*  Public Includes                                                           */
+/******************************************************************************/
+
+
+#include "snap.h"
+
+
+/******************************************************************************/
+/*  Public Macros                                                             */
+/******************************************************************************/
+
+
+#define SNAP_STREAM_MIN_SIZE_BUFFER	(2U * SNAP_MAX_SIZE_FRAME)	/**< @brief Minimum size of the stream buffer. It guarantees room for new bytes after an incomplete frame. */
+
+
+/******************************************************************************/
+/*  Public Types                                                              */
+/******************************************************************************/
+
+
+/**
+ * @brief Function called for each frame that reaches a final status.
+ * @param[in] context Pointer passed to snap_streamProcess() or snap_streamFinish().
+ * @param[in] frame   Pointer to the frame structure. The status is #SNAP_STATUS_VALID, #SNAP_STATUS_ERROR_HASH or #SNAP_STATUS_ERROR_OVERFLOW.
+ * @param[in] offset  Position of the sync byte in the stream (number of bytes received before it).
+ */
+typedef void (*snap_streamCallback_t)(void *context, const snap_frame_t *frame, uint64_t offset);
+
+/**
+ * @brief Counters updated by snap_streamProcess().
+ */
+typedef struct snap_streamStats_t
+{
+	uint64_t bytes;				/**< @brief Number of bytes received. */
+	uint64_t validFrames;		/**< @brief Number of frames with status #SNAP_STATUS_VALID. */
+	uint64_t hashErrors;		/**< @brief Number of frames with status #SNAP_STATUS_ERROR_HASH. */
+	uint64_t overflowErrors;	/**< @brief Number of frames with status #SNAP_STATUS_ERROR_OVERFLOW. */
+} snap_streamStats_t;
+
+/**
+ * @brief Stream decoder state.
+ */
+typedef struct snap_stream_t
+{
+	snap_frame_t       frame;								/**< @brief Frame structure used by the decoder. */
+	uint8_t            frameBuffer[SNAP_MAX_SIZE_FRAME];	/**< @brief Buffer of the frame structure. */
+	uint8_t            *buffer;								/**< @brief Pointer to the array that holds the received bytes. */
+	size_t             capacity;							/**< @brief Size of the array. */
+	size_t             length;								/**< @brief Number of bytes in the array (i.e. an incomplete frame kept from the previous block). */
+	uint64_t           offset;								/**< @brief Position of buffer[0] in the stream. */
+	snap_streamStats_t stats;								/**< @brief Counters. */
+} snap_stream_t;
+
+
+/******************************************************************************/
+/*  Public Function Declarations                                              */
+/******************************************************************************/
+
+
+int16_t snap_streamInit(snap_stream_t *stream, uint8_t *buffer, size_t capacity);
+
+uint8_t *snap_streamReserve(snap_stream_t *stream, size_t *space);
+
+size_t snap_streamProcess(snap_stream_t *stream, size_t count, snap_streamCallback_t callback, void *context);
+
+size_t snap_streamFinish(snap_stream_t *stream, snap_streamCallback_t callback, void *context);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif	// SNAP_STREAM_H_
+
+/******************************** END OF FILE *********************************/
@@ -190,6 +190,33 @@ static void test_decode_StatusValidOrError(uint8_t *frameBytes,
 	}
 }
 
+static void test_decodeBuffer(const uint8_t *inputBytes,
+							  const size_t inputSize,
+							  const size_t chunkSize,
+							  const size_t expectedConsumed,
+							  const snap_frame_t *expectedFrame)
+{
+	uint8_t actualBuffer[SNAP_MAX_SIZE_FRAME] = {0};
+	snap_frame_t actualFrame = {.buffer = actualBuffer, .maxSize = expectedFrame->maxSize, .status = SNAP_STATUS_IDLE, .size = 0};
+	size_t consumed = 0;
+
+	for(size_t i = 0; i < inputSize; i += chunkSize)
+	{
+		const size_t size = (inputSize - i < chunkSize) ? (inputSize - i) : chunkSize;
+		const size_t ret = snap_decodeBuffer(&actualFrame, &inputBytes[i], size);
+
+		consumed += ret;
+
+		if(ret < size)
+		{
+			break;
+		}
+	}
+
+	TEST_ASSERT_EQUAL_size_t_MESSAGE(expectedConsumed, consumed, "(bytes consumed)");
+	TEST_ASSERT_EQUAL_FRAME(expectedFrame, &actualFrame);
+}
+
 
 /******************************************************************************/
 /*  TEST GROUP: miscFunctions                                                 */
@@ -540,6 +567,7 @@ TEST_GROUP_RUNNER(decode)
 	RUN_TEST_CASE(decode, if_StatusValid_should_NotChangeAnyVariables_and_IgnoreAllInputBytes);
 	RUN_TEST_CASE(decode, if_StatusErrorHash_should_NotChangeAnyVariables_and_IgnoreAllInputBytes);
 	RUN_TEST_CASE(decode, if_StatusErrorOverflow_should_NotChangeAnyVariables_and_IgnoreAllInputBytes);
+	RUN_TEST_CASE(decode, if_StatusIncomplete_should_DropHeader_and_SearchSyncByteInHeader_when_HeaderIsNotInWhitelist);
 }
 
 TEST(decode, if_StatusIdle_should_StoreSyncByte_and_ChangeStatusToIncomplete_when_ReceiveSyncByte)
@@ -749,6 +777,182 @@ TEST(decode, if_StatusErrorOverflow_should_NotChangeAnyVariables_and_IgnoreAllIn
 								   (uint8_t [20]){0xFF, 0xEE, 0x54}, 20, SNAP_STATUS_ERROR_OVERFLOW, 137);
 }
 
+TEST(decode, if_StatusIncomplete_should_DropHeader_and_SearchSyncByteInHeader_when_HeaderIsNotInWhitelist)
+{
+	uint8_t whitelist[SNAP_SIZE_WHITELIST] = {0};
+	uint8_t buffer[SNAP_MAX_SIZE_FRAME] = {0};
+	snap_frame_t frame = {.buffer = buffer, .maxSize = SNAP_MAX_SIZE_FRAME, .status = SNAP_STATUS_IDLE, .size = 0};
+
+	// DAB=0, SAB=0, PFB=0, ACK=1, CMD=0, EDM=0, NDB=0
+	SNAP_WHITELIST_ALLOW(whitelist, 0x01, 0x00);
+	snap_setWhitelist(&frame, whitelist);
+	TEST_ASSERT_EQUAL_PTR(whitelist, frame.whitelist);
+	TEST_ASSERT_EQUAL_UINT(1, SNAP_WHITELIST_CHECK(whitelist, 0x01, 0x00));
+	TEST_ASSERT_EQUAL_UINT(0, SNAP_WHITELIST_CHECK(whitelist, 0x00, 0x01));
+
+	// No sync byte in the header: back to idle
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_INCOMPLETE, snap_decode(&frame, SNAP_SYNC));
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_INCOMPLETE, snap_decode(&frame, 0xFC));
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_IDLE, snap_decode(&frame, 0x5E));
+	TEST_ASSERT_EQUAL_UINT16(0, frame.size);
+
+	// Sync byte in HDB2
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_INCOMPLETE, snap_decode(&frame, SNAP_SYNC));
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_INCOMPLETE, snap_decode(&frame, SNAP_SYNC));
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_INCOMPLETE, snap_decode(&frame, 0x01));
+	TEST_ASSERT_EQUAL_UINT16(2, frame.size);
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_VALID, snap_decode(&frame, 0x00));
+	TEST_ASSERT_EQUAL_HEX8_ARRAY(((uint8_t []){SNAP_SYNC, 0x01, 0x00}), buffer, 3);
+
+	// Sync byte in HDB1
+	snap_reset(&frame);
+	TEST_ASSERT_EQUAL_PTR(whitelist, frame.whitelist);
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_INCOMPLETE, snap_decode(&frame, SNAP_SYNC));
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_INCOMPLETE, snap_decode(&frame, 0x33));
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_INCOMPLETE, snap_decode(&frame, SNAP_SYNC));
+	TEST_ASSERT_EQUAL_UINT16(1, frame.size);
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_INCOMPLETE, snap_decode(&frame, 0x01));
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_VALID, snap_decode(&frame, 0x00));
+	TEST_ASSERT_EQUAL_HEX8_ARRAY(((uint8_t []){SNAP_SYNC, 0x01, 0x00}), buffer, 3);
+
+	// snap_init() removes the whitelist
+	TEST_ASSERT_EQUAL_INT16(SNAP_MAX_SIZE_FRAME, snap_init(&frame, buffer, SNAP_MAX_SIZE_FRAME));
+	TEST_ASSERT_NULL(frame.whitelist);
+}
+
+
+/******************************************************************************/
+/*  TEST GROUP: decodeBuffer                                                  */
+/******************************************************************************/
+
+
+TEST_GROUP(decodeBuffer);
+
+TEST_SETUP(decodeBuffer) {}
+
+TEST_TEAR_DOWN(decodeBuffer) {}
+
+TEST_GROUP_RUNNER(decodeBuffer)
+{
+	RUN_TEST_CASE(decodeBuffer, should_SkipPreamble_and_StopAfterLastByte_when_ReceiveValidFrame);
+	RUN_TEST_CASE(decodeBuffer, should_StopAfterLastByte_when_ReceiveInvalidHashValue);
+	RUN_TEST_CASE(decodeBuffer, should_StopAfterHdb1_when_BufferIsTooShort);
+	RUN_TEST_CASE(decodeBuffer, should_ConsumeAllBytes_and_KeepStatusIncomplete_when_FrameIsNotComplete);
+	RUN_TEST_CASE(decodeBuffer, should_NotConsumeAnyBytes_if_StatusIsValidOrError);
+	RUN_TEST_CASE(decodeBuffer, should_FindFrameAfterFalseSyncByte_when_HeaderIsNotInWhitelist);
+}
+
+TEST(decodeBuffer, should_SkipPreamble_and_StopAfterLastByte_when_ReceiveValidFrame)
+{
+	// DAB=3, SAB=2, PFB=0, ACK=1, CMD=0, EDM=2, NDB=5, dAddr=0x998877, sAddr=0xFEDC, hash=0xCC, data[5]=0xBA 62 63 51 84
+	const uint8_t input[] = {0x00, 0x53, 0xFF,
+							 SNAP_SYNC, 0xE1, 0x25, 0x99, 0x88, 0x77, 0xFE, 0xDC, 0xBA, 0x62, 0x63, 0x51, 0x84, 0xCC,
+							 0x54, 0x00, 0x00};
+	const snap_frame_t expectedFrame = {.buffer = (uint8_t *)&input[3], .maxSize = SNAP_MAX_SIZE_FRAME, .status = SNAP_STATUS_VALID, .size = 14};
+
+	test_decodeBuffer(input, sizeof(input), 1, 17, &expectedFrame);
+	test_decodeBuffer(input, sizeof(input), 2, 17, &expectedFrame);
+	test_decodeBuffer(input, sizeof(input), 5, 17, &expectedFrame);
+	test_decodeBuffer(input, sizeof(input), sizeof(input), 17, &expectedFrame);
+
+	// DAB=2, SAB=2, PFB=2, ACK=0, CMD=0, EDM=5, NDB=12, dAddr=0x0001, sAddr=0x0002, flags=0x0003, hash=0x895817A7, data[128]=0xFF FF FF 00 00 00...
+	const uint8_t input2[150] = {SNAP_SYNC, 0xA8, 0x5C, 0x00, 0x01, 0x00, 0x02, 0x00, 0x03, 0xFF, 0xFF, 0xFF, [137] = 0x89, 0x58, 0x17, 0xA7, SNAP_SYNC};
+	const snap_frame_t expectedFrame2 = {.buffer = (uint8_t *)input2, .maxSize = 141, .status = SNAP_STATUS_VALID, .size = 141};
+
+	test_decodeBuffer(input2, sizeof(input2), 1, 141, &expectedFrame2);
+	test_decodeBuffer(input2, sizeof(input2), 64, 141, &expectedFrame2);
+	test_decodeBuffer(input2, sizeof(input2), sizeof(input2), 141, &expectedFrame2);
+}
+
+TEST(decodeBuffer, should_StopAfterLastByte_when_ReceiveInvalidHashValue)
+{
+	// DAB=1, SAB=1, PFB=2, ACK=2, CMD=0, EDM=3, NDB=9, dAddr=0xA1, sAddr=0xB1, flags=0xC1C2, hash=0x4F(!=0x4E), data[16]=0xD1 D2 D3 00 00 00...
+	const uint8_t input[30] = {0x11, SNAP_SYNC, 0x5A, 0x39, 0xA1, 0xB1, 0xC1, 0xC2, 0xD1, 0xD2, 0xD3, [24] = 0x4F, SNAP_SYNC};
+	const snap_frame_t expectedFrame = {.buffer = (uint8_t *)&input[1], .maxSize = SNAP_MAX_SIZE_FRAME, .status = SNAP_STATUS_ERROR_HASH, .size = 24};
+
+	test_decodeBuffer(input, sizeof(input), 1, 25, &expectedFrame);
+	test_decodeBuffer(input, sizeof(input), 7, 25, &expectedFrame);
+	test_decodeBuffer(input, sizeof(input), sizeof(input), 25, &expectedFrame);
+}
+
+TEST(decodeBuffer, should_StopAfterHdb1_when_BufferIsTooShort)
+{
+	// DAB=2, SAB=1, PFB=0, ACK=1, CMD=0, EDM=5, NDB=12, size=138, maxSize=137
+	const uint8_t input[20] = {0x00, 0x00, SNAP_SYNC, 0x91, 0x5C, 0x01, 0x02};
+	const snap_frame_t expectedFrame = {.buffer = (uint8_t *)&input[2], .maxSize = 137, .status = SNAP_STATUS_ERROR_OVERFLOW, .size = 3};
+
+	test_decodeBuffer(input, sizeof(input), 1, 5, &expectedFrame);
+	test_decodeBuffer(input, sizeof(input), sizeof(input), 5, &expectedFrame);
+}
+
+TEST(decodeBuffer, should_ConsumeAllBytes_and_KeepStatusIncomplete_when_FrameIsNotComplete)
+{
+	// DAB=0, SAB=2, PFB=1, ACK=1, CMD=0, EDM=6, NDB=10, sAddr=0xA0B1, flags=0xC2, data[32]=0xFF 01 80 00 00 00... (last 10 bytes missing)
+	const uint8_t input[30] = {0xAA, 0xBB, SNAP_SYNC, 0x25, 0x6A, 0xA0, 0xB1, 0xC2, 0xFF, 0x01, 0x80};
+	const snap_frame_t expectedFrame = {.buffer = (uint8_t *)&input[2], .maxSize = SNAP_MAX_SIZE_FRAME, .status = SNAP_STATUS_INCOMPLETE, .size = 28};
+
+	test_decodeBuffer(input, sizeof(input), 1, sizeof(input), &expectedFrame);
+	test_decodeBuffer(input, sizeof(input), 4, sizeof(input), &expectedFrame);
+	test_decodeBuffer(input, sizeof(input), sizeof(input), sizeof(input), &expectedFrame);
+
+	// No sync byte
+	const uint8_t input2[] = {0x00, 0x01, 0x02, 0x53, 0x55, 0xFF};
+	const snap_frame_t expectedFrame2 = {.buffer = NULL, .maxSize = SNAP_MAX_SIZE_FRAME, .status = SNAP_STATUS_IDLE, .size = 0};
+
+	test_decodeBuffer(input2, sizeof(input2), sizeof(input2), sizeof(input2), &expectedFrame2);
+}
+
+TEST(decodeBuffer, should_NotConsumeAnyBytes_if_StatusIsValidOrError)
+{
+	const uint8_t input[] = {SNAP_SYNC, 0x01, 0x00};
+	uint8_t buffer[SNAP_MAX_SIZE_FRAME] = {SNAP_SYNC, 0x00, 0x40, 0x48, 0xC5};
+	snap_frame_t frame = {.buffer = buffer, .maxSize = SNAP_MAX_SIZE_FRAME, .status = SNAP_STATUS_ERROR_HASH, .size = 5};
+
+	TEST_ASSERT_EQUAL_size_t(0, snap_decodeBuffer(&frame, input, sizeof(input)));
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_ERROR_HASH, frame.status);
+	TEST_ASSERT_EQUAL_UINT16(5, frame.size);
+
+	frame.status = SNAP_STATUS_VALID;
+
+	TEST_ASSERT_EQUAL_size_t(0, snap_decodeBuffer(&frame, input, sizeof(input)));
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_VALID, frame.status);
+	TEST_ASSERT_EQUAL_UINT16(5, frame.size);
+}
+
+TEST(decodeBuffer, should_FindFrameAfterFalseSyncByte_when_HeaderIsNotInWhitelist)
+{
+	// Noise with a sync byte (DAB=3, SAB=3, PFB=3, EDM=5, NDB=14, size=527), then DAB=0, SAB=0, PFB=0, ACK=0, CMD=0, EDM=4, NDB=0, hash=0x48C4
+	const uint8_t input[] = {0x00, SNAP_SYNC, 0xFC, 0x5E, 0x11, SNAP_SYNC, 0x00, 0x40, 0x48, 0xC4, 0x22};
+	uint8_t whitelist[SNAP_SIZE_WHITELIST] = {0};
+	uint8_t buffer[SNAP_MAX_SIZE_FRAME] = {0};
+	snap_frame_t frame;
+
+	TEST_ASSERT_EQUAL_INT16(SNAP_MAX_SIZE_FRAME, snap_init(&frame, buffer, SNAP_MAX_SIZE_FRAME));
+	TEST_ASSERT_EQUAL_size_t(sizeof(input), snap_decodeBuffer(&frame, input, sizeof(input)));
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_INCOMPLETE, frame.status);
+
+	SNAP_WHITELIST_ALLOW(whitelist, 0x00, 0x40);
+	snap_setWhitelist(&frame, whitelist);
+
+	for(size_t chunk = 1; chunk <= sizeof(input); chunk++)
+	{
+		size_t consumed = 0;
+
+		snap_reset(&frame);
+
+		while((consumed < sizeof(input)) && (frame.status != SNAP_STATUS_VALID))
+		{
+			const size_t size = (sizeof(input) - consumed < chunk) ? (sizeof(input) - consumed) : chunk;
+			consumed += snap_decodeBuffer(&frame, &input[consumed], size);
+		}
+
+		TEST_ASSERT_EQUAL_size_t_MESSAGE(10, consumed, "(bytes consumed)");
+		TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_VALID, frame.status);
+		TEST_ASSERT_EQUAL_UINT16(5, frame.size);
+		TEST_ASSERT_EQUAL_HEX8_ARRAY(&input[5], buffer, 5);
+	}
+}
+
 
 /******************************************************************************/
 /*  TEST GROUP: encapsulate                                                   */
@@ -1613,9 +1817,26 @@ static void runAllTests(void)
 	RUN_TEST_GROUP(init);
 	RUN_TEST_GROUP(reset);
 	RUN_TEST_GROUP(decode);
+	RUN_TEST_GROUP(decodeBuffer);
 	RUN_TEST_GROUP(encapsulate);
 	RUN_TEST_GROUP(getField);
 	RUN_TEST_GROUP(calculateHash);
+	RUN_TEST_GROUP(stream);
+	RUN_TEST_GROUP(link);
+	RUN_TEST_GROUP(cobs);
+	RUN_TEST_GROUP(gather);
+	RUN_TEST_GROUP(cut);
+	RUN_TEST_GROUP(pcapng);
+	RUN_TEST_GROUP(lz);
+	RUN_TEST_GROUP(query);
+	RUN_TEST_GROUP(index);
+	RUN_TEST_GROUP(filter);
+	RUN_TEST_GROUP(dispatch);
+	RUN_TEST_GROUP(rcu);
+	RUN_TEST_GROUP(columnar);
+	RUN_TEST_GROUP(ipc);
+	RUN_TEST_GROUP(client);
+	RUN_TEST_GROUP(tx);
 }
 
 int main(int argc, const char **argv)
@@ -0,0 +1,290 @@
+/**
+ * @file   test_snap_cobs.c
+ * @author Lucas Jadilo
+ * @brief  Unit tests for the COBS framing module of the libSNAP library.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include <string.h>
+#include "unity_fixture.h"
+#include "snap_cobs.h"
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+typedef struct report_t
+{
+	uint64_t offset;
+	uint16_t size;
+	int8_t   status;
+} report_t;
+
+typedef struct reportList_t
+{
+	report_t reports[10];
+	size_t   count;
+} reportList_t;
+
+
+/******************************************************************************/
+/*  Function Definitions                                                      */
+/******************************************************************************/
+
+
+static void storeReport(void *context, const snap_frame_t *frame, const uint64_t offset)
+{
+	reportList_t *list = context;
+
+	TEST_ASSERT_LESS_THAN_size_t(sizeof(list->reports) / sizeof(list->reports[0]), list->count);
+	TEST_ASSERT_EQUAL_HEX8(SNAP_SYNC, frame->buffer[0]);
+
+	list->reports[list->count].offset = offset;
+	list->reports[list->count].size = frame->size;
+	list->reports[list->count].status = frame->status;
+	list->count++;
+}
+
+static void test_encode(const uint8_t *input, const size_t inputSize, const uint8_t *expected, const size_t expectedSize)
+{
+	uint8_t packet[SNAP_COBS_SIZE_PACKET(600U)] = {0};
+
+	TEST_ASSERT_EQUAL_size_t(expectedSize, snap_cobsEncode(input, inputSize, packet));
+	TEST_ASSERT_LESS_OR_EQUAL_size_t(SNAP_COBS_SIZE_PACKET(inputSize), expectedSize);
+	TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, packet, expectedSize);
+}
+
+static void test_roundTrip(const snap_frame_t *frame)
+{
+	uint8_t packet[SNAP_COBS_MAX_SIZE_PACKET];
+	uint8_t buffer[SNAP_MAX_SIZE_FRAME];
+	snap_frame_t decoded;
+	const size_t size = snap_cobsEncode(frame->buffer, frame->size, packet);
+
+	TEST_ASSERT_EQUAL_HEX8(SNAP_COBS_DELIMITER, packet[size - 1]);
+	TEST_ASSERT_EQUAL_size_t(size - 1, strlen((const char *)packet));
+
+	snap_init(&decoded, buffer, sizeof(buffer));
+
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_VALID, snap_cobsDecodeFrame(&decoded, packet, size - 1));
+	TEST_ASSERT_EQUAL_UINT16(frame->size, decoded.size);
+	TEST_ASSERT_EQUAL_HEX8_ARRAY(frame->buffer, buffer, frame->size);
+}
+
+static void test_process(const uint8_t *input,
+						 const size_t inputSize,
+						 const size_t chunkSize,
+						 const report_t *expected,
+						 const size_t expectedCount,
+						 const uint64_t expectedFormatErrors)
+{
+	static snap_cobs_t cobs;
+	reportList_t list = {.count = 0};
+	size_t reported = 0;
+
+	TEST_ASSERT_EQUAL_INT16(0, snap_cobsInit(&cobs));
+
+	for(size_t i = 0; i < inputSize; i += chunkSize)
+	{
+		const size_t size = (inputSize - i < chunkSize) ? (inputSize - i) : chunkSize;
+
+		reported += snap_cobsProcess(&cobs, &input[i], size, storeReport, &list);
+	}
+
+	TEST_ASSERT_EQUAL_size_t(expectedCount, reported);
+	TEST_ASSERT_EQUAL_size_t(expectedCount, list.count);
+	TEST_ASSERT_EQUAL_UINT64(inputSize, cobs.stats.bytes);
+	TEST_ASSERT_EQUAL_UINT64(expectedFormatErrors, cobs.stats.formatErrors);
+
+	for(size_t i = 0; i < expectedCount; i++)
+	{
+		TEST_ASSERT_EQUAL_UINT64(expected[i].offset, list.reports[i].offset);
+		TEST_ASSERT_EQUAL_UINT16(expected[i].size, list.reports[i].size);
+		TEST_ASSERT_EQUAL_INT8(expected[i].status, list.reports[i].status);
+	}
+}
+
+
+/******************************************************************************/
+/*  TEST GROUP: cobs                                                          */
+/******************************************************************************/
+
+
+TEST_GROUP(cobs);
+
+TEST_SETUP(cobs) {}
+
+TEST_TEAR_DOWN(cobs) {}
+
+TEST_GROUP_RUNNER(cobs)
+{
+	RUN_TEST_CASE(cobs, encode_should_RemoveZeroBytes_and_AppendDelimiter);
+	RUN_TEST_CASE(cobs, decodeFrame_should_RestoreFrame_for_AnySize);
+	RUN_TEST_CASE(cobs, decodeFrame_should_ReturnFrameStatus_when_PacketHoldsOneFrame);
+	RUN_TEST_CASE(cobs, decodeFrame_should_ReturnErrorFormat_if_PacketIsInvalid);
+	RUN_TEST_CASE(cobs, process_should_ReportEveryFrameWithItsOffset_regardless_of_BlockSize);
+	RUN_TEST_CASE(cobs, process_should_DropPacket_and_ResumeAtNextDelimiter_when_PacketIsCorrupted);
+}
+
+TEST(cobs, encode_should_RemoveZeroBytes_and_AppendDelimiter)
+{
+	uint8_t input[255];
+	uint8_t expected[258];
+
+	test_encode(NULL, 0, (uint8_t []){0x01, 0x00}, 2);
+	test_encode((uint8_t []){0x00}, 1, (uint8_t []){0x01, 0x01, 0x00}, 3);
+	test_encode((uint8_t []){0x00, 0x00}, 2, (uint8_t []){0x01, 0x01, 0x01, 0x00}, 4);
+	test_encode((uint8_t []){0x11, 0x22, 0x00, 0x33}, 4, (uint8_t []){0x03, 0x11, 0x22, 0x02, 0x33, 0x00}, 6);
+	test_encode((uint8_t []){0x11, 0x22, 0x33, 0x44}, 4, (uint8_t []){0x05, 0x11, 0x22, 0x33, 0x44, 0x00}, 6);
+	test_encode((uint8_t []){0x11, 0x00, 0x00, 0x00}, 4, (uint8_t []){0x02, 0x11, 0x01, 0x01, 0x01, 0x00}, 6);
+
+	// DAB=0, SAB=0, PFB=0, ACK=0, CMD=0, EDM=4, NDB=0, hash=0x48C4
+	test_encode((uint8_t []){SNAP_SYNC, 0x00, 0x40, 0x48, 0xC4}, 5, (uint8_t []){0x02, SNAP_SYNC, 0x04, 0x40, 0x48, 0xC4, 0x00}, 7);
+
+	// Longest run (254 bytes), and one more byte
+	for(size_t i = 0; i < sizeof(input); i++)
+	{
+		input[i] = (uint8_t)(i + 1U);
+		expected[i + 1] = (uint8_t)(i + 1U);
+	}
+
+	expected[0] = 0xFF;
+	expected[255] = 0x00;
+	test_encode(input, 254, expected, 256);
+
+	expected[255] = 0x02;
+	expected[256] = 0xFF;
+	expected[257] = 0x00;
+	test_encode(input, 255, expected, 258);
+}
+
+TEST(cobs, decodeFrame_should_RestoreFrame_for_AnySize)
+{
+	static uint8_t data[512];
+	uint8_t buffer[SNAP_MAX_SIZE_FRAME];
+	snap_frame_t frame;
+	snap_fields_t fields = {.data = data, .destAddress = 0x000102, .sourceAddress = 0x5400, .protocolFlags = 0x000000,
+							.header = {.dab = 3, .sab = 2, .pfb = 3, .ack = 0, .cmd = 0, .edm = SNAP_HDB1_EDM_32BIT_CRC}};
+
+	snap_init(&frame, buffer, sizeof(buffer));
+
+	for(size_t i = 0; i < sizeof(data); i++)
+	{
+		data[i] = (uint8_t)((i % 300U < 280U) ? 0xFFU : 0x00U);	// Runs longer than 254 bytes, and zero bytes
+	}
+
+	for(uint16_t size = 0; size <= sizeof(data); size = (uint16_t)((size < 16U) ? size + 1U : size * 2U))
+	{
+		fields.dataSize = size;
+		TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_VALID, snap_encapsulate(&frame, &fields));
+		test_roundTrip(&frame);
+	}
+}
+
+TEST(cobs, decodeFrame_should_ReturnFrameStatus_when_PacketHoldsOneFrame)
+{
+	uint8_t buffer[SNAP_MAX_SIZE_FRAME];
+	snap_frame_t frame;
+
+	snap_init(&frame, buffer, sizeof(buffer));
+
+	// DAB=0, SAB=0, PFB=0, ACK=0, CMD=0, EDM=4, NDB=0, hash=0x48C4
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_VALID, snap_cobsDecodeFrame(&frame, (uint8_t []){0x02, SNAP_SYNC, 0x04, 0x40, 0x48, 0xC4}, 6));
+	TEST_ASSERT_EQUAL_UINT16(5, frame.size);
+	TEST_ASSERT_EQUAL_HEX8_ARRAY(((uint8_t []){SNAP_SYNC, 0x00, 0x40, 0x48, 0xC4}), buffer, 5);
+
+	// hash=0x48C5 (!=0x48C4)
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_ERROR_HASH, snap_cobsDecodeFrame(&frame, (uint8_t []){0x02, SNAP_SYNC, 0x04, 0x40, 0x48, 0xC5}, 6));
+	TEST_ASSERT_EQUAL_UINT16(5, frame.size);
+
+	// DAB=2, SAB=1, PFB=0, ACK=1, CMD=0, EDM=5, NDB=12, size=138, maxSize=137
+	frame.maxSize = 137;
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_ERROR_OVERFLOW, snap_cobsDecodeFrame(&frame, (uint8_t []){0x05, SNAP_SYNC, 0x91, 0x5C, 0x01}, 5));
+	TEST_ASSERT_EQUAL_UINT16(3, frame.size);
+
+	// The whitelist applies
+	uint8_t whitelist[SNAP_SIZE_WHITELIST] = {0};
+
+	frame.maxSize = sizeof(buffer);
+	snap_setWhitelist(&frame, whitelist);
+	TEST_ASSERT_EQUAL_INT8(SNAP_COBS_ERROR_FORMAT, snap_cobsDecodeFrame(&frame, (uint8_t []){0x02, SNAP_SYNC, 0x04, 0x40, 0x48, 0xC4}, 6));
+
+	SNAP_WHITELIST_ALLOW(whitelist, 0x00, 0x40);
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_VALID, snap_cobsDecodeFrame(&frame, (uint8_t []){0x02, SNAP_SYNC, 0x04, 0x40, 0x48, 0xC4}, 6));
+}
+
+TEST(cobs, decodeFrame_should_ReturnErrorFormat_if_PacketIsInvalid)
+{
+	uint8_t buffer[SNAP_MAX_SIZE_FRAME];
+	snap_frame_t frame;
+
+	snap_init(&frame, buffer, sizeof(buffer));
+
+	// Empty packet
+	TEST_ASSERT_EQUAL_INT8(SNAP_COBS_ERROR_FORMAT, snap_cobsDecodeFrame(&frame, NULL, 0));
+
+	// Code byte beyond the end of the packet
+	TEST_ASSERT_EQUAL_INT8(SNAP_COBS_ERROR_FORMAT, snap_cobsDecodeFrame(&frame, (uint8_t []){0x02, SNAP_SYNC, 0x04, 0x40, 0x48, 0xC4, 0x07, 0x11}, 8));
+
+	// Zero byte inside the packet
+	TEST_ASSERT_EQUAL_INT8(SNAP_COBS_ERROR_FORMAT, snap_cobsDecodeFrame(&frame, (uint8_t []){0x00, SNAP_SYNC, 0x04, 0x40, 0x48, 0xC4}, 6));
+	TEST_ASSERT_EQUAL_INT8(SNAP_COBS_ERROR_FORMAT, snap_cobsDecodeFrame(&frame, (uint8_t []){0x02, SNAP_SYNC, 0x04, 0x40, 0x00, 0xC4}, 6));
+
+	// Missing byte, extra byte, byte before the sync byte
+	TEST_ASSERT_EQUAL_INT8(SNAP_COBS_ERROR_FORMAT, snap_cobsDecodeFrame(&frame, (uint8_t []){0x02, SNAP_SYNC, 0x03, 0x40, 0x48}, 5));
+	TEST_ASSERT_EQUAL_INT8(SNAP_COBS_ERROR_FORMAT, snap_cobsDecodeFrame(&frame, (uint8_t []){0x02, SNAP_SYNC, 0x05, 0x40, 0x48, 0xC4, 0x11}, 7));
+	TEST_ASSERT_EQUAL_INT8(SNAP_COBS_ERROR_FORMAT, snap_cobsDecodeFrame(&frame, (uint8_t []){0x03, 0x11, SNAP_SYNC, 0x04, 0x40, 0x48, 0xC4}, 7));
+
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_IDLE, frame.status);
+	TEST_ASSERT_EQUAL_UINT16(0, frame.size);
+}
+
+TEST(cobs, process_should_ReportEveryFrameWithItsOffset_regardless_of_BlockSize)
+{
+	// Frame (EDM=2, 14 bytes), frame (EDM=5, 141 bytes), frame (no hash, 3 bytes), with idle delimiters
+	static const uint8_t frames[] = {SNAP_SYNC, 0xE1, 0x25, 0x99, 0x88, 0x77, 0xFE, 0xDC, 0xBA, 0x62, 0x63, 0x51, 0x84, 0xCC,
+									 SNAP_SYNC, 0xA8, 0x5C, 0x00, 0x01, 0x00, 0x02, 0x00, 0x03, 0xFF, 0xFF, 0xFF, [151] = 0x89, 0x58, 0x17, 0xA7,
+									 SNAP_SYNC, 0x01, 0x00};
+	uint8_t input[300] = {0x00, 0x00};
+	size_t size = 2;
+
+	size += snap_cobsEncode(&frames[0], 14, &input[size]);
+	size += snap_cobsEncode(&frames[14], 141, &input[size]);
+	input[size++] = 0x00;
+	size += snap_cobsEncode(&frames[155], 3, &input[size]);
+
+	const report_t expected[] = {{2, 14, SNAP_STATUS_VALID}, {18, 141, SNAP_STATUS_VALID}, {162, 3, SNAP_STATUS_VALID}};
+
+	TEST_ASSERT_EQUAL_size_t(167, size);
+
+	test_process(input, size, 1, expected, 3, 0);
+	test_process(input, size, 13, expected, 3, 0);
+	test_process(input, size, 100, expected, 3, 0);
+	test_process(input, size, size, expected, 3, 0);
+}
+
+TEST(cobs, process_should_DropPacket_and_ResumeAtNextDelimiter_when_PacketIsCorrupted)
+{
+	// Noise, frame with a corrupted hash (EDM=4), packet with a lost byte, oversized noise, valid frame (EDM=0)
+	uint8_t input[1002] = {0x11, 0x22, 0x00,
+						   0x02, SNAP_SYNC, 0x04, 0x40, 0x48, 0xC5, 0x00,
+						   0x02, SNAP_SYNC, 0x04, 0x40, 0xC4, 0x00,
+						   [996] = 0x00,
+						   0x03, SNAP_SYNC, 0x01, 0x01, 0x00};
+	const report_t expected[] = {{3, 5, SNAP_STATUS_ERROR_HASH}, {997, 3, SNAP_STATUS_VALID}};
+
+	memset(&input[16], 0x33, 980);
+
+	test_process(input, sizeof(input), 1, expected, 2, 3);
+	test_process(input, sizeof(input), 64, expected, 2, 3);
+	test_process(input, sizeof(input), sizeof(input), expected, 2, 3);
+}
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,447 @@
+/**
+ * @file   test_snap_columnar.c
+ * @author Lucas Jadilo
+ * @brief  Unit tests for the columnar files of the SNAP tools.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "unity_fixture.h"
+#include "snap_columnar.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define NUM_ROWS			(2500U)
+#define ROWS_PER_GROUP		(1000U)		// The last row group is partial
+#define NUM_GROUPS			((NUM_ROWS + ROWS_PER_GROUP - 1U) / ROWS_PER_GROUP)
+#define FIRST_TIMESTAMP		(1700000000000000000U)
+#define SIZE_TRAILER		(24U)
+#define SIZE_GROUP			(4U + 16U * SNAP_COLUMN_COUNT)
+#define MAX_SIZE_FILE		(1U << 18)
+
+
+/******************************************************************************/
+/*  Variables                                                                 */
+/******************************************************************************/
+
+
+static uint64_t expected[SNAP_COLUMN_COUNT][NUM_ROWS];
+static uint64_t values[ROWS_PER_GROUP];
+static uint8_t fileData[MAX_SIZE_FILE];
+static snap_columnarReader_t reader;
+static char path[] = "/tmp/test_snap_columnar_XXXXXX";
+static uint32_t seed;
+
+
+/******************************************************************************/
+/*  Function Definitions                                                      */
+/******************************************************************************/
+
+
+static uint32_t randomNumber(const uint32_t limit)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed % limit;
+}
+
+static uint64_t getLe(const uint8_t *p, const uint_fast8_t size)
+{
+	uint64_t value = 0;
+
+	for(uint_fast8_t i = size; i != 0; i--)
+	{
+		value = (value << 8) | p[i - 1];
+	}
+
+	return value;
+}
+
+static void putLe(uint8_t *p, uint64_t value, const uint_fast8_t size)
+{
+	for(uint_fast8_t i = 0; i < size; i++)
+	{
+		p[i] = (uint8_t)value;
+		value >>= 8;
+	}
+}
+
+static uint64_t getBe(const uint8_t *p, const uint_fast8_t size)
+{
+	uint64_t value = 0;
+
+	for(uint_fast8_t i = 0; i < size; i++)
+	{
+		value = (value << 8) | p[i];
+	}
+
+	return value;
+}
+
+/*
+ * Frames whose columns favor each encoding: increasing timestamps (DELTA), a constant channel (RLE), a few
+ * source addresses (DICT) and random destination addresses (PLAIN). The other columns are mixed.
+ */
+static void writeColumnar(void)
+{
+	static const uint32_t sources[] = {0x000012, 0x000034, 0x00B0B1, 0x123456};
+	uint8_t buffer[SNAP_MAX_SIZE_FRAME];
+	uint8_t data[8];
+	snap_columnarWriter_t writer;
+	snap_frame_t frame;
+
+	snap_init(&frame, buffer, sizeof(buffer));
+	TEST_ASSERT_EQUAL_INT(0, snap_columnarWriterOpen(&writer, path, ROWS_PER_GROUP));
+
+	for(size_t i = 0; i < NUM_ROWS; i++)
+	{
+		snap_fields_t fields = {.data = data, .paddingAfter = true};
+
+		fields.header.dab = 3;
+		fields.header.sab = 3;
+		fields.header.ack = randomNumber(4) & 3U;
+		fields.header.cmd = randomNumber(2) & 1U;
+		fields.header.edm = SNAP_HDB1_EDM_16BIT_CRC;
+		fields.dataSize = (uint16_t)randomNumber(sizeof(data) + 1U);
+		fields.destAddress = randomNumber(0x1000000U);
+		fields.sourceAddress = sources[randomNumber(sizeof(sources) / sizeof(sources[0]))];
+
+		for(size_t j = 0; j < sizeof(data); j++)
+		{
+			data[j] = (uint8_t)randomNumber(256);
+		}
+
+		TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_VALID, snap_encapsulate(&frame, &fields));
+
+		expected[SNAP_COLUMN_TIMESTAMP][i] = FIRST_TIMESTAMP + i * 1000U + randomNumber(500);
+		expected[SNAP_COLUMN_CHANNEL][i] = 7;
+		expected[SNAP_COLUMN_STATUS][i] = (uint8_t)frame.status;
+		expected[SNAP_COLUMN_DAB][i] = fields.header.dab;
+		expected[SNAP_COLUMN_SAB][i] = fields.header.sab;
+		expected[SNAP_COLUMN_PFB][i] = fields.header.pfb;
+		expected[SNAP_COLUMN_ACK][i] = fields.header.ack;
+		expected[SNAP_COLUMN_CMD][i] = fields.header.cmd;
+		expected[SNAP_COLUMN_EDM][i] = fields.header.edm;
+		expected[SNAP_COLUMN_NDB][i] = snap_getNdb(&frame);
+		expected[SNAP_COLUMN_DEST][i] = fields.destAddress;
+		expected[SNAP_COLUMN_SOURCE][i] = fields.sourceAddress;
+		expected[SNAP_COLUMN_FLAGS][i] = 0;
+		expected[SNAP_COLUMN_SIZE][i] = frame.size;
+		expected[SNAP_COLUMN_DATA_SIZE][i] = snap_getDataSize(&frame);
+		expected[SNAP_COLUMN_HASH][i] = getBe(&frame.buffer[snap_getHashIndex(&frame)], 2);
+
+		TEST_ASSERT_EQUAL_INT(0, snap_columnarAppend(&writer, expected[SNAP_COLUMN_TIMESTAMP][i], 7, (int8_t)frame.status,
+													 frame.buffer, frame.size));
+	}
+
+	TEST_ASSERT_EQUAL_INT(0, snap_columnarWriterClose(&writer));
+}
+
+static size_t loadFile(void)
+{
+	FILE *file = fopen(path, "rb");
+	TEST_ASSERT_NOT_NULL(file);
+
+	const size_t size = fread(fileData, 1, sizeof(fileData), file);
+	fclose(file);
+	TEST_ASSERT_GREATER_THAN_size_t(0, size);
+	TEST_ASSERT_LESS_THAN_size_t(sizeof(fileData), size);
+	return size;
+}
+
+static void storeFile(const size_t size)
+{
+	FILE *file = fopen(path, "wb");
+	TEST_ASSERT_NOT_NULL(file);
+	TEST_ASSERT_EQUAL_size_t(size, fwrite(fileData, 1, size, file));
+	TEST_ASSERT_EQUAL_INT(0, fclose(file));
+}
+
+static void checkOpenFails(void)
+{
+	errno = 0;
+	TEST_ASSERT_EQUAL_INT(-1, snap_columnarReaderOpen(&reader, path));
+	TEST_ASSERT_EQUAL_INT(EINVAL, errno);
+}
+
+static void checkReadFails(const uint32_t group, const snap_column_t column)
+{
+	errno = 0;
+	TEST_ASSERT_EQUAL_INT(-1, snap_columnarReadColumn(&reader, group, column, values));
+	TEST_ASSERT_EQUAL_INT(EINVAL, errno);
+}
+
+// Decode every column of every row group, one at a time, and compare them with the values of the frames
+static void checkColumns(void)
+{
+	for(uint32_t group = 0; group < NUM_GROUPS; group++)
+	{
+		const uint32_t rows = (group + 1U < NUM_GROUPS) ? ROWS_PER_GROUP : NUM_ROWS - group * ROWS_PER_GROUP;
+
+		for(uint_fast8_t column = 0; column < SNAP_COLUMN_COUNT; column++)
+		{
+			memset(values, 0xA5, sizeof(values));
+			TEST_ASSERT_EQUAL_INT_MESSAGE((int)rows, snap_columnarReadColumn(&reader, group, (snap_column_t)column, values),
+										  snap_columnName((snap_column_t)column));
+			TEST_ASSERT_EQUAL_HEX64_ARRAY_MESSAGE(&expected[column][group * ROWS_PER_GROUP], values, rows,
+												  snap_columnName((snap_column_t)column));
+		}
+	}
+}
+
+// Location of the entry of a column chunk in the footer of the loaded file
+static uint8_t *chunkEntry(const size_t size, const uint32_t group, const snap_column_t column)
+{
+	const size_t footer = (size_t)getLe(&fileData[size - SIZE_TRAILER], 8);
+	return &fileData[footer + (size_t)group * SIZE_GROUP + 4U + 16U * (size_t)column];
+}
+
+
+/******************************************************************************/
+/*  TEST GROUP: columnar                                                      */
+/******************************************************************************/
+
+
+TEST_GROUP(columnar);
+
+TEST_SETUP(columnar)
+{
+	const int fd = mkstemp(path);
+	TEST_ASSERT_GREATER_OR_EQUAL_INT(0, fd);
+	close(fd);
+	seed = 0x0BADCAFEU;
+	memset(&reader, 0, sizeof(reader));
+}
+
+TEST_TEAR_DOWN(columnar)
+{
+	if(reader.data != NULL)
+	{
+		snap_columnarReaderClose(&reader);
+	}
+
+	unlink(path);
+	strcpy(&path[sizeof(path) - 7U], "XXXXXX");
+}
+
+TEST_GROUP_RUNNER(columnar)
+{
+	RUN_TEST_CASE(columnar, roundTrip_should_RestoreEveryColumn_when_LastGroupIsPartial);
+	RUN_TEST_CASE(columnar, writer_should_ChooseEncodingFromData);
+	RUN_TEST_CASE(columnar, readColumn_should_ReturnError_if_GroupOrColumnDoesNotExist);
+	RUN_TEST_CASE(columnar, open_should_ReturnError_if_FileIsTruncated);
+	RUN_TEST_CASE(columnar, open_should_ReturnError_if_TrailerOrHeaderIsCorrupted);
+	RUN_TEST_CASE(columnar, readColumn_should_ReturnError_if_FooterIsCorrupted);
+	RUN_TEST_CASE(columnar, readColumn_should_ReturnError_if_ChunkIsCorrupted);
+}
+
+TEST(columnar, roundTrip_should_RestoreEveryColumn_when_LastGroupIsPartial)
+{
+	snap_columnarGroup_t description;
+
+	writeColumnar();
+	TEST_ASSERT_EQUAL_INT(0, snap_columnarReaderOpen(&reader, path));
+	TEST_ASSERT_EQUAL_UINT32(NUM_GROUPS, reader.groupCount);
+	TEST_ASSERT_EQUAL_UINT32(ROWS_PER_GROUP, reader.rowsPerGroup);
+	TEST_ASSERT_EQUAL_INT(0, snap_columnarGetGroup(&reader, NUM_GROUPS - 1U, &description));
+	TEST_ASSERT_EQUAL_UINT32(NUM_ROWS % ROWS_PER_GROUP, description.rows);
+	checkColumns();
+}
+
+TEST(columnar, writer_should_ChooseEncodingFromData)
+{
+	snap_columnarGroup_t description;
+
+	writeColumnar();
+	TEST_ASSERT_EQUAL_INT(0, snap_columnarReaderOpen(&reader, path));
+
+	for(uint32_t group = 0; group < NUM_GROUPS; group++)
+	{
+		TEST_ASSERT_EQUAL_INT(0, snap_columnarGetGroup(&reader, group, &description));
+		TEST_ASSERT_EQUAL_UINT8(SNAP_COLUMNAR_DELTA, description.chunks[SNAP_COLUMN_TIMESTAMP].encoding);
+		TEST_ASSERT_EQUAL_UINT8(SNAP_COLUMNAR_RLE, description.chunks[SNAP_COLUMN_CHANNEL].encoding);
+		TEST_ASSERT_EQUAL_UINT8(SNAP_COLUMNAR_RLE, description.chunks[SNAP_COLUMN_FLAGS].encoding);
+		TEST_ASSERT_EQUAL_UINT8(SNAP_COLUMNAR_DICT, description.chunks[SNAP_COLUMN_SOURCE].encoding);
+		TEST_ASSERT_EQUAL_UINT8(SNAP_COLUMNAR_PLAIN, description.chunks[SNAP_COLUMN_DEST].encoding);
+
+		// A constant column fits in a single run, whatever the number of rows
+		TEST_ASSERT_EQUAL_UINT32(2U + 2U, description.chunks[SNAP_COLUMN_CHANNEL].size);	// Run length (varint) and value
+		TEST_ASSERT_EQUAL_UINT32(description.rows * 3U, description.chunks[SNAP_COLUMN_DEST].size);
+	}
+}
+
+TEST(columnar, readColumn_should_ReturnError_if_GroupOrColumnDoesNotExist)
+{
+	snap_columnarGroup_t description;
+
+	writeColumnar();
+	TEST_ASSERT_EQUAL_INT(0, snap_columnarReaderOpen(&reader, path));
+	checkReadFails(NUM_GROUPS, SNAP_COLUMN_TIMESTAMP);
+	checkReadFails(0, SNAP_COLUMN_COUNT);
+	errno = 0;
+	TEST_ASSERT_EQUAL_INT(-1, snap_columnarGetGroup(&reader, NUM_GROUPS, &description));
+	TEST_ASSERT_EQUAL_INT(EINVAL, errno);
+	TEST_ASSERT_NULL(snap_columnName(SNAP_COLUMN_COUNT));
+	TEST_ASSERT_EQUAL_STRING("source", snap_columnName(SNAP_COLUMN_SOURCE));
+}
+
+TEST(columnar, open_should_ReturnError_if_FileIsTruncated)
+{
+	writeColumnar();
+	const size_t size = loadFile();
+
+	// Every size that cuts into the footer or the trailer, and some that cut into the chunks
+	for(size_t cut = 1; cut <= size; cut += (cut < SIZE_TRAILER + NUM_GROUPS * SIZE_GROUP + 8U) ? 1U : 997U)
+	{
+		storeFile(size - cut);
+		checkOpenFails();
+	}
+
+	storeFile(size);
+	TEST_ASSERT_EQUAL_INT(0, snap_columnarReaderOpen(&reader, path));
+}
+
+TEST(columnar, open_should_ReturnError_if_TrailerOrHeaderIsCorrupted)
+{
+	writeColumnar();
+	const size_t size = loadFile();
+
+	// Footer offset, number of row groups and magic (the reserved bytes are ignored)
+	for(size_t i = size - SIZE_TRAILER; i < size; i++)
+	{
+		const uint8_t byte = fileData[i];
+
+		fileData[i] ^= 0x01U;
+		storeFile(size);
+
+		if((i >= size - SIZE_TRAILER + 12U) && (i < size - SIZE_TRAILER + 16U))
+		{
+			TEST_ASSERT_EQUAL_INT(0, snap_columnarReaderOpen(&reader, path));
+			snap_columnarReaderClose(&reader);
+		}
+		else
+		{
+			checkOpenFails();
+		}
+
+		fileData[i] = byte;
+	}
+
+	// Magic, version, number of columns and number of rows per group
+	for(size_t i = 0; i < 12U; i++)
+	{
+		fileData[i] ^= 0x01U;
+		storeFile(size);
+		checkOpenFails();
+		fileData[i] ^= 0x01U;
+	}
+
+	putLe(&fileData[12], 0, 4);
+	storeFile(size);
+	checkOpenFails();
+	putLe(&fileData[12], SNAP_COLUMNAR_MAX_ROWS + 1U, 4);
+	storeFile(size);
+	checkOpenFails();
+}
+
+TEST(columnar, readColumn_should_ReturnError_if_FooterIsCorrupted)
+{
+	writeColumnar();
+	const size_t size = loadFile();
+	const size_t footer = (size_t)getLe(&fileData[size - SIZE_TRAILER], 8);
+	const uint32_t rows[] = {0, ROWS_PER_GROUP + 1U};
+	uint8_t *entry = chunkEntry(size, 1, SNAP_COLUMN_DEST);
+
+	// Number of rows of the second group
+	for(size_t i = 0; i < sizeof(rows) / sizeof(rows[0]); i++)
+	{
+		putLe(&fileData[footer + SIZE_GROUP], rows[i], 4);
+		storeFile(size);
+		TEST_ASSERT_EQUAL_INT(0, snap_columnarReaderOpen(&reader, path));
+		checkReadFails(1, SNAP_COLUMN_SIZE);
+		TEST_ASSERT_EQUAL_INT(ROWS_PER_GROUP, snap_columnarReadColumn(&reader, 0, SNAP_COLUMN_SIZE, values));
+		snap_columnarReaderClose(&reader);
+	}
+
+	putLe(&fileData[footer + SIZE_GROUP], ROWS_PER_GROUP, 4);
+
+	// Chunk before the header, inside the footer, past the footer, and unknown encoding
+	const uint64_t offset = getLe(&entry[0], 8);
+	const uint64_t chunkSize = getLe(&entry[8], 4);
+	const uint64_t patches[][3] =
+	{
+		{0, 8, 8},
+		{0, 8, footer + 1U},
+		{0, 8, footer - chunkSize + 1U},
+		{8, 4, footer - offset + 1U},
+		{12, 1, SNAP_COLUMNAR_DELTA + 1U},
+	};
+
+	for(size_t i = 0; i < sizeof(patches) / sizeof(patches[0]); i++)
+	{
+		const uint_fast8_t field = (uint_fast8_t)patches[i][0], width = (uint_fast8_t)patches[i][1];
+		const uint64_t original = getLe(&entry[field], width);
+
+		putLe(&entry[field], patches[i][2], width);
+		storeFile(size);
+		TEST_ASSERT_EQUAL_INT(0, snap_columnarReaderOpen(&reader, path));
+		checkReadFails(1, SNAP_COLUMN_DEST);
+		checkReadFails(1, SNAP_COLUMN_TIMESTAMP);	// The whole description of the group is rejected
+		TEST_ASSERT_EQUAL_INT(ROWS_PER_GROUP, snap_columnarReadColumn(&reader, 0, SNAP_COLUMN_DEST, values));
+		snap_columnarReaderClose(&reader);
+		putLe(&entry[field], original, width);
+	}
+}
+
+TEST(columnar, readColumn_should_ReturnError_if_ChunkIsCorrupted)
+{
+	writeColumnar();
+	const size_t size = loadFile();
+
+	// A chunk one byte shorter or longer than its content, with each encoding
+	for(uint_fast8_t column = 0; column < SNAP_COLUMN_COUNT; column++)
+	{
+		uint8_t *entry = chunkEntry(size, 0, (snap_column_t)column);
+		const uint64_t chunkSize = getLe(&entry[8], 4);
+
+		for(int delta = -1; delta <= 1; delta += 2)
+		{
+			putLe(&entry[8], (uint64_t)((int64_t)chunkSize + delta), 4);
+			storeFile(size);
+			TEST_ASSERT_EQUAL_INT(0, snap_columnarReaderOpen(&reader, path));
+			checkReadFails(0, (snap_column_t)column);
+			snap_columnarReaderClose(&reader);
+		}
+
+		putLe(&entry[8], chunkSize, 4);
+	}
+
+	// Dictionary index past the number of distinct values
+	const uint8_t *entry = chunkEntry(size, 0, SNAP_COLUMN_SOURCE);
+	const size_t offset = (size_t)getLe(&entry[0], 8);
+
+	TEST_ASSERT_EQUAL_UINT8(SNAP_COLUMNAR_DICT, entry[12]);
+	TEST_ASSERT_EQUAL_UINT8(4, fileData[offset]);
+	fileData[offset + 1U + 4U * 3U + 10U] = 4;
+	storeFile(size);
+	TEST_ASSERT_EQUAL_INT(0, snap_columnarReaderOpen(&reader, path));
+	checkReadFails(0, SNAP_COLUMN_SOURCE);
+	TEST_ASSERT_EQUAL_INT(ROWS_PER_GROUP, snap_columnarReadColumn(&reader, 1, SNAP_COLUMN_SOURCE, values));
+}
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,258 @@
+/**
+ * @file   test_snap_cut.c
+ * @author Lucas Jadilo
+ * @brief  Unit tests for the cut-through forwarder module of the libSNAP library.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include <string.h>
+#include "unity_fixture.h"
+#include "snap_cut.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define FORWARDED_ADDRESS	(0x12U)	// Destination address routed to port 1
+#define PORT				(1)
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+typedef struct output_t
+{
+	uint8_t  bytes[4 * SNAP_MAX_SIZE_FRAME];	// Bytes sent to the output port
+	size_t   size;								// Number of bytes sent
+	size_t   calls;								// Number of output calls
+	size_t   routes;							// Number of route calls
+	size_t   sentBeforeEnd;						// Bytes sent before the first frame was reported
+	size_t   frames;							// Number of frames reported
+	int8_t   status;							// Status of the last frame reported
+	int16_t  port;								// Port of the last frame reported
+} output_t;
+
+
+/******************************************************************************/
+/*  Private Variables                                                         */
+/******************************************************************************/
+
+
+static snap_cut_t cut;
+static output_t out;
+
+
+/******************************************************************************/
+/*  Function Definitions                                                      */
+/******************************************************************************/
+
+
+static int16_t test_route(void *context, const snap_frame_t *frame)
+{
+	output_t *output = context;
+	uint32_t address = 0;
+
+	output->routes++;
+	snap_getField(frame, &address, SNAP_FIELD_DEST_ADDRESS);
+
+	return (address == FORWARDED_ADDRESS) ? PORT : SNAP_CUT_NO_PORT;
+}
+
+static void test_output(void *context, const int16_t port, const uint8_t *data, const size_t size)
+{
+	output_t *output = context;
+
+	TEST_ASSERT_EQUAL_INT16(PORT, port);
+	TEST_ASSERT_NOT_EQUAL(0, size);
+	TEST_ASSERT_LESS_OR_EQUAL_size_t(sizeof(output->bytes) - output->size, size);
+
+	memcpy(&output->bytes[output->size], data, size);
+	output->size += size;
+	output->calls++;
+}
+
+static void test_callback(void *context, const snap_frame_t *frame, const int16_t port)
+{
+	output_t *output = context;
+
+	if(output->frames == 0)
+	{
+		output->sentBeforeEnd = output->size;
+	}
+
+	output->frames++;
+	output->status = frame->status;
+	output->port = port;
+}
+
+static uint16_t test_buildFrame(uint8_t *buffer, const uint32_t destAddress, const uint16_t dataSize)
+{
+	uint8_t data[32];
+	snap_frame_t frame;
+	snap_fields_t fields = {.data = data, .dataSize = dataSize, .destAddress = destAddress, .sourceAddress = 0x34,
+							.header = {.dab = SNAP_HDB2_DAB_1BYTE_DEST_ADDRESS, .sab = SNAP_HDB2_SAB_1BYTE_SOURCE_ADDRESS,
+									   .edm = SNAP_HDB1_EDM_16BIT_CRC}};
+
+	for(size_t i = 0; i < sizeof(data); i++)
+	{
+		data[i] = (uint8_t)(i + 0x80U);
+	}
+
+	snap_init(&frame, buffer, SNAP_MAX_SIZE_FRAME);
+	snap_encapsulate(&frame, &fields);
+
+	return frame.size;
+}
+
+
+/******************************************************************************/
+/*  TEST GROUP: cut                                                           */
+/******************************************************************************/
+
+
+TEST_GROUP(cut);
+
+TEST_SETUP(cut)
+{
+	memset(&out, 0, sizeof(out));
+}
+
+TEST_TEAR_DOWN(cut) {}
+
+TEST_GROUP_RUNNER(cut)
+{
+	RUN_TEST_CASE(cut, process_should_ForwardBytesBeforeFrameEnds_when_ModeIsCutThrough);
+	RUN_TEST_CASE(cut, process_should_BreakForwardedHash_when_HashIsWrong);
+	RUN_TEST_CASE(cut, process_should_ForwardOnlyValidFrames_when_ModeIsStoreAndForward);
+	RUN_TEST_CASE(cut, process_should_ForwardOnlyRoutedFrames_and_SkipNoise);
+}
+
+TEST(cut, process_should_ForwardBytesBeforeFrameEnds_when_ModeIsCutThrough)
+{
+	uint8_t frame[SNAP_MAX_SIZE_FRAME];
+	const uint16_t size = test_buildFrame(frame, FORWARDED_ADDRESS, 16);
+
+	TEST_ASSERT_EQUAL_INT16(0, snap_cutInit(&cut, SNAP_CUT_MODE_CUT_THROUGH, test_route, test_output, test_callback, &out));
+
+	// Byte by byte: the route is decided at the destination address, and every byte but the last is sent before the hash check
+	for(uint16_t i = 0; i < size; i++)
+	{
+		TEST_ASSERT_EQUAL_size_t((i == size - 1U) ? 1U : 0U, snap_cutProcess(&cut, &frame[i], 1));
+
+		if(i < SNAP_INDEX_DAB)
+		{
+			TEST_ASSERT_EQUAL_size_t(0, out.size);
+		}
+		else if(i < size - 1U)
+		{
+			TEST_ASSERT_EQUAL_size_t(i + 1U, out.size);
+		}
+	}
+
+	TEST_ASSERT_EQUAL_size_t(1, out.routes);
+	TEST_ASSERT_EQUAL_size_t(1, out.frames);
+	TEST_ASSERT_EQUAL_size_t(size, out.sentBeforeEnd);
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_VALID, out.status);
+	TEST_ASSERT_EQUAL_INT16(PORT, out.port);
+	TEST_ASSERT_EQUAL_size_t(size, out.size);
+	TEST_ASSERT_EQUAL_HEX8_ARRAY(frame, out.bytes, size);
+
+	// Whole frame in one block: header, body and last byte
+	memset(&out, 0, sizeof(out));
+
+	TEST_ASSERT_EQUAL_size_t(1, snap_cutProcess(&cut, frame, size));
+	TEST_ASSERT_EQUAL_size_t(3, out.calls);
+	TEST_ASSERT_EQUAL_HEX8_ARRAY(frame, out.bytes, size);
+	TEST_ASSERT_EQUAL_UINT64(2, cut.stats.forwardedFrames);
+	TEST_ASSERT_EQUAL_UINT64(2, cut.stats.validFrames);
+	TEST_ASSERT_EQUAL_UINT64(0, cut.stats.poisonedFrames);
+	TEST_ASSERT_EQUAL_UINT64(2U * size, cut.stats.bytes);
+}
+
+TEST(cut, process_should_BreakForwardedHash_when_HashIsWrong)
+{
+	uint8_t frame[SNAP_MAX_SIZE_FRAME], buffer[SNAP_MAX_SIZE_FRAME];
+	const uint16_t size = test_buildFrame(frame, FORWARDED_ADDRESS, 16);
+	snap_frame_t received;
+
+	TEST_ASSERT_EQUAL_INT16(0, snap_cutInit(&cut, SNAP_CUT_MODE_CUT_THROUGH, test_route, test_output, test_callback, &out));
+
+	// Error in the first hash byte only: the last byte received is correct, but must be changed anyway
+	frame[size - 2U] ^= 0x01U;
+
+	TEST_ASSERT_EQUAL_size_t(1, snap_cutProcess(&cut, frame, size));
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_ERROR_HASH, out.status);
+	TEST_ASSERT_EQUAL_size_t(size, out.size);
+	TEST_ASSERT_EQUAL_HEX8_ARRAY(frame, out.bytes, size - 1U);
+	TEST_ASSERT_NOT_EQUAL(frame[size - 1U], out.bytes[size - 1U]);
+	TEST_ASSERT_EQUAL_UINT64(1, cut.stats.hashErrors);
+	TEST_ASSERT_EQUAL_UINT64(1, cut.stats.poisonedFrames);
+
+	// The next node must reject the forwarded frame
+	snap_init(&received, buffer, sizeof(buffer));
+	snap_decodeBuffer(&received, out.bytes, out.size);
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_ERROR_HASH, received.status);
+}
+
+TEST(cut, process_should_ForwardOnlyValidFrames_when_ModeIsStoreAndForward)
+{
+	uint8_t frame[SNAP_MAX_SIZE_FRAME];
+	const uint16_t size = test_buildFrame(frame, FORWARDED_ADDRESS, 8);
+
+	TEST_ASSERT_EQUAL_INT16(0, snap_cutInit(&cut, SNAP_CUT_MODE_STORE_AND_FORWARD, test_route, test_output, test_callback, &out));
+
+	for(uint16_t i = 0; i < size; i++)
+	{
+		TEST_ASSERT_EQUAL_size_t(0, out.size);
+		snap_cutProcess(&cut, &frame[i], 1);
+	}
+
+	TEST_ASSERT_EQUAL_size_t(1, out.calls);
+	TEST_ASSERT_EQUAL_HEX8_ARRAY(frame, out.bytes, size);
+
+	frame[size - 1U] ^= 0x01U;
+	memset(&out, 0, sizeof(out));
+
+	TEST_ASSERT_EQUAL_size_t(1, snap_cutProcess(&cut, frame, size));
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_ERROR_HASH, out.status);
+	TEST_ASSERT_EQUAL_INT16(PORT, out.port);
+	TEST_ASSERT_EQUAL_size_t(0, out.size);
+	TEST_ASSERT_EQUAL_UINT64(1, cut.stats.forwardedFrames);
+}
+
+TEST(cut, process_should_ForwardOnlyRoutedFrames_and_SkipNoise)
+{
+	uint8_t block[3 * SNAP_MAX_SIZE_FRAME], expected[SNAP_MAX_SIZE_FRAME];
+	size_t size = 0;
+
+	block[size++] = 0x00;
+	block[size++] = 0xFF;
+	size += test_buildFrame(&block[size], 0x56, 20);
+	block[size++] = 0x11;
+	const uint16_t forwarded = test_buildFrame(&block[size], FORWARDED_ADDRESS, 5);
+	memcpy(expected, &block[size], forwarded);
+	size += forwarded;
+	block[size++] = SNAP_SYNC;	// Start of a frame that is not complete yet
+
+	TEST_ASSERT_EQUAL_INT16(0, snap_cutInit(&cut, SNAP_CUT_MODE_CUT_THROUGH, test_route, test_output, test_callback, &out));
+	TEST_ASSERT_EQUAL_size_t(2, snap_cutProcess(&cut, block, size));
+	TEST_ASSERT_EQUAL_size_t(2, out.routes);
+	TEST_ASSERT_EQUAL_size_t(2, out.frames);
+	TEST_ASSERT_EQUAL_INT16(PORT, out.port);
+	TEST_ASSERT_EQUAL_size_t(forwarded, out.size);
+	TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, out.bytes, forwarded);
+	TEST_ASSERT_EQUAL_UINT64(2, cut.stats.validFrames);
+	TEST_ASSERT_EQUAL_UINT64(1, cut.stats.forwardedFrames);
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_INCOMPLETE, cut.frame.status);
+}
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,284 @@
+/**
+ * @file   test_snap_dispatch.c
+ * @author Lucas Jadilo
+ * @brief  Unit tests for the frame dispatcher of the SNAP tools.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _DEFAULT_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include "unity_fixture.h"
+#include "snap_dispatch.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define NUM_FRAMES		(8U)
+#define NUM_THREADS		(4U)
+#define NUM_PUBLISHED	(200000U)
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+typedef struct reader_t
+{
+	pthread_t thread;
+	uint32_t  number;
+	uint64_t  received;
+	bool      corrupted;
+} reader_t;
+
+
+/******************************************************************************/
+/*  Variables                                                                 */
+/******************************************************************************/
+
+
+static snap_pool_t pool;
+static snap_dispatcher_t dispatcher;
+static reader_t readers[NUM_THREADS];
+static bool finished;
+
+
+/******************************************************************************/
+/*  Function Definitions                                                      */
+/******************************************************************************/
+
+
+static uint32_t countFree(void)
+{
+	snap_frame_t *frames[NUM_FRAMES + 1U];
+	uint32_t count = 0;
+
+	while((count <= NUM_FRAMES) && ((frames[count] = snap_poolGet(&pool)) != NULL))
+	{
+		count++;
+	}
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		snap_poolPut(&pool, frames[i]);
+	}
+
+	return count;
+}
+
+static void stamp(snap_frame_t *frame, const uint64_t number)
+{
+	memcpy(frame->buffer, &number, sizeof(number));
+	frame->size = sizeof(number);
+}
+
+static uint64_t readStamp(const snap_frame_t *frame)
+{
+	uint64_t number;
+	memcpy(&number, frame->buffer, sizeof(number));
+	return number;
+}
+
+// Each frame carries its publication number: it must increase, and must not change while the frame is held
+static void *readFrames(void *argument)
+{
+	reader_t *reader = argument;
+	uint64_t last = 0;
+
+	for(;;)
+	{
+		const bool done = __atomic_load_n(&finished, __ATOMIC_ACQUIRE);
+		const snap_frame_t *frame = snap_dispatchReceive(&dispatcher, reader->number);
+
+		if(frame == NULL)
+		{
+			if(done) break;
+			sched_yield();
+			continue;
+		}
+
+		const uint64_t number = readStamp(frame);
+
+		for(volatile uint32_t i = 0; i < 64U; i++) {}
+
+		reader->corrupted |= (number <= last) || (readStamp(frame) != number) || (frame->size != sizeof(number));
+		reader->received++;
+		last = number;
+		snap_dispatchRelease(&dispatcher, frame);
+	}
+
+	return NULL;
+}
+
+
+/******************************************************************************/
+/*  TEST GROUP: dispatch                                                      */
+/******************************************************************************/
+
+
+TEST_GROUP(dispatch);
+
+TEST_SETUP(dispatch)
+{
+	TEST_ASSERT_EQUAL_INT(0, snap_poolInit(&pool, NUM_FRAMES, SNAP_MIN_SIZE_FRAME + 8U, -1));
+}
+
+TEST_TEAR_DOWN(dispatch)
+{
+	snap_dispatchDestroy(&dispatcher);
+	snap_poolDestroy(&pool);
+}
+
+TEST_GROUP_RUNNER(dispatch)
+{
+	RUN_TEST_CASE(dispatch, release_should_RecycleFrame_when_LastSubscriberReleasesIt);
+	RUN_TEST_CASE(dispatch, publishTo_should_RecycleFrameAtOnce_when_NoSubscriberReceivesIt);
+	RUN_TEST_CASE(dispatch, publish_should_DropFrame_when_QueueIsFull);
+	RUN_TEST_CASE(dispatch, release_should_NeverRecycleHeldFrame_when_SubscribersRunConcurrently);
+}
+
+TEST(dispatch, release_should_RecycleFrame_when_LastSubscriberReleasesIt)
+{
+	TEST_ASSERT_EQUAL_INT(0, snap_dispatchInit(&dispatcher, &pool, 3, 4));
+
+	snap_frame_t *frame = snap_poolGet(&pool);
+	TEST_ASSERT_NOT_NULL(frame);
+	stamp(frame, 1);
+	TEST_ASSERT_EQUAL_UINT32(3, snap_dispatchPublish(&dispatcher, frame));
+	TEST_ASSERT_EQUAL_UINT32(NUM_FRAMES - 1U, countFree());
+
+	for(uint32_t i = 0; i < 3U; i++)
+	{
+		const snap_frame_t *received = snap_dispatchReceive(&dispatcher, i);
+
+		TEST_ASSERT_EQUAL_PTR(frame, received);
+		TEST_ASSERT_NULL(snap_dispatchReceive(&dispatcher, i));
+		TEST_ASSERT_EQUAL_UINT32(NUM_FRAMES - 1U, countFree());
+		snap_dispatchRelease(&dispatcher, received);
+	}
+
+	TEST_ASSERT_EQUAL_UINT32(NUM_FRAMES, countFree());
+}
+
+TEST(dispatch, publishTo_should_RecycleFrameAtOnce_when_NoSubscriberReceivesIt)
+{
+	TEST_ASSERT_EQUAL_INT(0, snap_dispatchInit(&dispatcher, &pool, 3, 4));
+
+	TEST_ASSERT_EQUAL_UINT32(0, snap_dispatchPublishTo(&dispatcher, snap_poolGet(&pool), 0));
+	TEST_ASSERT_EQUAL_UINT32(NUM_FRAMES, countFree());
+
+	// The bits above the number of subscribers are ignored
+	TEST_ASSERT_EQUAL_UINT32(0, snap_dispatchPublishTo(&dispatcher, snap_poolGet(&pool), ~(uint64_t)7U));
+	TEST_ASSERT_EQUAL_UINT32(NUM_FRAMES, countFree());
+
+	snap_frame_t *frame = snap_poolGet(&pool);
+	TEST_ASSERT_EQUAL_UINT32(1, snap_dispatchPublishTo(&dispatcher, frame, 0xF2U));
+	TEST_ASSERT_NULL(snap_dispatchReceive(&dispatcher, 0));
+	TEST_ASSERT_NULL(snap_dispatchReceive(&dispatcher, 2));
+
+	const snap_frame_t *received = snap_dispatchReceive(&dispatcher, 1);
+	TEST_ASSERT_EQUAL_PTR(frame, received);
+	snap_dispatchRelease(&dispatcher, received);
+	TEST_ASSERT_EQUAL_UINT32(NUM_FRAMES, countFree());
+}
+
+TEST(dispatch, publish_should_DropFrame_when_QueueIsFull)
+{
+	snap_frame_t *frames[3];
+
+	TEST_ASSERT_EQUAL_INT(0, snap_dispatchInit(&dispatcher, &pool, 2, 2));
+
+	for(uint32_t i = 0; i < 3U; i++)
+	{
+		frames[i] = snap_poolGet(&pool);
+		stamp(frames[i], i);
+	}
+
+	TEST_ASSERT_EQUAL_UINT32(2, snap_dispatchPublish(&dispatcher, frames[0]));
+	TEST_ASSERT_EQUAL_UINT32(1, snap_dispatchPublishTo(&dispatcher, frames[1], 1U << 1));
+	TEST_ASSERT_EQUAL_UINT32(1, snap_dispatchPublish(&dispatcher, frames[2]));	// Subscriber 1 is full
+	TEST_ASSERT_EQUAL_UINT64(1, dispatcher.subscribers[1].dropped);
+	TEST_ASSERT_EQUAL_UINT64(0, dispatcher.subscribers[0].dropped);
+
+	// Subscriber 0 holds frames 0 and 2: frame 2 is recycled when it releases it
+	for(uint32_t i = 0; i < 3U; i += 2U)
+	{
+		const snap_frame_t *received = snap_dispatchReceive(&dispatcher, 0);
+
+		TEST_ASSERT_EQUAL_PTR(frames[i], received);
+		snap_dispatchRelease(&dispatcher, received);
+	}
+
+	TEST_ASSERT_EQUAL_UINT32(NUM_FRAMES - 2U, countFree());
+
+	for(uint32_t i = 0; i < 2U; i++)
+	{
+		const snap_frame_t *received = snap_dispatchReceive(&dispatcher, 1);
+
+		TEST_ASSERT_EQUAL_PTR(frames[i], received);
+		snap_dispatchRelease(&dispatcher, received);
+	}
+
+	TEST_ASSERT_NULL(snap_dispatchReceive(&dispatcher, 1));
+	TEST_ASSERT_EQUAL_UINT32(NUM_FRAMES, countFree());
+}
+
+TEST(dispatch, release_should_NeverRecycleHeldFrame_when_SubscribersRunConcurrently)
+{
+	uint64_t delivered = 0, received = 0, dropped = 0, targeted = 0;
+	uint32_t seed = 0xC0FFEEU;
+
+	TEST_ASSERT_EQUAL_INT(0, snap_dispatchInit(&dispatcher, &pool, NUM_THREADS, NUM_FRAMES));	// No queue can be full
+	finished = false;
+
+	for(uint32_t i = 0; i < NUM_THREADS; i++)
+	{
+		readers[i] = (reader_t){.number = i};
+		TEST_ASSERT_EQUAL_INT(0, pthread_create(&readers[i].thread, NULL, readFrames, &readers[i]));
+	}
+
+	// The pool is small, so the frames are recycled many times while others are still held
+	for(uint64_t number = 1; number <= NUM_PUBLISHED; number++)
+	{
+		snap_frame_t *frame;
+
+		while((frame = snap_poolGet(&pool)) == NULL)
+		{
+			sched_yield();
+		}
+
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		stamp(frame, number);
+		targeted += (uint64_t)__builtin_popcount(seed & ((1U << NUM_THREADS) - 1U));
+		delivered += snap_dispatchPublishTo(&dispatcher, frame, seed);
+	}
+
+	__atomic_store_n(&finished, true, __ATOMIC_RELEASE);
+
+	for(uint32_t i = 0; i < NUM_THREADS; i++)
+	{
+		TEST_ASSERT_EQUAL_INT(0, pthread_join(readers[i].thread, NULL));
+		TEST_ASSERT_FALSE(readers[i].corrupted);
+		received += readers[i].received;
+		dropped += dispatcher.subscribers[i].dropped;
+	}
+
+	TEST_ASSERT_EQUAL_UINT64(0, dropped);
+	TEST_ASSERT_EQUAL_UINT64(targeted, delivered);
+	TEST_ASSERT_EQUAL_UINT64(delivered, received);
+	TEST_ASSERT_EQUAL_UINT32(NUM_FRAMES, countFree());
+}
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,278 @@
+/**
+ * @file   test_snap_filter.c
+ * @author Lucas Jadilo
+ * @brief  Unit tests for the subscription filters of the SNAP tools.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include <errno.h>
+#include <string.h>
+#include "unity_fixture.h"
+#include "snap_filter.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define NUM_SUBSCRIPTIONS	(150U)	// More than two words of subscribers
+#define NUM_FRAMES			(3000U)
+#define MAX_LIST			(4U)
+#define SIZE_LONG_LIST		(1000U)
+
+
+/******************************************************************************/
+/*  Variables                                                                 */
+/******************************************************************************/
+
+
+static snap_subscription_t subscriptions[NUM_SUBSCRIPTIONS];
+static uint32_t destLists[NUM_SUBSCRIPTIONS][MAX_LIST];
+static uint32_t sourceLists[NUM_SUBSCRIPTIONS][MAX_LIST];
+static uint8_t commandLists[NUM_SUBSCRIPTIONS][MAX_LIST];
+static uint32_t longList[SIZE_LONG_LIST];
+static uint64_t subscribers[SNAP_FILTER_WORDS(NUM_SUBSCRIPTIONS)];
+static uint8_t frameBuffer[SNAP_MAX_SIZE_FRAME];
+static snap_frame_t frame;
+static snap_filter_t filter;
+static uint32_t seed;
+
+
+/******************************************************************************/
+/*  Function Definitions                                                      */
+/******************************************************************************/
+
+
+static uint32_t randomNumber(const uint32_t limit)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed % limit;
+}
+
+// Addresses and flags from a small pool (so that frames and subscriptions often agree), masked to the field size
+static uint32_t randomField(const uint_fast8_t bytes)
+{
+	static const uint32_t pool[] = {0x000000, 0x000012, 0x0000B0, 0x00B0B1, 0x123456, 0xFFFFFF};
+	const uint32_t index = randomNumber(sizeof(pool) / sizeof(pool[0]) + 1U);
+	const uint32_t value = (index < sizeof(pool) / sizeof(pool[0])) ? pool[index] : randomNumber(0x1000000U);
+
+	return value & (uint32_t)((1UL << (8U * bytes)) - 1U);
+}
+
+static void randomFrame(void)
+{
+	uint8_t data[8];
+	snap_fields_t fields = {.data = data, .paddingAfter = true};
+
+	fields.header.dab = randomNumber(4) & 3U;
+	fields.header.sab = randomNumber(4) & 3U;
+	fields.header.pfb = randomNumber(4) & 3U;
+	fields.header.ack = randomNumber(4) & 3U;
+	fields.header.cmd = randomNumber(2) & 1U;
+	fields.header.edm = randomNumber(6) & 7U;
+	fields.dataSize = (uint16_t)randomNumber(3);
+	fields.destAddress = randomField(fields.header.dab);
+	fields.sourceAddress = randomField(fields.header.sab);
+	fields.protocolFlags = randomField(fields.header.pfb);
+
+	for(size_t i = 0; i < sizeof(data); i++)
+	{
+		data[i] = (uint8_t)randomNumber(4);
+	}
+
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_VALID, snap_encapsulate(&frame, &fields));
+}
+
+static void randomSubscription(const size_t i)
+{
+	snap_subscription_t *s = &subscriptions[i];
+
+	memset(s, 0, sizeof(*s));
+
+	// Each condition is present in about half of the subscriptions
+	if(randomNumber(2))
+	{
+		s->hdb2Mask = (uint8_t)randomNumber(256);
+		s->hdb2Value = (uint8_t)(randomNumber(256) & s->hdb2Mask);
+	}
+
+	if(randomNumber(2))
+	{
+		s->hdb1Mask = (uint8_t)(randomNumber(256) & 0xF0U);
+		s->hdb1Value = (uint8_t)(randomNumber(256) & s->hdb1Mask);
+	}
+
+	if(randomNumber(2))
+	{
+		s->flagsMask = randomField((uint_fast8_t)(1U + randomNumber(3)));
+		s->flagsValue = randomField(3) & s->flagsMask;
+	}
+
+	s->destCount = randomNumber(2) ? 0 : 1U + randomNumber(MAX_LIST);
+	s->sourceCount = randomNumber(2) ? 0 : 1U + randomNumber(MAX_LIST);
+	s->commandCount = randomNumber(2) ? 0 : 1U + randomNumber(MAX_LIST);
+	s->destAddresses = destLists[i];
+	s->sourceAddresses = sourceLists[i];
+	s->commands = commandLists[i];
+
+	for(size_t j = 0; j < MAX_LIST; j++)
+	{
+		destLists[i][j] = randomField((uint_fast8_t)randomNumber(4));
+		sourceLists[i][j] = randomField((uint_fast8_t)randomNumber(4));
+		commandLists[i][j] = (uint8_t)randomNumber(4);
+	}
+}
+
+static void checkFrames(const uint32_t count)
+{
+	uint32_t total = 0;
+
+	for(size_t f = 0; f < NUM_FRAMES; f++)
+	{
+		uint32_t expected = 0;
+
+		randomFrame();
+		memset(subscribers, 0xA5, sizeof(subscribers));
+
+		const uint32_t matches = snap_filterMatch(&filter, &frame, subscribers);
+
+		for(uint32_t i = 0; i < count; i++)
+		{
+			const bool test = snap_filterTest(&subscriptions[i], &frame);
+
+			expected += test;
+
+			// The set is only meaningful when some subscriber matches
+			if(matches != 0)
+			{
+				TEST_ASSERT_EQUAL(test, (subscribers[i / 64U] >> (i % 64U)) & 1U);
+			}
+		}
+
+		TEST_ASSERT_EQUAL_UINT32(expected, matches);
+		total += matches;
+	}
+
+	// The random subscriptions must select some frames, but not all of them
+	TEST_ASSERT_GREATER_THAN_UINT32(0, total);
+	TEST_ASSERT_LESS_THAN_UINT32(NUM_FRAMES * count, total);
+}
+
+
+/******************************************************************************/
+/*  TEST GROUP: filter                                                        */
+/******************************************************************************/
+
+
+TEST_GROUP(filter);
+
+TEST_SETUP(filter)
+{
+	seed = 0x13579BDFU;
+	snap_init(&frame, frameBuffer, sizeof(frameBuffer));
+	memset(&filter, 0, sizeof(filter));
+}
+
+TEST_TEAR_DOWN(filter)
+{
+	snap_filterDestroy(&filter);
+}
+
+TEST_GROUP_RUNNER(filter)
+{
+	RUN_TEST_CASE(filter, compile_should_ReturnError_if_SubscriptionIsInvalid);
+	RUN_TEST_CASE(filter, match_should_ReturnEverySubscriber_when_SubscriptionsAreEmpty);
+	RUN_TEST_CASE(filter, match_should_AgreeWithTest_when_SubscriptionsAreRandom);
+	RUN_TEST_CASE(filter, match_should_AgreeWithTest_when_AddressListIsLong);
+}
+
+TEST(filter, compile_should_ReturnError_if_SubscriptionIsInvalid)
+{
+	const snap_subscription_t invalid[] =
+	{
+		{.hdb2Mask = 0xF0, .hdb2Value = 0x01},
+		{.hdb1Mask = 0x0F, .hdb1Value = 0x10},
+		{.flagsMask = 0x1000000},
+		{.flagsMask = 0x00FF00, .flagsValue = 0x000100 | 0x000001},
+		{.destCount = 1},
+		{.sourceCount = 1},
+		{.commandCount = 1},
+	};
+
+	for(size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+	{
+		subscriptions[0] = invalid[i];
+		errno = 0;
+		TEST_ASSERT_EQUAL_INT(-1, snap_filterCompile(&filter, subscriptions, 1));
+		TEST_ASSERT_EQUAL_INT(EINVAL, errno);
+	}
+
+	memset(subscriptions, 0, sizeof(subscriptions));
+	errno = 0;
+	TEST_ASSERT_EQUAL_INT(-1, snap_filterCompile(&filter, subscriptions, SNAP_FILTER_MAX_SUBSCRIPTIONS + 1U));
+	TEST_ASSERT_EQUAL_INT(EINVAL, errno);
+}
+
+TEST(filter, match_should_ReturnEverySubscriber_when_SubscriptionsAreEmpty)
+{
+	memset(subscriptions, 0, sizeof(subscriptions));
+	TEST_ASSERT_EQUAL_INT(0, snap_filterCompile(&filter, subscriptions, 0));
+	randomFrame();
+	TEST_ASSERT_EQUAL_UINT32(0, snap_filterMatch(&filter, &frame, subscribers));
+	snap_filterDestroy(&filter);
+
+	TEST_ASSERT_EQUAL_INT(0, snap_filterCompile(&filter, subscriptions, 70));
+
+	for(size_t f = 0; f < 100U; f++)
+	{
+		randomFrame();
+		TEST_ASSERT_EQUAL_UINT32(70, snap_filterMatch(&filter, &frame, subscribers));
+		TEST_ASSERT_EQUAL_HEX64(UINT64_MAX, subscribers[0]);
+		TEST_ASSERT_EQUAL_HEX64(0x3F, subscribers[1]);
+	}
+}
+
+TEST(filter, match_should_AgreeWithTest_when_SubscriptionsAreRandom)
+{
+	for(size_t i = 0; i < NUM_SUBSCRIPTIONS; i++)
+	{
+		randomSubscription(i);
+	}
+
+	TEST_ASSERT_EQUAL_INT(0, snap_filterCompile(&filter, subscriptions, NUM_SUBSCRIPTIONS));
+	checkFrames(NUM_SUBSCRIPTIONS);
+}
+
+TEST(filter, match_should_AgreeWithTest_when_AddressListIsLong)
+{
+	// Enough distinct addresses to fill the hash table with collisions, including the frame addresses
+	for(size_t i = 0; i < SIZE_LONG_LIST; i++)
+	{
+		longList[i] = (i < 6U) ? randomField(3) : (uint32_t)(i * 0x10001U) & 0xFFFFFFU;
+	}
+
+	for(size_t i = 0; i < 8U; i++)
+	{
+		randomSubscription(i);
+	}
+
+	subscriptions[0].destAddresses = longList;
+	subscriptions[0].destCount = SIZE_LONG_LIST;
+	subscriptions[1].sourceAddresses = longList;
+	subscriptions[1].sourceCount = SIZE_LONG_LIST;
+	subscriptions[2].sourceAddresses = &longList[SIZE_LONG_LIST / 2U];
+	subscriptions[2].sourceCount = SIZE_LONG_LIST / 2U;
+
+	TEST_ASSERT_EQUAL_INT(0, snap_filterCompile(&filter, subscriptions, 8));
+	checkFrames(8);
+}
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,154 @@
+/**
+ * @file   test_snap_gather.c
+ * @author Lucas Jadilo
+ * @brief  Unit tests for the gather encoder module of the libSNAP library.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include <string.h>
+#include "unity_fixture.h"
+#include "snap_gather.h"
+
+
+/******************************************************************************/
+/*  Function Definitions                                                      */
+/******************************************************************************/
+
+
+static void test_sameFrame(snap_fields_t *fields)
+{
+	uint8_t expected[SNAP_MAX_SIZE_FRAME], actual[SNAP_MAX_SIZE_FRAME];
+	snap_fields_t copy = *fields;
+	snap_frame_t frame;
+	snap_gather_t gather;
+
+	snap_init(&frame, expected, sizeof(expected));
+
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_VALID, snap_encapsulate(&frame, &copy));
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_VALID, snap_gatherEncode(&gather, fields));
+	TEST_ASSERT_EQUAL_UINT16(frame.size, gather.size);
+	TEST_ASSERT_EQUAL_UINT16(gather.size, snap_gatherCopy(&gather, actual));
+	TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, actual, frame.size);
+	TEST_ASSERT_EQUAL_UINT8(copy.header.ndb, fields->header.ndb);
+}
+
+
+/******************************************************************************/
+/*  TEST GROUP: gather                                                        */
+/******************************************************************************/
+
+
+TEST_GROUP(gather);
+
+TEST_SETUP(gather) {}
+
+TEST_TEAR_DOWN(gather) {}
+
+TEST_GROUP_RUNNER(gather)
+{
+	RUN_TEST_CASE(gather, encode_should_BuildSameFrameAsEncapsulate_for_AnyFormat);
+	RUN_TEST_CASE(gather, encode_should_ReferenceData_and_SplitFrameInPrefixDataTrailer);
+	RUN_TEST_CASE(gather, encode_should_LeaveOutEmptyPieces);
+	RUN_TEST_CASE(gather, encode_should_ReturnErrorOverflow_if_DataHasMoreThan512Bytes);
+}
+
+TEST(gather, encode_should_BuildSameFrameAsEncapsulate_for_AnyFormat)
+{
+	static const uint16_t sizes[] = {0, 1, 7, 8, 9, 16, 17, 100, 128, 200, 256, 257, 511, 512};
+	uint8_t data[512];
+
+	for(size_t i = 0; i < sizeof(data); i++)
+	{
+		data[i] = (uint8_t)(i * 7U + 3U);
+	}
+
+	for(uint8_t edm = 0; edm <= SNAP_HDB1_EDM_USER_SPECIFIED; edm++)
+	{
+		for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+		{
+			for(uint8_t format = 0; format < 4; format++)
+			{
+				snap_fields_t fields = {.data = data, .dataSize = sizes[i], .paddingAfter = (format & 1U) != 0,
+										.destAddress = 0xA1A2A3, .sourceAddress = 0xB1B2B3, .protocolFlags = 0xC1C2C3,
+										.header = {.ack = SNAP_HDB2_ACK_REQUESTED, .cmd = SNAP_HDB1_CMD_MODE_ENABLED}};
+
+				fields.header.dab = format & SNAP_HDB2_DAB_MASK;
+				fields.header.sab = (3U - format) & SNAP_HDB2_SAB_MASK;
+				fields.header.pfb = format & SNAP_HDB2_PFB_MASK;
+				fields.header.edm = edm & SNAP_HDB1_EDM_MASK;
+
+				test_sameFrame(&fields);
+			}
+		}
+	}
+}
+
+TEST(gather, encode_should_ReferenceData_and_SplitFrameInPrefixDataTrailer)
+{
+	uint8_t data[20] = {0x01, 0x02, 0x03};
+	snap_fields_t fields = {.data = data, .dataSize = sizeof(data), .paddingAfter = true,
+							.destAddress = 0x12, .header = {.dab = SNAP_HDB2_DAB_1BYTE_DEST_ADDRESS, .edm = SNAP_HDB1_EDM_16BIT_CRC}};
+	snap_gather_t gather;
+
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_VALID, snap_gatherEncode(&gather, &fields));
+	TEST_ASSERT_EQUAL_UINT8(3, gather.count);
+	TEST_ASSERT_EQUAL_size_t(4, gather.pieces[0].length);
+	TEST_ASSERT_EQUAL_PTR(data, gather.pieces[1].base);
+	TEST_ASSERT_EQUAL_size_t(sizeof(data), gather.pieces[1].length);
+	TEST_ASSERT_EQUAL_size_t(12 + 2, gather.pieces[2].length);
+	TEST_ASSERT_EQUAL_UINT16(4 + 32 + 2, gather.size);
+
+	// Padding before the data: it goes in the prefix, and the trailer has only the hash
+	fields.paddingAfter = false;
+
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_VALID, snap_gatherEncode(&gather, &fields));
+	TEST_ASSERT_EQUAL_UINT8(3, gather.count);
+	TEST_ASSERT_EQUAL_size_t(4 + 12, gather.pieces[0].length);
+	TEST_ASSERT_EQUAL_PTR(data, gather.pieces[1].base);
+	TEST_ASSERT_EQUAL_size_t(2, gather.pieces[2].length);
+	test_sameFrame(&fields);
+}
+
+TEST(gather, encode_should_LeaveOutEmptyPieces)
+{
+	uint8_t data[8] = {0};
+	snap_fields_t fields = {.data = NULL, .dataSize = 5, .header = {.edm = SNAP_HDB1_EDM_NO_ERROR_DETECTION}};
+	snap_gather_t gather;
+
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_VALID, snap_gatherEncode(&gather, &fields));
+	TEST_ASSERT_EQUAL_UINT8(1, gather.count);
+	TEST_ASSERT_EQUAL_UINT16(3, gather.size);
+	TEST_ASSERT_EQUAL_UINT16(0, fields.dataSize);
+
+	fields.header.edm = SNAP_HDB1_EDM_8BIT_CRC;
+
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_VALID, snap_gatherEncode(&gather, &fields));
+	TEST_ASSERT_EQUAL_UINT8(2, gather.count);
+	TEST_ASSERT_EQUAL_size_t(1, gather.pieces[1].length);
+
+	fields.data = data;
+	fields.dataSize = sizeof(data);
+	fields.header.edm = SNAP_HDB1_EDM_NO_ERROR_DETECTION;
+
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_VALID, snap_gatherEncode(&gather, &fields));
+	TEST_ASSERT_EQUAL_UINT8(2, gather.count);
+	TEST_ASSERT_EQUAL_PTR(data, gather.pieces[1].base);
+}
+
+TEST(gather, encode_should_ReturnErrorOverflow_if_DataHasMoreThan512Bytes)
+{
+	uint8_t data[513] = {0};
+	snap_fields_t fields = {.data = data, .dataSize = sizeof(data), .header = {.edm = SNAP_HDB1_EDM_32BIT_CRC}};
+	snap_gather_t gather;
+
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_ERROR_OVERFLOW, snap_gatherEncode(&gather, &fields));
+	TEST_ASSERT_EQUAL_UINT8(0, gather.count);
+	TEST_ASSERT_EQUAL_UINT16(0, gather.size);
+}
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,670 @@
+/**
+ * @file   test_snap_ipc.c
+ * @author Lucas Jadilo
+ * @brief  Unit tests for the shared memory rings and the daemon client of the SNAP tools.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "unity_fixture.h"
+#include "snap_client.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define NUM_PORTS		(3U)
+#define NUM_SLOTS		(8U)
+#define NUM_PUSHED		(100000U)
+#define WAKE_TIMEOUT	(5000)		// Milliseconds: a lost wakeup fails the test after this long instead of hanging it
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+typedef struct daemon_t
+{
+	pthread_t           thread;
+	int                 listener;
+	snap_ipcReply_t     reply;
+	snap_ipcSubscribe_t received;
+	snap_ipc_t          ipc;
+} daemon_t;
+
+
+/******************************************************************************/
+/*  Variables                                                                 */
+/******************************************************************************/
+
+
+static snap_ipc_t producer;		// Daemon side
+static snap_ipc_t consumer;		// Client side
+static snap_client_t client;
+static daemon_t fakeDaemon;
+static uint8_t buffer[SNAP_MAX_SIZE_FRAME];
+static snap_frame_t frame;
+static int memFd;
+static int peer;
+static uint64_t failedPushes;
+static char socketPath[] = "/tmp/test_snap_ipc_XXXXXX";
+
+
+/******************************************************************************/
+/*  Function Definitions                                                      */
+/******************************************************************************/
+
+
+// Frames carry their number in the first bytes, and their size and other bytes depend on it
+static void makeFrame(snap_frame_t *f, const uint64_t number)
+{
+	memcpy(f->buffer, &number, sizeof(number));
+	f->size = (uint16_t)(sizeof(number) + number % 24U);
+
+	for(uint_fast16_t i = sizeof(number); i < f->size; i++)
+	{
+		f->buffer[i] = (uint8_t)(number * 7U + i);
+	}
+}
+
+static uint64_t checkBytes(const uint8_t *bytes, const uint16_t size)
+{
+	uint64_t number;
+
+	memcpy(&number, bytes, sizeof(number));
+	TEST_ASSERT_EQUAL_UINT16(sizeof(number) + number % 24U, size);
+
+	for(uint_fast16_t i = sizeof(number); i < size; i++)
+	{
+		TEST_ASSERT_EQUAL_HEX8((uint8_t)(number * 7U + i), bytes[i]);
+	}
+
+	return number;
+}
+
+static void push(const uint32_t port, const uint64_t number)
+{
+	makeFrame(&frame, number);
+	TEST_ASSERT_TRUE(snap_ipcPush(&producer, port, &frame, number * 10U));
+}
+
+static void pop(const uint32_t port, const uint64_t number)
+{
+	uint32_t received = UINT32_MAX;
+	const snap_ipcSlot_t *slot = snap_ipcPeek(&consumer, &received);
+
+	TEST_ASSERT_NOT_NULL(slot);
+	TEST_ASSERT_EQUAL_UINT32(port, received);
+	TEST_ASSERT_EQUAL_UINT64(number, checkBytes(slot->bytes, slot->size));
+	TEST_ASSERT_EQUAL_UINT64(number * 10U, slot->timestamp);
+	snap_ipcRelease(&consumer, received);
+}
+
+static uint64_t readEvent(void)
+{
+	uint64_t count = 0;
+
+	if(read(consumer.eventFd, &count, sizeof(count)) < 0)
+	{
+		TEST_ASSERT_EQUAL_INT(EAGAIN, errno);
+	}
+
+	return count;
+}
+
+// Frames numbered from 1 on each port in turn, pushed again (and counted) whenever the ring is full
+static void *pushFrames(void *argument)
+{
+	uint8_t bytes[SNAP_MAX_SIZE_FRAME];
+	snap_frame_t f;
+
+	(void)argument;
+	snap_init(&f, bytes, sizeof(bytes));
+
+	for(uint64_t number = 1; number <= NUM_PUSHED; number++)
+	{
+		makeFrame(&f, number);
+
+		while(!snap_ipcPush(&producer, (uint32_t)(number % NUM_PORTS), &f, number))
+		{
+			failedPushes++;
+			sched_yield();
+		}
+	}
+
+	return NULL;
+}
+
+static void *pushLater(void *argument)
+{
+	uint8_t bytes[SNAP_MAX_SIZE_FRAME];
+	snap_frame_t f;
+
+	(void)argument;
+	snap_init(&f, bytes, sizeof(bytes));
+	makeFrame(&f, 42);
+	usleep(20000);
+	snap_ipcPush(&producer, 2, &f, 420);
+	return NULL;
+}
+
+// Accept one client, check its subscription and answer with the reply prepared by the test
+static void *serveClient(void *argument)
+{
+	daemon_t *d = argument;
+	const int connection = accept4(d->listener, NULL, NULL, SOCK_CLOEXEC);
+	union
+	{
+		struct cmsghdr header;
+		uint8_t        space[CMSG_SPACE(2U * sizeof(int))];
+	} control;
+	struct iovec vector = {.iov_base = &d->reply, .iov_len = sizeof(d->reply)};
+	struct msghdr message = {.msg_iov = &vector, .msg_iovlen = 1};
+	int fds[2] = {-1, -1};
+
+	if(connection < 0)
+	{
+		return NULL;
+	}
+
+	if(recv(connection, &d->received, sizeof(d->received), 0) != (ssize_t)sizeof(d->received))
+	{
+		d->received.type = 0;
+	}
+
+	if(d->reply.error == 0)
+	{
+		fds[1] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+		if((snap_ipcCreate(&d->ipc, d->reply.ports, d->reply.slots, &fds[0]) == 0) && (fds[1] >= 0))
+		{
+			d->ipc.eventFd = dup(fds[1]);
+			memset(&control, 0, sizeof(control));
+			message.msg_control = &control;
+			message.msg_controllen = sizeof(control);
+			control.header.cmsg_level = SOL_SOCKET;
+			control.header.cmsg_type = SCM_RIGHTS;
+			control.header.cmsg_len = CMSG_LEN(sizeof(fds));
+			memcpy(CMSG_DATA(&control.header), fds, sizeof(fds));
+		}
+	}
+
+	if(sendmsg(connection, &message, MSG_NOSIGNAL) < 0)
+	{
+		d->received.type = 0;
+	}
+
+	close(fds[0]);
+	close(fds[1]);
+	close(connection);
+	return NULL;
+}
+
+static void startDaemon(const snap_ipcReply_t *reply)
+{
+	struct sockaddr_un address = {.sun_family = AF_UNIX};
+
+	memset(&fakeDaemon.received, 0, sizeof(fakeDaemon.received));
+	fakeDaemon.reply = *reply;
+	strcpy(address.sun_path, socketPath);
+	fakeDaemon.listener = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	TEST_ASSERT_GREATER_OR_EQUAL_INT(0, fakeDaemon.listener);
+	TEST_ASSERT_EQUAL_INT(0, bind(fakeDaemon.listener, (struct sockaddr *)&address, sizeof(address)));
+	TEST_ASSERT_EQUAL_INT(0, listen(fakeDaemon.listener, 1));
+	TEST_ASSERT_EQUAL_INT(0, pthread_create(&fakeDaemon.thread, NULL, serveClient, &fakeDaemon));
+}
+
+static void stopDaemon(void)
+{
+	TEST_ASSERT_EQUAL_INT(0, pthread_join(fakeDaemon.thread, NULL));
+	close(fakeDaemon.listener);
+	fakeDaemon.listener = -1;
+}
+
+
+/******************************************************************************/
+/*  TEST GROUP: ipc                                                           */
+/******************************************************************************/
+
+
+TEST_GROUP(ipc);
+
+TEST_SETUP(ipc)
+{
+	snap_init(&frame, buffer, sizeof(buffer));
+	TEST_ASSERT_EQUAL_INT(0, snap_ipcCreate(&producer, NUM_PORTS, NUM_SLOTS, &memFd));
+	producer.eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	TEST_ASSERT_GREATER_OR_EQUAL_INT(0, producer.eventFd);
+	TEST_ASSERT_EQUAL_INT(0, snap_ipcAttach(&consumer, memFd, dup(producer.eventFd), NUM_PORTS, NUM_SLOTS));
+}
+
+TEST_TEAR_DOWN(ipc)
+{
+	snap_ipcDetach(&consumer);
+	snap_ipcDetach(&producer);
+	close(memFd);
+}
+
+TEST_GROUP_RUNNER(ipc)
+{
+	RUN_TEST_CASE(ipc, create_should_ReturnError_if_SizeIsInvalid);
+	RUN_TEST_CASE(ipc, attach_should_ReturnError_if_AreaDoesNotMatch);
+	RUN_TEST_CASE(ipc, peek_should_ReturnFramesInOrder_when_RingWrapsAround);
+	RUN_TEST_CASE(ipc, peek_should_VisitPortsInRoundRobin);
+	RUN_TEST_CASE(ipc, push_should_CountDrop_when_RingIsFull);
+	RUN_TEST_CASE(ipc, sleep_should_SignalEventOnce_when_FrameArrivesAfterIt);
+	RUN_TEST_CASE(ipc, sleep_should_ReturnFalse_when_FrameIsAvailable);
+	RUN_TEST_CASE(ipc, peek_should_NeverMissFrame_when_ProducerRunsConcurrently);
+}
+
+TEST(ipc, create_should_ReturnError_if_SizeIsInvalid)
+{
+	const uint32_t sizes[][2] = {{0, 8}, {SNAP_IPC_MAX_PORTS + 1U, 8}, {1, 0}, {1, 6}, {1, SNAP_IPC_MAX_SLOTS * 2U}};
+	snap_ipc_t ipc;
+	int fd;
+
+	for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+	{
+		errno = 0;
+		TEST_ASSERT_EQUAL_INT(-1, snap_ipcCreate(&ipc, sizes[i][0], sizes[i][1], &fd));
+		TEST_ASSERT_EQUAL_INT(EINVAL, errno);
+	}
+}
+
+TEST(ipc, attach_should_ReturnError_if_AreaDoesNotMatch)
+{
+	const uint32_t sizes[][2] = {{NUM_PORTS - 1U, NUM_SLOTS}, {NUM_PORTS, NUM_SLOTS * 2U}, {NUM_PORTS, NUM_SLOTS - 1U}, {0, NUM_SLOTS}};
+	uint32_t *header = producer.memory;
+	snap_ipc_t ipc;
+
+	for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+	{
+		errno = 0;
+		TEST_ASSERT_EQUAL_INT(-1, snap_ipcAttach(&ipc, memFd, -1, sizes[i][0], sizes[i][1]));
+		TEST_ASSERT_EQUAL_INT(EPROTO, errno);
+	}
+
+	errno = 0;
+	TEST_ASSERT_EQUAL_INT(-1, snap_ipcAttach(&ipc, -1, -1, NUM_PORTS, NUM_SLOTS));
+	TEST_ASSERT_EQUAL_INT(EPROTO, errno);
+
+	// Right size, but not the header written by the daemon
+	for(uint_fast8_t word = 0; word < 3U; word++)
+	{
+		header[word] ^= 0x100U;
+		errno = 0;
+		TEST_ASSERT_EQUAL_INT(-1, snap_ipcAttach(&ipc, memFd, -1, NUM_PORTS, NUM_SLOTS));
+		TEST_ASSERT_EQUAL_INT(EPROTO, errno);
+		header[word] ^= 0x100U;
+	}
+
+	TEST_ASSERT_EQUAL_INT(0, snap_ipcAttach(&ipc, memFd, -1, NUM_PORTS, NUM_SLOTS));
+	TEST_ASSERT_EQUAL_size_t(snap_ipcSize(NUM_PORTS, NUM_SLOTS), ipc.memorySize);
+	snap_ipcDetach(&ipc);
+}
+
+TEST(ipc, peek_should_ReturnFramesInOrder_when_RingWrapsAround)
+{
+	uint64_t pushed = 0, popped = 0;
+
+	// Batches of every size up to a full ring, so the head and tail wrap at every offset
+	for(uint32_t round = 0; round < 10U * NUM_SLOTS; round++)
+	{
+		const uint32_t batch = 1U + round % NUM_SLOTS;
+
+		for(uint32_t i = 0; i < batch; i++)
+		{
+			push(1, ++pushed);
+		}
+
+		for(uint32_t i = 0; i < batch; i++)
+		{
+			pop(1, ++popped);
+		}
+
+		TEST_ASSERT_NULL(snap_ipcPeek(&consumer, &(uint32_t){0}));
+	}
+
+	TEST_ASSERT_EQUAL_UINT64(pushed, consumer.rings[1].tail);
+	TEST_ASSERT_EQUAL_UINT64(pushed, consumer.rings[1].head);
+	TEST_ASSERT_EQUAL_UINT64(0, consumer.rings[1].dropped);
+}
+
+TEST(ipc, peek_should_VisitPortsInRoundRobin)
+{
+	push(0, 1);
+	push(0, 2);
+	push(2, 3);
+	push(2, 4);
+	push(1, 5);
+
+	pop(0, 1);
+	pop(1, 5);
+	pop(2, 3);
+	pop(0, 2);
+	pop(2, 4);		// Port 1 is empty
+	TEST_ASSERT_NULL(snap_ipcPeek(&consumer, &(uint32_t){0}));
+}
+
+TEST(ipc, push_should_CountDrop_when_RingIsFull)
+{
+	for(uint64_t number = 1; number <= NUM_SLOTS; number++)
+	{
+		push(0, number);
+	}
+
+	makeFrame(&frame, 100);
+	TEST_ASSERT_FALSE(snap_ipcPush(&producer, 0, &frame, 0));
+	TEST_ASSERT_FALSE(snap_ipcPush(&producer, 0, &frame, 0));
+	TEST_ASSERT_EQUAL_UINT64(2, consumer.rings[0].dropped);
+	push(1, 200);																	// Other rings are not affected
+	TEST_ASSERT_EQUAL_UINT64(0, consumer.rings[1].dropped);
+
+	pop(0, 1);
+	push(0, NUM_SLOTS + 1U);														// One slot is free again
+	pop(1, 200);
+
+	for(uint64_t number = 2; number <= NUM_SLOTS + 1U; number++)
+	{
+		pop(0, number);
+	}
+
+	TEST_ASSERT_EQUAL_UINT64(2, consumer.rings[0].dropped);
+}
+
+TEST(ipc, sleep_should_SignalEventOnce_when_FrameArrivesAfterIt)
+{
+	TEST_ASSERT_TRUE(snap_ipcSleep(&consumer));
+	TEST_ASSERT_EQUAL_UINT32(1, *consumer.sleeping);
+	TEST_ASSERT_EQUAL_UINT64(0, readEvent());
+
+	// The first frame wakes the client up and clears the flag, so the next ones make no system call
+	push(1, 1);
+	TEST_ASSERT_EQUAL_UINT32(0, *consumer.sleeping);
+	push(1, 2);
+	TEST_ASSERT_EQUAL_UINT64(1, readEvent());
+	TEST_ASSERT_EQUAL_UINT64(0, readEvent());
+	pop(1, 1);
+	pop(1, 2);
+
+	TEST_ASSERT_TRUE(snap_ipcSleep(&consumer));
+	push(0, 3);
+	TEST_ASSERT_EQUAL_UINT64(1, readEvent());
+}
+
+TEST(ipc, sleep_should_ReturnFalse_when_FrameIsAvailable)
+{
+	push(2, 1);
+	TEST_ASSERT_FALSE(snap_ipcSleep(&consumer));
+	TEST_ASSERT_EQUAL_UINT32(0, *consumer.sleeping);
+	push(2, 2);
+	TEST_ASSERT_EQUAL_UINT64(0, readEvent());
+}
+
+TEST(ipc, peek_should_NeverMissFrame_when_ProducerRunsConcurrently)
+{
+	uint64_t next[NUM_PORTS], received = 0, sleeps = 0;
+	pthread_t thread;
+
+	for(uint32_t port = 0; port < NUM_PORTS; port++)
+	{
+		next[port] = (port == 0) ? NUM_PORTS : port;
+	}
+
+	failedPushes = 0;
+	TEST_ASSERT_EQUAL_INT(0, pthread_create(&thread, NULL, pushFrames, NULL));
+
+	while(received < NUM_PUSHED)
+	{
+		uint32_t port;
+		const snap_ipcSlot_t *slot = snap_ipcPeek(&consumer, &port);
+
+		if(slot != NULL)
+		{
+			TEST_ASSERT_EQUAL_UINT64(next[port], checkBytes(slot->bytes, slot->size));
+			TEST_ASSERT_EQUAL_UINT64(next[port], slot->timestamp);
+			next[port] += NUM_PORTS;
+			received++;
+			snap_ipcRelease(&consumer, port);
+		}
+		else if(snap_ipcSleep(&consumer))
+		{
+			// Same wait as the client: a lost wakeup would time out here
+			struct pollfd fd = {.fd = consumer.eventFd, .events = POLLIN};
+
+			TEST_ASSERT_EQUAL_INT(1, poll(&fd, 1, WAKE_TIMEOUT));
+			__atomic_store_n(consumer.sleeping, 0U, __ATOMIC_RELAXED);
+			readEvent();
+			sleeps++;
+		}
+	}
+
+	TEST_ASSERT_EQUAL_INT(0, pthread_join(thread, NULL));
+	TEST_ASSERT_NULL(snap_ipcPeek(&consumer, &(uint32_t){0}));
+	TEST_ASSERT_EQUAL_UINT64(failedPushes, consumer.rings[0].dropped + consumer.rings[1].dropped + consumer.rings[2].dropped);
+	TEST_ASSERT_GREATER_THAN_UINT64(0, sleeps);
+}
+
+
+/******************************************************************************/
+/*  TEST GROUP: client                                                        */
+/******************************************************************************/
+
+
+TEST_GROUP(client);
+
+TEST_SETUP(client)
+{
+	int fds[2];
+
+	snap_init(&frame, buffer, sizeof(buffer));
+	TEST_ASSERT_EQUAL_INT(0, snap_ipcCreate(&producer, NUM_PORTS, NUM_SLOTS, &memFd));
+	producer.eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	TEST_ASSERT_GREATER_OR_EQUAL_INT(0, producer.eventFd);
+	TEST_ASSERT_EQUAL_INT(0, socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds));
+	client.socket = fds[0];
+	peer = fds[1];
+	TEST_ASSERT_EQUAL_INT(0, snap_ipcAttach(&client.ipc, memFd, dup(producer.eventFd), NUM_PORTS, NUM_SLOTS));
+	consumer = client.ipc;
+	fakeDaemon.ipc.memory = NULL;
+	fakeDaemon.ipc.eventFd = -1;
+
+	const int fd = mkstemp(socketPath);
+	TEST_ASSERT_GREATER_OR_EQUAL_INT(0, fd);
+	close(fd);
+	unlink(socketPath);
+}
+
+TEST_TEAR_DOWN(client)
+{
+	snap_clientClose(&client);
+	snap_ipcDetach(&producer);
+	snap_ipcDetach(&fakeDaemon.ipc);
+	close(memFd);
+
+	if(peer >= 0)
+	{
+		close(peer);
+	}
+
+	unlink(socketPath);
+	strcpy(&socketPath[sizeof(socketPath) - 7U], "XXXXXX");
+}
+
+TEST_GROUP_RUNNER(client)
+{
+	RUN_TEST_CASE(client, receive_should_ReturnZero_when_TimeoutExpires);
+	RUN_TEST_CASE(client, receive_should_WaitForFrame_when_RingsAreEmpty);
+	RUN_TEST_CASE(client, receive_should_ReturnError_if_FrameDoesNotFit);
+	RUN_TEST_CASE(client, receive_should_ReturnError_when_DaemonClosesConnection);
+	RUN_TEST_CASE(client, send_should_WriteFrameMessage);
+	RUN_TEST_CASE(client, dropped_should_SumEveryRing);
+	RUN_TEST_CASE(client, connect_should_MapRings_when_DaemonAcceptsSubscription);
+	RUN_TEST_CASE(client, connect_should_ReturnError_if_DaemonRejectsSubscription);
+}
+
+TEST(client, receive_should_ReturnZero_when_TimeoutExpires)
+{
+	uint32_t port;
+
+	TEST_ASSERT_EQUAL_INT(0, snap_clientReceive(&client, &frame, &port, NULL, 0));
+	TEST_ASSERT_EQUAL_INT(0, snap_clientReceive(&client, &frame, &port, NULL, 20));
+	TEST_ASSERT_EQUAL_UINT32(0, *client.ipc.sleeping);
+}
+
+TEST(client, receive_should_WaitForFrame_when_RingsAreEmpty)
+{
+	uint64_t timestamp = 0;
+	uint32_t port = 0;
+	pthread_t thread;
+
+	TEST_ASSERT_EQUAL_INT(0, pthread_create(&thread, NULL, pushLater, NULL));
+	TEST_ASSERT_EQUAL_INT(1, snap_clientReceive(&client, &frame, &port, &timestamp, WAKE_TIMEOUT));
+	TEST_ASSERT_EQUAL_INT(0, pthread_join(thread, NULL));
+
+	TEST_ASSERT_EQUAL_UINT32(2, port);
+	TEST_ASSERT_EQUAL_UINT64(420, timestamp);
+	TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_VALID, frame.status);
+	TEST_ASSERT_EQUAL_UINT64(42, checkBytes(frame.buffer, frame.size));
+}
+
+TEST(client, receive_should_ReturnError_if_FrameDoesNotFit)
+{
+	uint8_t small[8];
+	snap_frame_t smallFrame;
+	uint32_t port;
+
+	push(0, 7);		// 15 bytes
+	push(0, 8);
+	snap_init(&smallFrame, small, sizeof(small));
+	errno = 0;
+	TEST_ASSERT_EQUAL_INT(-1, snap_clientReceive(&client, &smallFrame, &port, NULL, 0));
+	TEST_ASSERT_EQUAL_INT(EMSGSIZE, errno);
+
+	// The frame that did not fit was discarded
+	TEST_ASSERT_EQUAL_INT(1, snap_clientReceive(&client, &frame, &port, NULL, 0));
+	TEST_ASSERT_EQUAL_UINT64(8, checkBytes(frame.buffer, frame.size));
+}
+
+TEST(client, receive_should_ReturnError_when_DaemonClosesConnection)
+{
+	uint32_t port;
+
+	close(peer);
+	peer = -1;
+	errno = 0;
+	TEST_ASSERT_EQUAL_INT(-1, snap_clientReceive(&client, &frame, &port, NULL, WAKE_TIMEOUT));
+	TEST_ASSERT_EQUAL_INT(ECONNRESET, errno);
+}
+
+TEST(client, send_should_WriteFrameMessage)
+{
+	snap_ipcSend_t message;
+
+	makeFrame(&frame, 29);
+	TEST_ASSERT_EQUAL_INT(0, snap_clientSend(&client, 2, &frame));
+	TEST_ASSERT_EQUAL_INT((int)(offsetof(snap_ipcSend_t, bytes) + frame.size), (int)recv(peer, &message, sizeof(message), 0));
+	TEST_ASSERT_EQUAL_UINT32(SNAP_IPC_SEND, message.type);
+	TEST_ASSERT_EQUAL_UINT16(2, message.port);
+	TEST_ASSERT_EQUAL_UINT16(frame.size, message.size);
+	TEST_ASSERT_EQUAL_UINT64(29, checkBytes(message.bytes, message.size));
+
+	errno = 0;
+	TEST_ASSERT_EQUAL_INT(-1, snap_clientSend(&client, NUM_PORTS, &frame));
+	TEST_ASSERT_EQUAL_INT(EINVAL, errno);
+	frame.size = 0;
+	errno = 0;
+	TEST_ASSERT_EQUAL_INT(-1, snap_clientSend(&client, 0, &frame));
+	TEST_ASSERT_EQUAL_INT(EINVAL, errno);
+}
+
+TEST(client, dropped_should_SumEveryRing)
+{
+	makeFrame(&frame, 1);
+
+	for(uint32_t port = 0; port < NUM_PORTS; port++)
+	{
+		for(uint32_t i = 0; i < NUM_SLOTS + port + 1U; i++)
+		{
+			snap_ipcPush(&producer, port, &frame, 0);
+		}
+	}
+
+	TEST_ASSERT_EQUAL_UINT32(NUM_PORTS, snap_clientPorts(&client));
+	TEST_ASSERT_EQUAL_UINT64(1U + 2U + 3U, snap_clientDropped(&client));
+}
+
+TEST(client, connect_should_MapRings_when_DaemonAcceptsSubscription)
+{
+	const uint32_t sources[] = {0x12, 0xB0B1};
+	const snap_subscription_t subscription = {.hdb2Mask = 0x30, .hdb2Value = 0x10, .sourceAddresses = sources, .sourceCount = 2};
+	snap_client_t connected;
+	uint64_t timestamp;
+	uint32_t port;
+
+	startDaemon(&(snap_ipcReply_t){.type = SNAP_IPC_REPLY, .ports = 2, .slots = 16});
+	TEST_ASSERT_EQUAL_INT(0, snap_clientConnect(&connected, socketPath, &subscription, 0x2, 10));
+	stopDaemon();
+
+	TEST_ASSERT_EQUAL_UINT32(SNAP_IPC_SUBSCRIBE, fakeDaemon.received.type);
+	TEST_ASSERT_EQUAL_UINT32(0x2, fakeDaemon.received.portMask);
+	TEST_ASSERT_EQUAL_UINT32(10, fakeDaemon.received.slots);
+	TEST_ASSERT_EQUAL_UINT8(0x30, fakeDaemon.received.hdb2Mask);
+	TEST_ASSERT_EQUAL_UINT8(0x10, fakeDaemon.received.hdb2Value);
+	TEST_ASSERT_EQUAL_UINT8(2, fakeDaemon.received.sourceCount);
+	TEST_ASSERT_EQUAL_UINT32_ARRAY(sources, fakeDaemon.received.sourceAddresses, 2);
+	TEST_ASSERT_EQUAL_UINT8(0, fakeDaemon.received.destCount);
+
+	// The rings are shared with the daemon, which wakes the client up through the eventfd it sent
+	TEST_ASSERT_EQUAL_UINT32(2, snap_clientPorts(&connected));
+	TEST_ASSERT_EQUAL_UINT32(16, connected.ipc.count);
+	TEST_ASSERT_TRUE(snap_ipcSleep(&connected.ipc));
+	makeFrame(&frame, 77);
+	TEST_ASSERT_TRUE(snap_ipcPush(&fakeDaemon.ipc, 1, &frame, 5));
+	TEST_ASSERT_EQUAL_UINT32(0, *connected.ipc.sleeping);
+	TEST_ASSERT_EQUAL_INT(1, snap_clientReceive(&connected, &frame, &port, &timestamp, 0));
+	TEST_ASSERT_EQUAL_UINT32(1, port);
+	TEST_ASSERT_EQUAL_UINT64(5, timestamp);
+	TEST_ASSERT_EQUAL_UINT64(77, checkBytes(frame.buffer, frame.size));
+	snap_clientClose(&connected);
+}
+
+TEST(client, connect_should_ReturnError_if_DaemonRejectsSubscription)
+{
+	char longPath[sizeof(((struct sockaddr_un *)NULL)->sun_path) + 1U];
+	snap_client_t connected;
+
+	startDaemon(&(snap_ipcReply_t){.type = SNAP_IPC_REPLY, .error = EINVAL});
+	errno = 0;
+	TEST_ASSERT_EQUAL_INT(-1, snap_clientConnect(&connected, socketPath, NULL, SNAP_CLIENT_ALL_PORTS, 0));
+	TEST_ASSERT_EQUAL_INT(EINVAL, errno);
+	stopDaemon();
+	TEST_ASSERT_EQUAL_UINT32(SNAP_CLIENT_ALL_PORTS, fakeDaemon.received.portMask);
+	TEST_ASSERT_EQUAL_INT(-1, connected.socket);
+
+	memset(longPath, 'a', sizeof(longPath) - 1U);
+	longPath[sizeof(longPath) - 1U] = '\0';
+	errno = 0;
+	TEST_ASSERT_EQUAL_INT(-1, snap_clientConnect(&connected, longPath, NULL, SNAP_CLIENT_ALL_PORTS, 0));
+	TEST_ASSERT_EQUAL_INT(ENAMETOOLONG, errno);
+}
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,211 @@
+/**
+ * @file   test_snap_link.c
+ * @author Lucas Jadilo
+ * @brief  Unit tests for the link quality module of the libSNAP library.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include "unity_fixture.h"
+#include "snap_link.h"
+
+
+/******************************************************************************/
+/*  Function Definitions                                                      */
+/******************************************************************************/
+
+
+static uint8_t updateMany(snap_link_t *link, const snap_linkEvent_t event, const uint32_t count)
+{
+	uint8_t edm = snap_linkGetEdm(link);
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		edm = snap_linkUpdate(link, event, 64);
+	}
+
+	return edm;
+}
+
+
+/******************************************************************************/
+/*  TEST GROUP: link                                                          */
+/******************************************************************************/
+
+
+TEST_GROUP(link);
+
+TEST_SETUP(link) {}
+
+TEST_TEAR_DOWN(link) {}
+
+TEST_GROUP_RUNNER(link)
+{
+	RUN_TEST_CASE(link, init_should_ReturnError_if_ArgumentsAreInvalid);
+	RUN_TEST_CASE(link, update_should_KeepInitialEdm_until_HoldFramesElapse);
+	RUN_TEST_CASE(link, update_should_ChooseCheapestEdm_when_LinkIsClean);
+	RUN_TEST_CASE(link, update_should_ChooseStrongerEdm_as_soon_as_ErrorsAppear);
+	RUN_TEST_CASE(link, update_should_ReturnToWeakerEdm_only_after_ErrorRateDecays);
+	RUN_TEST_CASE(link, update_should_ChooseOnlyAllowedEdms);
+	RUN_TEST_CASE(link, update_should_AverageFrameSize);
+	RUN_TEST_CASE(link, getDataSize_should_ReturnLargestBucket_when_LinkIsClean);
+	RUN_TEST_CASE(link, getDataSize_should_ReturnSmallerBuckets_as_ErrorRateIncreases);
+}
+
+TEST(link, init_should_ReturnError_if_ArgumentsAreInvalid)
+{
+	snap_link_t link;
+
+	TEST_ASSERT_EQUAL_INT16(SNAP_ERROR_NULL_FRAME, snap_linkInit(NULL, NULL, SNAP_HDB1_EDM_32BIT_CRC));
+	TEST_ASSERT_EQUAL_INT16(SNAP_LINK_ERROR_CONFIG, snap_linkInit(&link, &(snap_linkConfig_t){0, 6, 4, 0x3C, 256}, 5));
+	TEST_ASSERT_EQUAL_INT16(SNAP_LINK_ERROR_CONFIG, snap_linkInit(&link, &(snap_linkConfig_t){64, 6, 4, 0x3C, 256}, 5));
+	TEST_ASSERT_EQUAL_INT16(SNAP_LINK_ERROR_CONFIG, snap_linkInit(&link, &(snap_linkConfig_t){32, 17, 4, 0x3C, 256}, 5));
+	TEST_ASSERT_EQUAL_INT16(SNAP_LINK_ERROR_CONFIG, snap_linkInit(&link, &(snap_linkConfig_t){32, 6, 17, 0x3C, 256}, 5));
+	TEST_ASSERT_EQUAL_INT16(SNAP_LINK_ERROR_CONFIG, snap_linkInit(&link, &(snap_linkConfig_t){32, 6, 4, 0xC3, 256}, 5));
+	TEST_ASSERT_EQUAL_INT16(0, snap_linkInit(&link, NULL, SNAP_HDB1_EDM_32BIT_CRC));
+	TEST_ASSERT_EQUAL_UINT8(SNAP_HDB1_EDM_32BIT_CRC, snap_linkGetEdm(&link));
+	TEST_ASSERT_EQUAL_UINT64(0, snap_linkGetErrorRate(&link));
+}
+
+TEST(link, update_should_KeepInitialEdm_until_HoldFramesElapse)
+{
+	snap_link_t link;
+
+	snap_linkInit(&link, NULL, SNAP_HDB1_EDM_32BIT_CRC);
+
+	TEST_ASSERT_EQUAL_UINT8(SNAP_HDB1_EDM_32BIT_CRC, updateMany(&link, SNAP_LINK_EVENT_VALID, 255));
+	TEST_ASSERT_EQUAL_UINT8(SNAP_HDB1_EDM_8BIT_CHECKSUM, snap_linkUpdate(&link, SNAP_LINK_EVENT_VALID, 64));
+	TEST_ASSERT_EQUAL_UINT32(256, link.frames);
+	TEST_ASSERT_EQUAL_UINT32(0, link.errors);
+}
+
+TEST(link, update_should_ChooseCheapestEdm_when_LinkIsClean)
+{
+	snap_link_t link;
+
+	// One undetected error every 2^20 frames: a 16-bit CRC is enough while the error rate is below 2^-4 / 2^4.
+	snap_linkInit(&link, &(snap_linkConfig_t){20, 4, 4, 0x3C, 16}, SNAP_HDB1_EDM_32BIT_CRC);
+	link.errorRate = SNAP_LINK_RATE_ONE / 1024U;
+
+	TEST_ASSERT_EQUAL_UINT8(SNAP_HDB1_EDM_16BIT_CRC, updateMany(&link, SNAP_LINK_EVENT_VALID, 16));
+	TEST_ASSERT_EQUAL_UINT8(SNAP_HDB1_EDM_16BIT_CRC, updateMany(&link, SNAP_LINK_EVENT_VALID, 15));
+	TEST_ASSERT_EQUAL_UINT8(SNAP_HDB1_EDM_8BIT_CHECKSUM, updateMany(&link, SNAP_LINK_EVENT_VALID, 1000));
+	TEST_ASSERT_EQUAL_UINT64(0, snap_linkGetErrorRate(&link));
+}
+
+TEST(link, update_should_ChooseStrongerEdm_as_soon_as_ErrorsAppear)
+{
+	snap_link_t link;
+
+	snap_linkInit(&link, NULL, SNAP_HDB1_EDM_8BIT_CHECKSUM);
+
+	TEST_ASSERT_EQUAL_UINT8(SNAP_HDB1_EDM_32BIT_CRC, snap_linkUpdate(&link, SNAP_LINK_EVENT_HASH_ERROR, 64));
+	TEST_ASSERT_EQUAL_UINT64(SNAP_LINK_RATE_ONE / 64U, snap_linkGetErrorRate(&link));
+
+	snap_linkInit(&link, NULL, SNAP_HDB1_EDM_8BIT_CHECKSUM);
+	TEST_ASSERT_EQUAL_UINT8(SNAP_HDB1_EDM_32BIT_CRC, snap_linkUpdate(&link, SNAP_LINK_EVENT_RESYNC, 64));
+
+	snap_linkInit(&link, NULL, SNAP_HDB1_EDM_16BIT_CRC);
+	TEST_ASSERT_EQUAL_UINT8(SNAP_HDB1_EDM_32BIT_CRC, snap_linkUpdate(&link, SNAP_LINK_EVENT_NACK, 64));
+	TEST_ASSERT_EQUAL_UINT32(1, link.errors);
+}
+
+TEST(link, update_should_ReturnToWeakerEdm_only_after_ErrorRateDecays)
+{
+	snap_link_t link;
+	uint32_t frames = 0;
+
+	snap_linkInit(&link, NULL, SNAP_HDB1_EDM_8BIT_CHECKSUM);
+	snap_linkUpdate(&link, SNAP_LINK_EVENT_HASH_ERROR, 64);
+
+	while(snap_linkUpdate(&link, SNAP_LINK_EVENT_VALID, 64) == SNAP_HDB1_EDM_32BIT_CRC)
+	{
+		frames++;
+	}
+
+	// Rate of 2^-6 decaying by 63/64 per frame: the 16-bit CRC meets 2^-32 with a margin of 16 below 2^-20.
+	TEST_ASSERT_EQUAL_UINT8(SNAP_HDB1_EDM_16BIT_CRC, snap_linkGetEdm(&link));
+	TEST_ASSERT_UINT32_WITHIN(10, 613, frames);
+	TEST_ASSERT_LESS_OR_EQUAL_UINT64(SNAP_LINK_RATE_ONE >> 20, snap_linkGetErrorRate(&link));
+
+	// A new error while the rate is still high goes back to the 32-bit CRC at once.
+	TEST_ASSERT_EQUAL_UINT8(SNAP_HDB1_EDM_32BIT_CRC, snap_linkUpdate(&link, SNAP_LINK_EVENT_HASH_ERROR, 64));
+	TEST_ASSERT_EQUAL_UINT8(SNAP_HDB1_EDM_32BIT_CRC, updateMany(&link, SNAP_LINK_EVENT_VALID, 255));
+	TEST_ASSERT_EQUAL_UINT8(SNAP_HDB1_EDM_8BIT_CHECKSUM, updateMany(&link, SNAP_LINK_EVENT_VALID, 5000));
+}
+
+TEST(link, update_should_ChooseOnlyAllowedEdms)
+{
+	snap_link_t link;
+
+	// Only the 8-bit and 16-bit CRCs are allowed.
+	snap_linkInit(&link, &(snap_linkConfig_t){32, 6, 4, 0x18, 1}, SNAP_HDB1_EDM_32BIT_CRC);
+
+	TEST_ASSERT_EQUAL_UINT8(SNAP_HDB1_EDM_8BIT_CRC, snap_linkUpdate(&link, SNAP_LINK_EVENT_VALID, 64));
+	TEST_ASSERT_EQUAL_UINT8(SNAP_HDB1_EDM_16BIT_CRC, snap_linkUpdate(&link, SNAP_LINK_EVENT_HASH_ERROR, 64));
+	TEST_ASSERT_EQUAL_UINT8(SNAP_HDB1_EDM_16BIT_CRC, updateMany(&link, SNAP_LINK_EVENT_HASH_ERROR, 100));
+}
+
+TEST(link, update_should_AverageFrameSize)
+{
+	snap_link_t link;
+
+	snap_linkInit(&link, &(snap_linkConfig_t){32, 2, 4, 0x3C, 256}, SNAP_HDB1_EDM_32BIT_CRC);
+
+	snap_linkUpdate(&link, SNAP_LINK_EVENT_VALID, 100);
+	TEST_ASSERT_EQUAL_UINT32(100U << 8, link.frameSize);
+
+	snap_linkUpdate(&link, SNAP_LINK_EVENT_VALID, 0);
+	TEST_ASSERT_EQUAL_UINT32(100U << 8, link.frameSize);
+
+	snap_linkUpdate(&link, SNAP_LINK_EVENT_VALID, 200);
+	TEST_ASSERT_EQUAL_UINT32(125U << 8, link.frameSize);
+
+	snap_linkUpdate(&link, SNAP_LINK_EVENT_HASH_ERROR, 25);
+	TEST_ASSERT_EQUAL_UINT32(100U << 8, link.frameSize);
+}
+
+TEST(link, getDataSize_should_ReturnLargestBucket_when_LinkIsClean)
+{
+	snap_link_t link;
+
+	snap_linkInit(&link, NULL, SNAP_HDB1_EDM_32BIT_CRC);
+
+	TEST_ASSERT_EQUAL_UINT16(512, snap_linkGetDataSize(&link, 9, 512));
+	TEST_ASSERT_EQUAL_UINT16(512, snap_linkGetDataSize(&link, 9, UINT16_MAX));
+	TEST_ASSERT_EQUAL_UINT16(64, snap_linkGetDataSize(&link, 9, 100));
+	TEST_ASSERT_EQUAL_UINT16(8, snap_linkGetDataSize(&link, 9, 15));
+	TEST_ASSERT_EQUAL_UINT16(1, snap_linkGetDataSize(&link, 9, 0));
+}
+
+TEST(link, getDataSize_should_ReturnSmallerBuckets_as_ErrorRateIncreases)
+{
+	snap_link_t link;
+
+	snap_linkInit(&link, NULL, SNAP_HDB1_EDM_32BIT_CRC);
+	link.frameSize = 100U << 8;
+
+	link.errorRate = SNAP_LINK_RATE_ONE / 1024U;
+	TEST_ASSERT_EQUAL_UINT16(512, snap_linkGetDataSize(&link, 9, 512));
+
+	link.errorRate = SNAP_LINK_RATE_ONE / 64U;
+	TEST_ASSERT_EQUAL_UINT16(256, snap_linkGetDataSize(&link, 9, 512));
+	TEST_ASSERT_EQUAL_UINT16(128, snap_linkGetDataSize(&link, 5, 512));
+
+	link.errorRate = SNAP_LINK_RATE_ONE / 16U;
+	TEST_ASSERT_EQUAL_UINT16(128, snap_linkGetDataSize(&link, 9, 512));
+
+	link.errorRate = SNAP_LINK_RATE_ONE / 2U;
+	TEST_ASSERT_EQUAL_UINT16(32, snap_linkGetDataSize(&link, 9, 512));
+
+	// Every byte lost: no bucket delivers anything, the smallest frames are chosen.
+	link.errorRate = SNAP_LINK_RATE_ONE;
+	link.frameSize = 1U << 8;
+	TEST_ASSERT_EQUAL_UINT16(1, snap_linkGetDataSize(&link, 9, 512));
+}
+
+/******************************** END OF FILE *********************************/
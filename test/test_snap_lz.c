@@ -0,0 +1,192 @@
+/**
+ * @file   test_snap_lz.c
+ * @author Lucas Jadilo
+ * @brief  Unit tests for the block codec of the SNAP tools.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include <errno.h>
+#include "unity_fixture.h"
+#include "snap_lz.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define SIZE_DATA	(70000U)	// Larger than the 64 KiB window of back references
+
+
+/******************************************************************************/
+/*  Variables                                                                 */
+/******************************************************************************/
+
+
+static uint8_t data[SIZE_DATA];
+static uint8_t packed[SNAP_LZ_BOUND(SIZE_DATA)];
+static uint8_t unpacked[SIZE_DATA];
+static uint32_t seed;
+
+
+/******************************************************************************/
+/*  Function Definitions                                                      */
+/******************************************************************************/
+
+
+static uint8_t randomByte(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return (uint8_t)seed;
+}
+
+static size_t roundTrip(const size_t size)
+{
+	const size_t packedSize = snap_lzCompress(data, size, packed);
+	size_t unpackedSize = sizeof(unpacked);
+
+	TEST_ASSERT_LESS_OR_EQUAL_size_t(SNAP_LZ_BOUND(size), packedSize);
+	TEST_ASSERT_EQUAL_INT(0, snap_lzDecompress(packed, packedSize, unpacked, &unpackedSize));
+	TEST_ASSERT_EQUAL_size_t(size, unpackedSize);
+
+	if(size != 0)
+	{
+		TEST_ASSERT_EQUAL_MEMORY(data, unpacked, size);
+	}
+
+	return packedSize;
+}
+
+
+/******************************************************************************/
+/*  TEST GROUP: lz                                                            */
+/******************************************************************************/
+
+
+TEST_GROUP(lz);
+
+TEST_SETUP(lz)
+{
+	seed = 0x12345678U;
+}
+
+TEST_TEAR_DOWN(lz) {}
+
+TEST_GROUP_RUNNER(lz)
+{
+	RUN_TEST_CASE(lz, roundTrip_should_RestoreData_when_DataIsIncompressible);
+	RUN_TEST_CASE(lz, roundTrip_should_RestoreData_when_DataRepeats);
+	RUN_TEST_CASE(lz, roundTrip_should_RestoreData_when_DataLooksLikeCapture);
+	RUN_TEST_CASE(lz, decompress_should_ReturnError_if_OutputIsTooSmall);
+	RUN_TEST_CASE(lz, decompress_should_ReturnError_if_BlockIsTruncated);
+}
+
+TEST(lz, roundTrip_should_RestoreData_when_DataIsIncompressible)
+{
+	for(size_t i = 0; i < SIZE_DATA; i++)
+	{
+		data[i] = randomByte();
+	}
+
+	for(size_t size = 0; size < 40; size++)
+	{
+		roundTrip(size);
+	}
+
+	roundTrip(SIZE_DATA);
+}
+
+TEST(lz, roundTrip_should_RestoreData_when_DataRepeats)
+{
+	for(size_t i = 0; i < SIZE_DATA; i++)
+	{
+		data[i] = 0xAA;
+	}
+
+	TEST_ASSERT_LESS_THAN_size_t(SIZE_DATA / 50U, roundTrip(SIZE_DATA));
+
+	// Short period, then a match much longer than its offset
+	for(size_t i = 0; i < SIZE_DATA; i++)
+	{
+		data[i] = (uint8_t)(i % 3U);
+	}
+
+	TEST_ASSERT_LESS_THAN_size_t(SIZE_DATA / 50U, roundTrip(SIZE_DATA));
+	roundTrip(1000);
+	roundTrip(17);
+}
+
+TEST(lz, roundTrip_should_RestoreData_when_DataLooksLikeCapture)
+{
+	// Records: increasing timestamp, constant channel and header, random payload
+	size_t size = 0;
+
+	for(uint64_t record = 0; size + 32U <= SIZE_DATA; record++)
+	{
+		const uint64_t timestamp = 1700000000000000000U + record * 1000U;
+
+		for(uint_fast8_t i = 0; i < 8U; i++)
+		{
+			data[size++] = (uint8_t)(timestamp >> (8U * i));
+		}
+
+		const uint8_t header[] = {0x01, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x54, 0x51, 0x32};
+
+		for(size_t i = 0; i < sizeof(header); i++)
+		{
+			data[size++] = header[i];
+		}
+
+		for(uint_fast8_t i = 0; i < 13U; i++)
+		{
+			data[size++] = (i < 5U) ? randomByte() : 0x00;
+		}
+	}
+
+	TEST_ASSERT_LESS_THAN_size_t(size / 2U, roundTrip(size));
+}
+
+TEST(lz, decompress_should_ReturnError_if_OutputIsTooSmall)
+{
+	for(size_t i = 0; i < SIZE_DATA; i++)
+	{
+		data[i] = (uint8_t)((i % 7U == 0) ? randomByte() : i);
+	}
+
+	const size_t packedSize = snap_lzCompress(data, 5000, packed);
+	size_t unpackedSize = 4999;
+
+	errno = 0;
+	TEST_ASSERT_EQUAL_INT(-1, snap_lzDecompress(packed, packedSize, unpacked, &unpackedSize));
+	TEST_ASSERT_EQUAL_INT(EINVAL, errno);
+}
+
+TEST(lz, decompress_should_ReturnError_if_BlockIsTruncated)
+{
+	for(size_t i = 0; i < SIZE_DATA; i++)
+	{
+		data[i] = (uint8_t)((i % 5U == 0) ? randomByte() : i / 64U);
+	}
+
+	const size_t packedSize = snap_lzCompress(data, 3000, packed);
+
+	// Every prefix is rejected or decodes to fewer bytes, without reading or writing out of bounds
+	for(size_t size = 0; size < packedSize; size++)
+	{
+		size_t unpackedSize = 3000;
+
+		if(snap_lzDecompress(packed, size, unpacked, &unpackedSize) == 0)
+		{
+			TEST_ASSERT_LESS_THAN_size_t(3000, unpackedSize);
+		}
+	}
+}
+
+/******************************** END OF FILE *********************************/
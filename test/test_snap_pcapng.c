@@ -0,0 +1,124 @@
+/**
+ * @file   test_snap_pcapng.c
+ * @author Lucas Jadilo
+ * @brief  Unit tests for the pcapng writer of the SNAP tools.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _DEFAULT_SOURCE
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include "unity_fixture.h"
+#include "snap_pcapng.h"
+
+
+/******************************************************************************/
+/*  Variables                                                                 */
+/******************************************************************************/
+
+
+static snap_pcapngWriter_t writer;
+static uint8_t frameBuffer[SNAP_MAX_SIZE_FRAME];
+static snap_frame_t frame;
+static int fd;
+
+// Header (28) + data (528) + epb_flags (8) [+ comment (4 + 24 or 28)] + end of options (4) + trailer (4)
+static const struct
+{
+	int8_t   status;
+	uint32_t size;
+} blocks[] = {{SNAP_STATUS_VALID, 572}, {SNAP_STATUS_ERROR_HASH, 600}, {SNAP_STATUS_ERROR_OVERFLOW, 604}};
+
+
+/******************************************************************************/
+/*  Function Definitions                                                      */
+/******************************************************************************/
+
+
+static uint32_t get32(const uint8_t *p)
+{
+	uint32_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+
+/******************************************************************************/
+/*  TEST GROUP: pcapng                                                        */
+/******************************************************************************/
+
+
+TEST_GROUP(pcapng);
+
+TEST_SETUP(pcapng)
+{
+	fd = open("/dev/null", O_WRONLY);
+	TEST_ASSERT_GREATER_OR_EQUAL_INT(0, fd);
+	snap_pcapngWriterInit(&writer, fd);
+
+	for(size_t i = 0; i < sizeof(frameBuffer); i++)
+	{
+		frameBuffer[i] = (uint8_t)i;
+	}
+
+	snap_init(&frame, frameBuffer, sizeof(frameBuffer));
+	frameBuffer[0] = SNAP_SYNC;
+	frame.size = SNAP_MAX_SIZE_FRAME;
+}
+
+TEST_TEAR_DOWN(pcapng)
+{
+	close(fd);
+}
+
+TEST_GROUP_RUNNER(pcapng)
+{
+	RUN_TEST_CASE(pcapng, write_should_SizeBlockForEveryStatus_when_FrameHasMaximumSize);
+	RUN_TEST_CASE(pcapng, write_should_NeverExceedBuffer_when_FrameHasMaximumSize);
+}
+
+TEST(pcapng, write_should_SizeBlockForEveryStatus_when_FrameHasMaximumSize)
+{
+	TEST_ASSERT_EQUAL_INT(0, snap_pcapngWrite(&writer, 0, 0, &frame));	// Also describes the interface
+
+	for(size_t i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i++)
+	{
+		const size_t start = writer.length;
+
+		frame.status = blocks[i].status;
+		TEST_ASSERT_EQUAL_INT(0, snap_pcapngWrite(&writer, 0, 0, &frame));
+		TEST_ASSERT_EQUAL_size_t(blocks[i].size, writer.length - start);
+		TEST_ASSERT_EQUAL_HEX32(0x00000006, get32(&writer.buffer[start]));
+		TEST_ASSERT_EQUAL_UINT32(blocks[i].size, get32(&writer.buffer[start + 4]));
+		TEST_ASSERT_EQUAL_UINT32(blocks[i].size, get32(&writer.buffer[writer.length - 4]));
+		TEST_ASSERT_EQUAL_MEMORY(frameBuffer, &writer.buffer[start + 28], SNAP_MAX_SIZE_FRAME);
+	}
+
+	TEST_ASSERT_EQUAL_UINT64(4, writer.records);
+}
+
+TEST(pcapng, write_should_NeverExceedBuffer_when_FrameHasMaximumSize)
+{
+	TEST_ASSERT_EQUAL_INT(0, snap_pcapngWrite(&writer, 0, 0, &frame));
+
+	for(size_t i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i++)
+	{
+		frame.status = blocks[i].status;
+
+		for(size_t length = SNAP_PCAPNG_SIZE_BUFFER - 2U * blocks[i].size; length <= SNAP_PCAPNG_SIZE_BUFFER; length++)
+		{
+			writer.length = length;
+			TEST_ASSERT_EQUAL_INT(0, snap_pcapngWrite(&writer, 0, 0, &frame));
+			TEST_ASSERT_LESS_OR_EQUAL_size_t(SNAP_PCAPNG_SIZE_BUFFER, writer.length);
+			TEST_ASSERT_EQUAL_UINT32(blocks[i].size, get32(&writer.buffer[writer.length - 4]));
+		}
+	}
+}
+
+/******************************** END OF FILE *********************************/
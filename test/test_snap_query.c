@@ -0,0 +1,658 @@
+/**
+ * @file   test_snap_query.c
+ * @author Lucas Jadilo
+ * @brief  Unit tests for the capture queries of the SNAP tools.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _DEFAULT_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "unity_fixture.h"
+#include "snap_query.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define NUM_SAMPLES		(4000U)
+#define FIRST_TIMESTAMP	(1700000000000000000U)
+#define TIME_STEP		(1000U)
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+typedef struct sample_t
+{
+	uint64_t      timestamp;
+	uint32_t      dest;
+	uint32_t      source;
+	uint32_t      flags;
+	snap_header_t header;
+	uint16_t      channel;
+	uint16_t      size;			// Size of the record (smaller than the frame if truncated)
+	uint16_t      dataIndex;
+	uint8_t       data[8];
+	int8_t        status;
+} sample_t;
+
+typedef struct query_t
+{
+	const char *expression;
+	bool       (*oracle)(const sample_t *sample);
+} query_t;
+
+
+/******************************************************************************/
+/*  Variables                                                                 */
+/******************************************************************************/
+
+
+static sample_t samples[NUM_SAMPLES];
+static bool matched[NUM_SAMPLES];
+static snap_query_t query;
+static snap_captureReader_t reader;
+static char capturePath[] = "/tmp/test_snap_query_XXXXXX";
+static char indexPath[] = "/tmp/test_snap_index_XXXXXX";
+static snap_index_t captureIndex;
+static uint64_t firstTimestamp = FIRST_TIMESTAMP;
+static uint32_t seed;
+
+
+/******************************************************************************/
+/*  Function Definitions                                                      */
+/******************************************************************************/
+
+
+static uint32_t randomNumber(const uint32_t limit)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed % limit;
+}
+
+static uint32_t randomValue(const uint32_t *values, const size_t count, const uint_fast8_t bytes)
+{
+	const uint32_t index = randomNumber((uint32_t)count + 1U);
+	const uint32_t value = (index < count) ? values[index] : randomNumber(0x1000000U);
+
+	return value & (uint32_t)((1UL << (8U * bytes)) - 1U);
+}
+
+// Random frames with field values that the queries below look for, some truncated, written to a capture file
+static void writeCapture(const bool compressed)
+{
+	static const uint32_t addresses[] = {0x12, 0x34, 0xB0B1, 0x123456};
+	static const uint32_t flags[] = {0x51, 0x5F, 0x23, 0x123456};
+	static const uint32_t bytes[] = {0x12, 0x34, 0x55};
+	uint8_t buffer[SNAP_MAX_SIZE_FRAME];
+	snap_captureWriter_t writer;
+	snap_frame_t frame;
+
+	seed = 0x2468ACE1U;
+	snap_init(&frame, buffer, sizeof(buffer));
+
+	const int ret = compressed ? snap_captureWriterOpenCompressed(&writer, capturePath, 4096) :
+								 snap_captureWriterOpen(&writer, capturePath);
+	TEST_ASSERT_EQUAL_INT(0, ret);
+
+	for(size_t i = 0; i < NUM_SAMPLES; i++)
+	{
+		sample_t *sample = &samples[i];
+		snap_fields_t fields = {.data = sample->data, .paddingAfter = true};
+
+		fields.header.dab = randomNumber(4) & 3U;
+		fields.header.sab = randomNumber(4) & 3U;
+		fields.header.pfb = randomNumber(4) & 3U;
+		fields.header.ack = randomNumber(4) & 3U;
+		fields.header.cmd = randomNumber(2) & 1U;
+		fields.header.edm = randomNumber(6) & 7U;
+		fields.dataSize = (uint16_t)randomNumber(9);
+		fields.destAddress = randomValue(addresses, sizeof(addresses) / sizeof(addresses[0]), fields.header.dab);
+		fields.sourceAddress = randomValue(addresses, sizeof(addresses) / sizeof(addresses[0]), fields.header.sab);
+		fields.protocolFlags = randomValue(flags, sizeof(flags) / sizeof(flags[0]), fields.header.pfb);
+
+		for(size_t j = 0; j < sizeof(sample->data); j++)
+		{
+			sample->data[j] = (uint8_t)randomValue(bytes, sizeof(bytes) / sizeof(bytes[0]), 1);
+		}
+
+		TEST_ASSERT_EQUAL_INT8(SNAP_STATUS_VALID, snap_encapsulate(&frame, &fields));
+
+		const uint32_t status = randomNumber(8);
+		frame.status = (status == 0) ? SNAP_STATUS_ERROR_HASH : (status == 1) ? SNAP_STATUS_ERROR_OVERFLOW : SNAP_STATUS_VALID;
+
+		if(randomNumber(8) == 0)
+		{
+			frame.size = (uint16_t)(1U + randomNumber(frame.size - 1U));
+		}
+
+		sample->timestamp = firstTimestamp + i * TIME_STEP;
+		sample->dest = fields.destAddress;
+		sample->source = fields.sourceAddress;
+		sample->flags = fields.protocolFlags;
+		sample->header = fields.header;
+		sample->channel = (uint16_t)randomNumber(4);
+		sample->size = frame.size;
+		sample->dataIndex = (uint16_t)snap_getDataIndex(&frame);
+		sample->status = frame.status;
+
+		TEST_ASSERT_EQUAL_INT(0, snap_captureWrite(&writer, sample->timestamp, sample->channel, &frame));
+	}
+
+	TEST_ASSERT_EQUAL_INT(0, snap_captureWriterClose(&writer));
+}
+
+// The oracles below read the fields from the samples, not from the frame bytes
+static bool hasHeader(const sample_t *sample)
+{
+	return sample->size > SNAP_INDEX_HDB1;
+}
+
+static bool getAddress(const sample_t *sample, const bool dest, uint32_t *value)
+{
+	const uint_fast8_t bytes = dest ? sample->header.dab : sample->header.sab;
+	const uint_fast16_t end = SNAP_INDEX_DAB + sample->header.dab + (dest ? 0U : sample->header.sab);
+
+	*value = dest ? sample->dest : sample->source;
+	return hasHeader(sample) && (bytes != 0) && (end <= sample->size);
+}
+
+static bool getData(const sample_t *sample, const uint_fast8_t offset, const uint_fast8_t count, uint64_t *value)
+{
+	if(!hasHeader(sample) || (offset + count > sample->header.ndb) || (sample->dataIndex + offset + count > sample->size))
+	{
+		return false;
+	}
+
+	*value = 0;
+
+	for(uint_fast8_t i = 0; i < count; i++)
+	{
+		*value = (*value << 8) | sample->data[offset + i];
+	}
+
+	return true;
+}
+
+static bool matchAckHash(const sample_t *sample)
+{
+	return hasHeader(sample) && (sample->header.ack == 1U) && (sample->status == SNAP_STATUS_ERROR_HASH);
+}
+
+static bool matchAddresses(const sample_t *sample)
+{
+	uint32_t source, dest;
+	return (getAddress(sample, false, &source) && (source == 0xB0B1)) || (getAddress(sample, true, &dest) && (dest == 0x12));
+}
+
+static bool matchChannelDataSize(const sample_t *sample)
+{
+	return (sample->channel < 2U) && hasHeader(sample) && (sample->header.ndb > 4U);
+}
+
+static bool matchData(const sample_t *sample)
+{
+	uint64_t byte, word;
+	return (getData(sample, 1, 1, &byte) && (byte == 0x55)) || (getData(sample, 0, 2, &word) && (word == 0x1234));
+}
+
+static bool matchTimestamp(const sample_t *sample)
+{
+	return (sample->timestamp >= FIRST_TIMESTAMP + 100U * TIME_STEP) && (sample->timestamp < FIRST_TIMESTAMP + 900U * TIME_STEP);
+}
+
+static bool matchFlags(const sample_t *sample)
+{
+	const uint_fast16_t end = SNAP_INDEX_DAB + sample->header.dab + sample->header.sab + sample->header.pfb;
+	return hasHeader(sample) && (sample->header.pfb != 0) && (end <= sample->size) && ((sample->flags & 0xF0U) == 0x50U);
+}
+
+static bool matchNoDest(const sample_t *sample)
+{
+	uint32_t dest;
+	return !(getAddress(sample, true, &dest) && (dest != 0));
+}
+
+static bool matchEdmCmd(const sample_t *sample)
+{
+	return hasHeader(sample) && ((sample->header.edm == 3U) || (sample->header.cmd != 0));
+}
+
+static bool matchSizeStatus(const sample_t *sample)
+{
+	return (sample->size <= 4U) || (sample->status != SNAP_STATUS_VALID);
+}
+
+static const query_t queries[] =
+{
+	{"ack == 1 && status == hash",                      matchAckHash},
+	{"source == 0xB0B1 || dest == 0x12",                matchAddresses},
+	{"!(channel >= 2) && data_size > 4",                matchChannelDataSize},
+	{"data[1] == 0x55 || data[0:2] == 0x1234",          matchData},
+	{"timestamp >= 1700000000000100000 && timestamp < 1700000000000900000", matchTimestamp},
+	{"flags & 0xF0 == 0x50",                            matchFlags},
+	{"!dest",                                           matchNoDest},
+	{"edm == 3 || cmd",                                 matchEdmCmd},
+	{"size <= 4 || status != valid",                    matchSizeStatus},
+};
+
+// Queries whose index can skip most blocks
+static bool matchFirstRecords(const sample_t *sample)
+{
+	return sample->timestamp < FIRST_TIMESTAMP + 50U * TIME_STEP;
+}
+
+static bool matchLastRecords(const sample_t *sample)
+{
+	return (sample->channel == 2U) && (sample->timestamp >= FIRST_TIMESTAMP + 3950U * TIME_STEP);
+}
+
+static const query_t selective[] =
+{
+	{"timestamp < 1700000000000050000",                       matchFirstRecords},
+	{"channel == 2 && timestamp >= 1700000000003950000",      matchLastRecords},
+};
+
+static bool collect(void *context, const snap_captureRecord_t *record, size_t offset)
+{
+	const size_t i = (size_t)((record->timestamp - firstTimestamp) / TIME_STEP);
+
+	(void)context;
+	(void)offset;
+	TEST_ASSERT_LESS_THAN_size_t(NUM_SAMPLES, i);
+	TEST_ASSERT_FALSE(matched[i]);
+	TEST_ASSERT_EQUAL_UINT16(samples[i].size, record->size);
+	matched[i] = true;
+	return true;
+}
+
+static bool stopAtThird(void *context, const snap_captureRecord_t *record, size_t offset)
+{
+	size_t *count = context;
+
+	(void)record;
+	(void)offset;
+	return ++(*count) < 3U;
+}
+
+// Scan the whole capture (with the index, if given) and compare the matching records with the oracle
+static size_t checkQuery(const query_t *q, const snap_index_t *index)
+{
+	size_t count = 0, skipped = 0;
+
+	TEST_ASSERT_EQUAL_INT_MESSAGE(0, snap_queryCompile(&query, q->expression), q->expression);
+	TEST_ASSERT_EQUAL_INT(0, snap_captureReaderOpen(&reader, capturePath));
+	memset(matched, 0, sizeof(matched));
+
+	const int ret = (index == NULL) ? snap_queryScan(&query, &reader, collect, NULL) :
+									  snap_queryScanIndex(&query, &reader, index, collect, NULL, &skipped);
+	TEST_ASSERT_EQUAL_INT(0, ret);
+
+	for(size_t i = 0; i < NUM_SAMPLES; i++)
+	{
+		TEST_ASSERT_EQUAL_MESSAGE(q->oracle(&samples[i]), matched[i], q->expression);
+		count += matched[i];
+	}
+
+	// The random frames must exercise both outcomes
+	TEST_ASSERT_GREATER_THAN_size_t_MESSAGE(0, count, q->expression);
+	TEST_ASSERT_LESS_THAN_size_t_MESSAGE(NUM_SAMPLES, count, q->expression);
+	return skipped;
+}
+
+static void checkQueries(const snap_index_t *index)
+{
+	for(size_t q = 0; q < sizeof(queries) / sizeof(queries[0]); q++)
+	{
+		checkQuery(&queries[q], index);
+		snap_captureReaderClose(&reader);
+	}
+}
+
+
+/******************************************************************************/
+/*  TEST GROUP: query                                                         */
+/******************************************************************************/
+
+
+TEST_GROUP(query);
+
+TEST_SETUP(query)
+{
+	const int fd = mkstemp(capturePath);
+	TEST_ASSERT_GREATER_OR_EQUAL_INT(0, fd);
+	close(fd);
+}
+
+TEST_TEAR_DOWN(query)
+{
+	unlink(capturePath);
+	strcpy(&capturePath[sizeof(capturePath) - 7U], "XXXXXX");
+}
+
+TEST_GROUP_RUNNER(query)
+{
+	RUN_TEST_CASE(query, compile_should_ReportErrorAndPosition_if_ExpressionIsInvalid);
+	RUN_TEST_CASE(query, scan_should_MatchBruteForce_when_CaptureIsPlain);
+	RUN_TEST_CASE(query, scan_should_MatchBruteForce_when_CaptureIsCompressed);
+	RUN_TEST_CASE(query, scan_should_Stop_when_CallbackReturnsFalse);
+}
+
+TEST(query, compile_should_ReportErrorAndPosition_if_ExpressionIsInvalid)
+{
+	static const struct {const char *expression; const char *error; size_t position;} invalid[] =
+	{
+		{"",                       "field expected",        0},
+		{"foo == 1",               "field expected",        0},
+		{"source ==",              "number expected",       9},
+		{"ack == 12ab",            "invalid number",        7},
+		{"(ack == 1",              "\")\" expected",        9},
+		{"ack == 1 extra",         "unexpected characters", 9},
+		{"ack == 1 &&",            "field expected",        11},
+		{"data 1",                 "\"[\" expected",        5},
+		{"data[1:9] == 0",         "invalid data range",    9},
+		{"data[600] == 0",         "invalid data range",    9},
+	};
+
+	for(size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+	{
+		TEST_ASSERT_EQUAL_INT_MESSAGE(-1, snap_queryCompile(&query, invalid[i].expression), invalid[i].expression);
+		TEST_ASSERT_EQUAL_STRING_MESSAGE(invalid[i].error, query.error, invalid[i].expression);
+		TEST_ASSERT_EQUAL_size_t_MESSAGE(invalid[i].position, query.errorPosition, invalid[i].expression);
+	}
+
+	char expression[512] = "";
+
+	for(size_t i = 0; i <= SNAP_QUERY_MAX_DEPTH; i++)
+	{
+		strcat(expression, "(");
+	}
+
+	TEST_ASSERT_EQUAL_INT(-1, snap_queryCompile(&query, expression));
+	TEST_ASSERT_EQUAL_STRING("expression too deep", query.error);
+
+	expression[0] = '\0';
+
+	for(size_t i = 0; i < SNAP_QUERY_MAX_CODE / 2U; i++)
+	{
+		strcat(expression, "cmd || ");
+	}
+
+	strcat(expression, "cmd");
+	TEST_ASSERT_EQUAL_INT(-1, snap_queryCompile(&query, expression));
+	TEST_ASSERT_EQUAL_STRING("expression too long", query.error);
+
+	TEST_ASSERT_EQUAL_INT(0, snap_queryCompile(&query, "  ack==1&&!(dest!=0x12||data[0:8]>=7) "));
+	TEST_ASSERT_NULL(query.error);
+}
+
+TEST(query, scan_should_MatchBruteForce_when_CaptureIsPlain)
+{
+	writeCapture(false);
+	checkQueries(NULL);
+}
+
+TEST(query, scan_should_MatchBruteForce_when_CaptureIsCompressed)
+{
+	writeCapture(true);
+	checkQueries(NULL);
+}
+
+TEST(query, scan_should_Stop_when_CallbackReturnsFalse)
+{
+	size_t count = 0;
+
+	writeCapture(false);
+	TEST_ASSERT_EQUAL_INT(0, snap_queryCompile(&query, "status == valid"));
+	TEST_ASSERT_EQUAL_INT(0, snap_captureReaderOpen(&reader, capturePath));
+	TEST_ASSERT_EQUAL_INT(0, snap_queryScan(&query, &reader, stopAtThird, &count));
+	TEST_ASSERT_LESS_THAN_size_t(reader.size, reader.pos);
+	snap_captureReaderClose(&reader);
+	TEST_ASSERT_EQUAL_size_t(3, count);
+}
+
+
+/******************************************************************************/
+/*  TEST GROUP: index                                                         */
+/******************************************************************************/
+
+
+TEST_GROUP(index);
+
+TEST_SETUP(index)
+{
+	int fd = mkstemp(capturePath);
+	TEST_ASSERT_GREATER_OR_EQUAL_INT(0, fd);
+	close(fd);
+	fd = mkstemp(indexPath);
+	TEST_ASSERT_GREATER_OR_EQUAL_INT(0, fd);
+	close(fd);
+}
+
+TEST_TEAR_DOWN(index)
+{
+	snap_indexClose(&captureIndex);
+	firstTimestamp = FIRST_TIMESTAMP;
+	unlink(capturePath);
+	unlink(indexPath);
+	strcpy(&capturePath[sizeof(capturePath) - 7U], "XXXXXX");
+	strcpy(&indexPath[sizeof(indexPath) - 7U], "XXXXXX");
+}
+
+TEST_GROUP_RUNNER(index)
+{
+	RUN_TEST_CASE(index, build_should_SummarizeEveryRecord_when_CaptureIsComplete);
+	RUN_TEST_CASE(index, block_should_NeverBeSkipped_when_ItHasMatchingRecords);
+	RUN_TEST_CASE(index, scanIndex_should_MatchFullScan_when_BlocksAreSkipped);
+	RUN_TEST_CASE(index, scanIndex_should_NotDecompressSkippedBlocks_when_CaptureIsCompressed);
+	RUN_TEST_CASE(index, scanIndex_should_ScanRecordsAfterIndex_when_IndexIsIncomplete);
+	RUN_TEST_CASE(index, scanIndex_should_NotSkipBlocks_when_IndexBelongsToPreviousCapture);
+}
+
+TEST(index, build_should_SummarizeEveryRecord_when_CaptureIsComplete)
+{
+	snap_indexBlock_t block;
+	snap_captureRecord_t record;
+	size_t total = 0;
+
+	writeCapture(false);
+	TEST_ASSERT_EQUAL_INT(0, snap_indexBuild(capturePath, indexPath, 2048));
+	TEST_ASSERT_EQUAL_INT(0, snap_indexOpen(&captureIndex, indexPath));
+	TEST_ASSERT_GREATER_THAN_size_t(10, captureIndex.blocks);
+	TEST_ASSERT_EQUAL_INT(0, snap_captureReaderOpen(&reader, capturePath));
+
+	for(size_t b = 0; b < captureIndex.blocks; b++)
+	{
+		uint32_t records = 0, valid = 0, hashErrors = 0, overflowErrors = 0;
+		uint64_t minTimestamp = UINT64_MAX, maxTimestamp = 0;
+		uint16_t minChannel = UINT16_MAX, maxChannel = 0;
+
+		snap_indexGetBlock(&captureIndex, b, &block);
+		TEST_ASSERT_EQUAL_UINT64(reader.pos, block.offset);
+
+		while(reader.pos < block.end)
+		{
+			TEST_ASSERT_EQUAL_INT(1, snap_captureRead(&reader, &record));
+
+			const sample_t *sample = &samples[(record.timestamp - FIRST_TIMESTAMP) / TIME_STEP];
+			uint32_t address;
+
+			records++;
+			valid += (sample->status == SNAP_STATUS_VALID);
+			hashErrors += (sample->status == SNAP_STATUS_ERROR_HASH);
+			overflowErrors += (sample->status == SNAP_STATUS_ERROR_OVERFLOW);
+			if(sample->timestamp < minTimestamp) minTimestamp = sample->timestamp;
+			if(sample->timestamp > maxTimestamp) maxTimestamp = sample->timestamp;
+			if(sample->channel < minChannel) minChannel = sample->channel;
+			if(sample->channel > maxChannel) maxChannel = sample->channel;
+
+			// Bloom filters may have false positives, never false negatives
+			if(getAddress(sample, true, &address))
+			{
+				TEST_ASSERT_TRUE(snap_indexBloomContains(block.destBloom, address));
+			}
+
+			if(getAddress(sample, false, &address))
+			{
+				TEST_ASSERT_TRUE(snap_indexBloomContains(block.sourceBloom, address));
+			}
+		}
+
+		TEST_ASSERT_EQUAL_UINT64(reader.pos, block.end);
+		TEST_ASSERT_EQUAL_UINT32(records, block.records);
+		TEST_ASSERT_EQUAL_UINT32(valid, block.valid);
+		TEST_ASSERT_EQUAL_UINT32(hashErrors, block.hashErrors);
+		TEST_ASSERT_EQUAL_UINT32(overflowErrors, block.overflowErrors);
+		TEST_ASSERT_EQUAL_UINT64(minTimestamp, block.minTimestamp);
+		TEST_ASSERT_EQUAL_UINT64(maxTimestamp, block.maxTimestamp);
+		TEST_ASSERT_EQUAL_UINT16(minChannel, block.minChannel);
+		TEST_ASSERT_EQUAL_UINT16(maxChannel, block.maxChannel);
+		total += records;
+	}
+
+	TEST_ASSERT_EQUAL_size_t(reader.size, reader.pos);
+	TEST_ASSERT_EQUAL_size_t(NUM_SAMPLES, total);
+	snap_captureReaderClose(&reader);
+}
+
+TEST(index, block_should_NeverBeSkipped_when_ItHasMatchingRecords)
+{
+	static const char *const expressions[] =
+	{
+		"status == overflow", "status != valid", "channel == 3", "channel == 3 && status == hash",
+		"source == 0xB0B1", "dest == 0x123456 && source == 0x12", "!(timestamp >= 1700000000001000000)"
+	};
+	snap_indexBlock_t block;
+	snap_captureRecord_t record;
+
+	writeCapture(false);
+	TEST_ASSERT_EQUAL_INT(0, snap_indexBuild(capturePath, indexPath, 512));
+	TEST_ASSERT_EQUAL_INT(0, snap_indexOpen(&captureIndex, indexPath));
+	TEST_ASSERT_EQUAL_INT(0, snap_captureReaderOpen(&reader, capturePath));
+
+	for(size_t e = 0; e < sizeof(expressions) / sizeof(expressions[0]); e++)
+	{
+		size_t skipped = 0;
+
+		TEST_ASSERT_EQUAL_INT(0, snap_queryCompile(&query, expressions[e]));
+
+		for(size_t b = 0; b < captureIndex.blocks; b++)
+		{
+			snap_indexGetBlock(&captureIndex, b, &block);
+
+			if(snap_queryBlock(&query, &block))
+			{
+				continue;
+			}
+
+			skipped++;
+			reader.pos = (size_t)block.offset;
+
+			while(reader.pos < block.end)
+			{
+				TEST_ASSERT_EQUAL_INT(1, snap_captureRead(&reader, &record));
+				TEST_ASSERT_FALSE_MESSAGE(snap_queryMatch(&query, &record), expressions[e]);
+			}
+		}
+
+		TEST_ASSERT_GREATER_THAN_size_t_MESSAGE(0, skipped, expressions[e]);
+	}
+
+	snap_captureReaderClose(&reader);
+}
+
+TEST(index, scanIndex_should_MatchFullScan_when_BlocksAreSkipped)
+{
+	writeCapture(false);
+	TEST_ASSERT_EQUAL_INT(0, snap_indexBuild(capturePath, indexPath, 2048));
+	TEST_ASSERT_EQUAL_INT(0, snap_indexOpen(&captureIndex, indexPath));
+	checkQueries(&captureIndex);
+
+	for(size_t q = 0; q < sizeof(selective) / sizeof(selective[0]); q++)
+	{
+		TEST_ASSERT_GREATER_THAN_size_t_MESSAGE(captureIndex.blocks / 2U, checkQuery(&selective[q], &captureIndex), selective[q].expression);
+		snap_captureReaderClose(&reader);
+	}
+}
+
+TEST(index, scanIndex_should_NotDecompressSkippedBlocks_when_CaptureIsCompressed)
+{
+	writeCapture(true);
+	TEST_ASSERT_EQUAL_INT(0, snap_indexBuild(capturePath, indexPath, 16384));
+	TEST_ASSERT_EQUAL_INT(0, snap_indexOpen(&captureIndex, indexPath));
+
+	const size_t skipped = checkQuery(&selective[1], &captureIndex);
+	size_t loaded = 0;
+
+	for(size_t b = 0; b < reader.blocks; b++)
+	{
+		loaded += (reader.loaded[b] != 0);
+	}
+
+	TEST_ASSERT_GREATER_THAN_size_t(0, skipped);
+	TEST_ASSERT_GREATER_THAN_size_t(0, loaded);
+	TEST_ASSERT_LESS_THAN_size_t(reader.blocks / 2U, loaded);
+	snap_captureReaderClose(&reader);
+}
+
+TEST(index, scanIndex_should_ScanRecordsAfterIndex_when_IndexIsIncomplete)
+{
+	snap_indexBuilder_t builder;
+	snap_captureRecord_t record;
+
+	// Index of the first half of the capture, as when the capture is still growing
+	writeCapture(false);
+	TEST_ASSERT_EQUAL_INT(0, snap_captureReaderOpen(&reader, capturePath));
+	TEST_ASSERT_EQUAL_INT(0, snap_indexBuilderOpen(&builder, indexPath, 2048));
+
+	for(size_t i = 0; i < NUM_SAMPLES / 2U; i++)
+	{
+		const uint64_t offset = reader.pos;
+
+		TEST_ASSERT_EQUAL_INT(1, snap_captureRead(&reader, &record));
+		TEST_ASSERT_EQUAL_INT(0, snap_indexAdd(&builder, &record, offset));
+	}
+
+	TEST_ASSERT_EQUAL_INT(0, snap_indexBuilderClose(&builder));
+	snap_captureReaderClose(&reader);
+	TEST_ASSERT_EQUAL_INT(0, snap_indexOpen(&captureIndex, indexPath));
+	checkQueries(&captureIndex);
+	TEST_ASSERT_GREATER_THAN_size_t(0, checkQuery(&selective[0], &captureIndex));
+	snap_captureReaderClose(&reader);
+	TEST_ASSERT_EQUAL_size_t(captureIndex.blocks, checkQuery(&selective[1], &captureIndex));
+	snap_captureReaderClose(&reader);
+}
+
+TEST(index, scanIndex_should_NotSkipBlocks_when_IndexBelongsToPreviousCapture)
+{
+	// Same frames and offsets, recorded later: only the timestamps differ from the capture of the index
+	for(uint_fast8_t compressed = 0; compressed < 2U; compressed++)
+	{
+		firstTimestamp = FIRST_TIMESTAMP;
+		writeCapture(compressed);
+		TEST_ASSERT_EQUAL_INT(0, snap_indexBuild(capturePath, indexPath, 2048));
+		firstTimestamp = FIRST_TIMESTAMP + 500U * TIME_STEP;
+		writeCapture(compressed);
+
+		TEST_ASSERT_EQUAL_INT(0, snap_indexOpen(&captureIndex, indexPath));
+		checkQueries(&captureIndex);
+		TEST_ASSERT_EQUAL_size_t(0, checkQuery(&selective[1], &captureIndex));
+		snap_captureReaderClose(&reader);
+		snap_indexClose(&captureIndex);
+	}
+}
+
+/******************************** END OF FILE *********************************/
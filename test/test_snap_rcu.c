@@ -0,0 +1,267 @@
+/**
+ * @file   test_snap_rcu.c
+ * @author Lucas Jadilo
+ * @brief  Unit tests for the configuration sharing (RCU) of the SNAP tools.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _DEFAULT_SOURCE
+#include <sched.h>
+#include <stdbool.h>
+#include <string.h>
+#include "unity_fixture.h"
+#include "snap_rcu.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define NUM_CONFIGS		(20000U)
+#define NUM_READERS		(4U)
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+typedef struct config_t
+{
+	uint32_t number;
+	bool     freed;		// Set by the free function instead of freeing the object, accessed with __atomic builtins
+} config_t;
+
+typedef struct reader_t
+{
+	pthread_t thread;
+	uint32_t  number;
+	uint64_t  acquired;
+	bool      usedFreed;
+} reader_t;
+
+
+/******************************************************************************/
+/*  Variables                                                                 */
+/******************************************************************************/
+
+
+static config_t configs[NUM_CONFIGS];
+static reader_t readers[NUM_READERS];
+static snap_rcu_t rcu;
+static uint32_t freeCount;
+static bool finished;
+
+
+/******************************************************************************/
+/*  Function Definitions                                                      */
+/******************************************************************************/
+
+
+static void freeConfig(void *context, void *object)
+{
+	config_t *config = object;
+
+	TEST_ASSERT_EQUAL_PTR(&rcu, context);
+	TEST_ASSERT_FALSE(__atomic_load_n(&config->freed, __ATOMIC_RELAXED));
+	__atomic_store_n(&config->freed, true, __ATOMIC_RELAXED);
+	freeCount++;
+}
+
+static bool isFreed(const uint32_t number)
+{
+	return __atomic_load_n(&configs[number].freed, __ATOMIC_RELAXED);
+}
+
+// The configuration held by a reader must not be freed until its next acquisition or release
+static void *readConfigs(void *argument)
+{
+	reader_t *reader = argument;
+	uint32_t last = 0;
+
+	while(!__atomic_load_n(&finished, __ATOMIC_ACQUIRE))
+	{
+		const config_t *config = snap_rcuAcquire(&rcu, reader->number);
+
+		for(volatile uint32_t i = 0; i < 32U; i++) {}
+
+		reader->usedFreed |= __atomic_load_n(&config->freed, __ATOMIC_RELAXED) || (config->number < last);
+		reader->acquired++;
+		last = config->number;
+
+		if((reader->acquired % 64U) == 0)
+		{
+			snap_rcuRelease(&rcu, reader->number);
+			sched_yield();
+		}
+	}
+
+	snap_rcuRelease(&rcu, reader->number);
+	return NULL;
+}
+
+
+/******************************************************************************/
+/*  TEST GROUP: rcu                                                           */
+/******************************************************************************/
+
+
+TEST_GROUP(rcu);
+
+TEST_SETUP(rcu)
+{
+	for(uint32_t i = 0; i < NUM_CONFIGS; i++)
+	{
+		configs[i] = (config_t){.number = i};
+	}
+
+	freeCount = 0;
+	TEST_ASSERT_EQUAL_INT(0, snap_rcuInit(&rcu, NUM_READERS, &configs[0], freeConfig, &rcu));
+}
+
+TEST_TEAR_DOWN(rcu)
+{
+	snap_rcuDestroy(&rcu);
+}
+
+TEST_GROUP_RUNNER(rcu)
+{
+	RUN_TEST_CASE(rcu, acquire_should_ReturnSameConfig_when_NothingIsPublished);
+	RUN_TEST_CASE(rcu, reclaim_should_WaitForEveryReader_when_ConfigIsRetired);
+	RUN_TEST_CASE(rcu, reclaim_should_FreeOnlyOlderConfigs_when_ReadersHoldDifferentEpochs);
+	RUN_TEST_CASE(rcu, retire_should_FreeObject_when_ReadersAcquireAgain);
+	RUN_TEST_CASE(rcu, destroy_should_FreeCurrentAndRetiredConfigs);
+	RUN_TEST_CASE(rcu, reclaim_should_NeverFreeHeldConfig_when_ReadersRunConcurrently);
+}
+
+TEST(rcu, acquire_should_ReturnSameConfig_when_NothingIsPublished)
+{
+	for(uint32_t i = 0; i < 3U; i++)
+	{
+		TEST_ASSERT_EQUAL_PTR(&configs[0], snap_rcuAcquire(&rcu, 0));
+		TEST_ASSERT_EQUAL_PTR(&configs[0], snap_rcuAcquire(&rcu, 1));
+	}
+
+	snap_rcuRelease(&rcu, 0);
+	TEST_ASSERT_EQUAL_PTR(&configs[0], snap_rcuAcquire(&rcu, 0));
+	TEST_ASSERT_EQUAL_UINT32(0, snap_rcuReclaim(&rcu));
+	TEST_ASSERT_EQUAL_UINT32(0, freeCount);
+}
+
+TEST(rcu, reclaim_should_WaitForEveryReader_when_ConfigIsRetired)
+{
+	snap_rcuAcquire(&rcu, 0);
+	snap_rcuAcquire(&rcu, 1);	// Readers 2 and 3 hold nothing
+
+	snap_rcuPublish(&rcu, &configs[1]);
+	TEST_ASSERT_EQUAL_UINT32(1, snap_rcuReclaim(&rcu));
+	TEST_ASSERT_FALSE(isFreed(0));
+
+	TEST_ASSERT_EQUAL_PTR(&configs[1], snap_rcuAcquire(&rcu, 0));
+	TEST_ASSERT_EQUAL_UINT32(1, snap_rcuReclaim(&rcu));
+	TEST_ASSERT_FALSE(isFreed(0));
+
+	snap_rcuRelease(&rcu, 1);
+	TEST_ASSERT_EQUAL_UINT32(0, snap_rcuReclaim(&rcu));
+	TEST_ASSERT_TRUE(isFreed(0));
+	TEST_ASSERT_FALSE(isFreed(1));
+	TEST_ASSERT_EQUAL_UINT32(1, freeCount);
+}
+
+TEST(rcu, reclaim_should_FreeOnlyOlderConfigs_when_ReadersHoldDifferentEpochs)
+{
+	snap_rcuAcquire(&rcu, 0);					// Holds config 0
+	snap_rcuPublish(&rcu, &configs[1]);
+	snap_rcuAcquire(&rcu, 1);					// Holds config 1
+	snap_rcuPublish(&rcu, &configs[2]);
+	snap_rcuPublish(&rcu, &configs[3]);
+
+	TEST_ASSERT_EQUAL_UINT32(3, snap_rcuReclaim(&rcu));
+	TEST_ASSERT_EQUAL_UINT32(0, freeCount);
+
+	// Reader 1 still holds config 1, and nothing can hold config 0 anymore
+	TEST_ASSERT_EQUAL_PTR(&configs[3], snap_rcuAcquire(&rcu, 0));
+	TEST_ASSERT_EQUAL_UINT32(2, snap_rcuReclaim(&rcu));
+	TEST_ASSERT_TRUE(isFreed(0));
+	TEST_ASSERT_FALSE(isFreed(1));
+	TEST_ASSERT_FALSE(isFreed(2));
+
+	TEST_ASSERT_EQUAL_PTR(&configs[3], snap_rcuAcquire(&rcu, 1));
+	TEST_ASSERT_EQUAL_UINT32(0, snap_rcuReclaim(&rcu));
+	TEST_ASSERT_TRUE(isFreed(1));
+	TEST_ASSERT_TRUE(isFreed(2));
+	TEST_ASSERT_FALSE(isFreed(3));
+}
+
+TEST(rcu, retire_should_FreeObject_when_ReadersAcquireAgain)
+{
+	snap_rcuAcquire(&rcu, 0);
+	snap_rcuPublish(&rcu, &configs[1]);
+	snap_rcuRetire(&rcu, &configs[100], freeConfig, &rcu);	// Referenced by config 0 only
+
+	TEST_ASSERT_EQUAL_UINT32(2, snap_rcuReclaim(&rcu));
+	TEST_ASSERT_FALSE(isFreed(100));
+
+	snap_rcuAcquire(&rcu, 0);
+	TEST_ASSERT_EQUAL_UINT32(0, snap_rcuReclaim(&rcu));
+	TEST_ASSERT_TRUE(isFreed(0));
+	TEST_ASSERT_TRUE(isFreed(100));
+}
+
+TEST(rcu, destroy_should_FreeCurrentAndRetiredConfigs)
+{
+	snap_rcuAcquire(&rcu, 0);
+	snap_rcuPublish(&rcu, &configs[1]);
+	snap_rcuPublish(&rcu, &configs[2]);
+	snap_rcuRelease(&rcu, 0);
+	snap_rcuDestroy(&rcu);
+
+	TEST_ASSERT_EQUAL_UINT32(3, freeCount);
+	TEST_ASSERT_TRUE(isFreed(0));
+	TEST_ASSERT_TRUE(isFreed(1));
+	TEST_ASSERT_TRUE(isFreed(2));
+}
+
+TEST(rcu, reclaim_should_NeverFreeHeldConfig_when_ReadersRunConcurrently)
+{
+	finished = false;
+
+	for(uint32_t i = 0; i < NUM_READERS; i++)
+	{
+		readers[i] = (reader_t){.number = i};
+		TEST_ASSERT_EQUAL_INT(0, pthread_create(&readers[i].thread, NULL, readConfigs, &readers[i]));
+	}
+
+	for(uint32_t i = 1; i < NUM_CONFIGS; i++)
+	{
+		snap_rcuPublish(&rcu, &configs[i]);
+
+		if((i % 16U) == 0)
+		{
+			snap_rcuReclaim(&rcu);
+			sched_yield();
+		}
+	}
+
+	__atomic_store_n(&finished, true, __ATOMIC_RELEASE);
+
+	for(uint32_t i = 0; i < NUM_READERS; i++)
+	{
+		TEST_ASSERT_EQUAL_INT(0, pthread_join(readers[i].thread, NULL));
+		TEST_ASSERT_FALSE(readers[i].usedFreed);
+		TEST_ASSERT_GREATER_THAN_UINT64(0, readers[i].acquired);
+	}
+
+	// Every reader has released: all the old configurations can be freed
+	TEST_ASSERT_EQUAL_UINT32(0, snap_rcuReclaim(&rcu));
+	TEST_ASSERT_EQUAL_UINT32(NUM_CONFIGS - 1U, freeCount);
+	TEST_ASSERT_FALSE(isFreed(NUM_CONFIGS - 1U));
+}
+
+/******************************** END OF FILE *********************************/
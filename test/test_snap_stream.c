@@ -0,0 +1,199 @@
+/**
+ * @file   test_snap_stream.c
+ * @author Lucas Jadilo
+ * @brief  Unit tests for the stream decoder module of the libSNAP library.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include "unity_fixture.h"
+#include "snap_stream.h"
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+typedef struct report_t
+{
+	uint64_t offset;
+	uint16_t size;
+	int8_t   status;
+} report_t;
+
+typedef struct reportList_t
+{
+	report_t reports[10];
+	size_t   count;
+} reportList_t;
+
+
+/******************************************************************************/
+/*  Function Definitions                                                      */
+/******************************************************************************/
+
+
+static void storeReport(void *context, const snap_frame_t *frame, const uint64_t offset)
+{
+	reportList_t *list = context;
+
+	TEST_ASSERT_LESS_THAN_size_t(sizeof(list->reports) / sizeof(list->reports[0]), list->count);
+	TEST_ASSERT_EQUAL_HEX8(SNAP_SYNC, frame->buffer[0]);
+
+	list->reports[list->count].offset = offset;
+	list->reports[list->count].size = frame->size;
+	list->reports[list->count].status = frame->status;
+	list->count++;
+}
+
+static void test_stream(const uint8_t *input,
+						const size_t inputSize,
+						const size_t chunkSize,
+						const report_t *expected,
+						const size_t expectedCount)
+{
+	static uint8_t buffer[SNAP_STREAM_MIN_SIZE_BUFFER];
+	snap_stream_t stream;
+	reportList_t list = {.count = 0};
+	size_t reported = 0;
+
+	TEST_ASSERT_EQUAL_INT16(0, snap_streamInit(&stream, buffer, sizeof(buffer)));
+
+	for(size_t i = 0; i < inputSize; i += chunkSize)
+	{
+		size_t space;
+		uint8_t *dest = snap_streamReserve(&stream, &space);
+		size_t size = (inputSize - i < chunkSize) ? (inputSize - i) : chunkSize;
+
+		TEST_ASSERT_GREATER_OR_EQUAL_size_t(size, space);
+
+		for(size_t j = 0; j < size; j++)
+		{
+			dest[j] = input[i + j];
+		}
+
+		reported += snap_streamProcess(&stream, size, storeReport, &list);
+	}
+
+	reported += snap_streamFinish(&stream, storeReport, &list);
+	TEST_ASSERT_EQUAL_size_t(0, stream.length);
+
+	TEST_ASSERT_EQUAL_size_t(expectedCount, reported);
+	TEST_ASSERT_EQUAL_size_t(expectedCount, list.count);
+	TEST_ASSERT_EQUAL_UINT64(inputSize, stream.stats.bytes);
+
+	for(size_t i = 0; i < expectedCount; i++)
+	{
+		TEST_ASSERT_EQUAL_UINT64(expected[i].offset, list.reports[i].offset);
+		TEST_ASSERT_EQUAL_UINT16(expected[i].size, list.reports[i].size);
+		TEST_ASSERT_EQUAL_INT8(expected[i].status, list.reports[i].status);
+	}
+}
+
+
+/******************************************************************************/
+/*  TEST GROUP: stream                                                        */
+/******************************************************************************/
+
+
+TEST_GROUP(stream);
+
+TEST_SETUP(stream) {}
+
+TEST_TEAR_DOWN(stream) {}
+
+TEST_GROUP_RUNNER(stream)
+{
+	RUN_TEST_CASE(stream, init_should_ReturnError_if_ArgumentsAreInvalid);
+	RUN_TEST_CASE(stream, process_should_ReportEveryFrameWithItsOffset_regardless_of_BlockSize);
+	RUN_TEST_CASE(stream, process_should_ResumeAfterSyncByte_when_FrameHasInvalidHash);
+	RUN_TEST_CASE(stream, process_should_KeepIncompleteFrame_until_NextBlock);
+	RUN_TEST_CASE(stream, finish_should_ReportHiddenFrames_when_StreamEndsInsideFalseFrame);
+}
+
+TEST(stream, init_should_ReturnError_if_ArgumentsAreInvalid)
+{
+	uint8_t buffer[SNAP_STREAM_MIN_SIZE_BUFFER];
+	snap_stream_t stream;
+
+	TEST_ASSERT_EQUAL_INT16(SNAP_ERROR_NULL_FRAME, snap_streamInit(NULL, buffer, sizeof(buffer)));
+	TEST_ASSERT_EQUAL_INT16(SNAP_ERROR_NULL_BUFFER, snap_streamInit(&stream, NULL, sizeof(buffer)));
+	TEST_ASSERT_EQUAL_INT16(SNAP_ERROR_SHORT_BUFFER, snap_streamInit(&stream, buffer, sizeof(buffer) - 1));
+	TEST_ASSERT_EQUAL_INT16(0, snap_streamInit(&stream, buffer, sizeof(buffer)));
+}
+
+TEST(stream, process_should_ReportEveryFrameWithItsOffset_regardless_of_BlockSize)
+{
+	// Preamble, frame (EDM=2, 14 bytes), frame (EDM=5, 141 bytes), frame (no hash, 3 bytes), postamble
+	uint8_t input[200] = {0x00, 0x11,
+						  SNAP_SYNC, 0xE1, 0x25, 0x99, 0x88, 0x77, 0xFE, 0xDC, 0xBA, 0x62, 0x63, 0x51, 0x84, 0xCC,
+						  SNAP_SYNC, 0xA8, 0x5C, 0x00, 0x01, 0x00, 0x02, 0x00, 0x03, 0xFF, 0xFF, 0xFF, [153] = 0x89, 0x58, 0x17, 0xA7,
+						  0x22, SNAP_SYNC, 0x01, 0x00, 0x33};
+	const report_t expected[] = {{2, 14, SNAP_STATUS_VALID}, {16, 141, SNAP_STATUS_VALID}, {158, 3, SNAP_STATUS_VALID}};
+
+	test_stream(input, 162, 1, expected, 3);
+	test_stream(input, 162, 13, expected, 3);
+	test_stream(input, 162, 100, expected, 3);
+	test_stream(input, 162, SNAP_STREAM_MIN_SIZE_BUFFER, expected, 3);
+}
+
+TEST(stream, process_should_ResumeAfterSyncByte_when_FrameHasInvalidHash)
+{
+	// False sync (EDM=4, bad hash) whose last bytes contain a complete valid frame (EDM=0, 3 bytes)
+	const uint8_t input[] = {0x00, SNAP_SYNC, 0x00, 0x40, SNAP_SYNC, 0x01, 0x00, 0x77};
+	const report_t expected[] = {{1, 5, SNAP_STATUS_ERROR_HASH}, {4, 3, SNAP_STATUS_VALID}};
+
+	test_stream(input, sizeof(input), 1, expected, 2);
+	test_stream(input, sizeof(input), 3, expected, 2);
+	test_stream(input, sizeof(input), sizeof(input), expected, 2);
+}
+
+TEST(stream, process_should_KeepIncompleteFrame_until_NextBlock)
+{
+	static uint8_t buffer[SNAP_STREAM_MIN_SIZE_BUFFER];
+	const uint8_t frame[] = {SNAP_SYNC, 0xE1, 0x25, 0x99, 0x88, 0x77, 0xFE, 0xDC, 0xBA, 0x62, 0x63, 0x51, 0x84, 0xCC};
+	snap_stream_t stream;
+	size_t space;
+	uint8_t *dest;
+
+	snap_streamInit(&stream, buffer, sizeof(buffer));
+
+	dest = snap_streamReserve(&stream, &space);
+	dest[0] = 0xFF;
+	for(size_t i = 0; i < 10; i++) dest[1 + i] = frame[i];
+
+	TEST_ASSERT_EQUAL_size_t(0, snap_streamProcess(&stream, 11, NULL, NULL));
+	TEST_ASSERT_EQUAL_size_t(10, stream.length);
+	TEST_ASSERT_EQUAL_UINT64(1, stream.offset);
+
+	dest = snap_streamReserve(&stream, &space);
+	TEST_ASSERT_EQUAL_PTR(&buffer[10], dest);
+	TEST_ASSERT_EQUAL_size_t(sizeof(buffer) - 10, space);
+	for(size_t i = 10; i < sizeof(frame); i++) dest[i - 10] = frame[i];
+
+	TEST_ASSERT_EQUAL_size_t(1, snap_streamProcess(&stream, sizeof(frame) - 10, NULL, NULL));
+	TEST_ASSERT_EQUAL_size_t(0, stream.length);
+	TEST_ASSERT_EQUAL_UINT64(15, stream.offset);
+	TEST_ASSERT_EQUAL_UINT64(1, stream.stats.validFrames);
+	TEST_ASSERT_EQUAL_UINT64(0, stream.stats.hashErrors);
+	TEST_ASSERT_EQUAL_UINT64(15, stream.stats.bytes);
+}
+
+TEST(stream, finish_should_ReportHiddenFrames_when_StreamEndsInsideFalseFrame)
+{
+	// False sync (EDM=7, never completed) hiding a valid frame (EDM=0, 3 bytes), then another false sync hiding another one
+	const uint8_t input[] = {SNAP_SYNC, 0xFC, 0x5E, SNAP_SYNC, 0x00, 0x00, 0x11, SNAP_SYNC, 0xE1, SNAP_SYNC, 0x01, 0x00, 0x22};
+	const report_t expected[] = {{3, 3, SNAP_STATUS_VALID}, {9, 3, SNAP_STATUS_VALID}};
+
+	test_stream(input, sizeof(input), 1, expected, 2);
+	test_stream(input, sizeof(input), 4, expected, 2);
+	test_stream(input, sizeof(input), sizeof(input), expected, 2);
+	test_stream(input, 1, 1, NULL, 0);
+}
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,255 @@
+/**
+ * @file   test_snap_tx.c
+ * @author Lucas Jadilo
+ * @brief  Unit tests for the transmit ring of the SNAP tools.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include "unity_fixture.h"
+#include "snap_tx.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define NUM_SLOTS		(32U)
+#define NUM_FRAMES		(300U)
+#define SIZE_PIPE		(4096U)		// Smaller than a full ring, so writev() is cut short
+#define SIZE_STREAM		(NUM_FRAMES * SNAP_MAX_SIZE_FRAME)
+
+
+/******************************************************************************/
+/*  Variables                                                                 */
+/******************************************************************************/
+
+
+static snap_tx_t tx;
+static int fds[2];
+static uint8_t expected[SIZE_STREAM];
+static uint8_t received[SIZE_STREAM];
+static size_t expectedSize;
+static size_t receivedSize;
+
+
+/******************************************************************************/
+/*  Function Definitions                                                      */
+/******************************************************************************/
+
+
+// Frame bytes that depend on the frame number and on their position, with sizes from 1 to the maximum
+static void submit(const uint32_t number)
+{
+	snap_frame_t *frame = snap_txAcquire(&tx);
+
+	TEST_ASSERT_NOT_NULL(frame);
+	TEST_ASSERT_EQUAL_UINT16(0, frame->size);
+	frame->size = (uint16_t)(1U + (number * 37U) % SNAP_MAX_SIZE_FRAME);
+
+	for(uint_fast16_t i = 0; i < frame->size; i++)
+	{
+		frame->buffer[i] = (uint8_t)(number + i * 13U);
+	}
+
+	TEST_ASSERT_LESS_OR_EQUAL_size_t(sizeof(expected), expectedSize + frame->size);
+	memcpy(&expected[expectedSize], frame->buffer, frame->size);
+	expectedSize += frame->size;
+	snap_txSubmit(&tx);
+}
+
+// Read what the pipe holds, up to a limit (nothing if it is empty and non-blocking)
+static void drain(const size_t limit)
+{
+	const size_t room = sizeof(received) - receivedSize;
+	const ssize_t ret = read(fds[0], &received[receivedSize], (limit < room) ? limit : room);
+
+	if(ret < 0)
+	{
+		TEST_ASSERT_EQUAL_INT(EAGAIN, errno);
+		return;
+	}
+
+	receivedSize += (size_t)ret;
+}
+
+static void checkStream(void)
+{
+	TEST_ASSERT_EQUAL_size_t(expectedSize, receivedSize);
+	TEST_ASSERT_EQUAL_MEMORY(expected, received, expectedSize);
+	TEST_ASSERT_EQUAL_UINT64(expectedSize, tx.bytesSent);
+	TEST_ASSERT_EQUAL_UINT32(0, snap_txPending(&tx));
+	TEST_ASSERT_EQUAL_size_t(0, tx.offset);
+}
+
+
+/******************************************************************************/
+/*  TEST GROUP: tx                                                            */
+/******************************************************************************/
+
+
+TEST_GROUP(tx);
+
+TEST_SETUP(tx)
+{
+	TEST_ASSERT_EQUAL_INT(0, pipe2(fds, O_CLOEXEC));
+	TEST_ASSERT_EQUAL_INT(0, snap_txInit(&tx, fds[1], NUM_SLOTS));
+	expectedSize = 0;
+	receivedSize = 0;
+}
+
+TEST_TEAR_DOWN(tx)
+{
+	snap_txDestroy(&tx);
+	close(fds[0]);
+	close(fds[1]);
+}
+
+TEST_GROUP_RUNNER(tx)
+{
+	RUN_TEST_CASE(tx, init_should_ReturnError_if_SlotCountIsInvalid);
+	RUN_TEST_CASE(tx, acquire_should_ReturnNull_when_RingIsFull);
+	RUN_TEST_CASE(tx, flush_should_SendBatches_when_ManySlotsAreSubmitted);
+	RUN_TEST_CASE(tx, flush_should_ResumePartialWrite_when_DescriptorIsNonBlocking);
+	RUN_TEST_CASE(tx, flush_should_KeepSlots_if_WriteFails);
+}
+
+TEST(tx, init_should_ReturnError_if_SlotCountIsInvalid)
+{
+	snap_tx_t other;
+
+	errno = 0;
+	TEST_ASSERT_EQUAL_INT(-1, snap_txInit(&other, fds[1], 0));
+	TEST_ASSERT_EQUAL_INT(EINVAL, errno);
+	errno = 0;
+	TEST_ASSERT_EQUAL_INT(-1, snap_txInit(&other, fds[1], (1U << 20) + 1U));
+	TEST_ASSERT_EQUAL_INT(EINVAL, errno);
+
+	TEST_ASSERT_EQUAL_INT(0, snap_txInit(&other, fds[1], 5));
+	TEST_ASSERT_EQUAL_UINT32(7, other.mask);
+	snap_txDestroy(&other);
+}
+
+TEST(tx, acquire_should_ReturnNull_when_RingIsFull)
+{
+	// The same slot is lent until it is submitted
+	snap_frame_t *frame = snap_txAcquire(&tx);
+	TEST_ASSERT_NOT_NULL(frame);
+	frame->size = 5;
+	TEST_ASSERT_EQUAL_PTR(frame, snap_txAcquire(&tx));
+	TEST_ASSERT_EQUAL_UINT16(0, frame->size);
+
+	for(uint32_t number = 0; number < NUM_SLOTS; number++)
+	{
+		submit(number);
+		TEST_ASSERT_EQUAL_UINT32(number + 1U, snap_txPending(&tx));
+	}
+
+	TEST_ASSERT_NULL(snap_txAcquire(&tx));
+	TEST_ASSERT_EQUAL_UINT32(NUM_SLOTS, snap_txPending(&tx));
+	TEST_ASSERT_EQUAL_UINT64(0, tx.calls);
+
+	TEST_ASSERT_EQUAL_INT(0, snap_txFlush(&tx));
+	TEST_ASSERT_EQUAL_UINT64(1, tx.calls);
+	TEST_ASSERT_EQUAL_PTR(frame, snap_txAcquire(&tx));		// Back to the first slot
+	drain(sizeof(received));
+	checkStream();
+}
+
+TEST(tx, flush_should_SendBatches_when_ManySlotsAreSubmitted)
+{
+	snap_txDestroy(&tx);
+	TEST_ASSERT_EQUAL_INT(0, snap_txInit(&tx, fds[1], 2U * SNAP_TX_MAX_BATCH));
+	TEST_ASSERT_GREATER_OR_EQUAL_INT(2U * SNAP_MAX_SIZE_FRAME * SNAP_TX_MAX_BATCH, fcntl(fds[1], F_SETPIPE_SZ, 2U * SNAP_MAX_SIZE_FRAME * SNAP_TX_MAX_BATCH));
+
+	for(uint32_t number = 0; number < SNAP_TX_MAX_BATCH + 10U; number++)
+	{
+		submit(number);
+	}
+
+	TEST_ASSERT_EQUAL_INT(0, snap_txFlush(&tx));
+	TEST_ASSERT_EQUAL_UINT64(2, tx.calls);
+	TEST_ASSERT_EQUAL_UINT64(SNAP_TX_MAX_BATCH + 10U, tx.framesSent);
+	TEST_ASSERT_EQUAL_INT(0, snap_txFlush(&tx));		// Nothing left
+	TEST_ASSERT_EQUAL_UINT64(2, tx.calls);
+	drain(sizeof(received));
+	checkStream();
+}
+
+TEST(tx, flush_should_ResumePartialWrite_when_DescriptorIsNonBlocking)
+{
+	uint64_t splits = 0, blocked = 0;
+	uint32_t number = 0;
+
+	TEST_ASSERT_EQUAL_INT(SIZE_PIPE, fcntl(fds[1], F_SETPIPE_SZ, SIZE_PIPE));
+	TEST_ASSERT_EQUAL_INT(0, fcntl(fds[1], F_SETFL, O_NONBLOCK));
+	TEST_ASSERT_EQUAL_INT(0, fcntl(fds[0], F_SETFL, O_NONBLOCK));
+
+	// The first call fills the pipe and stops in the middle of a frame
+	while(snap_txAcquire(&tx) != NULL)
+	{
+		submit(number++);
+	}
+
+	errno = 0;
+	TEST_ASSERT_EQUAL_INT(-1, snap_txFlush(&tx));
+	TEST_ASSERT_EQUAL_INT(EAGAIN, errno);
+	TEST_ASSERT_EQUAL_UINT64(SIZE_PIPE, tx.bytesSent);
+	TEST_ASSERT_NOT_EQUAL(0, tx.offset);
+	TEST_ASSERT_GREATER_THAN_UINT32(0, snap_txPending(&tx));
+
+	// Then the pipe is read in small pieces, while more frames are submitted and the ring wraps around
+	while((number < NUM_FRAMES) || (snap_txPending(&tx) > 0))
+	{
+		while((number < NUM_FRAMES) && (snap_txAcquire(&tx) != NULL))
+		{
+			submit(number++);
+		}
+
+		if(snap_txFlush(&tx) < 0)
+		{
+			TEST_ASSERT_EQUAL_INT(EAGAIN, errno);
+			blocked++;
+		}
+
+		splits += (tx.offset != 0);
+		drain(1 + (number * 97U) % 1500U);
+	}
+
+	drain(sizeof(received));
+	checkStream();
+	TEST_ASSERT_EQUAL_UINT64(NUM_FRAMES, tx.framesSent);
+	TEST_ASSERT_GREATER_THAN_UINT64(NUM_FRAMES / 10U, splits);
+	TEST_ASSERT_GREATER_THAN_UINT64(NUM_FRAMES / 10U, blocked);
+}
+
+TEST(tx, flush_should_KeepSlots_if_WriteFails)
+{
+	submit(1);
+	submit(2);
+	tx.fd = -1;
+
+	errno = 0;
+	TEST_ASSERT_EQUAL_INT(-1, snap_txFlush(&tx));
+	TEST_ASSERT_EQUAL_INT(EBADF, errno);
+	TEST_ASSERT_EQUAL_UINT32(2, snap_txPending(&tx));
+	TEST_ASSERT_EQUAL_UINT64(0, tx.bytesSent);
+
+	// Nothing was lost: the slots are sent once the descriptor can be written
+	tx.fd = fds[1];
+	TEST_ASSERT_EQUAL_INT(0, snap_txFlush(&tx));
+	drain(sizeof(received));
+	checkStream();
+}
+
+/******************************** END OF FILE *********************************/
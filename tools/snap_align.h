@@ -0,0 +1,29 @@
+/**
+ * @file   snap_align.h
+ * @author Lucas Jadilo
+ * @brief  Cache line alignment of the shared memory areas of the tools (private, not installed with the libraries).
+ */
+
+#ifndef SNAP_ALIGN_H_
+#define SNAP_ALIGN_H_
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include <stddef.h>
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define CACHE_LINE	(64U)	// Size of a cache line, so that the data written by different threads never shares one
+#define ALIGN(size)	(((size) + CACHE_LINE - 1U) & ~(size_t)(CACHE_LINE - 1U))	// Size rounded up to whole cache lines
+
+#endif	// SNAP_ALIGN_H_
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,719 @@
+/**
+ * @file   snap_capture.c
+ * @author Lucas Jadilo
+ * @brief  Capture files: timestamped SNAP frames recorded from one or more channels.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "snap_capture.h"
+#include "snap_lz.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define WRITER_BUFFER_SIZE	(1U << 20)
+#define MAX_SIZE_RECORD		(SNAP_CAPTURE_SIZE_RECORD + SNAP_MAX_SIZE_FRAME)
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+typedef struct decompression_t
+{
+	const uint8_t *file;		// Mapped compressed file.
+	const uint8_t *table;		// Block table inside the file.
+	uint8_t       *data;		// Decompressed records (same layout as an uncompressed file).
+	const size_t  *offsets;		// Offset of each block in the decompressed records.
+	uint8_t       *loaded;		// Set for each block decompressed without error.
+	size_t        end;			// Block after the last one to decompress.
+	size_t        next;			// Next block to decompress (shared by the threads).
+} decompression_t;
+
+
+/******************************************************************************/
+/*  Private Variables                                                         */
+/******************************************************************************/
+
+
+static const uint8_t magic[8] = {'S', 'N', 'A', 'P', 'C', 'A', 'P', '\0'};
+
+
+/******************************************************************************/
+/*  Private Functions                                                         */
+/******************************************************************************/
+
+
+static void putLe(uint8_t *p, uint64_t value, const uint_fast8_t size)
+{
+	for(uint_fast8_t i = 0; i < size; i++)
+	{
+		p[i] = (uint8_t)value;
+		value >>= 8;
+	}
+}
+
+static uint64_t getLe(const uint8_t *p, const uint_fast8_t size)
+{
+	uint64_t value = 0;
+
+	for(uint_fast8_t i = size; i != 0; i--)
+	{
+		value = (value << 8) | p[i - 1];
+	}
+
+	return value;
+}
+
+static int openFile(snap_captureWriter_t *writer, const char *path, const uint16_t version, const uint32_t blockSize)
+{
+	uint8_t header[SNAP_CAPTURE_SIZE_HEADER] = {0};
+
+	writer->records = 0;
+	writer->size = 0;
+	writer->file = fopen(path, "wb");
+
+	if(writer->file == NULL)
+	{
+		return -1;
+	}
+
+	setvbuf(writer->file, NULL, _IOFBF, WRITER_BUFFER_SIZE);
+
+	memcpy(header, magic, sizeof(magic));
+	putLe(&header[8], version, 2);
+	putLe(&header[12], blockSize, 4);
+
+	if(fwrite(header, sizeof(header), 1, writer->file) != 1)
+	{
+		fclose(writer->file);
+		writer->file = NULL;
+		return -1;
+	}
+
+	writer->size = sizeof(header);
+	return 0;
+}
+
+static int writeBlock(snap_captureWriter_t *writer)
+{
+	if(writer->blocks == writer->tableSize)
+	{
+		const size_t size = (writer->tableSize != 0) ? writer->tableSize * 2U : 64U;
+		uint8_t *table = realloc(writer->table, size * SNAP_CAPTURE_SIZE_BLOCK);
+
+		if(table == NULL)
+		{
+			return -1;
+		}
+
+		writer->table = table;
+		writer->tableSize = size;
+	}
+
+	// A block that does not shrink is stored as is (compressed size = uncompressed size).
+	size_t size = snap_lzCompress(writer->block, writer->length, writer->packed);
+	const uint8_t *data = writer->packed;
+
+	if(size >= writer->length)
+	{
+		size = writer->length;
+		data = writer->block;
+	}
+
+	if(fwrite(data, 1, size, writer->file) != size)
+	{
+		return -1;
+	}
+
+	uint8_t *entry = &writer->table[writer->blocks * SNAP_CAPTURE_SIZE_BLOCK];
+
+	putLe(&entry[0], writer->offset, 8);
+	putLe(&entry[8], size, 4);
+	putLe(&entry[12], writer->length, 4);
+	putLe(&entry[16], writer->firstRecord, 8);
+
+	writer->blocks++;
+	writer->offset += size;
+	writer->firstRecord = writer->records;
+	writer->length = 0;
+	return 0;
+}
+
+static int closeCompressed(snap_captureWriter_t *writer)
+{
+	uint8_t trailer[SNAP_CAPTURE_SIZE_TRAILER];
+	int ret = 0;
+
+	if((writer->length != 0) && (writeBlock(writer) < 0))
+	{
+		ret = -1;
+	}
+
+	putLe(&trailer[0], writer->offset, 8);
+	putLe(&trailer[8], writer->blocks, 8);
+
+	if((ret == 0) &&
+	   ((fwrite(writer->table, SNAP_CAPTURE_SIZE_BLOCK, writer->blocks, writer->file) != writer->blocks) ||
+		(fwrite(trailer, sizeof(trailer), 1, writer->file) != 1)))
+	{
+		ret = -1;
+	}
+
+	free(writer->block);
+	free(writer->packed);
+	free(writer->table);
+	writer->block = NULL;
+	writer->packed = NULL;
+	writer->table = NULL;
+	return ret;
+}
+
+static void *decompressBlocks(void *argument)
+{
+	decompression_t *job = argument;
+	size_t i;
+
+	while((i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->end)
+	{
+		const uint8_t *entry = &job->table[i * SNAP_CAPTURE_SIZE_BLOCK];
+		const uint8_t *source = &job->file[getLe(&entry[0], 8)];
+		const size_t size = (size_t)getLe(&entry[8], 4);
+		size_t rawSize = (size_t)getLe(&entry[12], 4);
+		uint8_t *destination = &job->data[job->offsets[i]];
+
+		if(size == rawSize)
+		{
+			memcpy(destination, source, size);
+			job->loaded[i] = 1;
+		}
+		else if((snap_lzDecompress(source, size, destination, &rawSize) == 0) && (rawSize == getLe(&entry[12], 4)))
+		{
+			job->loaded[i] = 1;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Decompress a block, and the next ones not decompressed yet in parallel (one per CPU), since a block is most
+ * often needed because the records are read in order.
+ */
+static int loadBlocks(snap_captureReader_t *reader, const size_t first)
+{
+	const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	decompression_t job = {.file = reader->file, .table = &reader->file[reader->tableOffset], .data = (uint8_t *)(uintptr_t)reader->data,
+						   .offsets = reader->blockOffsets, .loaded = reader->loaded, .end = first + 1U, .next = first};
+	pthread_t threads[SNAP_CAPTURE_MAX_THREADS];
+	size_t count = 0;
+
+	while((job.end < reader->blocks) && (job.end - first < (size_t)cpus) && (job.end - first < SNAP_CAPTURE_MAX_THREADS) && !reader->loaded[job.end])
+	{
+		job.end++;
+	}
+
+	// The calling thread works too, so one thread is enough on a single CPU.
+	while((count + 1U < job.end - first) && (pthread_create(&threads[count], NULL, decompressBlocks, &job) == 0))
+	{
+		count++;
+	}
+
+	decompressBlocks(&job);
+
+	while(count != 0)
+	{
+		pthread_join(threads[--count], NULL);
+	}
+
+	if(!reader->loaded[first])
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Make sure that the record at an offset is in memory: decompress its block if needed (compressed files).
+ */
+static int loadRecord(snap_captureReader_t *reader, const size_t pos)
+{
+	size_t block = reader->block;
+
+	if(reader->blocks == 0)
+	{
+		return 0;
+	}
+
+	if((pos < reader->blockOffsets[block]) || (pos >= reader->blockOffsets[block + 1U]))
+	{
+		size_t low = 0, high = reader->blocks;
+
+		// Last block that starts before the offset.
+		while(high - low > 1U)
+		{
+			const size_t middle = low + (high - low) / 2U;
+
+			if(reader->blockOffsets[middle] <= pos)
+			{
+				low = middle;
+			}
+			else
+			{
+				high = middle;
+			}
+		}
+
+		block = low;
+		reader->block = block;
+	}
+
+	return reader->loaded[block] ? 0 : loadBlocks(reader, block);
+}
+
+static int openCompressed(snap_captureReader_t *reader, const uint8_t *file, const size_t fileSize)
+{
+	if(fileSize < SNAP_CAPTURE_SIZE_HEADER + SNAP_CAPTURE_SIZE_TRAILER)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	const uint64_t tableOffset = getLe(&file[fileSize - SNAP_CAPTURE_SIZE_TRAILER], 8);
+	const uint64_t blocks = getLe(&file[fileSize - SNAP_CAPTURE_SIZE_TRAILER + 8], 8);
+
+	if((tableOffset < SNAP_CAPTURE_SIZE_HEADER) || (tableOffset > fileSize - SNAP_CAPTURE_SIZE_TRAILER) ||
+	   (blocks != (fileSize - SNAP_CAPTURE_SIZE_TRAILER - tableOffset) / SNAP_CAPTURE_SIZE_BLOCK) ||
+	   ((fileSize - SNAP_CAPTURE_SIZE_TRAILER - tableOffset) % SNAP_CAPTURE_SIZE_BLOCK != 0))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	reader->blocks = (size_t)blocks;
+	reader->blockOffsets = malloc((reader->blocks + 1U) * sizeof(reader->blockOffsets[0]));
+	reader->blockRecords = malloc((reader->blocks + 1U) * sizeof(reader->blockRecords[0]));
+
+	if((reader->blockOffsets == NULL) || (reader->blockRecords == NULL))
+	{
+		return -1;
+	}
+
+	// Check the whole table before decompressing anything: blocks inside the file, records in order.
+	const uint8_t *table = &file[tableOffset];
+	size_t size = SNAP_CAPTURE_SIZE_HEADER;
+
+	for(size_t i = 0; i < reader->blocks; i++)
+	{
+		const uint8_t *entry = &table[i * SNAP_CAPTURE_SIZE_BLOCK];
+		const uint64_t offset = getLe(&entry[0], 8);
+		const uint64_t packedSize = getLe(&entry[8], 4);
+		const uint64_t rawSize = getLe(&entry[12], 4);
+
+		reader->blockOffsets[i] = size;
+		reader->blockRecords[i] = getLe(&entry[16], 8);
+
+		if((offset < SNAP_CAPTURE_SIZE_HEADER) || (offset > tableOffset) || (packedSize > tableOffset - offset) ||
+		   (packedSize > rawSize) || (rawSize > SIZE_MAX - size) ||
+		   ((i != 0) && (reader->blockRecords[i] < reader->blockRecords[i - 1])))
+		{
+			errno = EINVAL;
+			return -1;
+		}
+
+		size += (size_t)rawSize;
+	}
+
+	reader->blockOffsets[reader->blocks] = size;
+	reader->loaded = calloc(reader->blocks + 1U, 1);
+
+	if(reader->loaded == NULL)
+	{
+		return -1;
+	}
+
+	// Only the pages of the blocks decompressed later are ever touched.
+	void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+	if(data == MAP_FAILED)
+	{
+		return -1;
+	}
+
+	memcpy(data, file, SNAP_CAPTURE_SIZE_HEADER);
+	putLe(&((uint8_t *)data)[8], SNAP_CAPTURE_VERSION, 2);
+
+	reader->file = file;
+	reader->fileSize = fileSize;
+	reader->tableOffset = (size_t)tableOffset;
+	reader->data = data;
+	reader->size = size;
+	return 0;
+}
+
+
+/******************************************************************************/
+/*  Public Functions                                                          */
+/******************************************************************************/
+
+
+/**
+ * @brief Get the current time in the format used by capture records.
+ * @return Nanoseconds since the Unix epoch.
+ */
+uint64_t snap_captureTime(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	return (uint64_t)now.tv_sec * 1000000000U + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * @brief Create a capture file and write its header.
+ * @param[out] writer Pointer to the writer structure.
+ * @param[in]  path   Path of the file (it is truncated if it exists).
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set).
+ */
+int snap_captureWriterOpen(snap_captureWriter_t *writer, const char *path)
+{
+	writer->block = NULL;
+	return openFile(writer, path, SNAP_CAPTURE_VERSION, 0);
+}
+
+/**
+ * @brief Create a compressed capture file and write its header.
+ * @param[out] writer    Pointer to the writer structure.
+ * @param[in]  path      Path of the file (it is truncated if it exists).
+ * @param[in]  blockSize Minimum uncompressed size of a block (1 to #SNAP_CAPTURE_MAX_BLOCK). Larger blocks
+ *                       compress better; smaller blocks make seeks cheaper.
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set).
+ */
+int snap_captureWriterOpenCompressed(snap_captureWriter_t *writer, const char *path, const uint32_t blockSize)
+{
+	writer->block = NULL;
+
+	if((blockSize == 0) || (blockSize > SNAP_CAPTURE_MAX_BLOCK))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	writer->block = malloc(blockSize + MAX_SIZE_RECORD);
+	writer->packed = malloc(SNAP_LZ_BOUND(blockSize + MAX_SIZE_RECORD));
+	writer->table = NULL;
+	writer->length = 0;
+	writer->blocks = 0;
+	writer->tableSize = 0;
+	writer->offset = SNAP_CAPTURE_SIZE_HEADER;
+	writer->firstRecord = 0;
+	writer->blockSize = blockSize;
+
+	if((writer->block == NULL) || (writer->packed == NULL) ||
+	   (openFile(writer, path, SNAP_CAPTURE_VERSION_COMPRESSED, blockSize) < 0))
+	{
+		free(writer->block);
+		free(writer->packed);
+		writer->block = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Append a frame to the capture file.
+ * @param[in,out] writer    Pointer to the writer structure.
+ * @param[in]     timestamp Nanoseconds since the Unix epoch (see snap_captureTime()).
+ * @param[in]     channel   Channel number.
+ * @param[in]     frame     Pointer to the frame structure. All the bytes stored in the frame are written, whatever the status.
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set).
+ */
+int snap_captureWrite(snap_captureWriter_t *writer, const uint64_t timestamp, const uint16_t channel, const snap_frame_t *frame)
+{
+	uint8_t header[SNAP_CAPTURE_SIZE_RECORD] = {0};
+
+	putLe(&header[0], timestamp, 8);
+	putLe(&header[8], channel, 2);
+	putLe(&header[10], frame->size, 2);
+	header[12] = (uint8_t)frame->status;
+
+	if(writer->block != NULL)
+	{
+		memcpy(&writer->block[writer->length], header, sizeof(header));
+		memcpy(&writer->block[writer->length + sizeof(header)], frame->buffer, frame->size);
+		writer->length += sizeof(header) + frame->size;
+		writer->records++;
+		writer->size += sizeof(header) + frame->size;
+		return (writer->length >= writer->blockSize) ? writeBlock(writer) : 0;
+	}
+
+	if((fwrite(header, sizeof(header), 1, writer->file) != 1) ||
+	   (fwrite(frame->buffer, 1, frame->size, writer->file) != frame->size))
+	{
+		return -1;
+	}
+
+	writer->records++;
+	writer->size += sizeof(header) + frame->size;
+	return 0;
+}
+
+/**
+ * @brief Flush and close the capture file.
+ * @param[in,out] writer Pointer to the writer structure.
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set).
+ */
+int snap_captureWriterClose(snap_captureWriter_t *writer)
+{
+	const int ret = (writer->block != NULL) ? closeCompressed(writer) : 0;
+	const int closed = fclose(writer->file);
+	writer->file = NULL;
+	return (ret || closed) ? -1 : 0;
+}
+
+/**
+ * @brief Open a capture file for reading and check its header.
+ * @details Compressed files are only checked here: each block is decompressed when a record in it is first
+ *          read (see snap_captureRead()).
+ * @param[out] reader Pointer to the reader structure.
+ * @param[in]  path   Path of the file.
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set; EINVAL means the file is not a capture file).
+ */
+int snap_captureReaderOpen(snap_captureReader_t *reader, const char *path)
+{
+	struct stat info;
+	const int fd = open(path, O_RDONLY);
+
+	if(fd < 0)
+	{
+		return -1;
+	}
+
+	if(fstat(fd, &info) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	if((size_t)info.st_size < SNAP_CAPTURE_SIZE_HEADER)
+	{
+		close(fd);
+		errno = EINVAL;
+		return -1;
+	}
+
+	void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if(data == MAP_FAILED)
+	{
+		return -1;
+	}
+
+	madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+
+	reader->data = data;
+	reader->size = (size_t)info.st_size;
+	reader->pos = SNAP_CAPTURE_SIZE_HEADER;
+	reader->blockOffsets = NULL;
+	reader->blockRecords = NULL;
+	reader->blocks = 0;
+	reader->file = NULL;
+	reader->fileSize = 0;
+	reader->tableOffset = 0;
+	reader->loaded = NULL;
+	reader->block = 0;
+
+	if(memcmp(reader->data, magic, sizeof(magic)) != 0)
+	{
+		snap_captureReaderClose(reader);
+		errno = EINVAL;
+		return -1;
+	}
+
+	switch(getLe(&reader->data[8], 2))
+	{
+		case SNAP_CAPTURE_VERSION:
+			return 0;
+		case SNAP_CAPTURE_VERSION_COMPRESSED:
+		{
+			const int ret = openCompressed(reader, data, (size_t)info.st_size);
+			const int error = errno;
+
+			if(ret < 0)
+			{
+				munmap(data, (size_t)info.st_size);
+				reader->data = NULL;
+				snap_captureReaderClose(reader);
+				errno = error;
+			}
+
+			return ret;
+		}
+		default:
+			snap_captureReaderClose(reader);
+			errno = EINVAL;
+			return -1;
+	}
+}
+
+/**
+ * @brief Read the next record of the capture file.
+ * @details In compressed files, the block of the record is decompressed the first time one of its records
+ *          is read or sought, together with the next blocks not decompressed yet (in parallel). The blocks
+ *          skipped by snap_captureSeek() or by moving the read position are never decompressed.
+ * @param[in,out] reader Pointer to the reader structure.
+ * @param[out]    record Pointer to the record structure. The frame bytes are not copied, and stay valid until
+ *                       the reader is closed.
+ * @retval 1  A record was read.
+ * @retval 0  End of file.
+ * @retval -1 Error: the file is truncated or corrupted, or the block cannot be decompressed (errno is set
+ *            to EINVAL).
+ */
+int snap_captureRead(snap_captureReader_t *reader, snap_captureRecord_t *record)
+{
+	if(reader->pos == reader->size)
+	{
+		return 0;
+	}
+
+	if((reader->size - reader->pos < SNAP_CAPTURE_SIZE_RECORD) || (loadRecord(reader, reader->pos) < 0))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	const uint8_t *header = &reader->data[reader->pos];
+
+	record->timestamp = getLe(&header[0], 8);
+	record->channel = (uint16_t)getLe(&header[8], 2);
+	record->size = (uint16_t)getLe(&header[10], 2);
+	record->status = (int8_t)header[12];
+	record->bytes = &header[SNAP_CAPTURE_SIZE_RECORD];
+
+	if((record->size > SNAP_MAX_SIZE_FRAME) || (reader->size - reader->pos - SNAP_CAPTURE_SIZE_RECORD < record->size))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	reader->pos += SNAP_CAPTURE_SIZE_RECORD + record->size;
+	return 1;
+}
+
+/**
+ * @brief Move the reader to a record, so that the next call to snap_captureRead() returns it.
+ * @details The records are skipped from the start of the block that contains the record (compressed files),
+ *          or from the start of the file.
+ * @param[in,out] reader Pointer to the reader structure.
+ * @param[in]     record Number of the record (0 = first). The number of records moves the reader to the end.
+ * @retval 0  Success.
+ * @retval -1 The file has fewer records, or is corrupted (errno is set to EINVAL). The reader does not move.
+ */
+int snap_captureSeek(snap_captureReader_t *reader, const uint64_t record)
+{
+	size_t pos = SNAP_CAPTURE_SIZE_HEADER;
+	uint64_t count = record;
+
+	if((reader->blocks != 0) && (record >= reader->blockRecords[0]))
+	{
+		size_t low = 0, high = reader->blocks;
+
+		// Last block whose first record is not after the record.
+		while(high - low > 1U)
+		{
+			const size_t middle = low + (high - low) / 2U;
+
+			if(reader->blockRecords[middle] <= record)
+			{
+				low = middle;
+			}
+			else
+			{
+				high = middle;
+			}
+		}
+
+		pos = reader->blockOffsets[low];
+		count = record - reader->blockRecords[low];
+	}
+
+	for(; count != 0; count--)
+	{
+		if((reader->size - pos < SNAP_CAPTURE_SIZE_RECORD) || (loadRecord(reader, pos) < 0))
+		{
+			errno = EINVAL;
+			return -1;
+		}
+
+		const size_t size = SNAP_CAPTURE_SIZE_RECORD + (size_t)getLe(&reader->data[pos + 10], 2);
+
+		if(reader->size - pos < size)
+		{
+			errno = EINVAL;
+			return -1;
+		}
+
+		pos += size;
+	}
+
+	reader->pos = pos;
+	return 0;
+}
+
+/**
+ * @brief Unmap the capture file (or free the decompressed records).
+ * @param[in,out] reader Pointer to the reader structure.
+ */
+void snap_captureReaderClose(snap_captureReader_t *reader)
+{
+	if(reader->data != NULL)
+	{
+		munmap((void *)(uintptr_t)reader->data, reader->size);
+	}
+
+	if(reader->file != NULL)
+	{
+		munmap((void *)(uintptr_t)reader->file, reader->fileSize);
+	}
+
+	free(reader->blockOffsets);
+	free(reader->blockRecords);
+	free(reader->loaded);
+	reader->file = NULL;
+	reader->loaded = NULL;
+	reader->data = NULL;
+	reader->size = 0;
+	reader->pos = 0;
+	reader->blockOffsets = NULL;
+	reader->blockRecords = NULL;
+	reader->blocks = 0;
+}
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,145 @@
+/**
+ * @file   snap_capture.h
+ * @author Lucas Jadilo
+ * @brief  Capture files: timestamped SNAP frames recorded from one or more channels.
+ * @details File layout (all integers are little-endian):
+ *          | Offset | Size | Content                                  |
+ *          |:------:|:----:|:-----------------------------------------|
+ *          | 0      | 8    | Magic "SNAPCAP\0"                        |
+ *          | 8      | 2    | Format version (#SNAP_CAPTURE_VERSION)   |
+ *          | 10     | 2    | Flags (reserved, zero)                   |
+ *          | 12     | 4    | Block size (compressed files, else zero) |
+ *          | 16     | ...  | Records                                  |
+ *
+ *          Each record has a 16-byte header followed by the frame bytes (starting with the sync byte):
+ *          | Offset | Size | Content                                          |
+ *          |:------:|:----:|:-------------------------------------------------|
+ *          | 0      | 8    | Timestamp (nanoseconds since the Unix epoch)     |
+ *          | 8      | 2    | Channel number                                   |
+ *          | 10     | 2    | Number of frame bytes                            |
+ *          | 12     | 1    | Frame status (#snap_status_t)                    |
+ *          | 13     | 3    | Reserved (zero)                                  |
+ *
+ *          Compressed files (version #SNAP_CAPTURE_VERSION_COMPRESSED) store the same records in blocks of at
+ *          least the block size (records are never split), each compressed on its own with snap_lz.h, or stored
+ *          as is when it does not shrink. The blocks are followed by a table of #SNAP_CAPTURE_SIZE_BLOCK bytes per
+ *          block (u64 file offset, u32 compressed size, u32 uncompressed size, u64 number of the first record)
+ *          and by a 16-byte trailer (u64 offset of the table, u64 number of blocks).
+ *
+ *          The reader decompresses the blocks into memory laid out like an uncompressed file, so record
+ *          offsets (e.g. in capture indexes) are the same for both versions. A block is decompressed only when
+ *          one of its records is first read, together with the next ones in parallel, so the blocks passed over
+ *          by a seek (found with the block table) or by a range skipped with a capture index are never
+ *          decompressed, and their pages of that memory are never touched.
+ */
+
+#ifndef SNAP_CAPTURE_H_
+#define SNAP_CAPTURE_H_
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include <stdio.h>
+#include "snap.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define SNAP_CAPTURE_VERSION		(1U)	/**< @brief Version written in the file header. */
+#define SNAP_CAPTURE_SIZE_HEADER	(16U)	/**< @brief Size of the file header. */
+#define SNAP_CAPTURE_SIZE_RECORD	(16U)	/**< @brief Size of the record header. */
+
+#define SNAP_CAPTURE_VERSION_COMPRESSED	(2U)				/**< @brief Version of compressed files. */
+#define SNAP_CAPTURE_SIZE_BLOCK			(24U)				/**< @brief Size of a block table entry. */
+#define SNAP_CAPTURE_SIZE_TRAILER		(16U)				/**< @brief Size of the trailer of compressed files. */
+#define SNAP_CAPTURE_MAX_BLOCK			(64U * 1024U * 1024U)	/**< @brief Largest block size of compressed files. */
+#define SNAP_CAPTURE_MAX_THREADS		(16U)				/**< @brief Maximum number of decompression threads. */
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+/**
+ * @brief Record read from a capture file.
+ */
+typedef struct snap_captureRecord_t
+{
+	uint64_t      timestamp;	/**< @brief Nanoseconds since the Unix epoch. */
+	const uint8_t *bytes;		/**< @brief Pointer to the frame bytes (inside the mapped file). */
+	uint16_t      channel;		/**< @brief Channel number. */
+	uint16_t      size;			/**< @brief Number of frame bytes. */
+	int8_t        status;		/**< @brief Frame status (#snap_status_t). */
+} snap_captureRecord_t;
+
+/**
+ * @brief Buffered capture writer.
+ */
+typedef struct snap_captureWriter_t
+{
+	FILE     *file;			/**< @brief Output file. */
+	uint64_t records;		/**< @brief Number of records written. */
+	uint64_t size;			/**< @brief Number of uncompressed bytes written (offset of the next record). */
+	uint8_t  *block;		/**< @brief Records of the current block (compressed files only, NULL otherwise). */
+	uint8_t  *packed;		/**< @brief Compressed block. */
+	uint8_t  *table;		/**< @brief Block table entries. */
+	size_t   length;		/**< @brief Number of bytes in the current block. */
+	size_t   blocks;		/**< @brief Number of blocks written. */
+	size_t   tableSize;		/**< @brief Number of entries allocated in the block table. */
+	uint64_t offset;		/**< @brief File offset of the next block. */
+	uint64_t firstRecord;	/**< @brief Number of the first record of the current block. */
+	uint32_t blockSize;		/**< @brief Minimum uncompressed size of a block. */
+} snap_captureWriter_t;
+
+/**
+ * @brief Capture reader. The whole file is mapped into memory.
+ */
+typedef struct snap_captureReader_t
+{
+	const uint8_t *data;			/**< @brief Pointer to the mapped file (or to the decompressed records). */
+	size_t        size;				/**< @brief Size of the file (uncompressed). */
+	size_t        pos;				/**< @brief Offset of the next record. */
+	size_t        *blockOffsets;	/**< @brief Offset of each block, and the size at the end (compressed files only, NULL otherwise). */
+	uint64_t      *blockRecords;	/**< @brief Number of the first record of each block. */
+	size_t        blocks;			/**< @brief Number of blocks. */
+	const uint8_t *file;			/**< @brief Pointer to the mapped compressed file (NULL otherwise). */
+	size_t        fileSize;			/**< @brief Size of the compressed file. */
+	size_t        tableOffset;		/**< @brief Offset of the block table in the compressed file. */
+	uint8_t       *loaded;			/**< @brief Nonzero for each block already decompressed. */
+	size_t        block;			/**< @brief Block of the last record read. */
+} snap_captureReader_t;
+
+
+/******************************************************************************/
+/*  Function Declarations                                                     */
+/******************************************************************************/
+
+
+uint64_t snap_captureTime(void);
+
+int snap_captureWriterOpen(snap_captureWriter_t *writer, const char *path);
+
+int snap_captureWriterOpenCompressed(snap_captureWriter_t *writer, const char *path, uint32_t blockSize);
+
+int snap_captureWrite(snap_captureWriter_t *writer, uint64_t timestamp, uint16_t channel, const snap_frame_t *frame);
+
+int snap_captureWriterClose(snap_captureWriter_t *writer);
+
+int snap_captureReaderOpen(snap_captureReader_t *reader, const char *path);
+
+int snap_captureRead(snap_captureReader_t *reader, snap_captureRecord_t *record);
+
+int snap_captureSeek(snap_captureReader_t *reader, uint64_t record);
+
+void snap_captureReaderClose(snap_captureReader_t *reader);
+
+#endif	// SNAP_CAPTURE_H_
+
+/******************************** END OF FILE *********************************/
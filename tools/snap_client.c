@@ -0,0 +1,354 @@
+/**
+ * @file   snap_client.c
+ * @author Lucas Jadilo
+ * @brief  Client library of the SNAP daemon (snapd).
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "snap_client.h"
+
+
+/******************************************************************************/
+/*  Private Functions                                                         */
+/******************************************************************************/
+
+
+static int64_t monotonicMs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static int makeMessage(snap_ipcSubscribe_t *message, const snap_subscription_t *subscription, const uint32_t portMask, const uint32_t slots)
+{
+	memset(message, 0, sizeof(*message));
+	message->type = SNAP_IPC_SUBSCRIBE;
+	message->portMask = portMask;
+	message->slots = slots;
+
+	if(subscription == NULL)
+	{
+		return 0;
+	}
+
+	if((subscription->destCount > SNAP_IPC_MAX_LIST) || (subscription->sourceCount > SNAP_IPC_MAX_LIST) ||
+	   (subscription->commandCount > SNAP_IPC_MAX_LIST))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	message->flagsMask = subscription->flagsMask;
+	message->flagsValue = subscription->flagsValue;
+	message->hdb2Mask = subscription->hdb2Mask;
+	message->hdb2Value = subscription->hdb2Value;
+	message->hdb1Mask = subscription->hdb1Mask;
+	message->hdb1Value = subscription->hdb1Value;
+	message->destCount = (uint8_t)subscription->destCount;
+	message->sourceCount = (uint8_t)subscription->sourceCount;
+	message->commandCount = (uint8_t)subscription->commandCount;
+
+	if(subscription->destCount > 0) memcpy(message->destAddresses, subscription->destAddresses, subscription->destCount * sizeof(uint32_t));
+	if(subscription->sourceCount > 0) memcpy(message->sourceAddresses, subscription->sourceAddresses, subscription->sourceCount * sizeof(uint32_t));
+	if(subscription->commandCount > 0) memcpy(message->commands, subscription->commands, subscription->commandCount);
+
+	return 0;
+}
+
+static int receiveReply(const int socket, snap_ipcReply_t *reply, int *memFd, int *eventFd)
+{
+	union
+	{
+		struct cmsghdr header;
+		uint8_t        space[CMSG_SPACE(2U * sizeof(int))];
+	} control;
+	struct iovec vector = {.iov_base = reply, .iov_len = sizeof(*reply)};
+	struct msghdr message = {.msg_iov = &vector, .msg_iovlen = 1, .msg_control = &control, .msg_controllen = sizeof(control)};
+	ssize_t ret;
+
+	while(((ret = recvmsg(socket, &message, MSG_CMSG_CLOEXEC)) < 0) && (errno == EINTR)) {}
+
+	if(ret < 0)
+	{
+		return -1;
+	}
+
+	const struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+	const bool withFds = (header != NULL) && (header->cmsg_level == SOL_SOCKET) && (header->cmsg_type == SCM_RIGHTS) &&
+						 (header->cmsg_len == CMSG_LEN(2U * sizeof(int)));
+	int fds[2] = {-1, -1};
+
+	if(withFds)
+	{
+		memcpy(fds, CMSG_DATA(header), sizeof(fds));
+	}
+
+	if(((size_t)ret != sizeof(*reply)) || (reply->type != SNAP_IPC_REPLY) || (reply->error != 0) || !withFds)
+	{
+		if(withFds)
+		{
+			close(fds[0]);
+			close(fds[1]);
+		}
+
+		errno = (((size_t)ret == sizeof(*reply)) && (reply->type == SNAP_IPC_REPLY) && (reply->error != 0)) ? reply->error : EPROTO;
+		return -1;
+	}
+
+	*memFd = fds[0];
+	*eventFd = fds[1];
+
+	return 0;
+}
+
+static void copySlot(snap_frame_t *frame, const snap_ipcSlot_t *slot)
+{
+	memcpy(frame->buffer, slot->bytes, slot->size);
+	frame->size = slot->size;
+	frame->status = SNAP_STATUS_VALID;
+}
+
+
+/******************************************************************************/
+/*  Public Functions                                                          */
+/******************************************************************************/
+
+
+/**
+ * @brief Connect to the daemon and subscribe to frames.
+ * @param[out] client       Pointer to the client handle.
+ * @param[in]  path         Path of the Unix socket of the daemon.
+ * @param[in]  subscription Conditions of the frames wanted (at most #SNAP_IPC_MAX_LIST items per list), or NULL for every frame.
+ * @param[in]  portMask     Bit i is set to receive the frames of port i (#SNAP_CLIENT_ALL_PORTS for every port).
+ * @param[in]  slots        Frames that can wait in each ring (rounded up to a power of two), or 0 for the default of the daemon.
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set, possibly to the error reported by the daemon).
+ */
+int snap_clientConnect(snap_client_t *client, const char *path, const snap_subscription_t *subscription, const uint32_t portMask, const uint32_t slots)
+{
+	struct sockaddr_un address = {.sun_family = AF_UNIX};
+	snap_ipcSubscribe_t message;
+	snap_ipcReply_t reply;
+	int memFd, eventFd;
+
+	client->socket = -1;
+	client->ipc.memory = NULL;
+	client->ipc.eventFd = -1;
+
+	if(strlen(path) >= sizeof(address.sun_path))
+	{
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	if(makeMessage(&message, subscription, portMask, slots) < 0)
+	{
+		return -1;
+	}
+
+	strcpy(address.sun_path, path);
+	client->socket = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+
+	if((client->socket < 0) || (connect(client->socket, (struct sockaddr *)&address, sizeof(address)) < 0) ||
+	   (send(client->socket, &message, sizeof(message), MSG_NOSIGNAL) < 0) ||
+	   (receiveReply(client->socket, &reply, &memFd, &eventFd) < 0))
+	{
+		const int error = errno;
+		snap_clientClose(client);
+		errno = error;
+		return -1;
+	}
+
+	const int ret = snap_ipcAttach(&client->ipc, memFd, eventFd, reply.ports, reply.slots);
+	const int error = errno;
+
+	close(memFd);
+
+	if(ret < 0)
+	{
+		close(eventFd);
+		snap_clientClose(client);
+		errno = error;
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Receive the next frame, from any port, in round robin order.
+ * @details The frame is copied into the buffer of the frame structure, with status #SNAP_STATUS_VALID (only
+ *          valid frames are delivered by the daemon).
+ * @param[in,out] client    Pointer to the client handle.
+ * @param[out]    frame     Pointer to the frame structure (with a buffer of at least #SNAP_MAX_SIZE_FRAME bytes).
+ * @param[out]    port      Port the frame was received on.
+ * @param[out]    timestamp Time the daemon read the end of the frame (CLOCK_MONOTONIC, ns). It can be NULL.
+ * @param[in]     timeoutMs Longest wait in milliseconds (0 = do not wait, negative = no limit).
+ * @retval 1  A frame was received.
+ * @retval 0  No frame before the timeout.
+ * @retval -1 Error (errno is set; ECONNRESET if the daemon closed the connection, EMSGSIZE if the frame did not fit and was discarded).
+ */
+int snap_clientReceive(snap_client_t *client, snap_frame_t *frame, uint32_t *port, uint64_t *timestamp, const int timeoutMs)
+{
+	const int64_t deadline = monotonicMs() + timeoutMs;
+
+	while(true)
+	{
+		const snap_ipcSlot_t *slot = snap_ipcPeek(&client->ipc, port);
+
+		if(slot != NULL)
+		{
+			const bool fits = (slot->size <= frame->maxSize);
+
+			if(fits)
+			{
+				copySlot(frame, slot);
+
+				if(timestamp != NULL)
+				{
+					*timestamp = slot->timestamp;
+				}
+			}
+
+			snap_ipcRelease(&client->ipc, *port);
+
+			if(!fits)
+			{
+				errno = EMSGSIZE;
+				return -1;
+			}
+
+			return 1;
+		}
+
+		const int64_t remaining = (timeoutMs < 0) ? -1 : deadline - monotonicMs();
+
+		if((timeoutMs >= 0) && (remaining <= 0))
+		{
+			return 0;
+		}
+
+		if(!snap_ipcSleep(&client->ipc))
+		{
+			continue;	// A frame arrived meanwhile
+		}
+
+		struct pollfd fds[2] = {{.fd = client->ipc.eventFd, .events = POLLIN}, {.fd = client->socket, .events = POLLIN}};
+		const int ret = poll(fds, 2, (int)remaining);
+
+		__atomic_store_n(client->ipc.sleeping, 0U, __ATOMIC_RELAXED);
+
+		if((ret < 0) && (errno != EINTR))
+		{
+			return -1;
+		}
+
+		if((ret > 0) && ((fds[0].revents & POLLIN) != 0))
+		{
+			uint64_t count;
+
+			if(read(client->ipc.eventFd, &count, sizeof(count)) < 0)
+			{
+				// Already cleared (nothing else reads it)
+			}
+		}
+
+		if((ret > 0) && ((fds[1].revents & (POLLIN | POLLHUP | POLLERR)) != 0))
+		{
+			// The daemon sends nothing after the reply, so the socket is readable only once it is closed
+			errno = ECONNRESET;
+			return -1;
+		}
+	}
+}
+
+/**
+ * @brief Send a frame on a port, through the daemon.
+ * @details The frame is queued on the transmit ring of the port; it is lost (and counted by the daemon) if
+ *          the ring is full.
+ * @param[in,out] client Pointer to the client handle.
+ * @param[in]     port   Port the frame is sent on.
+ * @param[in]     frame  Pointer to the frame structure (a single complete frame).
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set).
+ */
+int snap_clientSend(snap_client_t *client, const uint32_t port, const snap_frame_t *frame)
+{
+	snap_ipcSend_t message;
+
+	if((port >= client->ipc.ports) || (frame->size == 0) || (frame->size > SNAP_MAX_SIZE_FRAME))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	message.type = SNAP_IPC_SEND;
+	message.port = (uint16_t)port;
+	message.size = frame->size;
+	memcpy(message.bytes, frame->buffer, frame->size);
+
+	while(send(client->socket, &message, offsetof(snap_ipcSend_t, bytes) + frame->size, MSG_NOSIGNAL) < 0)
+	{
+		if(errno != EINTR) return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Get the number of ports of the daemon.
+ * @param[in] client Pointer to the client handle.
+ * @return Number of ports.
+ */
+uint32_t snap_clientPorts(const snap_client_t *client)
+{
+	return client->ipc.ports;
+}
+
+/**
+ * @brief Get the number of frames lost because the rings of the client were full.
+ * @param[in] client Pointer to the client handle.
+ * @return Number of frames dropped on all ports.
+ */
+uint64_t snap_clientDropped(const snap_client_t *client)
+{
+	uint64_t dropped = 0;
+
+	for(uint32_t i = 0; i < client->ipc.ports; i++)
+	{
+		dropped += __atomic_load_n(&client->ipc.rings[i].dropped, __ATOMIC_RELAXED);
+	}
+
+	return dropped;
+}
+
+/**
+ * @brief Close the connection to the daemon and unmap the rings.
+ * @param[in,out] client Pointer to the client handle.
+ */
+void snap_clientClose(snap_client_t *client)
+{
+	snap_ipcDetach(&client->ipc);
+
+	if(client->socket >= 0)
+	{
+		close(client->socket);
+		client->socket = -1;
+	}
+}
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,69 @@
+/**
+ * @file   snap_client.h
+ * @author Lucas Jadilo
+ * @brief  Client library of the SNAP daemon (snapd).
+ * @details The daemon owns the ports and decodes their bytes once, whatever the number of clients. A client
+ *          connects to the Unix socket of the daemon with a subscription (see #snap_subscription_t) and a
+ *          set of ports, and receives the matching valid frames through its own shared memory rings (see
+ *          snap_ipc.h): receiving a frame is a copy from the ring, with no system call while frames keep
+ *          coming. Frames sent by a client are queued on the transmit ring of the port by the daemon.
+ *
+ *          A client handle must be used by a single thread.
+ */
+
+#ifndef SNAP_CLIENT_H_
+#define SNAP_CLIENT_H_
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include "snap_filter.h"
+#include "snap_ipc.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define SNAP_CLIENT_ALL_PORTS	(UINT32_MAX)	/**< @brief Port mask of every port of the daemon. */
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+/**
+ * @brief Connection to the daemon.
+ */
+typedef struct snap_client_t
+{
+	int        socket;		/**< @brief Control socket. */
+	snap_ipc_t ipc;			/**< @brief Shared memory rings (one per port of the daemon). */
+} snap_client_t;
+
+
+/******************************************************************************/
+/*  Function Declarations                                                     */
+/******************************************************************************/
+
+
+int snap_clientConnect(snap_client_t *client, const char *path, const snap_subscription_t *subscription, uint32_t portMask, uint32_t slots);
+
+int snap_clientReceive(snap_client_t *client, snap_frame_t *frame, uint32_t *port, uint64_t *timestamp, int timeoutMs);
+
+int snap_clientSend(snap_client_t *client, uint32_t port, const snap_frame_t *frame);
+
+uint32_t snap_clientPorts(const snap_client_t *client);
+
+uint64_t snap_clientDropped(const snap_client_t *client);
+
+void snap_clientClose(snap_client_t *client);
+
+#endif	// SNAP_CLIENT_H_
+
+/******************************** END OF FILE *********************************/
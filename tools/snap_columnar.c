@@ -0,0 +1,806 @@
+/**
+ * @file   snap_columnar.c
+ * @author Lucas Jadilo
+ * @brief  Columnar files: decoded frame fields stored column by column, for offline aggregation.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "snap_columnar.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define SIZE_HEADER		(16U)
+#define SIZE_TRAILER	(24U)
+#define SIZE_ENTRY		(16U)
+#define SIZE_GROUP		(4U + SIZE_ENTRY * SNAP_COLUMN_COUNT)
+
+#define WRITER_BUFFER_SIZE	(1U << 20)
+#define MAX_SIZE_VARINT		(10U)
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+typedef struct column_t
+{
+	const char *name;
+	uint8_t    width;	// Bytes per value in the PLAIN, RLE and DICT encodings
+} column_t;
+
+
+/******************************************************************************/
+/*  Private Variables                                                         */
+/******************************************************************************/
+
+
+static const uint8_t magic[8] = {'S', 'N', 'A', 'P', 'C', 'O', 'L', '\0'};
+
+static const column_t columns[SNAP_COLUMN_COUNT] =
+{
+	[SNAP_COLUMN_TIMESTAMP] = {"timestamp", 8},
+	[SNAP_COLUMN_CHANNEL]   = {"channel",   2},
+	[SNAP_COLUMN_STATUS]    = {"status",    1},
+	[SNAP_COLUMN_DAB]       = {"dab",       1},
+	[SNAP_COLUMN_SAB]       = {"sab",       1},
+	[SNAP_COLUMN_PFB]       = {"pfb",       1},
+	[SNAP_COLUMN_ACK]       = {"ack",       1},
+	[SNAP_COLUMN_CMD]       = {"cmd",       1},
+	[SNAP_COLUMN_EDM]       = {"edm",       1},
+	[SNAP_COLUMN_NDB]       = {"ndb",       1},
+	[SNAP_COLUMN_DEST]      = {"dest",      3},
+	[SNAP_COLUMN_SOURCE]    = {"source",    3},
+	[SNAP_COLUMN_FLAGS]     = {"flags",     3},
+	[SNAP_COLUMN_SIZE]      = {"size",      2},
+	[SNAP_COLUMN_DATA_SIZE] = {"data_size", 2},
+	[SNAP_COLUMN_HASH]      = {"hash",      4},
+};
+
+
+/******************************************************************************/
+/*  Private Functions                                                         */
+/******************************************************************************/
+
+
+static uint8_t *putLe(uint8_t *p, uint64_t value, const uint_fast8_t size)
+{
+	for(uint_fast8_t i = 0; i < size; i++)
+	{
+		p[i] = (uint8_t)value;
+		value >>= 8;
+	}
+
+	return p + size;
+}
+
+static uint64_t getLe(const uint8_t *p, const uint_fast8_t size)
+{
+	uint64_t value = 0;
+
+	for(uint_fast8_t i = size; i != 0; i--)
+	{
+		value = (value << 8) | p[i - 1];
+	}
+
+	return value;
+}
+
+static uint32_t getBe(const uint8_t *bytes, const uint16_t size, const uint_fast16_t index, const uint_fast8_t count)
+{
+	uint32_t value = 0;
+
+	if(index + count <= size)
+	{
+		for(uint_fast8_t i = 0; i < count; i++)
+		{
+			value = (value << 8) | bytes[index + i];
+		}
+	}
+
+	return value;
+}
+
+static uint_fast8_t sizeVarint(uint64_t value)
+{
+	uint_fast8_t size = 1;
+
+	while(value >= 0x80U)
+	{
+		value >>= 7;
+		size++;
+	}
+
+	return size;
+}
+
+static uint8_t *putVarint(uint8_t *p, uint64_t value)
+{
+	while(value >= 0x80U)
+	{
+		*p++ = (uint8_t)(value | 0x80U);
+		value >>= 7;
+	}
+
+	*p++ = (uint8_t)value;
+	return p;
+}
+
+static const uint8_t *getVarint(const uint8_t *p, const uint8_t *end, uint64_t *value)
+{
+	*value = 0;
+
+	for(uint_fast8_t shift = 0; (p < end) && (shift < 64U); shift += 7U)
+	{
+		const uint8_t byte = *p++;
+		*value |= (uint64_t)(byte & 0x7FU) << shift;
+
+		if(byte < 0x80U)
+		{
+			return p;
+		}
+	}
+
+	return NULL;
+}
+
+static uint64_t zigzag(const uint64_t delta)
+{
+	return (delta << 1) ^ (uint64_t)-(int64_t)(delta >> 63);
+}
+
+static uint64_t unzigzag(const uint64_t value)
+{
+	return (value >> 1) ^ (uint64_t)-(int64_t)(value & 1U);
+}
+
+static uint_fast32_t dictionaryCapacity(const uint32_t rowsPerGroup)
+{
+	uint_fast32_t capacity = 64;
+
+	while(capacity < 2U * rowsPerGroup)
+	{
+		capacity <<= 1;
+	}
+
+	return capacity;
+}
+
+/**
+ * @brief Build the dictionary of a column chunk.
+ * @details The distinct values are stored in @p distinct (in order of appearance) and the index of
+ *          each row in writer->indexes.
+ * @return Number of distinct values.
+ */
+static uint32_t buildDictionary(snap_columnarWriter_t *writer, const uint64_t *values, uint64_t *distinct)
+{
+	const uint_fast32_t capacity = dictionaryCapacity(writer->rowsPerGroup);
+	const uint_fast32_t mask = capacity - 1U;
+	uint32_t count = 0;
+
+	memset(writer->slots, 0, capacity * sizeof(writer->slots[0]));
+
+	for(uint_fast32_t i = 0; i < writer->length; i++)
+	{
+		uint_fast32_t slot = (uint_fast32_t)((values[i] * 0x9E3779B97F4A7C15U) >> 40) & mask;
+
+		while((writer->slots[slot] != 0) && (writer->keys[slot] != values[i]))
+		{
+			slot = (slot + 1U) & mask;
+		}
+
+		if(writer->slots[slot] == 0)
+		{
+			writer->keys[slot] = values[i];
+			distinct[count] = values[i];
+			writer->slots[slot] = ++count;
+		}
+
+		writer->indexes[i] = (uint16_t)(writer->slots[slot] - 1U);
+	}
+
+	return count;
+}
+
+static size_t encodeChunk(snap_columnarWriter_t *writer, const snap_column_t column, uint8_t *encoding)
+{
+	const uint64_t *values = &writer->values[(size_t)column * writer->rowsPerGroup];
+	uint64_t *distinct = &writer->keys[dictionaryCapacity(writer->rowsPerGroup)];
+	const uint_fast8_t width = columns[column].width;
+	const uint32_t rows = writer->length;
+	size_t rleSize = 0, deltaSize = 0, dictSize = SIZE_MAX;
+	uint32_t count = 0;
+	uint8_t *p = writer->scratch;
+
+	for(uint_fast32_t i = 0, run = 1; i < rows; i++, run++)
+	{
+		if((i + 1U == rows) || (values[i + 1U] != values[i]))
+		{
+			rleSize += sizeVarint(run) + width;
+			run = 0;
+		}
+
+		deltaSize += sizeVarint(zigzag(values[i] - (i ? values[i - 1U] : 0)));
+	}
+
+	if(width > 1U)
+	{
+		count = buildDictionary(writer, values, distinct);
+		dictSize = sizeVarint(count) + (size_t)count * width + (size_t)rows * ((count <= 256U) ? 1U : 2U);
+	}
+
+	*encoding = SNAP_COLUMNAR_PLAIN;
+	size_t size = (size_t)rows * width;
+
+	if(rleSize < size)   { *encoding = SNAP_COLUMNAR_RLE;   size = rleSize; }
+	if(dictSize < size)  { *encoding = SNAP_COLUMNAR_DICT;  size = dictSize; }
+	if(deltaSize < size) { *encoding = SNAP_COLUMNAR_DELTA; size = deltaSize; }
+
+	switch(*encoding)
+	{
+		case SNAP_COLUMNAR_RLE:
+			for(uint_fast32_t i = 0, run = 1; i < rows; i++, run++)
+			{
+				if((i + 1U == rows) || (values[i + 1U] != values[i]))
+				{
+					p = putVarint(p, run);
+					p = putLe(p, values[i], width);
+					run = 0;
+				}
+			}
+			break;
+		case SNAP_COLUMNAR_DICT:
+			p = putVarint(p, count);
+
+			for(uint_fast32_t i = 0; i < count; i++)
+			{
+				p = putLe(p, distinct[i], width);
+			}
+
+			for(uint_fast32_t i = 0; i < rows; i++)
+			{
+				p = putLe(p, writer->indexes[i], (count <= 256U) ? 1U : 2U);
+			}
+			break;
+		case SNAP_COLUMNAR_DELTA:
+			for(uint_fast32_t i = 0; i < rows; i++)
+			{
+				p = putVarint(p, zigzag(values[i] - (i ? values[i - 1U] : 0)));
+			}
+			break;
+		default:
+			for(uint_fast32_t i = 0; i < rows; i++)
+			{
+				p = putLe(p, values[i], width);
+			}
+			break;
+	}
+
+	return (size_t)(p - writer->scratch);
+}
+
+static bool decodePlain(const uint8_t *p, const size_t size, const uint_fast8_t width, uint64_t *values, const uint32_t rows)
+{
+	if(size != (size_t)rows * width)
+	{
+		return false;
+	}
+
+	for(uint_fast32_t i = 0; i < rows; i++, p += width)
+	{
+		values[i] = getLe(p, width);
+	}
+
+	return true;
+}
+
+static bool decodeRle(const uint8_t *p, const size_t size, const uint_fast8_t width, uint64_t *values, const uint32_t rows)
+{
+	const uint8_t *end = p + size;
+	uint_fast32_t i = 0;
+
+	while(i < rows)
+	{
+		uint64_t run;
+		p = getVarint(p, end, &run);
+
+		if((p == NULL) || (run == 0) || (run > rows - i) || ((size_t)(end - p) < width))
+		{
+			return false;
+		}
+
+		const uint64_t value = getLe(p, width);
+		p += width;
+
+		while(run--)
+		{
+			values[i++] = value;
+		}
+	}
+
+	return p == end;
+}
+
+static bool decodeDictionary(const uint8_t *p, const size_t size, const uint_fast8_t width, uint64_t *values, const uint32_t rows)
+{
+	const uint8_t *end = p + size;
+	uint64_t count;
+
+	p = getVarint(p, end, &count);
+
+	if((p == NULL) || (count == 0) || (count > rows))
+	{
+		return false;
+	}
+
+	const uint_fast8_t indexWidth = (count <= 256U) ? 1U : 2U;
+	const uint8_t *dictionary = p;
+
+	if((size_t)(end - p) != count * width + (size_t)rows * indexWidth)
+	{
+		return false;
+	}
+
+	p += count * width;
+
+	for(uint_fast32_t i = 0; i < rows; i++, p += indexWidth)
+	{
+		const uint64_t index = getLe(p, indexWidth);
+
+		if(index >= count)
+		{
+			return false;
+		}
+
+		values[i] = getLe(&dictionary[index * width], width);
+	}
+
+	return true;
+}
+
+static bool decodeDelta(const uint8_t *p, const size_t size, uint64_t *values, const uint32_t rows)
+{
+	const uint8_t *end = p + size;
+	uint64_t value = 0;
+
+	for(uint_fast32_t i = 0; i < rows; i++)
+	{
+		uint64_t delta;
+		p = getVarint(p, end, &delta);
+
+		if(p == NULL)
+		{
+			return false;
+		}
+
+		value += unzigzag(delta);
+		values[i] = value;
+	}
+
+	return p == end;
+}
+
+static int writeGroup(snap_columnarWriter_t *writer)
+{
+	snap_columnarGroup_t *groups = realloc(writer->groups, (writer->groupCount + 1U) * sizeof(groups[0]));
+
+	if(groups == NULL)
+	{
+		return -1;
+	}
+
+	writer->groups = groups;
+	snap_columnarGroup_t *group = &groups[writer->groupCount];
+	group->rows = writer->length;
+
+	for(uint_fast8_t column = 0; column < SNAP_COLUMN_COUNT; column++)
+	{
+		const size_t size = encodeChunk(writer, (snap_column_t)column, &group->chunks[column].encoding);
+
+		if(fwrite(writer->scratch, 1, size, writer->file) != size)
+		{
+			return -1;
+		}
+
+		group->chunks[column].offset = writer->offset;
+		group->chunks[column].size = (uint32_t)size;
+		writer->offset += size;
+	}
+
+	writer->groupCount++;
+	writer->length = 0;
+	return 0;
+}
+
+static void freeWriter(snap_columnarWriter_t *writer)
+{
+	free(writer->values);
+	free(writer->keys);
+	free(writer->slots);
+	free(writer->indexes);
+	free(writer->scratch);
+	free(writer->groups);
+	writer->values = NULL;
+	writer->keys = NULL;
+	writer->slots = NULL;
+	writer->indexes = NULL;
+	writer->scratch = NULL;
+	writer->groups = NULL;
+}
+
+
+/******************************************************************************/
+/*  Public Functions                                                          */
+/******************************************************************************/
+
+
+/**
+ * @brief Get the name of a column.
+ * @param[in] column Column (#snap_column_t).
+ * @return Name of the column (e.g. "source"), or NULL if the column does not exist.
+ */
+const char *snap_columnName(const snap_column_t column)
+{
+	return ((unsigned)column < SNAP_COLUMN_COUNT) ? columns[column].name : NULL;
+}
+
+/**
+ * @brief Create a columnar file and write its header.
+ * @param[out] writer       Pointer to the writer structure.
+ * @param[in]  path         Path of the file (it is truncated if it exists).
+ * @param[in]  rowsPerGroup Number of rows per group (1 to #SNAP_COLUMNAR_MAX_ROWS).
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set).
+ */
+int snap_columnarWriterOpen(snap_columnarWriter_t *writer, const char *path, const uint32_t rowsPerGroup)
+{
+	uint8_t header[SIZE_HEADER] = {0};
+
+	memset(writer, 0, sizeof(*writer));
+
+	if((rowsPerGroup == 0) || (rowsPerGroup > SNAP_COLUMNAR_MAX_ROWS))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	const size_t capacity = dictionaryCapacity(rowsPerGroup);
+
+	writer->rowsPerGroup = rowsPerGroup;
+	writer->values = malloc((size_t)SNAP_COLUMN_COUNT * rowsPerGroup * sizeof(writer->values[0]));
+	writer->keys = malloc((capacity + rowsPerGroup) * sizeof(writer->keys[0]));
+	writer->slots = malloc(capacity * sizeof(writer->slots[0]));
+	writer->indexes = malloc(rowsPerGroup * sizeof(writer->indexes[0]));
+	writer->scratch = malloc((size_t)rowsPerGroup * MAX_SIZE_VARINT);
+
+	if(!writer->values || !writer->keys || !writer->slots || !writer->indexes || !writer->scratch)
+	{
+		freeWriter(writer);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	writer->file = fopen(path, "wb");
+
+	if(writer->file == NULL)
+	{
+		freeWriter(writer);
+		return -1;
+	}
+
+	setvbuf(writer->file, NULL, _IOFBF, WRITER_BUFFER_SIZE);
+
+	memcpy(header, magic, sizeof(magic));
+	putLe(&header[8], SNAP_COLUMNAR_VERSION, 2);
+	putLe(&header[10], SNAP_COLUMN_COUNT, 2);
+	putLe(&header[12], rowsPerGroup, 4);
+
+	if(fwrite(header, sizeof(header), 1, writer->file) != 1)
+	{
+		fclose(writer->file);
+		freeWriter(writer);
+		return -1;
+	}
+
+	writer->offset = sizeof(header);
+	return 0;
+}
+
+/**
+ * @brief Append a frame to the current row group (the group is written when it is full).
+ * @details The fields are read straight from the frame bytes. The ones that are absent or
+ *          truncated (e.g. in frames with overflow errors) are stored as 0.
+ * @param[in,out] writer    Pointer to the writer structure.
+ * @param[in]     timestamp Nanoseconds since the Unix epoch.
+ * @param[in]     channel   Channel number.
+ * @param[in]     status    Frame status (#snap_status_t).
+ * @param[in]     bytes     Pointer to the frame bytes (starting with the sync byte).
+ * @param[in]     size      Number of frame bytes.
+ * @retval 0  Success.
+ * @retval -1 Error while writing the row group (errno is set).
+ */
+int snap_columnarAppend(snap_columnarWriter_t *writer, const uint64_t timestamp, const uint16_t channel, const int8_t status,
+						const uint8_t *bytes, const uint16_t size)
+{
+	uint64_t *row = &writer->values[writer->length];
+	const uint32_t stride = writer->rowsPerGroup;
+	const uint8_t hdb2 = (size > SNAP_INDEX_HDB2) ? bytes[SNAP_INDEX_HDB2] : 0;
+	const uint8_t hdb1 = (size > SNAP_INDEX_HDB1) ? bytes[SNAP_INDEX_HDB1] : 0;
+	const uint8_t header[] = {SNAP_SYNC, hdb2, hdb1};
+	const uint_fast16_t indexSab = SNAP_INDEX_SAB(header);
+	const uint_fast16_t indexPfb = SNAP_INDEX_PFB(header);
+	const uint_fast16_t indexHash = SNAP_INDEX_HASH(header);
+
+	row[SNAP_COLUMN_TIMESTAMP * stride] = timestamp;
+	row[SNAP_COLUMN_CHANNEL * stride] = channel;
+	row[SNAP_COLUMN_STATUS * stride] = (uint8_t)status;
+	row[SNAP_COLUMN_DAB * stride] = SNAP_HDB2_DAB(header);
+	row[SNAP_COLUMN_SAB * stride] = SNAP_HDB2_SAB(header);
+	row[SNAP_COLUMN_PFB * stride] = SNAP_HDB2_PFB(header);
+	row[SNAP_COLUMN_ACK * stride] = SNAP_HDB2_ACK(header);
+	row[SNAP_COLUMN_CMD * stride] = SNAP_HDB1_CMD(header);
+	row[SNAP_COLUMN_EDM * stride] = SNAP_HDB1_EDM(header);
+	row[SNAP_COLUMN_NDB * stride] = SNAP_HDB1_NDB(header);
+	row[SNAP_COLUMN_DEST * stride] = getBe(bytes, size, SNAP_INDEX_DAB, SNAP_HDB2_DAB(header));
+	row[SNAP_COLUMN_SOURCE * stride] = getBe(bytes, size, indexSab, SNAP_HDB2_SAB(header));
+	row[SNAP_COLUMN_FLAGS * stride] = getBe(bytes, size, indexPfb, SNAP_HDB2_PFB(header));
+	row[SNAP_COLUMN_SIZE * stride] = size;
+	row[SNAP_COLUMN_DATA_SIZE * stride] = SNAP_SIZE_DATA(header);
+	row[SNAP_COLUMN_HASH * stride] = getBe(bytes, size, indexHash, (uint_fast8_t)SNAP_SIZE_HASH(header));
+
+	writer->rows++;
+
+	if(++writer->length == writer->rowsPerGroup)
+	{
+		return writeGroup(writer);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Write the last row group and the footer, close the file and free the writer memory.
+ * @param[in,out] writer Pointer to the writer structure.
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set).
+ */
+int snap_columnarWriterClose(snap_columnarWriter_t *writer)
+{
+	uint8_t entry[SIZE_GROUP];
+	uint8_t trailer[SIZE_TRAILER] = {0};
+	int ret = 0;
+
+	if(writer->length && (writeGroup(writer) < 0))
+	{
+		ret = -1;
+	}
+
+	for(size_t i = 0; (ret == 0) && (i < writer->groupCount); i++)
+	{
+		uint8_t *p = putLe(entry, writer->groups[i].rows, 4);
+
+		for(uint_fast8_t column = 0; column < SNAP_COLUMN_COUNT; column++)
+		{
+			p = putLe(p, writer->groups[i].chunks[column].offset, 8);
+			p = putLe(p, writer->groups[i].chunks[column].size, 4);
+			p = putLe(p, writer->groups[i].chunks[column].encoding, 4);
+		}
+
+		if(fwrite(entry, sizeof(entry), 1, writer->file) != 1)
+		{
+			ret = -1;
+		}
+	}
+
+	putLe(&trailer[0], writer->offset, 8);
+	putLe(&trailer[8], writer->groupCount, 4);
+	memcpy(&trailer[16], magic, sizeof(magic));
+
+	if((ret == 0) && (fwrite(trailer, sizeof(trailer), 1, writer->file) != 1))
+	{
+		ret = -1;
+	}
+
+	if((fclose(writer->file) != 0) && (ret == 0))
+	{
+		ret = -1;
+	}
+
+	writer->file = NULL;
+	freeWriter(writer);
+	return ret;
+}
+
+/**
+ * @brief Open a columnar file for reading and check its header and footer.
+ * @param[out] reader Pointer to the reader structure.
+ * @param[in]  path   Path of the file.
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set; EINVAL means the file is not a valid columnar file).
+ */
+int snap_columnarReaderOpen(snap_columnarReader_t *reader, const char *path)
+{
+	struct stat info;
+	const int fd = open(path, O_RDONLY);
+
+	if(fd < 0)
+	{
+		return -1;
+	}
+
+	if(fstat(fd, &info) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	if((size_t)info.st_size < SIZE_HEADER + SIZE_TRAILER)
+	{
+		close(fd);
+		errno = EINVAL;
+		return -1;
+	}
+
+	void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if(data == MAP_FAILED)
+	{
+		return -1;
+	}
+
+	reader->data = data;
+	reader->size = (size_t)info.st_size;
+
+	const uint8_t *trailer = &reader->data[reader->size - SIZE_TRAILER];
+	const uint64_t footerOffset = getLe(&trailer[0], 8);
+
+	reader->groupCount = (uint32_t)getLe(&trailer[8], 4);
+	reader->rowsPerGroup = (uint32_t)getLe(&reader->data[12], 4);
+	reader->footer = &reader->data[footerOffset < reader->size ? footerOffset : 0];
+
+	if((memcmp(reader->data, magic, sizeof(magic)) != 0) ||
+	   (memcmp(&trailer[16], magic, sizeof(magic)) != 0) ||
+	   (getLe(&reader->data[8], 2) != SNAP_COLUMNAR_VERSION) ||
+	   (getLe(&reader->data[10], 2) != SNAP_COLUMN_COUNT) ||
+	   (reader->rowsPerGroup == 0) || (reader->rowsPerGroup > SNAP_COLUMNAR_MAX_ROWS) ||
+	   (footerOffset < SIZE_HEADER) ||
+	   (footerOffset + (uint64_t)reader->groupCount * SIZE_GROUP != reader->size - SIZE_TRAILER))
+	{
+		snap_columnarReaderClose(reader);
+		errno = EINVAL;
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Get the description of a row group.
+ * @param[in]  reader      Pointer to the reader structure.
+ * @param[in]  group       Index of the row group.
+ * @param[out] description Pointer to the row group description.
+ * @retval 0  Success.
+ * @retval -1 Error: the group does not exist or its description is corrupted (errno is set to EINVAL).
+ */
+int snap_columnarGetGroup(const snap_columnarReader_t *reader, const uint32_t group, snap_columnarGroup_t *description)
+{
+	const size_t footerOffset = (size_t)(reader->footer - reader->data);
+
+	if(group >= reader->groupCount)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	const uint8_t *p = &reader->footer[(size_t)group * SIZE_GROUP];
+
+	description->rows = (uint32_t)getLe(p, 4);
+	p += 4;
+
+	if((description->rows == 0) || (description->rows > reader->rowsPerGroup))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	for(uint_fast8_t column = 0; column < SNAP_COLUMN_COUNT; column++, p += SIZE_ENTRY)
+	{
+		snap_columnarChunk_t *chunk = &description->chunks[column];
+
+		chunk->offset = getLe(&p[0], 8);
+		chunk->size = (uint32_t)getLe(&p[8], 4);
+		chunk->encoding = p[12];
+
+		if((chunk->offset < SIZE_HEADER) || (chunk->offset > footerOffset) || (footerOffset - chunk->offset < chunk->size) ||
+		   (chunk->encoding > SNAP_COLUMNAR_DELTA))
+		{
+			errno = EINVAL;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Decode one column of a row group.
+ * @details Only the chunk of that column is read from the file.
+ * @param[in]  reader Pointer to the reader structure.
+ * @param[in]  group  Index of the row group.
+ * @param[in]  column Column (#snap_column_t).
+ * @param[out] values Array that will store the values (it must have room for reader->rowsPerGroup values).
+ * @return Number of rows decoded (> 0), or -1 if the group or column does not exist or the chunk is
+ *         corrupted (errno is set to EINVAL).
+ */
+int snap_columnarReadColumn(const snap_columnarReader_t *reader, const uint32_t group, const snap_column_t column, uint64_t *values)
+{
+	snap_columnarGroup_t description;
+
+	if(((unsigned)column >= SNAP_COLUMN_COUNT) || (snap_columnarGetGroup(reader, group, &description) < 0))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	const snap_columnarChunk_t *chunk = &description.chunks[column];
+	const uint8_t *data = &reader->data[chunk->offset];
+	const uint8_t width = columns[column].width;
+	bool ok;
+
+	switch(chunk->encoding)
+	{
+		case SNAP_COLUMNAR_PLAIN:
+			ok = decodePlain(data, chunk->size, width, values, description.rows);
+			break;
+		case SNAP_COLUMNAR_RLE:
+			ok = decodeRle(data, chunk->size, width, values, description.rows);
+			break;
+		case SNAP_COLUMNAR_DICT:
+			ok = decodeDictionary(data, chunk->size, width, values, description.rows);
+			break;
+		default:	// SNAP_COLUMNAR_DELTA
+			ok = decodeDelta(data, chunk->size, values, description.rows);
+			break;
+	}
+
+	if(!ok)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	return (int)description.rows;
+}
+
+/**
+ * @brief Unmap the columnar file.
+ * @param[in,out] reader Pointer to the reader structure.
+ */
+void snap_columnarReaderClose(snap_columnarReader_t *reader)
+{
+	munmap((void *)(uintptr_t)reader->data, reader->size);
+	reader->data = NULL;
+	reader->footer = NULL;
+	reader->size = 0;
+	reader->groupCount = 0;
+}
+
+/******************************** END OF FILE *********************************/
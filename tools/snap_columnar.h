@@ -0,0 +1,162 @@
+/**
+ * @file   snap_columnar.h
+ * @author Lucas Jadilo
+ * @brief  Columnar files: decoded frame fields stored column by column, for offline aggregation.
+ * @details The frames are split into row groups of a fixed number of rows. Each row group stores one chunk
+ *          per column (#snap_column_t), and each chunk uses the smallest of these encodings:
+ *          - #SNAP_COLUMNAR_PLAIN: the values, each one with the width of the column;
+ *          - #SNAP_COLUMNAR_RLE: pairs of (run length as a varint, value);
+ *          - #SNAP_COLUMNAR_DICT: the number of distinct values (varint), the distinct values, and then one
+ *            index per row (1 byte if there are up to 256 distinct values, 2 bytes otherwise);
+ *          - #SNAP_COLUMNAR_DELTA: the differences between consecutive values (zigzag varints).
+ *
+ *          File layout (all integers are little-endian):
+ *          | Content                                                                           |
+ *          |:----------------------------------------------------------------------------------|
+ *          | Header (16 bytes): magic "SNAPCOL\0", u16 version, u16 columns, u32 rows per group  |
+ *          | Chunks of the row groups, one after the other                                     |
+ *          | Footer: for each row group, u32 rows and, for each column, a 16-byte chunk entry  |
+ *          |         (u64 offset, u32 size, u8 encoding, 3 reserved bytes)                     |
+ *          | Trailer (24 bytes): u64 footer offset, u32 row groups, u32 reserved, magic        |
+ *
+ *          The reader maps the file into memory and decodes only the chunks it is asked for, so
+ *          an aggregation over two columns reads a small fraction of the file.
+ */
+
+#ifndef SNAP_COLUMNAR_H_
+#define SNAP_COLUMNAR_H_
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include <stdio.h>
+#include "snap.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define SNAP_COLUMNAR_VERSION		(1U)		/**< @brief Version written in the file header. */
+#define SNAP_COLUMNAR_MAX_ROWS		(65536U)	/**< @brief Maximum number of rows per group. */
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+/**
+ * @brief Columns of a columnar file.
+ */
+typedef enum snap_column_t
+{
+	SNAP_COLUMN_TIMESTAMP = 0,	/**< Nanoseconds since the Unix epoch. */
+	SNAP_COLUMN_CHANNEL,		/**< Channel number. */
+	SNAP_COLUMN_STATUS,			/**< Frame status (#snap_status_t stored as uint8_t). */
+	SNAP_COLUMN_DAB,			/**< DAB bits. */
+	SNAP_COLUMN_SAB,			/**< SAB bits. */
+	SNAP_COLUMN_PFB,			/**< PFB bits. */
+	SNAP_COLUMN_ACK,			/**< ACK bits. */
+	SNAP_COLUMN_CMD,			/**< CMD bit. */
+	SNAP_COLUMN_EDM,			/**< EDM bits. */
+	SNAP_COLUMN_NDB,			/**< NDB bits. */
+	SNAP_COLUMN_DEST,			/**< Destination address (0 if absent or truncated). */
+	SNAP_COLUMN_SOURCE,			/**< Source address (0 if absent or truncated). */
+	SNAP_COLUMN_FLAGS,			/**< Protocol flags (0 if absent or truncated). */
+	SNAP_COLUMN_SIZE,			/**< Number of frame bytes. */
+	SNAP_COLUMN_DATA_SIZE,		/**< Size of the data field (based on the NDB bits). */
+	SNAP_COLUMN_HASH,			/**< Hash value received (0 if absent or truncated). */
+	SNAP_COLUMN_COUNT			/**< Number of columns. */
+} snap_column_t;
+
+/**
+ * @brief Chunk encodings.
+ */
+typedef enum snap_columnarEncoding_t
+{
+	SNAP_COLUMNAR_PLAIN = 0,	/**< Plain values. */
+	SNAP_COLUMNAR_RLE   = 1,	/**< Run-length encoding. */
+	SNAP_COLUMNAR_DICT  = 2,	/**< Dictionary encoding. */
+	SNAP_COLUMNAR_DELTA = 3		/**< Delta encoding. */
+} snap_columnarEncoding_t;
+
+/**
+ * @brief Location of a column chunk in the file.
+ */
+typedef struct snap_columnarChunk_t
+{
+	uint64_t offset;	/**< @brief Offset of the chunk in the file. */
+	uint32_t size;		/**< @brief Size of the chunk. */
+	uint8_t  encoding;	/**< @brief Encoding (#snap_columnarEncoding_t). */
+} snap_columnarChunk_t;
+
+/**
+ * @brief Row group description.
+ */
+typedef struct snap_columnarGroup_t
+{
+	uint32_t             rows;						/**< @brief Number of rows. */
+	snap_columnarChunk_t chunks[SNAP_COLUMN_COUNT];	/**< @brief One chunk per column. */
+} snap_columnarGroup_t;
+
+/**
+ * @brief Columnar writer. All the memory is allocated when the writer is opened.
+ */
+typedef struct snap_columnarWriter_t
+{
+	FILE                 *file;			/**< @brief Output file. */
+	uint64_t             *values;		/**< @brief Values of the current row group (column after column). */
+	uint64_t             *keys;			/**< @brief Dictionary hash table (values). */
+	uint32_t             *slots;		/**< @brief Dictionary hash table (index of each value plus one, 0 = empty). */
+	uint16_t             *indexes;		/**< @brief Dictionary index of each row. */
+	uint8_t              *scratch;		/**< @brief Encoded chunk. */
+	snap_columnarGroup_t *groups;		/**< @brief Row groups written so far. */
+	size_t               groupCount;	/**< @brief Number of row groups written. */
+	uint64_t             offset;		/**< @brief Current offset in the file. */
+	uint64_t             rows;			/**< @brief Number of rows written. */
+	uint32_t             rowsPerGroup;	/**< @brief Rows per group. */
+	uint32_t             length;		/**< @brief Rows in the current group. */
+} snap_columnarWriter_t;
+
+/**
+ * @brief Columnar reader. The whole file is mapped into memory.
+ */
+typedef struct snap_columnarReader_t
+{
+	const uint8_t *data;			/**< @brief Pointer to the mapped file. */
+	size_t        size;				/**< @brief Size of the file. */
+	const uint8_t *footer;			/**< @brief Pointer to the footer. */
+	uint32_t      groupCount;		/**< @brief Number of row groups. */
+	uint32_t      rowsPerGroup;		/**< @brief Maximum number of rows per group. */
+} snap_columnarReader_t;
+
+
+/******************************************************************************/
+/*  Function Declarations                                                     */
+/******************************************************************************/
+
+
+const char *snap_columnName(snap_column_t column);
+
+int snap_columnarWriterOpen(snap_columnarWriter_t *writer, const char *path, uint32_t rowsPerGroup);
+
+int snap_columnarAppend(snap_columnarWriter_t *writer, uint64_t timestamp, uint16_t channel, int8_t status, const uint8_t *bytes, uint16_t size);
+
+int snap_columnarWriterClose(snap_columnarWriter_t *writer);
+
+int snap_columnarReaderOpen(snap_columnarReader_t *reader, const char *path);
+
+int snap_columnarGetGroup(const snap_columnarReader_t *reader, uint32_t group, snap_columnarGroup_t *description);
+
+int snap_columnarReadColumn(const snap_columnarReader_t *reader, uint32_t group, snap_column_t column, uint64_t *values);
+
+void snap_columnarReaderClose(snap_columnarReader_t *reader);
+
+#endif	// SNAP_COLUMNAR_H_
+
+/******************************** END OF FILE *********************************/
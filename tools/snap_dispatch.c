@@ -0,0 +1,195 @@
+/**
+ * @file   snap_dispatch.c
+ * @author Lucas Jadilo
+ * @brief  Fan-out of decoded frames to several subscribers without copies, with reference counting.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include <errno.h>
+#include "snap_align.h"
+#include "snap_dispatch.h"
+
+
+/******************************************************************************/
+/*  Public Functions                                                          */
+/******************************************************************************/
+
+
+/**
+ * @brief Create a dispatcher for the frames of a pool.
+ * @details The queues and the reference counts are allocated on the node of the pool.
+ * @param[out] dispatcher  Pointer to the dispatcher structure.
+ * @param[in]  pool        Pointer to the pool of the frames that will be published.
+ * @param[in]  subscribers Number of subscribers (1 to #SNAP_DISPATCH_MAX_SUBSCRIBERS), numbered from 0.
+ * @param[in]  queueSize   Number of frames each queue can hold (rounded up to a power of two; at least 2).
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set).
+ */
+int snap_dispatchInit(snap_dispatcher_t *dispatcher, snap_pool_t *pool, const uint32_t subscribers, const uint32_t queueSize)
+{
+	if((subscribers == 0) || (subscribers > SNAP_DISPATCH_MAX_SUBSCRIBERS) || (queueSize < 2U) || (queueSize > (1U << 30)))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	uint32_t size = 2;
+
+	while(size < queueSize)
+	{
+		size <<= 1;
+	}
+
+	const size_t subscribersSize = ALIGN(subscribers * sizeof(snap_subscriber_t));
+	const size_t entriesSize = ALIGN(size * sizeof(uint32_t));
+
+	dispatcher->memorySize = subscribersSize + subscribers * entriesSize + pool->count * sizeof(uint32_t);
+	dispatcher->memory = snap_numaAlloc(dispatcher->memorySize, pool->node);
+
+	if(dispatcher->memory == NULL)
+	{
+		return -1;
+	}
+
+	uint8_t *memory = dispatcher->memory;
+
+	dispatcher->pool = pool;
+	dispatcher->subscribers = dispatcher->memory;
+	dispatcher->references = (uint32_t *)&memory[subscribersSize + subscribers * entriesSize];
+	dispatcher->count = subscribers;
+
+	for(uint32_t i = 0; i < subscribers; i++)
+	{
+		dispatcher->subscribers[i].entries = (uint32_t *)&memory[subscribersSize + i * entriesSize];
+		dispatcher->subscribers[i].mask = size - 1U;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Publish a frame to every subscriber.
+ * @details See snap_dispatchPublishTo().
+ * @param[in,out] dispatcher Pointer to the dispatcher structure.
+ * @param[in]     frame      Pointer to the frame.
+ * @return Number of subscribers that received the frame (the others had their queue full).
+ */
+uint32_t snap_dispatchPublish(snap_dispatcher_t *dispatcher, snap_frame_t *frame)
+{
+	return snap_dispatchPublishTo(dispatcher, frame, UINT64_MAX);
+}
+
+/**
+ * @brief Publish a frame to some of the subscribers (e.g. the ones found by snap_filterMatch()).
+ * @details It must be called by the publisher thread only. The frame must have been taken from the pool of
+ *          the dispatcher and must not be changed afterwards. Its reference count is set to the number of
+ *          subscribers that received it; if there are none, it goes back to the pool at once. Only the
+ *          subscribers in the set are visited.
+ * @param[in,out] dispatcher  Pointer to the dispatcher structure.
+ * @param[in]     frame       Pointer to the frame.
+ * @param[in]     subscribers Set of subscribers (bit i for subscriber i; the bits above the number of subscribers are ignored).
+ * @return Number of subscribers that received the frame (the others had their queue full).
+ */
+uint32_t snap_dispatchPublishTo(snap_dispatcher_t *dispatcher, snap_frame_t *frame, uint64_t subscribers)
+{
+	const uint32_t index = (uint32_t)(frame - dispatcher->pool->frames);
+	uint32_t delivered = 0;
+
+	subscribers &= UINT64_MAX >> (64U - dispatcher->count);
+
+	const uint32_t references = (uint32_t)__builtin_popcountll(subscribers) + 1U;	// The publisher holds one until the frame is queued everywhere
+
+	__atomic_store_n(&dispatcher->references[index], references, __ATOMIC_RELAXED);
+
+	for(; subscribers; subscribers &= subscribers - 1U)
+	{
+		snap_subscriber_t *subscriber = &dispatcher->subscribers[__builtin_ctzll(subscribers)];
+		const uint64_t tail = subscriber->tail;
+
+		if(tail - subscriber->headCache > subscriber->mask)
+		{
+			subscriber->headCache = __atomic_load_n(&subscriber->head, __ATOMIC_ACQUIRE);
+
+			if(tail - subscriber->headCache > subscriber->mask)
+			{
+				__atomic_store_n(&subscriber->dropped, subscriber->dropped + 1U, __ATOMIC_RELAXED);
+				continue;
+			}
+		}
+
+		subscriber->entries[tail & subscriber->mask] = index;
+		__atomic_store_n(&subscriber->tail, tail + 1U, __ATOMIC_RELEASE);
+		delivered++;
+	}
+
+	if(__atomic_sub_fetch(&dispatcher->references[index], references - delivered, __ATOMIC_ACQ_REL) == 0)
+	{
+		snap_poolPut(dispatcher->pool, frame);
+	}
+
+	return delivered;
+}
+
+/**
+ * @brief Receive the next frame published to a subscriber.
+ * @details It must be called by the thread of that subscriber only. The frame can be read until it is
+ *          released with snap_dispatchRelease(), which must be done exactly once for each frame received.
+ * @param[in,out] dispatcher Pointer to the dispatcher structure.
+ * @param[in]     subscriber Subscriber number.
+ * @return Pointer to the frame, or NULL if the queue is empty.
+ */
+const snap_frame_t *snap_dispatchReceive(snap_dispatcher_t *dispatcher, const uint32_t subscriber)
+{
+	snap_subscriber_t *queue = &dispatcher->subscribers[subscriber];
+	const uint64_t head = queue->head;
+
+	if(head == queue->tailCache)
+	{
+		queue->tailCache = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+
+		if(head == queue->tailCache)
+		{
+			return NULL;
+		}
+	}
+
+	const uint32_t index = queue->entries[head & queue->mask];
+
+	__atomic_store_n(&queue->head, head + 1U, __ATOMIC_RELEASE);
+
+	return &dispatcher->pool->frames[index];
+}
+
+/**
+ * @brief Release a frame received with snap_dispatchReceive().
+ * @details The last release returns the frame to the pool. It can be called by any thread.
+ * @param[in,out] dispatcher Pointer to the dispatcher structure.
+ * @param[in]     frame      Pointer to the frame.
+ */
+void snap_dispatchRelease(snap_dispatcher_t *dispatcher, const snap_frame_t *frame)
+{
+	const uint32_t index = (uint32_t)(frame - dispatcher->pool->frames);
+
+	if(__atomic_sub_fetch(&dispatcher->references[index], 1U, __ATOMIC_ACQ_REL) == 0)
+	{
+		snap_poolPut(dispatcher->pool, &dispatcher->pool->frames[index]);
+	}
+}
+
+/**
+ * @brief Free the memory of a dispatcher (the pool is not freed).
+ * @param[in,out] dispatcher Pointer to the dispatcher structure.
+ */
+void snap_dispatchDestroy(snap_dispatcher_t *dispatcher)
+{
+	snap_numaFree(dispatcher->memory, dispatcher->memorySize);
+	dispatcher->memory = NULL;
+	dispatcher->count = 0;
+}
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,95 @@
+/**
+ * @file   snap_dispatch.h
+ * @author Lucas Jadilo
+ * @brief  Fan-out of decoded frames to several subscribers without copies, with reference counting.
+ * @details A frame is stored once, in a pool frame (see snap_pool.h), and published to every subscriber:
+ *          each one receives the index of the frame through its own single-producer single-consumer queue,
+ *          reads the frame in place and releases it. The frame has an atomic reference count, set to the
+ *          number of subscribers that received it, and it goes back to the pool when the last one releases it.
+ *
+ *          There is one publisher (the thread that services the channel) and one thread per subscriber
+ *          (e.g. logger, router, application). The queues are lock-free rings with the producer and consumer
+ *          indexes on separate cache lines, and each side keeps a copy of the other index, so the shared
+ *          lines are only read when a queue looks full or empty. A subscriber that falls behind loses the
+ *          frames that do not fit in its queue (counted in snap_subscriber_t::dropped); the others are not
+ *          slowed down.
+ */
+
+#ifndef SNAP_DISPATCH_H_
+#define SNAP_DISPATCH_H_
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include "snap_pool.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define SNAP_DISPATCH_MAX_SUBSCRIBERS	(32U)	/**< @brief Largest number of subscribers of a dispatcher. */
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+/**
+ * @brief Subscriber of a dispatcher: a single-producer single-consumer queue of frame indexes.
+ * @details The fields written by the publisher, the fields written by the subscriber and the read-only
+ *          fields are on separate cache lines (the structures are cache line aligned in the dispatcher mapping).
+ */
+typedef struct snap_subscriber_t
+{
+	uint64_t tail;			/**< @brief Number of frames pushed (written by the publisher). */
+	uint64_t headCache;		/**< @brief Copy of head kept by the publisher. */
+	uint64_t dropped;		/**< @brief Number of frames lost because the queue was full (written by the publisher). */
+	uint8_t  padding1[64U - 3U * sizeof(uint64_t)];
+	uint64_t head;			/**< @brief Number of frames popped (written by the subscriber). */
+	uint64_t tailCache;		/**< @brief Copy of tail kept by the subscriber. */
+	uint8_t  padding2[64U - 2U * sizeof(uint64_t)];
+	uint32_t *entries;		/**< @brief Ring of frame indexes. */
+	uint32_t mask;			/**< @brief Size of the ring minus one (the size is a power of two). */
+	uint8_t  padding3[64U - sizeof(uint32_t *) - sizeof(uint32_t)];
+} snap_subscriber_t;
+
+/**
+ * @brief Dispatcher of the frames of a pool.
+ */
+typedef struct snap_dispatcher_t
+{
+	snap_pool_t       *pool;			/**< @brief Pool of the published frames. */
+	snap_subscriber_t *subscribers;		/**< @brief Subscribers. */
+	uint32_t          *references;		/**< @brief Reference count of each frame of the pool. Accessed with __atomic builtins. */
+	void              *memory;			/**< @brief Mapping that holds the subscribers, the queues and the reference counts. */
+	size_t            memorySize;		/**< @brief Size of the mapping. */
+	uint32_t          count;			/**< @brief Number of subscribers. */
+} snap_dispatcher_t;
+
+
+/******************************************************************************/
+/*  Function Declarations                                                     */
+/******************************************************************************/
+
+
+int snap_dispatchInit(snap_dispatcher_t *dispatcher, snap_pool_t *pool, uint32_t subscribers, uint32_t queueSize);
+
+uint32_t snap_dispatchPublish(snap_dispatcher_t *dispatcher, snap_frame_t *frame);
+
+uint32_t snap_dispatchPublishTo(snap_dispatcher_t *dispatcher, snap_frame_t *frame, uint64_t subscribers);
+
+const snap_frame_t *snap_dispatchReceive(snap_dispatcher_t *dispatcher, uint32_t subscriber);
+
+void snap_dispatchRelease(snap_dispatcher_t *dispatcher, const snap_frame_t *frame);
+
+void snap_dispatchDestroy(snap_dispatcher_t *dispatcher);
+
+#endif	// SNAP_DISPATCH_H_
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,458 @@
+/**
+ * @file   snap_filter.c
+ * @author Lucas Jadilo
+ * @brief  Subscription filters compiled into lookup tables, to find the subscribers of a frame.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "snap_filter.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define TABLE_HDB2		(0U)
+#define TABLE_HDB1		(1U)
+#define TABLE_FLAGS		(2U)			// Three tables: flags bits 23-16, 15-8 and 7-0
+#define TABLE_COMMAND	(5U)
+#define USED_DEST		(6U)			// Bits of snap_filter_t::used for the address tables
+#define USED_SOURCE		(7U)
+#define NO_COMMAND		(256U)			// Entry of the command table for frames without data
+#define FREE_KEY		(UINT32_MAX)
+#define MAX_VALUE		(0xFFFFFFU)		// Largest address or flags value
+
+
+/******************************************************************************/
+/*  Private Functions                                                         */
+/******************************************************************************/
+
+
+static uint32_t readNumber(const uint8_t *bytes, const uint8_t size)
+{
+	uint32_t value = 0;
+
+	for(uint8_t i = 0; i < size; i++)
+	{
+		value = (value << 8) | bytes[i];
+	}
+
+	return value;
+}
+
+static bool isListed(const uint32_t *list, const size_t count, const uint32_t value)
+{
+	for(size_t i = 0; i < count; i++)
+	{
+		if(list[i] == value) return true;
+	}
+
+	return false;
+}
+
+static uint32_t hashAddress(uint32_t address)
+{
+	address ^= address >> 16;
+	address *= 0x7FEB352DU;
+	address ^= address >> 15;
+	address *= 0x846CA68BU;
+	address ^= address >> 16;
+
+	return address;
+}
+
+static int compareAddresses(const void *a, const void *b)
+{
+	const uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/**
+ * @brief Get the distinct destination or source addresses listed by the subscriptions.
+ * @return Sorted array allocated with malloc(), or NULL on error (errno is set).
+ */
+static uint32_t *collectAddresses(const snap_subscription_t *subscriptions, const uint32_t count, const bool source, uint32_t *distinct)
+{
+	size_t total = 0;
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		total += source ? subscriptions[i].sourceCount : subscriptions[i].destCount;
+	}
+
+	uint32_t *addresses = malloc((total + 1U) * sizeof(uint32_t));
+	size_t length = 0;
+
+	if(addresses == NULL)
+	{
+		return NULL;
+	}
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		const uint32_t *list = source ? subscriptions[i].sourceAddresses : subscriptions[i].destAddresses;
+		const size_t listCount = source ? subscriptions[i].sourceCount : subscriptions[i].destCount;
+
+		for(size_t j = 0; j < listCount; j++)
+		{
+			if(list[j] > MAX_VALUE)
+			{
+				free(addresses);
+				errno = EINVAL;
+				return NULL;
+			}
+
+			addresses[length++] = list[j];
+		}
+	}
+
+	qsort(addresses, length, sizeof(uint32_t), compareAddresses);
+	*distinct = 0;
+
+	for(size_t i = 0; i < length; i++)
+	{
+		if((i == 0) || (addresses[i] != addresses[i - 1U]))
+		{
+			addresses[(*distinct)++] = addresses[i];
+		}
+	}
+
+	return addresses;
+}
+
+static uint32_t slotCount(const uint32_t distinct)
+{
+	uint32_t slots = 1;
+
+	while(slots < 2U * distinct)
+	{
+		slots <<= 1;
+	}
+
+	return slots;
+}
+
+static void setBit(uint64_t *set, const uint32_t bit)
+{
+	set[bit / 64U] |= (uint64_t)1 << (bit % 64U);
+}
+
+/**
+ * @brief Fill the sets of the destination or source addresses (starting at set @p first) and their hash table.
+ * @return Number of sets used.
+ */
+static uint32_t buildAddresses(snap_filter_t *filter, snap_filterAddresses_t *table, const snap_subscription_t *subscriptions,
+							   const bool source, const uint32_t *addresses, const uint32_t distinct, const uint32_t first)
+{
+	uint64_t *wildcard = &filter->sets[(size_t)first * filter->words];
+
+	table->wildcard = first;
+	table->mask = slotCount(distinct) - 1U;
+	memset(table->keys, 0xFF, (table->mask + 1U) * sizeof(uint32_t));
+
+	for(uint32_t i = 0; i < filter->count; i++)
+	{
+		const uint32_t *list = source ? subscriptions[i].sourceAddresses : subscriptions[i].destAddresses;
+		const size_t listCount = source ? subscriptions[i].sourceCount : subscriptions[i].destCount;
+
+		if(listCount == 0)
+		{
+			setBit(wildcard, i);
+		}
+
+		for(size_t j = 0; j < listCount; j++)
+		{
+			const uint32_t *address = bsearch(&list[j], addresses, distinct, sizeof(uint32_t), compareAddresses);
+
+			setBit(&filter->sets[(size_t)(first + 1U + (uint32_t)(address - addresses)) * filter->words], i);
+		}
+	}
+
+	for(uint32_t j = 0; j < distinct; j++)
+	{
+		const uint32_t set = first + 1U + j;
+		uint32_t slot = hashAddress(addresses[j]) & table->mask;
+
+		for(uint32_t w = 0; w < filter->words; w++)
+		{
+			filter->sets[(size_t)set * filter->words + w] |= wildcard[w];
+		}
+
+		while(table->keys[slot] != FREE_KEY)
+		{
+			slot = (slot + 1U) & table->mask;
+		}
+
+		table->keys[slot] = addresses[j];
+		table->sets[slot] = set;
+	}
+
+	return distinct + 1U;
+}
+
+static uint32_t lookupAddress(const snap_filterAddresses_t *table, const uint32_t address)
+{
+	uint32_t slot = hashAddress(address) & table->mask;
+
+	while(table->keys[slot] != FREE_KEY)
+	{
+		if(table->keys[slot] == address) return table->sets[slot];
+		slot = (slot + 1U) & table->mask;
+	}
+
+	return table->wildcard;
+}
+
+
+/******************************************************************************/
+/*  Public Functions                                                          */
+/******************************************************************************/
+
+
+/**
+ * @brief Test a single subscription against a frame, without compiling it.
+ * @param[in] subscription Pointer to the subscription.
+ * @param[in] frame        Pointer to a frame with a valid header.
+ * @return Whether the frame matches the subscription.
+ */
+bool snap_filterTest(const snap_subscription_t *subscription, const snap_frame_t *frame)
+{
+	const uint8_t *bytes = frame->buffer;
+	const uint32_t flags = readNumber(&bytes[SNAP_INDEX_PFB(bytes)], SNAP_HDB2_PFB(bytes));
+	const uint32_t dest = readNumber(&bytes[SNAP_INDEX_DAB], SNAP_HDB2_DAB(bytes));
+	const uint32_t source = readNumber(&bytes[SNAP_INDEX_SAB(bytes)], SNAP_HDB2_SAB(bytes));
+
+	if((SNAP_HDB2(bytes) & subscription->hdb2Mask) != subscription->hdb2Value) return false;
+	if((SNAP_HDB1(bytes) & subscription->hdb1Mask) != subscription->hdb1Value) return false;
+	if((flags & subscription->flagsMask) != subscription->flagsValue) return false;
+	if(subscription->destCount && !isListed(subscription->destAddresses, subscription->destCount, dest)) return false;
+	if(subscription->sourceCount && !isListed(subscription->sourceAddresses, subscription->sourceCount, source)) return false;
+
+	if(subscription->commandCount)
+	{
+		if(SNAP_SIZE_DATA(bytes) == 0) return false;
+		return memchr(subscription->commands, bytes[SNAP_INDEX_DATA(bytes)], subscription->commandCount) != NULL;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Compile subscriptions together.
+ * @details Subscriber i is the one of subscriptions[i]. The subscriptions (and their lists) are not used
+ *          after this call; to change them, compile them again and destroy the old filter.
+ * @param[out] filter        Pointer to the filter structure.
+ * @param[in]  subscriptions Array of subscriptions.
+ * @param[in]  count         Number of subscriptions (0 to #SNAP_FILTER_MAX_SUBSCRIPTIONS).
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set; EINVAL means a subscription has a value outside its mask or an address
+ *            or flags value above 0xFFFFFF).
+ */
+int snap_filterCompile(snap_filter_t *filter, const snap_subscription_t *subscriptions, const uint32_t count)
+{
+	if(count > SNAP_FILTER_MAX_SUBSCRIPTIONS)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		const snap_subscription_t *s = &subscriptions[i];
+
+		if((s->hdb2Value & ~s->hdb2Mask) || (s->hdb1Value & ~s->hdb1Mask) || (s->flagsMask > MAX_VALUE) || (s->flagsValue & ~s->flagsMask) ||
+		   (s->destCount && !s->destAddresses) || (s->sourceCount && !s->sourceAddresses) || (s->commandCount && !s->commands))
+		{
+			errno = EINVAL;
+			return -1;
+		}
+	}
+
+	uint32_t destDistinct = 0, sourceDistinct = 0;
+	uint32_t *dest = collectAddresses(subscriptions, count, false, &destDistinct);
+	uint32_t *source = (dest != NULL) ? collectAddresses(subscriptions, count, true, &sourceDistinct) : NULL;
+
+	if(source == NULL)
+	{
+		const int error = errno;
+
+		free(dest);
+		errno = error;
+		return -1;
+	}
+
+	const uint32_t words = (count > 0) ? SNAP_FILTER_WORDS(count) : 1U;
+	const size_t sets = 1U + (SNAP_FILTER_TABLES * 256U + 1U) + (destDistinct + 1U) + (sourceDistinct + 1U);
+	const size_t destSlots = slotCount(destDistinct), sourceSlots = slotCount(sourceDistinct);
+
+	filter->memory = calloc(1, sets * words * sizeof(uint64_t) + 2U * (destSlots + sourceSlots) * sizeof(uint32_t));
+
+	if(filter->memory == NULL)
+	{
+		free(dest);
+		free(source);
+		return -1;
+	}
+
+	uint32_t *slots = (uint32_t *)((uint64_t *)filter->memory + sets * words);
+
+	filter->sets = filter->memory;
+	filter->dest.keys = slots;
+	filter->dest.sets = &slots[destSlots];
+	filter->source.keys = &slots[2U * destSlots];
+	filter->source.sets = &slots[2U * destSlots + sourceSlots];
+	filter->count = count;
+	filter->words = words;
+	filter->used = 0;
+
+	uint32_t next = 1;	// Set 0 has all subscribers
+
+	for(uint32_t t = 0; t < SNAP_FILTER_TABLES; t++)
+	{
+		filter->tables[t] = next;
+		next += (t == TABLE_COMMAND) ? 257U : 256U;
+	}
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		const snap_subscription_t *s = &subscriptions[i];
+
+		setBit(filter->sets, i);
+
+		for(uint32_t v = 0; v < 256U; v++)
+		{
+			if((v & s->hdb2Mask) == s->hdb2Value) setBit(&filter->sets[(size_t)(filter->tables[TABLE_HDB2] + v) * words], i);
+			if((v & s->hdb1Mask) == s->hdb1Value) setBit(&filter->sets[(size_t)(filter->tables[TABLE_HDB1] + v) * words], i);
+
+			for(uint32_t k = 0; k < 3U; k++)
+			{
+				const uint32_t shift = 16U - 8U * k;
+
+				if((v & (s->flagsMask >> shift) & 0xFFU) == ((s->flagsValue >> shift) & 0xFFU))
+				{
+					setBit(&filter->sets[(size_t)(filter->tables[TABLE_FLAGS + k] + v) * words], i);
+				}
+			}
+
+			if((s->commandCount == 0) || memchr(s->commands, (int)v, s->commandCount))
+			{
+				setBit(&filter->sets[(size_t)(filter->tables[TABLE_COMMAND] + v) * words], i);
+			}
+		}
+
+		if(s->commandCount == 0)
+		{
+			setBit(&filter->sets[(size_t)(filter->tables[TABLE_COMMAND] + NO_COMMAND) * words], i);
+		}
+
+		filter->used |= (s->hdb2Mask ? 1U << TABLE_HDB2 : 0U) | (s->hdb1Mask ? 1U << TABLE_HDB1 : 0U) |
+						((s->flagsMask & 0xFF0000U) ? 1U << TABLE_FLAGS : 0U) | ((s->flagsMask & 0x00FF00U) ? 1U << (TABLE_FLAGS + 1U) : 0U) |
+						((s->flagsMask & 0x0000FFU) ? 1U << (TABLE_FLAGS + 2U) : 0U) | (s->commandCount ? 1U << TABLE_COMMAND : 0U) |
+						(s->destCount ? 1U << USED_DEST : 0U) | (s->sourceCount ? 1U << USED_SOURCE : 0U);
+	}
+
+	next += buildAddresses(filter, &filter->dest, subscriptions, false, dest, destDistinct, next);
+	buildAddresses(filter, &filter->source, subscriptions, true, source, sourceDistinct, next);
+
+	free(dest);
+	free(source);
+
+	return 0;
+}
+
+/**
+ * @brief Find the subscribers of a frame.
+ * @details The fields are looked up from the most selective (addresses, command byte) to the least
+ *          selective (header bytes), and the search stops when no subscriber is left.
+ * @param[in]  filter      Pointer to the compiled filter.
+ * @param[in]  frame       Pointer to a frame with a valid header.
+ * @param[out] subscribers Set of subscribers that match (bit i of word i / 64 for subscriber i), with
+ *                         snap_filter_t::words words.
+ * @return Number of subscribers that match.
+ */
+uint32_t snap_filterMatch(const snap_filter_t *filter, const snap_frame_t *frame, uint64_t *subscribers)
+{
+	const uint8_t *bytes = frame->buffer;
+	const uint32_t words = filter->words;
+	const uint32_t used = filter->used;
+	uint32_t lookups[SNAP_FILTER_TABLES + 2U];
+	uint32_t length = 0;
+	uint32_t count = 0;
+
+	if(used & (1U << USED_DEST))
+	{
+		lookups[length++] = lookupAddress(&filter->dest, readNumber(&bytes[SNAP_INDEX_DAB], SNAP_HDB2_DAB(bytes)));
+	}
+
+	if(used & (1U << USED_SOURCE))
+	{
+		lookups[length++] = lookupAddress(&filter->source, readNumber(&bytes[SNAP_INDEX_SAB(bytes)], SNAP_HDB2_SAB(bytes)));
+	}
+
+	if(used & (1U << TABLE_COMMAND))
+	{
+		lookups[length++] = filter->tables[TABLE_COMMAND] + ((SNAP_SIZE_DATA(bytes) > 0) ? bytes[SNAP_INDEX_DATA(bytes)] : NO_COMMAND);
+	}
+
+	if(used & (7U << TABLE_FLAGS))
+	{
+		const uint32_t flags = readNumber(&bytes[SNAP_INDEX_PFB(bytes)], SNAP_HDB2_PFB(bytes));
+
+		for(uint32_t k = 0; k < 3U; k++)
+		{
+			if(used & (1U << (TABLE_FLAGS + k))) lookups[length++] = filter->tables[TABLE_FLAGS + k] + ((flags >> (16U - 8U * k)) & 0xFFU);
+		}
+	}
+
+	if(used & (1U << TABLE_HDB2)) lookups[length++] = filter->tables[TABLE_HDB2] + SNAP_HDB2(bytes);
+	if(used & (1U << TABLE_HDB1)) lookups[length++] = filter->tables[TABLE_HDB1] + SNAP_HDB1(bytes);
+
+	memcpy(subscribers, filter->sets, words * sizeof(uint64_t));
+
+	for(uint32_t i = 0; i < length; i++)
+	{
+		const uint64_t *set = &filter->sets[(size_t)lookups[i] * words];
+		uint64_t any = 0;
+
+		for(uint32_t w = 0; w < words; w++)
+		{
+			subscribers[w] &= set[w];
+			any |= subscribers[w];
+		}
+
+		if(any == 0)
+		{
+			return 0;
+		}
+	}
+
+	for(uint32_t w = 0; w < words; w++)
+	{
+		count += (uint32_t)__builtin_popcountll(subscribers[w]);
+	}
+
+	return count;
+}
+
+/**
+ * @brief Free the memory of a compiled filter.
+ * @param[in,out] filter Pointer to the filter structure.
+ */
+void snap_filterDestroy(snap_filter_t *filter)
+{
+	free(filter->memory);
+	filter->memory = NULL;
+	filter->count = 0;
+}
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,111 @@
+/**
+ * @file   snap_filter.h
+ * @author Lucas Jadilo
+ * @brief  Subscription filters compiled into lookup tables, to find the subscribers of a frame.
+ * @details A subscription selects frames by header bits, destination and source addresses, protocol flags
+ *          and command byte (the first data byte); a frame matches when it satisfies every condition of the
+ *          subscription. Testing every subscription for every frame costs more than decoding the frame when
+ *          there are dozens of them, so the subscriptions are compiled together instead: each field is looked
+ *          up in a table that gives, for the value of the field in the frame, the set of subscribers whose
+ *          condition on that field is satisfied (a bit per subscriber). The header bytes, the flags bytes and
+ *          the command byte are indexed directly (256 entries each) and the addresses go through a hash table
+ *          of the addresses listed by the subscriptions (any other address gives the subscribers that accept
+ *          all addresses). The subscribers of the frame are the intersection of those sets.
+ *
+ *          Only the fields that some subscription constrains are looked up, and the lookup stops as soon as
+ *          the intersection is empty, so the cost depends on the number of fields and of matching subscribers
+ *          rather than on the number of subscriptions. The filters are recompiled whenever a subscription
+ *          changes.
+ */
+
+#ifndef SNAP_FILTER_H_
+#define SNAP_FILTER_H_
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "snap.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define SNAP_FILTER_MAX_SUBSCRIPTIONS	(4096U)						/**< @brief Largest number of subscriptions compiled together. */
+#define SNAP_FILTER_WORDS(count)		(((count) + 63U) / 64U)		/**< @brief Number of 64-bit words of a set of subscribers. @param count Number of subscriptions. */
+#define SNAP_FILTER_TABLES				(6U)						/**< @brief Number of tables indexed directly by a byte of the frame. */
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+/**
+ * @brief Conditions of a subscription. A zeroed structure matches every frame.
+ */
+typedef struct snap_subscription_t
+{
+	uint8_t        hdb2Mask;			/**< @brief The frame matches if (HDB2 & hdb2Mask) == hdb2Value. */
+	uint8_t        hdb2Value;			/**< @brief See hdb2Mask. */
+	uint8_t        hdb1Mask;			/**< @brief The frame matches if (HDB1 & hdb1Mask) == hdb1Value. */
+	uint8_t        hdb1Value;			/**< @brief See hdb1Mask. */
+	uint32_t       flagsMask;			/**< @brief The frame matches if (flags & flagsMask) == flagsValue (the flags are 0 if the frame has none). */
+	uint32_t       flagsValue;			/**< @brief See flagsMask. */
+	const uint32_t *destAddresses;		/**< @brief Destination addresses accepted (the address is 0 if the frame has none). */
+	size_t         destCount;			/**< @brief Number of destination addresses (0 = any). */
+	const uint32_t *sourceAddresses;	/**< @brief Source addresses accepted (the address is 0 if the frame has none). */
+	size_t         sourceCount;			/**< @brief Number of source addresses (0 = any). */
+	const uint8_t  *commands;			/**< @brief Command bytes accepted, i.e. values of the first data byte (frames without data do not match). */
+	size_t         commandCount;		/**< @brief Number of command bytes (0 = any, including frames without data). */
+} snap_subscription_t;
+
+/**
+ * @brief Hash table of the addresses listed by the subscriptions.
+ */
+typedef struct snap_filterAddresses_t
+{
+	uint32_t *keys;			/**< @brief Address of each slot (UINT32_MAX = free). */
+	uint32_t *sets;			/**< @brief Set of subscribers of each slot. */
+	uint32_t mask;			/**< @brief Number of slots minus one (the number of slots is a power of two). */
+	uint32_t wildcard;		/**< @brief Set of subscribers of the addresses that are not in the table. */
+} snap_filterAddresses_t;
+
+/**
+ * @brief Subscriptions compiled together.
+ */
+typedef struct snap_filter_t
+{
+	uint64_t               *sets;						/**< @brief Sets of subscribers, with #words words each; set 0 has all subscribers. */
+	uint32_t               tables[SNAP_FILTER_TABLES];	/**< @brief First set of each direct table (HDB2, HDB1, flags bytes from the MSB, command byte). */
+	snap_filterAddresses_t dest;						/**< @brief Sets of the destination addresses. */
+	snap_filterAddresses_t source;						/**< @brief Sets of the source addresses. */
+	uint32_t               used;						/**< @brief Bit i is set if table i is looked up; bits 6 and 7 stand for the destination and source addresses. */
+	uint32_t               count;						/**< @brief Number of subscriptions. */
+	uint32_t               words;						/**< @brief Number of 64-bit words of each set. */
+	void                   *memory;						/**< @brief Memory of the sets and of the hash tables. */
+} snap_filter_t;
+
+
+/******************************************************************************/
+/*  Function Declarations                                                     */
+/******************************************************************************/
+
+
+bool snap_filterTest(const snap_subscription_t *subscription, const snap_frame_t *frame);
+
+int snap_filterCompile(snap_filter_t *filter, const snap_subscription_t *subscriptions, uint32_t count);
+
+uint32_t snap_filterMatch(const snap_filter_t *filter, const snap_frame_t *frame, uint64_t *subscribers);
+
+void snap_filterDestroy(snap_filter_t *filter);
+
+#endif	// SNAP_FILTER_H_
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,444 @@
+/**
+ * @file   snap_index.c
+ * @author Lucas Jadilo
+ * @brief  Capture indexes: per-block summaries stored alongside a capture file, used to skip blocks in queries.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "snap_index.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define BLOOM_HASHES	(3U)
+#define FNV_OFFSET		(2166136261U)
+#define FNV_PRIME		(16777619U)
+
+
+/******************************************************************************/
+/*  Private Variables                                                         */
+/******************************************************************************/
+
+
+static const uint8_t magic[8] = {'S', 'N', 'A', 'P', 'I', 'D', 'X', '\0'};
+
+
+/******************************************************************************/
+/*  Private Functions                                                         */
+/******************************************************************************/
+
+
+static uint8_t *putLe(uint8_t *p, uint64_t value, const uint_fast8_t size)
+{
+	for(uint_fast8_t i = 0; i < size; i++)
+	{
+		p[i] = (uint8_t)value;
+		value >>= 8;
+	}
+
+	return p + size;
+}
+
+static uint64_t getLe(const uint8_t *p, const uint_fast8_t size)
+{
+	uint64_t value = 0;
+
+	for(uint_fast8_t i = size; i != 0; i--)
+	{
+		value = (value << 8) | p[i - 1];
+	}
+
+	return value;
+}
+
+static bool getAddress(const snap_captureRecord_t *record, const uint_fast16_t index, const uint_fast8_t count, uint32_t *address)
+{
+	if((count == 0) || (index + count > record->size))
+	{
+		return false;
+	}
+
+	*address = 0;
+
+	for(uint_fast8_t i = 0; i < count; i++)
+	{
+		*address = (*address << 8) | record->bytes[index + i];
+	}
+
+	return true;
+}
+
+static uint_fast16_t bloomBit(const uint32_t address, const uint_fast8_t hash)
+{
+	const uint64_t mixed = ((uint64_t)address + 1U) * 0x9E3779B97F4A7C15U;
+	return (uint_fast16_t)(mixed >> (64U - 11U * (hash + 1U))) & (SNAP_INDEX_BLOOM_BITS - 1U);
+}
+
+static void bloomInsert(uint8_t *bloom, const uint32_t address)
+{
+	for(uint_fast8_t i = 0; i < BLOOM_HASHES; i++)
+	{
+		const uint_fast16_t bit = bloomBit(address, i);
+		bloom[bit / 8U] |= (uint8_t)(1U << (bit % 8U));
+	}
+}
+
+static int writeBlock(snap_indexBuilder_t *builder)
+{
+	const snap_indexBlock_t *block = &builder->block;
+	uint8_t entry[SNAP_INDEX_SIZE_BLOCK] = {0};
+	uint8_t *p = entry;
+
+	p = putLe(p, block->offset, 8);
+	p = putLe(p, block->end, 8);
+	p = putLe(p, block->minTimestamp, 8);
+	p = putLe(p, block->maxTimestamp, 8);
+	p = putLe(p, block->records, 4);
+	p = putLe(p, block->valid, 4);
+	p = putLe(p, block->hashErrors, 4);
+	p = putLe(p, block->overflowErrors, 4);
+	p = putLe(p, block->minChannel, 2);
+	p = putLe(p, block->maxChannel, 2);
+	p = putLe(p, block->firstHash, 4);
+	memcpy(p, block->destBloom, sizeof(block->destBloom));
+	memcpy(p + sizeof(block->destBloom), block->sourceBloom, sizeof(block->sourceBloom));
+
+	if(fwrite(entry, sizeof(entry), 1, builder->file) != 1)
+	{
+		return -1;
+	}
+
+	builder->blocks++;
+	memset(&builder->block, 0, sizeof(builder->block));
+	return 0;
+}
+
+
+/******************************************************************************/
+/*  Public Functions                                                          */
+/******************************************************************************/
+
+
+/**
+ * @brief Create an index file and write its header.
+ * @param[out] builder   Pointer to the builder structure.
+ * @param[in]  path      Path of the file (it is truncated if it exists).
+ * @param[in]  blockSize Minimum size of a block, in capture bytes (e.g. #SNAP_INDEX_DEFAULT_BLOCK).
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set).
+ */
+int snap_indexBuilderOpen(snap_indexBuilder_t *builder, const char *path, const uint32_t blockSize)
+{
+	uint8_t header[SNAP_INDEX_SIZE_HEADER] = {0};
+
+	memset(builder, 0, sizeof(*builder));
+	builder->blockSize = blockSize ? blockSize : 1U;
+	builder->file = fopen(path, "wb");
+
+	if(builder->file == NULL)
+	{
+		return -1;
+	}
+
+	memcpy(header, magic, sizeof(magic));
+	putLe(&header[8], SNAP_INDEX_VERSION, 2);
+	putLe(&header[12], builder->blockSize, 4);
+
+	if(fwrite(header, sizeof(header), 1, builder->file) != 1)
+	{
+		fclose(builder->file);
+		builder->file = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Add a record to the current block (the block is written when it is complete).
+ * @details The records must be added in the order they are stored in the capture file.
+ * @param[in,out] builder Pointer to the builder structure.
+ * @param[in]     record  Pointer to the record.
+ * @param[in]     offset  Offset of the record in the capture file.
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set).
+ */
+int snap_indexAdd(snap_indexBuilder_t *builder, const snap_captureRecord_t *record, const uint64_t offset)
+{
+	snap_indexBlock_t *block = &builder->block;
+	uint32_t address;
+
+	if(block->records == 0)
+	{
+		block->offset = offset;
+		block->minTimestamp = record->timestamp;
+		block->maxTimestamp = record->timestamp;
+		block->minChannel = record->channel;
+		block->maxChannel = record->channel;
+		block->firstHash = snap_indexRecordHash(record);
+	}
+
+	block->end = offset + SNAP_CAPTURE_SIZE_RECORD + record->size;
+	block->records++;
+
+	if(record->timestamp < block->minTimestamp) block->minTimestamp = record->timestamp;
+	if(record->timestamp > block->maxTimestamp) block->maxTimestamp = record->timestamp;
+	if(record->channel < block->minChannel)     block->minChannel = record->channel;
+	if(record->channel > block->maxChannel)     block->maxChannel = record->channel;
+
+	block->valid += (record->status == SNAP_STATUS_VALID);
+	block->hashErrors += (record->status == SNAP_STATUS_ERROR_HASH);
+	block->overflowErrors += (record->status == SNAP_STATUS_ERROR_OVERFLOW);
+
+	if(record->size > SNAP_INDEX_HDB1)
+	{
+		const uint8_t *header = record->bytes;
+
+		if(getAddress(record, SNAP_INDEX_DAB, SNAP_HDB2_DAB(header), &address))
+		{
+			bloomInsert(block->destBloom, address);
+		}
+
+		if(getAddress(record, SNAP_INDEX_SAB(header), SNAP_HDB2_SAB(header), &address))
+		{
+			bloomInsert(block->sourceBloom, address);
+		}
+	}
+
+	if(block->end - block->offset >= builder->blockSize)
+	{
+		return writeBlock(builder);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Write the last block and close the index file.
+ * @param[in,out] builder Pointer to the builder structure.
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set).
+ */
+int snap_indexBuilderClose(snap_indexBuilder_t *builder)
+{
+	int ret = 0;
+
+	if(builder->block.records && (writeBlock(builder) < 0))
+	{
+		ret = -1;
+	}
+
+	if((fclose(builder->file) != 0) && (ret == 0))
+	{
+		ret = -1;
+	}
+
+	builder->file = NULL;
+	return ret;
+}
+
+/**
+ * @brief Build the index of an existing capture file.
+ * @param[in] capturePath Path of the capture file.
+ * @param[in] indexPath   Path of the index file (it is truncated if it exists).
+ * @param[in] blockSize   Minimum size of a block, in capture bytes.
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set; EINVAL means the capture file is corrupted).
+ */
+int snap_indexBuild(const char *capturePath, const char *indexPath, const uint32_t blockSize)
+{
+	snap_captureReader_t reader;
+	snap_captureRecord_t record;
+	snap_indexBuilder_t builder;
+	int ret;
+
+	if(snap_captureReaderOpen(&reader, capturePath) < 0)
+	{
+		return -1;
+	}
+
+	if(snap_indexBuilderOpen(&builder, indexPath, blockSize) < 0)
+	{
+		snap_captureReaderClose(&reader);
+		return -1;
+	}
+
+	uint64_t offset = reader.pos;
+
+	while((ret = snap_captureRead(&reader, &record)) > 0)
+	{
+		if(snap_indexAdd(&builder, &record, offset) < 0)
+		{
+			ret = -1;
+			break;
+		}
+
+		offset = reader.pos;
+	}
+
+	if(snap_indexBuilderClose(&builder) < 0)
+	{
+		ret = -1;
+	}
+
+	snap_captureReaderClose(&reader);
+	return ret;
+}
+
+/**
+ * @brief Calculate the hash of a record that identifies the first record of a block.
+ * @details It covers the timestamp, channel, size, status and frame bytes (FNV-1a), so a record of another
+ *          capture at the same offset almost never has the same hash.
+ * @param[in] record Pointer to the record.
+ * @return Hash of the record.
+ */
+uint32_t snap_indexRecordHash(const snap_captureRecord_t *record)
+{
+	uint8_t header[SNAP_CAPTURE_SIZE_RECORD] = {0};
+	uint32_t hash = FNV_OFFSET;
+
+	putLe(&header[0], record->timestamp, 8);
+	putLe(&header[8], record->channel, 2);
+	putLe(&header[10], record->size, 2);
+	header[12] = (uint8_t)record->status;
+
+	for(size_t i = 0; i < sizeof(header); i++)
+	{
+		hash = (hash ^ header[i]) * FNV_PRIME;
+	}
+
+	for(uint_fast16_t i = 0; i < record->size; i++)
+	{
+		hash = (hash ^ record->bytes[i]) * FNV_PRIME;
+	}
+
+	return hash;
+}
+
+/**
+ * @brief Check if an address may be in a Bloom filter.
+ * @param[in] bloom   Pointer to the Bloom filter (#SNAP_INDEX_BLOOM_BITS bits).
+ * @param[in] address Address.
+ * @return false if the address is certainly not in the filter, true if it may be.
+ */
+bool snap_indexBloomContains(const uint8_t *bloom, const uint32_t address)
+{
+	for(uint_fast8_t i = 0; i < BLOOM_HASHES; i++)
+	{
+		const uint_fast16_t bit = bloomBit(address, i);
+
+		if(!(bloom[bit / 8U] & (1U << (bit % 8U))))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * @brief Open an index file for reading and check its header.
+ * @details Only the complete blocks are used (the file may still be being written).
+ * @param[out] index Pointer to the index structure.
+ * @param[in]  path  Path of the file.
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set; EINVAL means the file is not an index file).
+ */
+int snap_indexOpen(snap_index_t *index, const char *path)
+{
+	struct stat info;
+	const int fd = open(path, O_RDONLY);
+
+	if(fd < 0)
+	{
+		return -1;
+	}
+
+	if(fstat(fd, &info) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	if((size_t)info.st_size < SNAP_INDEX_SIZE_HEADER)
+	{
+		close(fd);
+		errno = EINVAL;
+		return -1;
+	}
+
+	void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if(data == MAP_FAILED)
+	{
+		return -1;
+	}
+
+	index->data = data;
+	index->size = (size_t)info.st_size;
+	index->blocks = (index->size - SNAP_INDEX_SIZE_HEADER) / SNAP_INDEX_SIZE_BLOCK;
+
+	if((memcmp(index->data, magic, sizeof(magic)) != 0) || (getLe(&index->data[8], 2) != SNAP_INDEX_VERSION))
+	{
+		snap_indexClose(index);
+		errno = EINVAL;
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Get the summary of a block.
+ * @param[in]  index   Pointer to the index structure.
+ * @param[in]  block   Index of the block (less than index->blocks).
+ * @param[out] summary Pointer to the block summary.
+ */
+void snap_indexGetBlock(const snap_index_t *index, const size_t block, snap_indexBlock_t *summary)
+{
+	const uint8_t *p = &index->data[SNAP_INDEX_SIZE_HEADER + block * SNAP_INDEX_SIZE_BLOCK];
+
+	summary->offset = getLe(&p[0], 8);
+	summary->end = getLe(&p[8], 8);
+	summary->minTimestamp = getLe(&p[16], 8);
+	summary->maxTimestamp = getLe(&p[24], 8);
+	summary->records = (uint32_t)getLe(&p[32], 4);
+	summary->valid = (uint32_t)getLe(&p[36], 4);
+	summary->hashErrors = (uint32_t)getLe(&p[40], 4);
+	summary->overflowErrors = (uint32_t)getLe(&p[44], 4);
+	summary->minChannel = (uint16_t)getLe(&p[48], 2);
+	summary->maxChannel = (uint16_t)getLe(&p[50], 2);
+	summary->firstHash = (uint32_t)getLe(&p[52], 4);
+	memcpy(summary->destBloom, &p[56], sizeof(summary->destBloom));
+	memcpy(summary->sourceBloom, &p[56 + sizeof(summary->destBloom)], sizeof(summary->sourceBloom));
+}
+
+/**
+ * @brief Unmap the index file.
+ * @param[in,out] index Pointer to the index structure.
+ */
+void snap_indexClose(snap_index_t *index)
+{
+	munmap((void *)(uintptr_t)index->data, index->size);
+	index->data = NULL;
+	index->size = 0;
+	index->blocks = 0;
+}
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,124 @@
+/**
+ * @file   snap_index.h
+ * @author Lucas Jadilo
+ * @brief  Capture indexes: per-block summaries stored alongside a capture file, used to skip blocks in queries.
+ * @details The capture is split into blocks of consecutive records (a new block starts once the current one
+ *          spans at least the block size given to the builder). For each block, the index stores its offsets,
+ *          the minimum and maximum timestamps and channels, the number of records of each status, and two
+ *          Bloom filters with the destination and source addresses of its frames.
+ *
+ *          File layout (all integers are little-endian):
+ *          | Content                                                                      |
+ *          |:-----------------------------------------------------------------------------|
+ *          | Header (16 bytes): magic "SNAPIDX\0", u16 version, u16 reserved, u32 block size |
+ *          | Blocks (#SNAP_INDEX_SIZE_BLOCK bytes each): u64 offset, u64 end, u64 minimum  |
+ *          | and maximum timestamps, u32 records, u32 valid, hash error and overflow error |
+ *          | counts, u16 minimum and maximum channels, u32 hash of the first record,       |
+ *          | destination and source Bloom filters (#SNAP_INDEX_BLOOM_BITS bits each)       |
+ *
+ *          Blocks are appended as soon as they are complete and the header never changes, so an index that is
+ *          still being written (or whose capture is still growing) can be used: the records after the last
+ *          complete block are just scanned without it.
+ *
+ *          The hash of the first record of each block (see snap_indexRecordHash()) ties the index to its capture:
+ *          an index left over from a capture that was since rewritten (e.g. recorded again to the same path) does
+ *          not match it, and is not used to skip blocks.
+ */
+
+#ifndef SNAP_INDEX_H_
+#define SNAP_INDEX_H_
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include "snap_capture.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define SNAP_INDEX_VERSION			(2U)					/**< @brief Version written in the file header. */
+#define SNAP_INDEX_SIZE_HEADER		(16U)					/**< @brief Size of the file header. */
+#define SNAP_INDEX_BLOOM_BITS		(2048U)					/**< @brief Size of each Bloom filter, in bits. */
+#define SNAP_INDEX_SIZE_BLOCK		(56U + SNAP_INDEX_BLOOM_BITS / 4U)	/**< @brief Size of a block summary in the file. */
+#define SNAP_INDEX_DEFAULT_BLOCK	(256U * 1024U)			/**< @brief Default block size, in capture bytes. */
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+/**
+ * @brief Summary of a block of records.
+ */
+typedef struct snap_indexBlock_t
+{
+	uint64_t offset;									/**< @brief Offset of the first record in the capture file. */
+	uint64_t end;										/**< @brief Offset right after the last record. */
+	uint64_t minTimestamp;								/**< @brief Smallest timestamp. */
+	uint64_t maxTimestamp;								/**< @brief Largest timestamp. */
+	uint32_t records;									/**< @brief Number of records. */
+	uint32_t valid;										/**< @brief Number of valid frames. */
+	uint32_t hashErrors;								/**< @brief Number of frames with hash errors. */
+	uint32_t overflowErrors;							/**< @brief Number of frames with overflow errors. */
+	uint16_t minChannel;								/**< @brief Smallest channel number. */
+	uint16_t maxChannel;								/**< @brief Largest channel number. */
+	uint32_t firstHash;									/**< @brief Hash of the first record (see snap_indexRecordHash()). */
+	uint8_t  destBloom[SNAP_INDEX_BLOOM_BITS / 8U];		/**< @brief Bloom filter of the destination addresses. */
+	uint8_t  sourceBloom[SNAP_INDEX_BLOOM_BITS / 8U];	/**< @brief Bloom filter of the source addresses. */
+} snap_indexBlock_t;
+
+/**
+ * @brief Index builder (the blocks are written as the records are added).
+ */
+typedef struct snap_indexBuilder_t
+{
+	FILE              *file;		/**< @brief Output file. */
+	snap_indexBlock_t block;		/**< @brief Current block. */
+	uint64_t          blocks;		/**< @brief Number of blocks written. */
+	uint32_t          blockSize;	/**< @brief Minimum size of a block, in capture bytes. */
+} snap_indexBuilder_t;
+
+/**
+ * @brief Index reader. The whole file is mapped into memory.
+ */
+typedef struct snap_index_t
+{
+	const uint8_t *data;		/**< @brief Pointer to the mapped file. */
+	size_t        size;			/**< @brief Size of the file. */
+	size_t        blocks;		/**< @brief Number of complete blocks. */
+} snap_index_t;
+
+
+/******************************************************************************/
+/*  Function Declarations                                                     */
+/******************************************************************************/
+
+
+int snap_indexBuilderOpen(snap_indexBuilder_t *builder, const char *path, uint32_t blockSize);
+
+int snap_indexAdd(snap_indexBuilder_t *builder, const snap_captureRecord_t *record, uint64_t offset);
+
+int snap_indexBuilderClose(snap_indexBuilder_t *builder);
+
+int snap_indexBuild(const char *capturePath, const char *indexPath, uint32_t blockSize);
+
+uint32_t snap_indexRecordHash(const snap_captureRecord_t *record);
+
+bool snap_indexBloomContains(const uint8_t *bloom, uint32_t address);
+
+int snap_indexOpen(snap_index_t *index, const char *path);
+
+void snap_indexGetBlock(const snap_index_t *index, size_t block, snap_indexBlock_t *summary);
+
+void snap_indexClose(snap_index_t *index);
+
+#endif	// SNAP_INDEX_H_
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,287 @@
+/**
+ * @file   snap_ipc.c
+ * @author Lucas Jadilo
+ * @brief  Shared memory rings and messages between the SNAP daemon (snapd) and its clients (snap_client.h).
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "snap_align.h"
+#include "snap_ipc.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define SLOT_SIZE		(ALIGN(sizeof(snap_ipcSlot_t)))
+#define HEADER_SIZE		(CACHE_LINE)	// Magic, ports, slots and sleeping flag (4 words)
+
+
+/******************************************************************************/
+/*  Private Functions                                                         */
+/******************************************************************************/
+
+
+static void setPointers(snap_ipc_t *ipc, void *memory, const uint32_t ports, const uint32_t slots)
+{
+	ipc->memory = memory;
+	ipc->memorySize = snap_ipcSize(ports, slots);
+	ipc->sleeping = &((uint32_t *)memory)[3];
+	ipc->rings = (snap_ipcRing_t *)((uint8_t *)memory + HEADER_SIZE);
+	ipc->slots = (uint8_t *)memory + HEADER_SIZE + ports * sizeof(snap_ipcRing_t);
+	ipc->ports = ports;
+	ipc->count = slots;
+	ipc->next = 0;
+}
+
+static snap_ipcSlot_t *getSlot(const snap_ipc_t *ipc, const uint32_t port, const uint64_t index)
+{
+	return (snap_ipcSlot_t *)&ipc->slots[((size_t)port * ipc->count + (index & (ipc->count - 1U))) * SLOT_SIZE];
+}
+
+static bool isEmpty(const snap_ipc_t *ipc, const uint32_t port)
+{
+	const snap_ipcRing_t *ring = &ipc->rings[port];
+	return __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+}
+
+
+/******************************************************************************/
+/*  Public Functions                                                          */
+/******************************************************************************/
+
+
+/**
+ * @brief Get the size of a shared memory area.
+ * @param[in] ports Number of rings.
+ * @param[in] slots Number of slots of each ring.
+ * @return Size in bytes.
+ */
+size_t snap_ipcSize(const uint32_t ports, const uint32_t slots)
+{
+	return HEADER_SIZE + ports * sizeof(snap_ipcRing_t) + (size_t)ports * slots * SLOT_SIZE;
+}
+
+/**
+ * @brief Create a shared memory area, as a memfd (daemon side).
+ * @param[out] ipc   Pointer to the handle (its eventFd is set to -1).
+ * @param[in]  ports Number of rings (1 to #SNAP_IPC_MAX_PORTS).
+ * @param[in]  slots Number of slots of each ring (a power of two, up to #SNAP_IPC_MAX_SLOTS).
+ * @param[out] memFd File descriptor of the memfd, to be sent to the client.
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set).
+ */
+int snap_ipcCreate(snap_ipc_t *ipc, const uint32_t ports, const uint32_t slots, int *memFd)
+{
+	if((ports == 0) || (ports > SNAP_IPC_MAX_PORTS) || (slots == 0) || (slots > SNAP_IPC_MAX_SLOTS) || ((slots & (slots - 1U)) != 0))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	const size_t size = snap_ipcSize(ports, slots);
+	const int fd = memfd_create("snapd", MFD_CLOEXEC);
+
+	if(fd < 0)
+	{
+		return -1;
+	}
+
+	void *memory = MAP_FAILED;
+
+	if((ftruncate(fd, (off_t)size) < 0) || ((memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED))
+	{
+		const int error = errno;
+		close(fd);
+		errno = error;
+		return -1;
+	}
+
+	uint32_t *header = memory;
+
+	header[0] = SNAP_IPC_MAGIC;
+	header[1] = ports;
+	header[2] = slots;
+	setPointers(ipc, memory, ports, slots);
+	ipc->eventFd = -1;
+	*memFd = fd;
+
+	return 0;
+}
+
+/**
+ * @brief Map a shared memory area received from the daemon (client side).
+ * @param[out] ipc     Pointer to the handle.
+ * @param[in]  memFd   File descriptor of the memfd (it can be closed afterwards).
+ * @param[in]  eventFd File descriptor of the eventfd (owned by the handle from now on).
+ * @param[in]  ports   Number of rings given by the daemon.
+ * @param[in]  slots   Number of slots given by the daemon.
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set; EPROTO if the area does not match).
+ */
+int snap_ipcAttach(snap_ipc_t *ipc, const int memFd, const int eventFd, const uint32_t ports, const uint32_t slots)
+{
+	struct stat info;
+
+	if((ports == 0) || (ports > SNAP_IPC_MAX_PORTS) || (slots == 0) || (slots > SNAP_IPC_MAX_SLOTS) || ((slots & (slots - 1U)) != 0) ||
+	   (fstat(memFd, &info) < 0) || ((size_t)info.st_size != snap_ipcSize(ports, slots)))
+	{
+		errno = EPROTO;
+		return -1;
+	}
+
+	void *memory = mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, memFd, 0);
+
+	if(memory == MAP_FAILED)
+	{
+		return -1;
+	}
+
+	const uint32_t *header = memory;
+
+	if((header[0] != SNAP_IPC_MAGIC) || (header[1] != ports) || (header[2] != slots))
+	{
+		munmap(memory, (size_t)info.st_size);
+		errno = EPROTO;
+		return -1;
+	}
+
+	setPointers(ipc, memory, ports, slots);
+	ipc->eventFd = eventFd;
+
+	return 0;
+}
+
+/**
+ * @brief Copy a frame into the ring of a port (daemon side, by the thread of the port only).
+ * @details If the client sleeps (see snap_ipcSleep()), its eventfd is signaled.
+ * @param[in,out] ipc       Pointer to the handle (with the eventFd of the client).
+ * @param[in]     port      Port (ring) of the frame.
+ * @param[in]     frame     Pointer to the frame structure.
+ * @param[in]     timestamp Reception time of the frame.
+ * @return true if the frame was queued, false if the ring was full (the frame is counted as dropped).
+ */
+bool snap_ipcPush(snap_ipc_t *ipc, const uint32_t port, const snap_frame_t *frame, const uint64_t timestamp)
+{
+	snap_ipcRing_t *ring = &ipc->rings[port];
+	const uint64_t tail = ring->tail;
+
+	if(tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) >= ipc->count)
+	{
+		__atomic_store_n(&ring->dropped, ring->dropped + 1U, __ATOMIC_RELAXED);
+		return false;
+	}
+
+	snap_ipcSlot_t *slot = getSlot(ipc, port, tail);
+
+	slot->timestamp = timestamp;
+	slot->size = frame->size;
+	memcpy(slot->bytes, frame->buffer, frame->size);
+	__atomic_store_n(&ring->tail, tail + 1U, __ATOMIC_RELEASE);
+
+	// Pairs with the fence of snap_ipcSleep(): either the client sees the new tail, or this sees its flag
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if(__atomic_load_n(ipc->sleeping, __ATOMIC_RELAXED) && __atomic_exchange_n(ipc->sleeping, 0U, __ATOMIC_ACQ_REL) && (ipc->eventFd >= 0))
+	{
+		const uint64_t one = 1;
+
+		if(write(ipc->eventFd, &one, sizeof(one)) < 0)
+		{
+			// The counter cannot overflow in practice, and the client also wakes up on a timeout
+		}
+	}
+
+	return true;
+}
+
+/**
+ * @brief Get the oldest frame of the next ring that has one (client side), in round robin order.
+ * @param[in,out] ipc  Pointer to the handle.
+ * @param[out]    port Port (ring) of the frame.
+ * @return Pointer to the slot, valid until snap_ipcRelease(), or NULL if every ring is empty.
+ */
+const snap_ipcSlot_t *snap_ipcPeek(snap_ipc_t *ipc, uint32_t *port)
+{
+	for(uint32_t i = 0; i < ipc->ports; i++)
+	{
+		const uint32_t candidate = (ipc->next + i) % ipc->ports;
+
+		if(!isEmpty(ipc, candidate))
+		{
+			*port = candidate;
+			ipc->next = (candidate + 1U) % ipc->ports;
+			return getSlot(ipc, candidate, ipc->rings[candidate].head);
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Free the slot returned by snap_ipcPeek() (client side).
+ * @param[in,out] ipc  Pointer to the handle.
+ * @param[in]     port Port returned by snap_ipcPeek().
+ */
+void snap_ipcRelease(snap_ipc_t *ipc, const uint32_t port)
+{
+	snap_ipcRing_t *ring = &ipc->rings[port];
+	__atomic_store_n(&ring->head, ring->head + 1U, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Get ready to wait for frames on the eventfd (client side).
+ * @details The sleeping flag is set, and the rings are checked again afterwards, so a frame pushed at the
+ *          same time is never missed: either it is seen here, or its producer signals the eventfd.
+ * @param[in,out] ipc Pointer to the handle.
+ * @return true if the client can wait on the eventfd, false if a frame is already available (the flag is cleared).
+ */
+bool snap_ipcSleep(snap_ipc_t *ipc)
+{
+	__atomic_store_n(ipc->sleeping, 1U, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	for(uint32_t i = 0; i < ipc->ports; i++)
+	{
+		if(!isEmpty(ipc, i))
+		{
+			__atomic_store_n(ipc->sleeping, 0U, __ATOMIC_RELAXED);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * @brief Unmap a shared memory area and close its eventfd (if any).
+ * @param[in,out] ipc Pointer to the handle.
+ */
+void snap_ipcDetach(snap_ipc_t *ipc)
+{
+	if(ipc->memory != NULL)
+	{
+		munmap(ipc->memory, ipc->memorySize);
+		ipc->memory = NULL;
+	}
+
+	if(ipc->eventFd >= 0)
+	{
+		close(ipc->eventFd);
+		ipc->eventFd = -1;
+	}
+}
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,159 @@
+/**
+ * @file   snap_ipc.h
+ * @author Lucas Jadilo
+ * @brief  Shared memory rings and messages between the SNAP daemon (snapd) and its clients (snap_client.h).
+ * @details The daemon owns the ports and decodes each byte once. Every client has one shared memory area
+ *          (a memfd created by the daemon), with one ring of frame slots per port: the thread of the port is
+ *          the only producer of its ring and the client is the only consumer, so each ring is a lock-free
+ *          single-producer single-consumer queue. When a ring is full, the frame is dropped for that client
+ *          only and counted in the ring.
+ *
+ *          A client that has nothing to read sets the sleeping flag of the area, checks the rings again and
+ *          then waits on an eventfd, which the producers signal only when the flag is set, so the daemon
+ *          makes no system call per frame while the client keeps up.
+ *
+ *          The control messages go through a SOCK_SEQPACKET Unix socket: the client sends a subscription,
+ *          and the daemon answers with the number of ports and slots, plus the memfd and the eventfd
+ *          (SCM_RIGHTS). Afterwards, the client may send frames to be transmitted on a port.
+ */
+
+#ifndef SNAP_IPC_H_
+#define SNAP_IPC_H_
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include <stddef.h>
+#include "snap.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define SNAP_IPC_MAGIC			(0x534E4150U)	/**< @brief First word of a shared memory area ("SNAP"). */
+#define SNAP_IPC_MAX_PORTS		(32U)			/**< @brief Largest number of ports of a daemon. */
+#define SNAP_IPC_MAX_SLOTS		(65536U)		/**< @brief Largest number of slots of a ring. */
+#define SNAP_IPC_MAX_LIST		(16U)			/**< @brief Largest number of addresses or commands of a subscription message. */
+
+#define SNAP_IPC_SUBSCRIBE		(1U)			/**< @brief Type of a subscription message (client to daemon). */
+#define SNAP_IPC_REPLY			(2U)			/**< @brief Type of a reply message (daemon to client). */
+#define SNAP_IPC_SEND			(3U)			/**< @brief Type of a send message (client to daemon). */
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+/**
+ * @brief Slot of a ring: a frame received on a port.
+ */
+typedef struct snap_ipcSlot_t
+{
+	uint64_t timestamp;						/**< @brief Time the block with the end of the frame was read (CLOCK_MONOTONIC, ns). */
+	uint16_t size;							/**< @brief Frame size. */
+	uint8_t  bytes[SNAP_MAX_SIZE_FRAME];	/**< @brief Frame bytes. */
+} snap_ipcSlot_t;
+
+/**
+ * @brief Control of a ring. The fields of the producer and of the consumer are on separate cache lines.
+ */
+typedef struct snap_ipcRing_t
+{
+	uint64_t tail;			/**< @brief Number of frames pushed (written by the daemon). Accessed with __atomic builtins. */
+	uint64_t dropped;		/**< @brief Number of frames lost because the ring was full (written by the daemon). Accessed with __atomic builtins. */
+	uint8_t  padding1[64U - 2U * sizeof(uint64_t)];
+	uint64_t head;			/**< @brief Number of frames popped (written by the client). Accessed with __atomic builtins. */
+	uint8_t  padding2[64U - sizeof(uint64_t)];
+} snap_ipcRing_t;
+
+/**
+ * @brief Handle of a shared memory area (local to each process).
+ */
+typedef struct snap_ipc_t
+{
+	void           *memory;		/**< @brief Mapping of the area. */
+	size_t         memorySize;	/**< @brief Size of the mapping. */
+	uint32_t       *sleeping;	/**< @brief Flag set by the client before it waits on the eventfd. Accessed with __atomic builtins. */
+	snap_ipcRing_t *rings;		/**< @brief Control of the ring of each port. */
+	uint8_t        *slots;		/**< @brief Slots of all the rings (ring i starts at slot i * count). */
+	uint32_t       ports;		/**< @brief Number of rings. */
+	uint32_t       count;		/**< @brief Number of slots of each ring (a power of two). */
+	uint32_t       next;		/**< @brief Next ring checked by the client (round robin). */
+	int            eventFd;		/**< @brief Eventfd signaled when the client sleeps and a frame arrives. */
+} snap_ipc_t;
+
+/**
+ * @brief Subscription message: the frames that the client wants. The conditions are those of #snap_subscription_t.
+ */
+typedef struct snap_ipcSubscribe_t
+{
+	uint32_t type;								/**< @brief #SNAP_IPC_SUBSCRIBE. */
+	uint32_t portMask;							/**< @brief Bit i is set to receive the frames of port i. */
+	uint32_t slots;								/**< @brief Slots wanted in each ring (rounded up to a power of two). */
+	uint32_t flagsMask;							/**< @brief See #snap_subscription_t. */
+	uint32_t flagsValue;						/**< @brief See #snap_subscription_t. */
+	uint8_t  hdb2Mask;							/**< @brief See #snap_subscription_t. */
+	uint8_t  hdb2Value;							/**< @brief See #snap_subscription_t. */
+	uint8_t  hdb1Mask;							/**< @brief See #snap_subscription_t. */
+	uint8_t  hdb1Value;							/**< @brief See #snap_subscription_t. */
+	uint8_t  destCount;							/**< @brief Number of destination addresses (0 = any). */
+	uint8_t  sourceCount;						/**< @brief Number of source addresses (0 = any). */
+	uint8_t  commandCount;						/**< @brief Number of command bytes (0 = any). */
+	uint8_t  commands[SNAP_IPC_MAX_LIST];		/**< @brief Command bytes accepted. */
+	uint32_t destAddresses[SNAP_IPC_MAX_LIST];	/**< @brief Destination addresses accepted. */
+	uint32_t sourceAddresses[SNAP_IPC_MAX_LIST];	/**< @brief Source addresses accepted. */
+} snap_ipcSubscribe_t;
+
+/**
+ * @brief Reply message, sent with the memfd and the eventfd of the client on success.
+ */
+typedef struct snap_ipcReply_t
+{
+	uint32_t type;		/**< @brief #SNAP_IPC_REPLY. */
+	int32_t  error;		/**< @brief 0 on success, or an errno value. */
+	uint32_t ports;		/**< @brief Number of ports (and rings). */
+	uint32_t slots;		/**< @brief Number of slots of each ring. */
+} snap_ipcReply_t;
+
+/**
+ * @brief Send message: a frame to be transmitted on a port.
+ */
+typedef struct snap_ipcSend_t
+{
+	uint32_t type;							/**< @brief #SNAP_IPC_SEND. */
+	uint16_t port;							/**< @brief Port. */
+	uint16_t size;							/**< @brief Frame size. */
+	uint8_t  bytes[SNAP_MAX_SIZE_FRAME];	/**< @brief Frame bytes (a single complete frame). */
+} snap_ipcSend_t;
+
+
+/******************************************************************************/
+/*  Function Declarations                                                     */
+/******************************************************************************/
+
+
+size_t snap_ipcSize(uint32_t ports, uint32_t slots);
+
+int snap_ipcCreate(snap_ipc_t *ipc, uint32_t ports, uint32_t slots, int *memFd);
+
+int snap_ipcAttach(snap_ipc_t *ipc, int memFd, int eventFd, uint32_t ports, uint32_t slots);
+
+bool snap_ipcPush(snap_ipc_t *ipc, uint32_t port, const snap_frame_t *frame, uint64_t timestamp);
+
+const snap_ipcSlot_t *snap_ipcPeek(snap_ipc_t *ipc, uint32_t *port);
+
+void snap_ipcRelease(snap_ipc_t *ipc, uint32_t port);
+
+bool snap_ipcSleep(snap_ipc_t *ipc);
+
+void snap_ipcDetach(snap_ipc_t *ipc);
+
+#endif	// SNAP_IPC_H_
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,251 @@
+/**
+ * @file   snap_lz.c
+ * @author Lucas Jadilo
+ * @brief  Fast LZ77 block codec used by compressed capture files.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include <errno.h>
+#include <stdbool.h>
+#include <string.h>
+#include "snap_lz.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define MIN_MATCH		(4U)		// Shortest match encoded.
+#define MAX_OFFSET		(65535U)	// Farthest match (2-byte offset).
+#define LAST_LITERALS	(5U)		// The last bytes of a block are always literals.
+#define MATCH_LIMIT		(12U)		// No match starts in the last bytes of a block.
+#define HASH_BITS		(14U)
+#define SKIP_SHIFT		(6U)		// The search step grows by one every 64 bytes without a match.
+
+
+/******************************************************************************/
+/*  Private Functions                                                         */
+/******************************************************************************/
+
+
+static uint32_t read32(const uint8_t *p)
+{
+	uint32_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static uint32_t hash(const uint32_t sequence)
+{
+	return (sequence * 2654435761U) >> (32U - HASH_BITS);
+}
+
+static uint8_t *putLength(uint8_t *out, size_t length)
+{
+	while(length >= 255U)
+	{
+		*out++ = 255U;
+		length -= 255U;
+	}
+
+	*out++ = (uint8_t)length;
+	return out;
+}
+
+static uint8_t *putSequence(uint8_t *out, const uint8_t *literals, const size_t literalLength, const size_t offset, const size_t matchLength)
+{
+	uint8_t *token = out++;
+
+	*token = (uint8_t)(((literalLength < 15U) ? literalLength : 15U) << 4);
+
+	if(literalLength >= 15U)
+	{
+		out = putLength(out, literalLength - 15U);
+	}
+
+	memcpy(out, literals, literalLength);
+	out += literalLength;
+
+	if(matchLength != 0)
+	{
+		const size_t length = matchLength - MIN_MATCH;
+
+		*out++ = (uint8_t)offset;
+		*out++ = (uint8_t)(offset >> 8);
+		*token |= (uint8_t)((length < 15U) ? length : 15U);
+
+		if(length >= 15U)
+		{
+			out = putLength(out, length - 15U);
+		}
+	}
+
+	return out;
+}
+
+static bool getLength(const uint8_t **in, const uint8_t *end, size_t *length)
+{
+	uint8_t byte;
+
+	do
+	{
+		if(*in == end)
+		{
+			return false;
+		}
+
+		byte = *(*in)++;
+		*length += byte;
+	} while(byte == 255U);
+
+	return true;
+}
+
+
+/******************************************************************************/
+/*  Public Functions                                                          */
+/******************************************************************************/
+
+
+/**
+ * @brief Compress a block.
+ * @param[in]  source      Pointer to the data.
+ * @param[in]  size        Number of bytes of data (less than 4 GiB).
+ * @param[out] destination Pointer to the output buffer, at least SNAP_LZ_BOUND(size) bytes long.
+ * @return Size of the compressed block.
+ */
+size_t snap_lzCompress(const uint8_t *source, const size_t size, uint8_t *destination)
+{
+	const uint8_t *in = source, *anchor = source, *end = source + size;
+	uint8_t *out = destination;
+
+	if(size > MATCH_LIMIT)
+	{
+		uint32_t table[1U << HASH_BITS] = {0};		// Position + 1 of the last sequence with each hash (0 = none).
+		const uint8_t *inLimit = end - MATCH_LIMIT, *matchLimit = end - LAST_LITERALS;
+
+		while(in < inLimit)
+		{
+			const uint32_t sequence = read32(in);
+			const uint32_t h = hash(sequence);
+			const uint32_t candidate = table[h];
+			const uint8_t *match = &source[(candidate != 0) ? candidate - 1U : 0];
+
+			table[h] = (uint32_t)(in - source) + 1U;
+
+			if((candidate == 0) || ((size_t)(in - match) > MAX_OFFSET) || (read32(match) != sequence))
+			{
+				in += 1U + ((size_t)(in - anchor) >> SKIP_SHIFT);
+				continue;
+			}
+
+			while((in > anchor) && (match > source) && (in[-1] == match[-1]))
+			{
+				in--;
+				match--;
+			}
+
+			size_t length = MIN_MATCH;
+
+			while((in + length < matchLimit) && (in[length] == match[length]))
+			{
+				length++;
+			}
+
+			out = putSequence(out, anchor, (size_t)(in - anchor), (size_t)(in - match), length);
+			in += length;
+			anchor = in;
+		}
+	}
+
+	out = putSequence(out, anchor, (size_t)(end - anchor), 0, 0);
+	return (size_t)(out - destination);
+}
+
+/**
+ * @brief Decompress a block.
+ * @param[in]     source          Pointer to the compressed block.
+ * @param[in]     size            Size of the compressed block.
+ * @param[out]    destination     Pointer to the output buffer.
+ * @param[in,out] destinationSize Size of the output buffer as input; number of bytes decompressed as output.
+ * @retval 0  Success.
+ * @retval -1 The block is corrupted or does not fit in the output buffer (errno is set to EINVAL).
+ */
+int snap_lzDecompress(const uint8_t *source, const size_t size, uint8_t *destination, size_t *destinationSize)
+{
+	const uint8_t *in = source, *inEnd = source + size;
+	uint8_t *out = destination, *outEnd = destination + *destinationSize;
+
+	while(in != inEnd)
+	{
+		const uint8_t token = *in++;
+		size_t literals = token >> 4;
+
+		if((literals == 15U) && !getLength(&in, inEnd, &literals))
+		{
+			break;
+		}
+
+		if(((size_t)(inEnd - in) < literals) || ((size_t)(outEnd - out) < literals))
+		{
+			break;
+		}
+
+		memcpy(out, in, literals);
+		in += literals;
+		out += literals;
+
+		if(in == inEnd)
+		{
+			*destinationSize = (size_t)(out - destination);
+			return 0;
+		}
+
+		if(inEnd - in < 2)
+		{
+			break;
+		}
+
+		const size_t offset = (size_t)in[0] | ((size_t)in[1] << 8);
+		size_t length = token & 15U;
+		in += 2;
+
+		if((length == 15U) && !getLength(&in, inEnd, &length))
+		{
+			break;
+		}
+
+		length += MIN_MATCH;
+
+		if((offset == 0) || (offset > (size_t)(out - destination)) || ((size_t)(outEnd - out) < length))
+		{
+			break;
+		}
+
+		const uint8_t *match = out - offset;
+
+		if(offset >= length)
+		{
+			memcpy(out, match, length);
+			out += length;
+		}
+		else
+		{
+			while(length-- != 0)
+			{
+				*out++ = *match++;
+			}
+		}
+	}
+
+	errno = EINVAL;
+	return -1;
+}
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,48 @@
+/**
+ * @file   snap_lz.h
+ * @author Lucas Jadilo
+ * @brief  Fast LZ77 block codec used by compressed capture files.
+ * @details The compressed block is a sequence of (literals, match) pairs, in the same layout as the LZ4 block
+ *          format: a token byte holds the number of literals (high nibble) and the match length minus 4 (low
+ *          nibble), a nibble equal to 15 is followed by extra length bytes (added until one is not 255), and the
+ *          literals are followed by the 2-byte little-endian match offset. The last sequence has literals only.
+ *
+ *          The compressor looks for matches of at least 4 bytes within the last 64 KiB with a single hash table
+ *          probe per position, skipping faster through data that does not compress. It favours speed over ratio,
+ *          which suits padded frames and repeated headers. The decompressor checks every length and offset, so
+ *          corrupted input is reported instead of being read or written out of bounds.
+ */
+
+#ifndef SNAP_LZ_H_
+#define SNAP_LZ_H_
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define SNAP_LZ_BOUND(size)	((size) + (size) / 255U + 16U)	/**< @brief Largest compressed size of @p size bytes. */
+
+
+/******************************************************************************/
+/*  Function Declarations                                                     */
+/******************************************************************************/
+
+
+size_t snap_lzCompress(const uint8_t *source, size_t size, uint8_t *destination);
+
+int snap_lzDecompress(const uint8_t *source, size_t size, uint8_t *destination, size_t *destinationSize);
+
+#endif	// SNAP_LZ_H_
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,383 @@
+/**
+ * @file   snap_metrics.c
+ * @author Lucas Jadilo
+ * @brief  Metrics of running tools (gateways), exported in the Prometheus text format over a Unix socket.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "snap_align.h"
+#include "snap_metrics.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define REQUEST_TIMEOUT_MS	(100)	// Time given to a client to send an HTTP request before the plain text is sent
+#define HTTP_HEADER			"HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nConnection: close\r\n\r\n"
+
+
+/******************************************************************************/
+/*  Private Functions                                                         */
+/******************************************************************************/
+
+
+static snap_metricsChannel_t *getChannel(const snap_metrics_t *metrics, const uint32_t index)
+{
+	return (snap_metricsChannel_t *)((uint8_t *)metrics->memory + index * metrics->stride);
+}
+
+static uint64_t load(const uint64_t *value)
+{
+	return __atomic_load_n(value, __ATOMIC_RELAXED);
+}
+
+static void printCounter(snap_metrics_t *metrics, FILE *file, const char *name, const char *help,
+						 const snap_metricsCounter_t counter, const char *extraLabel)
+{
+	const uint32_t count = __atomic_load_n(&metrics->count, __ATOMIC_ACQUIRE);
+
+	if(help != NULL)
+	{
+		fprintf(file, "# HELP %s %s\n# TYPE %s counter\n", name, help, name);
+	}
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		const snap_metricsChannel_t *channel = getChannel(metrics, i);
+
+		fprintf(file, "%s{channel=\"%s\"%s} %llu\n", name, channel->name, (extraLabel != NULL) ? extraLabel : "",
+				(unsigned long long)load(&channel->counters[counter]));
+	}
+}
+
+static void serveClient(snap_metrics_t *metrics, const int client)
+{
+	struct pollfd request = {.fd = client, .events = POLLIN};
+	char buffer[256];
+	bool http = false;
+	char *text = NULL;
+	size_t length = 0;
+
+	if(poll(&request, 1, REQUEST_TIMEOUT_MS) > 0)
+	{
+		const ssize_t ret = recv(client, buffer, sizeof(buffer), MSG_DONTWAIT);
+		http = (ret >= 4) && (memcmp(buffer, "GET ", 4) == 0);
+	}
+
+	FILE *file = open_memstream(&text, &length);
+
+	if(file == NULL)
+	{
+		return;
+	}
+
+	if(http)
+	{
+		fputs(HTTP_HEADER, file);
+	}
+
+	snap_metricsPrint(metrics, file);
+	fclose(file);
+
+	for(size_t sent = 0; sent < length; )
+	{
+		const ssize_t ret = send(client, &text[sent], length - sent, MSG_NOSIGNAL);
+
+		if(ret < 0)
+		{
+			if(errno == EINTR) continue;
+			break;
+		}
+
+		sent += (size_t)ret;
+	}
+
+	free(text);
+}
+
+static void *exportMetrics(void *argument)
+{
+	snap_metrics_t *metrics = argument;
+
+	for(;;)
+	{
+		struct pollfd fds[2] = {{.fd = metrics->listenFd, .events = POLLIN}, {.fd = metrics->stopFds[0], .events = POLLIN}};
+
+		if(poll(fds, 2, -1) < 0)
+		{
+			continue;	// EINTR
+		}
+
+		if(fds[1].revents != 0)
+		{
+			break;
+		}
+
+		const int client = accept4(metrics->listenFd, NULL, NULL, SOCK_CLOEXEC);
+
+		if(client >= 0)
+		{
+			serveClient(metrics, client);
+			close(client);
+		}
+	}
+
+	return NULL;
+}
+
+
+/******************************************************************************/
+/*  Public Functions                                                          */
+/******************************************************************************/
+
+
+/**
+ * @brief Create a metrics registry.
+ * @param[out] metrics  Pointer to the registry.
+ * @param[in]  capacity Largest number of channels (at least 1).
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set).
+ */
+int snap_metricsInit(snap_metrics_t *metrics, const uint32_t capacity)
+{
+	if(capacity == 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	metrics->stride = ALIGN(sizeof(snap_metricsChannel_t));
+	metrics->memorySize = capacity * metrics->stride;
+	metrics->memory = mmap(NULL, metrics->memorySize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if(metrics->memory == MAP_FAILED)
+	{
+		metrics->memory = NULL;
+		return -1;
+	}
+
+	metrics->capacity = capacity;
+	metrics->count = 0;
+	metrics->listenFd = -1;
+	metrics->stopFds[0] = -1;
+	metrics->stopFds[1] = -1;
+	metrics->path[0] = '\0';
+
+	return 0;
+}
+
+/**
+ * @brief Add a channel to the registry (its metrics start at zero).
+ * @details Channels can be added while the exporter runs, but by a single thread at a time. Quotes,
+ *          backslashes and control characters of the name are replaced, so it is always a valid label value.
+ * @param[in,out] metrics Pointer to the registry.
+ * @param[in]     name    Name of the channel (value of the label "channel"), truncated if needed.
+ * @return Pointer to the channel, or NULL if the registry is full.
+ */
+snap_metricsChannel_t *snap_metricsAddChannel(snap_metrics_t *metrics, const char *name)
+{
+	const uint32_t index = metrics->count;
+
+	if(index == metrics->capacity)
+	{
+		return NULL;
+	}
+
+	snap_metricsChannel_t *channel = getChannel(metrics, index);
+	size_t i = 0;
+
+	for(; (name[i] != '\0') && (i < SNAP_METRICS_SIZE_NAME - 1U); i++)
+	{
+		const char c = name[i];
+		channel->name[i] = ((c == '"') || (c == '\\') || ((unsigned char)c < 0x20U)) ? '_' : c;
+	}
+
+	channel->name[i] = '\0';
+	__atomic_store_n(&metrics->count, index + 1U, __ATOMIC_RELEASE);
+
+	return channel;
+}
+
+/**
+ * @brief Start the exporter thread, listening on a Unix socket.
+ * @details A stale socket left at the path (e.g. by a crash) is replaced. Any other file is not.
+ * @param[in,out] metrics Pointer to the registry.
+ * @param[in]     path    Path of the socket.
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set).
+ */
+int snap_metricsStart(snap_metrics_t *metrics, const char *path)
+{
+	struct sockaddr_un address = {.sun_family = AF_UNIX};
+	struct stat info;
+
+	if(strlen(path) >= sizeof(address.sun_path))
+	{
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	strcpy(address.sun_path, path);
+
+	if((lstat(path, &info) == 0) && S_ISSOCK(info.st_mode))
+	{
+		unlink(path);
+	}
+
+	metrics->listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+	if((metrics->listenFd < 0) || (bind(metrics->listenFd, (struct sockaddr *)&address, sizeof(address)) < 0))
+	{
+		const int error = errno;
+		snap_metricsStop(metrics);
+		errno = error;
+		return -1;
+	}
+
+	strcpy(metrics->path, path);	// From now on, snap_metricsStop() removes the socket
+
+	int error = 0;
+
+	if((listen(metrics->listenFd, 16) < 0) || (pipe2(metrics->stopFds, O_CLOEXEC) < 0))
+	{
+		error = errno;
+	}
+	else if((error = pthread_create(&metrics->thread, NULL, exportMetrics, metrics)) != 0)
+	{
+		close(metrics->stopFds[1]);		// No thread to stop
+		metrics->stopFds[1] = -1;
+	}
+
+	if(error != 0)
+	{
+		snap_metricsStop(metrics);
+		errno = error;
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Print a snapshot of the metrics of every channel, in the Prometheus text format (version 0.0.4).
+ * @param[in] metrics Pointer to the registry.
+ * @param[in] file    Output file.
+ */
+void snap_metricsPrint(snap_metrics_t *metrics, FILE *file)
+{
+	const uint32_t count = __atomic_load_n(&metrics->count, __ATOMIC_ACQUIRE);
+
+	printCounter(metrics, file, "snap_bytes_total", "Bytes received (or sent, by an output channel).", SNAP_METRICS_BYTES, NULL);
+	printCounter(metrics, file, "snap_frames_total", "Frames decoded, by final status.", SNAP_METRICS_VALID, ",status=\"valid\"");
+	printCounter(metrics, file, "snap_frames_total", NULL, SNAP_METRICS_HASH_ERRORS, ",status=\"hash_error\"");
+	printCounter(metrics, file, "snap_frames_total", NULL, SNAP_METRICS_OVERFLOW_ERRORS, ",status=\"overflow\"");
+	printCounter(metrics, file, "snap_forwarded_frames_total", "Frames forwarded or sent.", SNAP_METRICS_FORWARDED, NULL);
+	printCounter(metrics, file, "snap_dropped_frames_total", "Frames dropped.", SNAP_METRICS_DROPPED, NULL);
+
+	fputs("# HELP snap_queue_depth Frames or bytes waiting in the queue of the channel.\n# TYPE snap_queue_depth gauge\n", file);
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		const snap_metricsChannel_t *channel = getChannel(metrics, i);
+
+		fprintf(file, "snap_queue_depth{channel=\"%s\"} %lld\n", channel->name,
+				(long long)__atomic_load_n(&channel->queueDepth, __ATOMIC_RELAXED));
+	}
+
+	fputs("# HELP snap_frame_latency_seconds Frame latency measured by the tool.\n# TYPE snap_frame_latency_seconds histogram\n", file);
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		const snap_metricsChannel_t *channel = getChannel(metrics, i);
+		uint64_t cumulative = 0;
+
+		for(uint32_t j = 0; j < SNAP_METRICS_BUCKETS; j++)
+		{
+			cumulative += load(&channel->buckets[j]);
+
+			if(j < SNAP_METRICS_BUCKETS - 1U)
+			{
+				fprintf(file, "snap_frame_latency_seconds_bucket{channel=\"%s\",le=\"%.7g\"} %llu\n",
+						channel->name, (double)(1ULL << j) * 1e-6, (unsigned long long)cumulative);
+			}
+			else
+			{
+				fprintf(file, "snap_frame_latency_seconds_bucket{channel=\"%s\",le=\"+Inf\"} %llu\n",
+						channel->name, (unsigned long long)cumulative);
+			}
+		}
+
+		fprintf(file, "snap_frame_latency_seconds_sum{channel=\"%s\"} %.9f\n", channel->name, (double)load(&channel->latencySum) * 1e-9);
+		fprintf(file, "snap_frame_latency_seconds_count{channel=\"%s\"} %llu\n", channel->name, (unsigned long long)cumulative);
+	}
+}
+
+/**
+ * @brief Stop the exporter thread and remove the socket (the channels remain valid).
+ * @param[in,out] metrics Pointer to the registry.
+ */
+void snap_metricsStop(snap_metrics_t *metrics)
+{
+	if(metrics->path[0] != '\0')
+	{
+		const char stop = 1;
+
+		if(write(metrics->stopFds[1], &stop, 1) == 1)
+		{
+			pthread_join(metrics->thread, NULL);
+		}
+
+		unlink(metrics->path);
+		metrics->path[0] = '\0';
+	}
+
+	for(int i = 0; i < 2; i++)
+	{
+		if(metrics->stopFds[i] >= 0)
+		{
+			close(metrics->stopFds[i]);
+			metrics->stopFds[i] = -1;
+		}
+	}
+
+	if(metrics->listenFd >= 0)
+	{
+		close(metrics->listenFd);
+		metrics->listenFd = -1;
+	}
+}
+
+/**
+ * @brief Stop the exporter thread (if it runs) and free the memory of the registry.
+ * @param[in,out] metrics Pointer to the registry.
+ */
+void snap_metricsDestroy(snap_metrics_t *metrics)
+{
+	snap_metricsStop(metrics);
+
+	if(metrics->memory != NULL)
+	{
+		munmap(metrics->memory, metrics->memorySize);
+		metrics->memory = NULL;
+	}
+}
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,167 @@
+/**
+ * @file   snap_metrics.h
+ * @author Lucas Jadilo
+ * @brief  Metrics of running tools (gateways), exported in the Prometheus text format over a Unix socket.
+ * @details Each channel (e.g. a port) has its own counters, queue depth gauge and latency histogram, on
+ *          their own cache lines, and is updated by a single thread: an update is a plain load and a
+ *          relaxed atomic store, with no lock and no read-modify-write instruction, so the hot path costs
+ *          about the same as incrementing a local variable. The exporter thread reads every value with
+ *          relaxed atomic loads, i.e. it takes a snapshot without stopping the writers (the values of a
+ *          snapshot may be a few updates apart from each other, but none is ever torn).
+ *
+ *          The exporter answers every connection to its Unix socket with the current metrics and closes it.
+ *          If the client sends an HTTP GET request first, the answer has an HTTP header, so the socket can be
+ *          scraped through any HTTP client or proxy (e.g. `curl --unix-socket /run/snapgw.sock http://x/metrics`);
+ *          otherwise the plain text is sent (e.g. `socat - UNIX-CONNECT:/run/snapgw.sock`).
+ */
+
+#ifndef SNAP_METRICS_H_
+#define SNAP_METRICS_H_
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define SNAP_METRICS_SIZE_NAME	(48U)	/**< @brief Size of a channel name, including the null character. */
+#define SNAP_METRICS_BUCKETS	(22U)	/**< @brief Latency buckets: up to 1 us, 2 us, 4 us... 2^20 us, and above. */
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+/**
+ * @brief Counters of a channel.
+ */
+typedef enum snap_metricsCounter_t
+{
+	SNAP_METRICS_BYTES           = 0,	/**< Bytes received (or sent, by an output channel). */
+	SNAP_METRICS_VALID           = 1,	/**< Frames with status #SNAP_STATUS_VALID. */
+	SNAP_METRICS_HASH_ERRORS     = 2,	/**< Frames with status #SNAP_STATUS_ERROR_HASH. */
+	SNAP_METRICS_OVERFLOW_ERRORS = 3,	/**< Frames with status #SNAP_STATUS_ERROR_OVERFLOW. */
+	SNAP_METRICS_FORWARDED       = 4,	/**< Frames forwarded or sent. */
+	SNAP_METRICS_DROPPED         = 5,	/**< Frames dropped (e.g. no route, or full queue). */
+	SNAP_METRICS_COUNTERS        = 6	/**< Number of counters. */
+} snap_metricsCounter_t;
+
+/**
+ * @brief Metrics of a channel, updated by a single thread.
+ */
+typedef struct snap_metricsChannel_t
+{
+	uint64_t counters[SNAP_METRICS_COUNTERS];	/**< @brief Counters. Accessed with __atomic builtins. */
+	int64_t  queueDepth;						/**< @brief Frames or bytes waiting in the queue of the channel. Accessed with __atomic builtins. */
+	uint64_t buckets[SNAP_METRICS_BUCKETS];		/**< @brief Latency histogram (not cumulative). Accessed with __atomic builtins. */
+	uint64_t latencySum;						/**< @brief Sum of the latencies, in nanoseconds. Accessed with __atomic builtins. */
+	char     name[SNAP_METRICS_SIZE_NAME];		/**< @brief Value of the label "channel". */
+} snap_metricsChannel_t;
+
+/**
+ * @brief Metrics registry and exporter.
+ */
+typedef struct snap_metrics_t
+{
+	void      *memory;			/**< @brief Mapping that holds the channels, each on its own cache lines. */
+	size_t    memorySize;		/**< @brief Size of the mapping. */
+	size_t    stride;			/**< @brief Distance between two channels in the mapping. */
+	uint32_t  capacity;			/**< @brief Largest number of channels. */
+	uint32_t  count;			/**< @brief Number of channels. Accessed with __atomic builtins. */
+	int       listenFd;			/**< @brief Listening socket, or -1. */
+	int       stopFds[2];		/**< @brief Pipe that wakes the exporter thread up to stop it. */
+	pthread_t thread;			/**< @brief Exporter thread. */
+	char      path[108];		/**< @brief Path of the socket. */
+} snap_metrics_t;
+
+
+/******************************************************************************/
+/*  Function Declarations                                                     */
+/******************************************************************************/
+
+
+int snap_metricsInit(snap_metrics_t *metrics, uint32_t capacity);
+
+snap_metricsChannel_t *snap_metricsAddChannel(snap_metrics_t *metrics, const char *name);
+
+int snap_metricsStart(snap_metrics_t *metrics, const char *path);
+
+void snap_metricsPrint(snap_metrics_t *metrics, FILE *file);
+
+void snap_metricsStop(snap_metrics_t *metrics);
+
+void snap_metricsDestroy(snap_metrics_t *metrics);
+
+
+/******************************************************************************/
+/*  Inline Functions                                                          */
+/******************************************************************************/
+
+
+/**
+ * @brief Add to a counter. It must be called by the thread that owns the channel only.
+ * @param[in,out] channel Pointer to the channel.
+ * @param[in]     counter Counter.
+ * @param[in]     value   Value added.
+ */
+static inline void snap_metricsAdd(snap_metricsChannel_t *channel, const snap_metricsCounter_t counter, const uint64_t value)
+{
+	__atomic_store_n(&channel->counters[counter], channel->counters[counter] + value, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Set a counter, e.g. to a total kept by another module. It must be called by the thread that owns the channel only.
+ * @param[in,out] channel Pointer to the channel.
+ * @param[in]     counter Counter.
+ * @param[in]     value   New value (it must not be less than the previous one).
+ */
+static inline void snap_metricsSet(snap_metricsChannel_t *channel, const snap_metricsCounter_t counter, const uint64_t value)
+{
+	__atomic_store_n(&channel->counters[counter], value, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Set the queue depth gauge. It must be called by the thread that owns the channel only.
+ * @param[in,out] channel Pointer to the channel.
+ * @param[in]     depth   Current depth.
+ */
+static inline void snap_metricsSetQueueDepth(snap_metricsChannel_t *channel, const int64_t depth)
+{
+	__atomic_store_n(&channel->queueDepth, depth, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Add a latency to the histogram. It must be called by the thread that owns the channel only.
+ * @param[in,out] channel   Pointer to the channel.
+ * @param[in]     latencyNs Latency in nanoseconds.
+ */
+static inline void snap_metricsObserve(snap_metricsChannel_t *channel, const uint64_t latencyNs)
+{
+	const uint64_t us = (latencyNs + 999U) / 1000U;
+	unsigned int bucket = (us <= 1U) ? 0U : (unsigned int)(64 - __builtin_clzll(us - 1U));	// Smallest i such that us <= 2^i
+
+	if(bucket >= SNAP_METRICS_BUCKETS)
+	{
+		bucket = SNAP_METRICS_BUCKETS - 1U;
+	}
+
+	__atomic_store_n(&channel->buckets[bucket], channel->buckets[bucket] + 1U, __ATOMIC_RELAXED);
+	__atomic_store_n(&channel->latencySum, channel->latencySum + latencyNs, __ATOMIC_RELAXED);
+}
+
+#endif	// SNAP_METRICS_H_
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,275 @@
+/**
+ * @file   snap_pcapng.c
+ * @author Lucas Jadilo
+ * @brief  pcapng writer: export SNAP frames to standard packet analyzers (Wireshark, tshark, tcpdump).
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include "snap_pcapng.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define BLOCK_SHB	(0x0A0D0D0AU)
+#define BLOCK_IDB	(0x00000001U)
+#define BLOCK_EPB	(0x00000006U)
+
+#define BYTE_ORDER_MAGIC	(0x1A2B3C4DU)
+
+#define OPT_ENDOFOPT	(0U)
+#define OPT_COMMENT		(1U)
+#define OPT_USERAPPL	(4U)	// shb_userappl
+#define OPT_NAME		(2U)	// if_name
+#define OPT_TSRESOL		(9U)	// if_tsresol
+#define OPT_FLAGS		(2U)	// epb_flags
+
+#define FLAG_INBOUND		(0x00000001U)
+#define FLAG_CRC_ERROR		(0x01000000U)
+#define FLAG_TOO_LONG		(0x02000000U)
+
+#define COMMENT_HASH		"SNAP status: hash error"
+#define COMMENT_OVERFLOW	"SNAP status: overflow error"
+
+#define SIZE_PADDED(size)	(((size) + 3U) & ~3U)	// Options and packet data are padded to 32 bits
+#define SIZE_OPTION(size)	(4U + SIZE_PADDED(size))	// Code, length and padded value
+#define MAX_SIZE_COMMENT	((sizeof(COMMENT_HASH) > sizeof(COMMENT_OVERFLOW)) ? (sizeof(COMMENT_HASH) - 1U) : (sizeof(COMMENT_OVERFLOW) - 1U))
+
+#define MAX_SIZE_IDB	(64U)	// Header, if_name ("snap" + 5 digits), if_tsresol, end of options, trailer
+#define MAX_SIZE_EPB	(28U + SIZE_PADDED(SNAP_MAX_SIZE_FRAME) + SIZE_OPTION(4U) + SIZE_OPTION(MAX_SIZE_COMMENT) + 4U + 4U)	// Header, data, epb_flags, longest comment, end of options, trailer
+
+
+/******************************************************************************/
+/*  Private Functions                                                         */
+/******************************************************************************/
+
+
+static uint8_t *put16(uint8_t *p, const uint16_t value)
+{
+	memcpy(p, &value, sizeof(value));
+	return p + sizeof(value);
+}
+
+static uint8_t *put32(uint8_t *p, const uint32_t value)
+{
+	memcpy(p, &value, sizeof(value));
+	return p + sizeof(value);
+}
+
+static uint8_t *putOption(uint8_t *p, const uint16_t code, const void *value, const uint16_t size)
+{
+	p = put16(p, code);
+	p = put16(p, size);
+	memcpy(p, value, size);
+	p += size;
+
+	for(uint_fast16_t i = size; i % 4U; i++)
+	{
+		*p++ = 0;
+	}
+
+	return p;
+}
+
+static uint8_t *beginBlock(uint8_t *p, const uint32_t type)
+{
+	p = put32(p, type);
+	return put32(p, 0);	// Total length, filled by endBlock()
+}
+
+static uint8_t *endBlock(uint8_t *start, uint8_t *p)
+{
+	p = put32(p, OPT_ENDOFOPT);	// opt_endofopt (code and length)
+	const uint32_t size = (uint32_t)(p - start) + 4U;
+	put32(&start[4], size);
+	return put32(p, size);
+}
+
+static int reserve(snap_pcapngWriter_t *writer, const size_t size)
+{
+	if(writer->length > sizeof(writer->buffer) - size)
+	{
+		return snap_pcapngFlush(writer);
+	}
+
+	return 0;
+}
+
+static int writeInterface(snap_pcapngWriter_t *writer)
+{
+	if(reserve(writer, MAX_SIZE_IDB) < 0)
+	{
+		return -1;
+	}
+
+	char name[16] = "snap";
+	uint_fast8_t size = 4;
+	const uint8_t tsresol = 9;	// Nanoseconds
+	uint8_t *start = &writer->buffer[writer->length];
+	uint8_t *p = beginBlock(start, BLOCK_IDB);
+
+	for(uint32_t divisor = 10000; divisor; divisor /= 10)
+	{
+		if((writer->interfaces >= divisor) || (divisor == 1))
+		{
+			name[size++] = (char)('0' + (writer->interfaces / divisor) % 10U);
+		}
+	}
+
+	p = put16(p, SNAP_PCAPNG_LINKTYPE);
+	p = put16(p, 0);
+	p = put32(p, SNAP_MAX_SIZE_FRAME);	// snaplen
+	p = putOption(p, OPT_NAME, name, size);
+	p = putOption(p, OPT_TSRESOL, &tsresol, 1);
+	p = endBlock(start, p);
+
+	writer->length += (size_t)(p - start);
+	writer->interfaces++;
+	return 0;
+}
+
+
+/******************************************************************************/
+/*  Public Functions                                                          */
+/******************************************************************************/
+
+
+/**
+ * @brief Initialize the writer and put the section header in its buffer.
+ * @details The file descriptor is not closed by the writer.
+ * @param[out] writer Pointer to the writer structure.
+ * @param[in]  fd     Output file descriptor (file, pipe or socket).
+ * @retval 0 Success (it cannot fail).
+ */
+int snap_pcapngWriterInit(snap_pcapngWriter_t *writer, const int fd)
+{
+	static const char application[] = "libSNAP";
+	uint8_t *start = writer->buffer;
+	uint8_t *p = beginBlock(start, BLOCK_SHB);
+
+	writer->fd = fd;
+	writer->records = 0;
+	writer->interfaces = 0;
+
+	p = put32(p, BYTE_ORDER_MAGIC);
+	p = put16(p, 1);	// Major version
+	p = put16(p, 0);	// Minor version
+	p = put32(p, UINT32_MAX);	// Section length (unknown: -1)
+	p = put32(p, UINT32_MAX);
+	p = putOption(p, OPT_USERAPPL, application, sizeof(application) - 1U);
+	p = endBlock(start, p);
+
+	writer->length = (size_t)(p - start);
+	return 0;
+}
+
+/**
+ * @brief Append a frame to the file, as an Enhanced Packet Block.
+ * @details The interface of the channel (and the ones of all the channels before it) is described
+ *          the first time the channel is used.
+ * @param[in,out] writer    Pointer to the writer structure.
+ * @param[in]     timestamp Nanoseconds since the Unix epoch.
+ * @param[in]     channel   Channel number (interface ID).
+ * @param[in]     frame     Pointer to the frame structure. All the bytes stored in the frame are written, whatever the status.
+ * @retval 0  Success.
+ * @retval -1 Error while flushing the buffer (errno is set).
+ */
+int snap_pcapngWrite(snap_pcapngWriter_t *writer, const uint64_t timestamp, const uint16_t channel, const snap_frame_t *frame)
+{
+	while(writer->interfaces <= channel)
+	{
+		if(writeInterface(writer) < 0)
+		{
+			return -1;
+		}
+	}
+
+	if(reserve(writer, MAX_SIZE_EPB) < 0)
+	{
+		return -1;
+	}
+
+	uint32_t flags = FLAG_INBOUND;
+	uint8_t *start = &writer->buffer[writer->length];
+	uint8_t *p = beginBlock(start, BLOCK_EPB);
+
+	p = put32(p, channel);
+	p = put32(p, (uint32_t)(timestamp >> 32));
+	p = put32(p, (uint32_t)timestamp);
+	p = put32(p, frame->size);	// Captured length
+	p = put32(p, frame->size);	// Original length
+
+	memcpy(p, frame->buffer, frame->size);
+	p += frame->size;
+
+	for(uint_fast16_t i = frame->size; i % 4U; i++)
+	{
+		*p++ = 0;
+	}
+
+	if(frame->status == SNAP_STATUS_ERROR_HASH)
+	{
+		flags |= FLAG_CRC_ERROR;
+		p = putOption(p, OPT_FLAGS, &flags, sizeof(flags));
+		p = putOption(p, OPT_COMMENT, COMMENT_HASH, sizeof(COMMENT_HASH) - 1U);
+	}
+	else if(frame->status == SNAP_STATUS_ERROR_OVERFLOW)
+	{
+		flags |= FLAG_TOO_LONG;
+		p = putOption(p, OPT_FLAGS, &flags, sizeof(flags));
+		p = putOption(p, OPT_COMMENT, COMMENT_OVERFLOW, sizeof(COMMENT_OVERFLOW) - 1U);
+	}
+	else
+	{
+		p = putOption(p, OPT_FLAGS, &flags, sizeof(flags));
+	}
+
+	p = endBlock(start, p);
+
+	writer->length += (size_t)(p - start);
+	writer->records++;
+	return 0;
+}
+
+/**
+ * @brief Write the buffered blocks to the file descriptor.
+ * @param[in,out] writer Pointer to the writer structure.
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set). The buffered blocks are discarded.
+ */
+int snap_pcapngFlush(snap_pcapngWriter_t *writer)
+{
+	const uint8_t *data = writer->buffer;
+	size_t size = writer->length;
+
+	writer->length = 0;
+
+	while(size)
+	{
+		const ssize_t ret = write(writer->fd, data, size);
+
+		if(ret < 0)
+		{
+			if(errno == EINTR) continue;
+			return -1;
+		}
+
+		data += ret;
+		size -= (size_t)ret;
+	}
+
+	return 0;
+}
+
+/******************************** END OF FILE *********************************/
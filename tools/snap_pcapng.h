@@ -0,0 +1,72 @@
+/**
+ * @file   snap_pcapng.h
+ * @author Lucas Jadilo
+ * @brief  pcapng writer: export SNAP frames to standard packet analyzers (Wireshark, tshark, tcpdump).
+ * @details The file has one section, with one interface per channel (the interface ID is the channel
+ *          number) and one Enhanced Packet Block per frame, with nanosecond timestamps (if_tsresol=9).
+ *          SNAP has no registered link type, so the interfaces use @c LINKTYPE_USER0 (#SNAP_PCAPNG_LINKTYPE),
+ *          which can be mapped to a dissector in the analyzer (e.g. Wireshark's "DLT User" table).
+ *
+ *          Every frame is written, whatever its status. The status is stored in the @c epb_flags option
+ *          (bit 24 = CRC error for hash errors, bit 25 = packet too long for overflows) and, for
+ *          invalid frames, also in an @c opt_comment.
+ *
+ *          The blocks are built directly from the frame buffer into a fixed buffer inside the writer
+ *          structure, which is written to the file descriptor only when it is full or flushed, so
+ *          nothing is allocated per frame. Integers are written in host byte order, as allowed by
+ *          the format (the byte-order magic tells the readers which one is used).
+ */
+
+#ifndef SNAP_PCAPNG_H_
+#define SNAP_PCAPNG_H_
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include "snap.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define SNAP_PCAPNG_LINKTYPE		(147U)			/**< @brief Link type of the interfaces (LINKTYPE_USER0). */
+#define SNAP_PCAPNG_SIZE_BUFFER		(64U * 1024U)	/**< @brief Size of the writer buffer. */
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+/**
+ * @brief Buffered pcapng writer.
+ */
+typedef struct snap_pcapngWriter_t
+{
+	uint8_t  buffer[SNAP_PCAPNG_SIZE_BUFFER];	/**< @brief Blocks not yet written to the file. */
+	size_t   length;							/**< @brief Number of bytes in the buffer. */
+	uint64_t records;							/**< @brief Number of frames written. */
+	uint32_t interfaces;						/**< @brief Number of interfaces described so far (channels 0 to interfaces-1). */
+	int      fd;								/**< @brief Output file descriptor. */
+} snap_pcapngWriter_t;
+
+
+/******************************************************************************/
+/*  Function Declarations                                                     */
+/******************************************************************************/
+
+
+int snap_pcapngWriterInit(snap_pcapngWriter_t *writer, int fd);
+
+int snap_pcapngWrite(snap_pcapngWriter_t *writer, uint64_t timestamp, uint16_t channel, const snap_frame_t *frame);
+
+int snap_pcapngFlush(snap_pcapngWriter_t *writer);
+
+#endif	// SNAP_PCAPNG_H_
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,200 @@
+/**
+ * @file   snap_perf.c
+ * @author Lucas Jadilo
+ * @brief  Hardware performance counters (perf_event_open) for the benchmark tools.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "snap_perf.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define CACHE_EVENT(cache)	((uint64_t)(cache) | ((uint64_t)PERF_COUNT_HW_CACHE_OP_READ << 8) | ((uint64_t)PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+
+/******************************************************************************/
+/*  Private Functions                                                         */
+/******************************************************************************/
+
+
+static int openEvent(const uint32_t type, const uint64_t config)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+
+/******************************************************************************/
+/*  Public Functions                                                          */
+/******************************************************************************/
+
+
+/**
+ * @brief Open the counters of the calling thread (they are stopped).
+ * @param[out] perf Pointer to the counter set.
+ * @retval 0  At least one event is available.
+ * @retval -1 No event is available (errno is set by the first failure, e.g. EACCES, ENOENT or ENOSYS).
+ */
+int snap_perfOpen(snap_perf_t *perf)
+{
+	static const struct { uint32_t type; uint64_t config; } events[SNAP_PERF_EVENTS] =
+	{
+		[SNAP_PERF_CYCLES]        = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+		[SNAP_PERF_INSTRUCTIONS]  = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+		[SNAP_PERF_BRANCH_MISSES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+		[SNAP_PERF_L1D_MISSES]    = {PERF_TYPE_HW_CACHE, CACHE_EVENT(PERF_COUNT_HW_CACHE_L1D)},
+		[SNAP_PERF_LLC_MISSES]    = {PERF_TYPE_HW_CACHE, CACHE_EVENT(PERF_COUNT_HW_CACHE_LL)},
+	};
+	int firstError = 0;
+	bool any = false;
+
+	for(int i = 0; i < SNAP_PERF_EVENTS; i++)
+	{
+		perf->fds[i] = openEvent(events[i].type, events[i].config);
+
+		if(perf->fds[i] >= 0)
+		{
+			any = true;
+		}
+		else if(firstError == 0)
+		{
+			firstError = errno;
+		}
+	}
+
+	if(!any)
+	{
+		errno = firstError;
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Reset and start the counters.
+ * @param[in] perf Pointer to the counter set.
+ */
+void snap_perfStart(snap_perf_t *perf)
+{
+	for(int i = 0; i < SNAP_PERF_EVENTS; i++)
+	{
+		if(perf->fds[i] >= 0)
+		{
+			ioctl(perf->fds[i], PERF_EVENT_IOC_RESET, 0);
+			ioctl(perf->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+}
+
+/**
+ * @brief Stop the counters and read them.
+ * @param[in]  perf   Pointer to the counter set.
+ * @param[out] counts Values counted since snap_perfStart().
+ */
+void snap_perfStop(snap_perf_t *perf, snap_perfCounts_t *counts)
+{
+	for(int i = 0; i < SNAP_PERF_EVENTS; i++)
+	{
+		if(perf->fds[i] >= 0)
+		{
+			ioctl(perf->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+		}
+	}
+
+	for(int i = 0; i < SNAP_PERF_EVENTS; i++)
+	{
+		uint64_t data[3];	// Value, time enabled, time running
+
+		counts->available[i] = (perf->fds[i] >= 0) && (read(perf->fds[i], data, sizeof(data)) == (ssize_t)sizeof(data)) && (data[2] != 0);
+		counts->values[i] = counts->available[i] ? (double)data[0] * ((double)data[1] / (double)data[2]) : 0.0;
+	}
+}
+
+/**
+ * @brief Print the column titles of snap_perfPrint().
+ * @param[in] file Output file.
+ */
+void snap_perfPrintHeader(FILE *file)
+{
+	fprintf(file, " %9s %9s %5s %9s %9s %9s", "cycles", "instr", "IPC", "br-miss", "L1d-miss", "LLC-miss");
+}
+
+/**
+ * @brief Print the values per operation, in columns (a dash for the events not available).
+ * @param[in] file       Output file.
+ * @param[in] counts     Values of the counter set.
+ * @param[in] operations Number of operations measured (e.g. frames).
+ */
+void snap_perfPrint(FILE *file, const snap_perfCounts_t *counts, const uint64_t operations)
+{
+	const double scale = (operations != 0) ? 1.0 / (double)operations : 0.0;
+
+	for(int i = 0; i < SNAP_PERF_EVENTS; i++)
+	{
+		if(i == SNAP_PERF_BRANCH_MISSES)
+		{
+			if(counts->available[SNAP_PERF_CYCLES] && counts->available[SNAP_PERF_INSTRUCTIONS] && (counts->values[SNAP_PERF_CYCLES] > 0.0))
+			{
+				fprintf(file, " %5.2f", counts->values[SNAP_PERF_INSTRUCTIONS] / counts->values[SNAP_PERF_CYCLES]);
+			}
+			else
+			{
+				fprintf(file, " %5s", "-");
+			}
+		}
+
+		if(counts->available[i])
+		{
+			fprintf(file, " %9.*f", (i >= SNAP_PERF_BRANCH_MISSES) ? 3 : 1, counts->values[i] * scale);
+		}
+		else
+		{
+			fprintf(file, " %9s", "-");
+		}
+	}
+}
+
+/**
+ * @brief Close the counters.
+ * @param[in,out] perf Pointer to the counter set.
+ */
+void snap_perfClose(snap_perf_t *perf)
+{
+	for(int i = 0; i < SNAP_PERF_EVENTS; i++)
+	{
+		if(perf->fds[i] >= 0)
+		{
+			close(perf->fds[i]);
+			perf->fds[i] = -1;
+		}
+	}
+}
+
+/******************************** END OF FILE *********************************/
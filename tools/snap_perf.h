@@ -0,0 +1,84 @@
+/**
+ * @file   snap_perf.h
+ * @author Lucas Jadilo
+ * @brief  Hardware performance counters (perf_event_open) for the benchmark tools.
+ * @details A counter set measures the cycles, instructions, branch misses, L1 data cache read misses and
+ *          last level cache read misses of the calling thread, in user space only, between snap_perfStart()
+ *          and snap_perfStop(). Each counter is opened on its own, so the events that the CPU (or the
+ *          hypervisor) does not support are simply left out. When the kernel does not allow any of them
+ *          (e.g. perf_event_paranoid > 2, or a seccomp filter in a container), snap_perfOpen() fails and the
+ *          benchmarks run without counters.
+ *
+ *          If the kernel multiplexes the counters, the values are scaled by the fraction of time they ran.
+ */
+
+#ifndef SNAP_PERF_H_
+#define SNAP_PERF_H_
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+/**
+ * @brief Events counted.
+ */
+typedef enum snap_perfEvent_t
+{
+	SNAP_PERF_CYCLES        = 0,	/**< CPU cycles. */
+	SNAP_PERF_INSTRUCTIONS  = 1,	/**< Instructions retired. */
+	SNAP_PERF_BRANCH_MISSES = 2,	/**< Mispredicted branches. */
+	SNAP_PERF_L1D_MISSES    = 3,	/**< L1 data cache read misses. */
+	SNAP_PERF_LLC_MISSES    = 4,	/**< Last level cache read misses. */
+	SNAP_PERF_EVENTS        = 5		/**< Number of events. */
+} snap_perfEvent_t;
+
+/**
+ * @brief Counter set.
+ */
+typedef struct snap_perf_t
+{
+	int fds[SNAP_PERF_EVENTS];	/**< @brief File descriptor of each counter, or -1 if the event is not available. */
+} snap_perf_t;
+
+/**
+ * @brief Values of a counter set.
+ */
+typedef struct snap_perfCounts_t
+{
+	double values[SNAP_PERF_EVENTS];		/**< @brief Value of each event (scaled if the counter was multiplexed). */
+	bool   available[SNAP_PERF_EVENTS];		/**< @brief The event was counted. */
+} snap_perfCounts_t;
+
+
+/******************************************************************************/
+/*  Function Declarations                                                     */
+/******************************************************************************/
+
+
+int snap_perfOpen(snap_perf_t *perf);
+
+void snap_perfStart(snap_perf_t *perf);
+
+void snap_perfStop(snap_perf_t *perf, snap_perfCounts_t *counts);
+
+void snap_perfPrintHeader(FILE *file);
+
+void snap_perfPrint(FILE *file, const snap_perfCounts_t *counts, uint64_t operations);
+
+void snap_perfClose(snap_perf_t *perf);
+
+#endif	// SNAP_PERF_H_
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,390 @@
+/**
+ * @file   snap_pool.c
+ * @author Lucas Jadilo
+ * @brief  NUMA-aware frame pools and channel state for multi-port hosts (gateways).
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "snap_align.h"
+#include "snap_pool.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define NODE_PATH			"/sys/devices/system/node"
+#define MPOL_PREFERRED		(1)						// Memory policy of mbind(): allocate on the node if possible
+#define BITS_PER_LONG		(8U * sizeof(unsigned long))
+
+
+/******************************************************************************/
+/*  Private Functions                                                         */
+/******************************************************************************/
+
+
+/**
+ * @brief Read a sysfs list such as "0-3,8-11".
+ * @param[in]  path Path of the file.
+ * @param[out] set  Set where the values are added, or NULL.
+ * @return Largest value in the list, or -1 on error (errno is set).
+ */
+static int readList(const char *path, cpu_set_t *set)
+{
+	FILE *file = fopen(path, "r");
+	char text[4096];
+	int max = -1;
+
+	if(file == NULL)
+	{
+		return -1;
+	}
+
+	if(fgets(text, sizeof(text), file) == NULL)
+	{
+		fclose(file);
+		errno = EINVAL;
+		return -1;
+	}
+
+	fclose(file);
+
+	for(char *p = text; (*p != '\0') && (*p != '\n'); )
+	{
+		char *end;
+		const long first = strtol(p, &end, 10);
+		long last = first;
+
+		if((end == p) || (first < 0))
+		{
+			errno = EINVAL;
+			return -1;
+		}
+
+		if(*end == '-')
+		{
+			p = end + 1;
+			last = strtol(p, &end, 10);
+
+			if((end == p) || (last < first))
+			{
+				errno = EINVAL;
+				return -1;
+			}
+		}
+
+		for(long value = first; (set != NULL) && (value <= last) && (value < CPU_SETSIZE); value++)
+		{
+			CPU_SET((size_t)value, set);
+		}
+
+		max = (last > max) ? (int)last : max;
+		p = (*end == ',') ? end + 1 : end;
+	}
+
+	return max;
+}
+
+
+/******************************************************************************/
+/*  Public Functions                                                          */
+/******************************************************************************/
+
+
+/**
+ * @brief Get the number of NUMA nodes of the host.
+ * @return Number of nodes (the nodes are numbered from 0). It is 1 if the host has no NUMA support.
+ */
+int snap_numaNodeCount(void)
+{
+	const int max = readList(NODE_PATH "/possible", NULL);
+
+	return (max >= 0) ? max + 1 : 1;
+}
+
+/**
+ * @brief Get the NUMA node of the CPU that runs the calling thread.
+ * @return Node number (0 if it cannot be known).
+ */
+int snap_numaCurrentNode(void)
+{
+	unsigned int cpu, node;
+
+	if(syscall(SYS_getcpu, &cpu, &node, NULL) < 0)
+	{
+		return 0;
+	}
+
+	return (int)node;
+}
+
+/**
+ * @brief Pin the calling thread to the CPUs of a NUMA node.
+ * @param[in] node Node number.
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set; EINVAL means the node does not exist or has no CPUs).
+ */
+int snap_numaBindThread(const int node)
+{
+	char path[64];
+	cpu_set_t set;
+
+	snprintf(path, sizeof(path), NODE_PATH "/node%d/cpulist", node);
+	CPU_ZERO(&set);
+
+	if((node < 0) || (readList(path, &set) < 0) || (CPU_COUNT(&set) == 0))
+	{
+		if((node == 0) && (snap_numaNodeCount() == 1))	// No NUMA support: node 0 is the whole host
+		{
+			return 0;
+		}
+
+		errno = EINVAL;
+		return -1;
+	}
+
+	const int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+	if(ret != 0)
+	{
+		errno = ret;
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Allocate zeroed memory on a NUMA node.
+ * @details The memory is bound to the node with the preferred policy (it falls back to other nodes only if
+ *          the node is full) and every page is touched by the calling thread, which should run on that node.
+ *          If the binding is not supported, the pages are placed by the first touch.
+ * @param[in] size Number of bytes.
+ * @param[in] node Node number, or -1 for the node of the calling thread.
+ * @return Pointer to the memory (page aligned), or NULL on error (errno is set).
+ */
+void *snap_numaAlloc(const size_t size, const int node)
+{
+	void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if(memory == MAP_FAILED)
+	{
+		return NULL;
+	}
+
+	if((node >= 0) && ((unsigned int)node < SNAP_POOL_MAX_NODES))
+	{
+		unsigned long mask[SNAP_POOL_MAX_NODES / BITS_PER_LONG] = {0};
+
+		mask[(unsigned int)node / BITS_PER_LONG] = 1UL << ((unsigned int)node % BITS_PER_LONG);
+		syscall(SYS_mbind, memory, size, MPOL_PREFERRED, mask, (unsigned long)SNAP_POOL_MAX_NODES + 1U, 0U);	// Best effort
+	}
+
+	memset(memory, 0, size);
+
+	return memory;
+}
+
+/**
+ * @brief Free memory allocated with snap_numaAlloc().
+ * @param[in] memory Pointer to the memory (NULL is ignored).
+ * @param[in] size   Number of bytes given to snap_numaAlloc().
+ */
+void snap_numaFree(void *memory, const size_t size)
+{
+	if(memory != NULL)
+	{
+		munmap(memory, size);
+	}
+}
+
+/**
+ * @brief Create a pool of frames on a NUMA node.
+ * @details The frames are initialized with snap_init() and are all free.
+ * @param[out] pool      Pointer to the pool structure.
+ * @param[in]  count     Number of frames (1 to 2^31).
+ * @param[in]  frameSize Size of each frame buffer (#SNAP_MIN_SIZE_FRAME to #SNAP_MAX_SIZE_FRAME).
+ * @param[in]  node      Node number, or -1 for the node of the calling thread.
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set).
+ */
+int snap_poolInit(snap_pool_t *pool, const uint32_t count, const uint16_t frameSize, const int node)
+{
+	if((count == 0) || (count > (1U << 31)) || (frameSize < SNAP_MIN_SIZE_FRAME) || (frameSize > SNAP_MAX_SIZE_FRAME))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	const size_t framesSize = ALIGN(count * sizeof(snap_frame_t));
+	const size_t linksSize = ALIGN(count * sizeof(uint32_t));
+	const size_t bufferSize = ALIGN((size_t)frameSize);
+
+	pool->node = (node >= 0) ? node : snap_numaCurrentNode();
+	pool->memorySize = framesSize + linksSize + count * bufferSize;
+	pool->memory = snap_numaAlloc(pool->memorySize, pool->node);
+
+	if(pool->memory == NULL)
+	{
+		return -1;
+	}
+
+	uint8_t *buffers = (uint8_t *)pool->memory + framesSize + linksSize;
+
+	pool->frames = pool->memory;
+	pool->links = (uint32_t *)((uint8_t *)pool->memory + framesSize);
+	pool->count = count;
+	pool->frameSize = frameSize;
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		snap_init(&pool->frames[i], &buffers[i * bufferSize], frameSize);
+		pool->links[i] = (i + 1U < count) ? i + 2U : 0U;
+	}
+
+	__atomic_store_n(&pool->head, 1U, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+/**
+ * @brief Take a free frame from the pool.
+ * @details It can be called by any thread. The frame is reset (see snap_reset()).
+ * @param[in,out] pool Pointer to the pool structure.
+ * @return Pointer to the frame, or NULL if all frames are in use.
+ */
+snap_frame_t *snap_poolGet(snap_pool_t *pool)
+{
+	uint64_t head = __atomic_load_n(&pool->head, __ATOMIC_ACQUIRE);
+	uint64_t newHead;
+	uint32_t first;
+
+	do
+	{
+		first = (uint32_t)head;
+
+		if(first == 0)
+		{
+			return NULL;
+		}
+
+		const uint32_t next = __atomic_load_n(&pool->links[first - 1U], __ATOMIC_RELAXED);	// May be stale: then the tag has changed and the exchange fails
+
+		newHead = (((head >> 32) + 1U) << 32) | next;
+	} while(!__atomic_compare_exchange_n(&pool->head, &head, newHead, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+	snap_frame_t *frame = &pool->frames[first - 1U];
+
+	snap_reset(frame);
+
+	return frame;
+}
+
+/**
+ * @brief Return a frame to the pool.
+ * @details It can be called by any thread, e.g. by the consumer of the frame on another node.
+ * @param[in,out] pool  Pointer to the pool structure.
+ * @param[in]     frame Pointer to a frame taken from this pool.
+ */
+void snap_poolPut(snap_pool_t *pool, snap_frame_t *frame)
+{
+	const uint32_t index = (uint32_t)(frame - pool->frames);
+	uint64_t head = __atomic_load_n(&pool->head, __ATOMIC_RELAXED);
+	uint64_t newHead;
+
+	do
+	{
+		__atomic_store_n(&pool->links[index], (uint32_t)head, __ATOMIC_RELAXED);
+		newHead = (((head >> 32) + 1U) << 32) | (index + 1U);
+	} while(!__atomic_compare_exchange_n(&pool->head, &head, newHead, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/**
+ * @brief Free the memory of a pool.
+ * @param[in,out] pool Pointer to the pool structure.
+ */
+void snap_poolDestroy(snap_pool_t *pool)
+{
+	snap_numaFree(pool->memory, pool->memorySize);
+	pool->memory = NULL;
+	pool->count = 0;
+}
+
+/**
+ * @brief Create the state of a channel on a NUMA node.
+ * @details It must be called by the thread that will service the channel. If a node is given, the thread
+ *          is pinned to the CPUs of that node first, so the memory and the thread stay together.
+ * @param[out] channel  Pointer to the channel structure.
+ * @param[in]  node     Node number, or -1 to keep the affinity of the thread and use its current node.
+ * @param[in]  capacity Size of the stream buffer (at least #SNAP_STREAM_MIN_SIZE_BUFFER).
+ * @param[in]  frames   Number of frames of the pool (with #SNAP_MAX_SIZE_FRAME bytes each).
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set).
+ */
+int snap_channelInit(snap_channel_t *channel, const int node, const size_t capacity, const uint32_t frames)
+{
+	if(capacity < SNAP_STREAM_MIN_SIZE_BUFFER)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	if((node >= 0) && (snap_numaBindThread(node) < 0))
+	{
+		return -1;
+	}
+
+	channel->node = (node >= 0) ? node : snap_numaCurrentNode();
+	channel->memorySize = ALIGN(sizeof(snap_stream_t)) + capacity;
+	channel->memory = snap_numaAlloc(channel->memorySize, channel->node);
+
+	if(channel->memory == NULL)
+	{
+		return -1;
+	}
+
+	if(snap_poolInit(&channel->pool, frames, SNAP_MAX_SIZE_FRAME, channel->node) < 0)
+	{
+		const int error = errno;
+
+		snap_numaFree(channel->memory, channel->memorySize);
+		errno = error;
+		return -1;
+	}
+
+	channel->stream = channel->memory;
+	channel->buffer = (uint8_t *)channel->memory + ALIGN(sizeof(snap_stream_t));
+	channel->capacity = capacity;
+	snap_streamInit(channel->stream, channel->buffer, capacity);
+
+	return 0;
+}
+
+/**
+ * @brief Free the state of a channel.
+ * @param[in,out] channel Pointer to the channel structure.
+ */
+void snap_channelDestroy(snap_channel_t *channel)
+{
+	snap_poolDestroy(&channel->pool);
+	snap_numaFree(channel->memory, channel->memorySize);
+	channel->memory = NULL;
+}
+
+/******************************** END OF FILE *********************************/
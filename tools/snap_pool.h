@@ -0,0 +1,104 @@
+/**
+ * @file   snap_pool.h
+ * @author Lucas Jadilo
+ * @brief  NUMA-aware frame pools and channel state for multi-port hosts (gateways).
+ * @details On hosts with several NUMA nodes, memory is fastest when it is on the node of the CPU that
+ *          touches it. A channel (one port and its decoder) is serviced by a single thread, so all of its
+ *          state, i.e. the stream decoder, its buffer and the pool of frames handed to the consumers, is
+ *          allocated on the node of that thread: the memory is bound to the node (preferred policy) and
+ *          touched by the thread that creates it, so the pages never land elsewhere. The node of each
+ *          channel is chosen by the caller, which pins the servicing thread to the CPUs of that node.
+ *
+ *          A pool holds a fixed number of frames, all with the same buffer size, in a single mapping.
+ *          Frames are taken by the channel thread and can be returned by any thread (e.g. the consumer, on
+ *          another node): the free list is a lock-free stack whose head carries a tag against ABA.
+ *
+ *          The node functions read /sys/devices/system/node and use the getcpu and mbind system calls
+ *          directly, so no library is needed. On hosts without NUMA they report a single node 0.
+ */
+
+#ifndef SNAP_POOL_H_
+#define SNAP_POOL_H_
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include "snap_stream.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define SNAP_POOL_MAX_NODES	(1024U)	/**< @brief Largest number of NUMA nodes supported. */
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+/**
+ * @brief Pool of frames allocated on a NUMA node.
+ */
+typedef struct snap_pool_t
+{
+	void         *memory;		/**< @brief Mapping that holds the frame structures, the free list links and the buffers. */
+	size_t       memorySize;	/**< @brief Size of the mapping. */
+	snap_frame_t *frames;		/**< @brief Frame structures (frames[i].buffer is the buffer of frame i). */
+	uint32_t     *links;		/**< @brief Free list: index + 1 of the next free frame (0 = none). */
+	uint64_t     head;			/**< @brief Free list head: tag (high 32 bits) and index + 1 of the first free frame. Accessed with __atomic builtins. */
+	uint32_t     count;			/**< @brief Number of frames. */
+	uint16_t     frameSize;		/**< @brief Size of each frame buffer. */
+	int          node;			/**< @brief NUMA node of the memory. */
+} snap_pool_t;
+
+/**
+ * @brief State of a channel (one port), allocated on the node of the thread that services it.
+ */
+typedef struct snap_channel_t
+{
+	int           node;			/**< @brief NUMA node of the channel memory and of the servicing thread. */
+	snap_stream_t *stream;		/**< @brief Stream decoder. */
+	uint8_t       *buffer;		/**< @brief Buffer of the stream decoder. */
+	size_t        capacity;		/**< @brief Size of the buffer. */
+	snap_pool_t   pool;			/**< @brief Frames handed to the consumers. */
+	void          *memory;		/**< @brief Mapping that holds the decoder and its buffer. */
+	size_t        memorySize;	/**< @brief Size of the mapping. */
+} snap_channel_t;
+
+
+/******************************************************************************/
+/*  Function Declarations                                                     */
+/******************************************************************************/
+
+
+int snap_numaNodeCount(void);
+
+int snap_numaCurrentNode(void);
+
+int snap_numaBindThread(int node);
+
+void *snap_numaAlloc(size_t size, int node);
+
+void snap_numaFree(void *memory, size_t size);
+
+int snap_poolInit(snap_pool_t *pool, uint32_t count, uint16_t frameSize, int node);
+
+snap_frame_t *snap_poolGet(snap_pool_t *pool);
+
+void snap_poolPut(snap_pool_t *pool, snap_frame_t *frame);
+
+void snap_poolDestroy(snap_pool_t *pool);
+
+int snap_channelInit(snap_channel_t *channel, int node, size_t capacity, uint32_t frames);
+
+void snap_channelDestroy(snap_channel_t *channel);
+
+#endif	// SNAP_POOL_H_
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,931 @@
+/**
+ * @file   snap_query.c
+ * @author Lucas Jadilo
+ * @brief  Capture queries: predicates over frame fields compiled to bytecode and evaluated on the raw frame bytes.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "snap_query.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define SCAN_BATCH		(256U)	// Records whose headers are tested at once
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+typedef enum opcode_t
+{
+	OP_HEADER = 0,	// value = (header byte arg1 >> arg2) & immediate
+	OP_DEST,
+	OP_SOURCE,
+	OP_FLAGS,
+	OP_HASH,
+	OP_DATA,		// value = arg1 data bytes starting at offset immediate
+	OP_SIZE,
+	OP_DATA_SIZE,
+	OP_STATUS,
+	OP_CHANNEL,
+	OP_TIMESTAMP,
+	OP_MASK,		// value &= immediate
+	OP_COMPARE,		// push (value <arg1> immediate)
+	OP_NOT,
+	OP_AND,
+	OP_OR
+} opcode_t;
+
+typedef enum compare_t
+{
+	CMP_EQ = 0,
+	CMP_NE,
+	CMP_LT,
+	CMP_LE,
+	CMP_GT,
+	CMP_GE
+} compare_t;
+
+typedef enum trit_t
+{
+	TRIT_FALSE   = 0,
+	TRIT_TRUE    = 1,
+	TRIT_UNKNOWN = 2
+} trit_t;
+
+typedef enum state_t
+{
+	STATE_KNOWN = 0,	// The value was loaded
+	STATE_MISSING,		// The frame does not have the field: comparisons are false
+	STATE_UNKNOWN		// Only the header is known (header bitmap): comparisons are unknown
+} state_t;
+
+typedef struct view_t
+{
+	const snap_captureRecord_t *record;	// NULL when only the header is known
+	uint8_t                    header[SNAP_INDEX_HDB1 + 1U];
+	bool                       hasHeader;
+} view_t;
+
+typedef struct field_t
+{
+	const char *name;
+	uint8_t    opcode;
+	uint8_t    index;
+	uint8_t    shift;
+	uint8_t    mask;
+} field_t;
+
+typedef struct parser_t
+{
+	snap_query_t *query;
+	const char   *start;
+	const char   *p;
+	uint_fast8_t depth;
+	uint_fast8_t stack;
+} parser_t;
+
+
+/******************************************************************************/
+/*  Private Variables                                                         */
+/******************************************************************************/
+
+
+static const field_t fields[] =
+{
+	{"hdb2",      OP_HEADER,    SNAP_INDEX_HDB2, 0,                 0xFFU},
+	{"hdb1",      OP_HEADER,    SNAP_INDEX_HDB1, 0,                 0xFFU},
+	{"dab",       OP_HEADER,    SNAP_INDEX_HDB2, SNAP_HDB2_DAB_POS, SNAP_HDB2_DAB_MASK},
+	{"sab",       OP_HEADER,    SNAP_INDEX_HDB2, SNAP_HDB2_SAB_POS, SNAP_HDB2_SAB_MASK},
+	{"pfb",       OP_HEADER,    SNAP_INDEX_HDB2, SNAP_HDB2_PFB_POS, SNAP_HDB2_PFB_MASK},
+	{"ack",       OP_HEADER,    SNAP_INDEX_HDB2, SNAP_HDB2_ACK_POS, SNAP_HDB2_ACK_MASK},
+	{"cmd",       OP_HEADER,    SNAP_INDEX_HDB1, SNAP_HDB1_CMD_POS, SNAP_HDB1_CMD_MASK},
+	{"edm",       OP_HEADER,    SNAP_INDEX_HDB1, SNAP_HDB1_EDM_POS, SNAP_HDB1_EDM_MASK},
+	{"ndb",       OP_HEADER,    SNAP_INDEX_HDB1, SNAP_HDB1_NDB_POS, SNAP_HDB1_NDB_MASK},
+	{"dest",      OP_DEST,      0, 0, 0},
+	{"source",    OP_SOURCE,    0, 0, 0},
+	{"flags",     OP_FLAGS,     0, 0, 0},
+	{"hash",      OP_HASH,      0, 0, 0},
+	{"size",      OP_SIZE,      0, 0, 0},
+	{"data_size", OP_DATA_SIZE, 0, 0, 0},
+	{"status",    OP_STATUS,    0, 0, 0},
+	{"channel",   OP_CHANNEL,   0, 0, 0},
+	{"timestamp", OP_TIMESTAMP, 0, 0, 0},
+	{"data",      OP_DATA,      0, 0, 0},
+};
+
+static const char *const opcodeNames[] =
+{
+	"header", "dest", "source", "flags", "hash", "data", "size", "data_size",
+	"status", "channel", "timestamp", "mask", "compare", "not", "and", "or"
+};
+
+static const char *const compareNames[] = {"==", "!=", "<", "<=", ">", ">="};
+
+
+/******************************************************************************/
+/*  Private Functions: Evaluation                                             */
+/******************************************************************************/
+
+
+static state_t loadBytes(const view_t *view, const uint_fast16_t index, const uint_fast8_t count, uint64_t *value)
+{
+	if(view->record == NULL)
+	{
+		return STATE_UNKNOWN;
+	}
+
+	if(index + count > view->record->size)
+	{
+		return STATE_MISSING;
+	}
+
+	*value = 0;
+
+	for(uint_fast8_t i = 0; i < count; i++)
+	{
+		*value = (*value << 8) | view->record->bytes[index + i];
+	}
+
+	return STATE_KNOWN;
+}
+
+static state_t loadField(const view_t *view, const snap_queryInstruction_t *instruction, uint64_t *value)
+{
+	const snap_captureRecord_t *record = view->record;
+	const uint8_t *header = view->header;
+
+	switch(instruction->opcode)
+	{
+		case OP_SIZE:
+		case OP_STATUS:
+		case OP_CHANNEL:
+		case OP_TIMESTAMP:
+			if(record == NULL) return STATE_UNKNOWN;
+			*value = (instruction->opcode == OP_SIZE)    ? record->size :
+					 (instruction->opcode == OP_STATUS)  ? (uint8_t)record->status :
+					 (instruction->opcode == OP_CHANNEL) ? record->channel : record->timestamp;
+			return STATE_KNOWN;
+		default:
+			break;
+	}
+
+	if(!view->hasHeader)
+	{
+		return STATE_MISSING;
+	}
+
+	switch(instruction->opcode)
+	{
+		case OP_HEADER:
+			*value = (header[instruction->arg1] >> instruction->arg2) & instruction->immediate;
+			return STATE_KNOWN;
+		case OP_DATA_SIZE:
+			*value = SNAP_SIZE_DATA(header);
+			return STATE_KNOWN;
+		case OP_DEST:
+			if(SNAP_HDB2_DAB(header) == 0) return STATE_MISSING;
+			return loadBytes(view, SNAP_INDEX_DAB, SNAP_HDB2_DAB(header), value);
+		case OP_SOURCE:
+			if(SNAP_HDB2_SAB(header) == 0) return STATE_MISSING;
+			return loadBytes(view, SNAP_INDEX_SAB(header), SNAP_HDB2_SAB(header), value);
+		case OP_FLAGS:
+			if(SNAP_HDB2_PFB(header) == 0) return STATE_MISSING;
+			return loadBytes(view, SNAP_INDEX_PFB(header), SNAP_HDB2_PFB(header), value);
+		case OP_HASH:
+			if(SNAP_SIZE_HASH(header) == 0) return STATE_MISSING;
+			return loadBytes(view, SNAP_INDEX_HASH(header), (uint_fast8_t)SNAP_SIZE_HASH(header), value);
+		default:	// OP_DATA
+			if(instruction->immediate + instruction->arg1 > SNAP_SIZE_DATA(header)) return STATE_MISSING;
+			return loadBytes(view, SNAP_INDEX_DATA(header) + (uint_fast16_t)instruction->immediate, instruction->arg1, value);
+	}
+}
+
+static bool compare(const uint8_t operation, const uint64_t a, const uint64_t b)
+{
+	switch(operation)
+	{
+		case CMP_EQ: return a == b;
+		case CMP_NE: return a != b;
+		case CMP_LT: return a < b;
+		case CMP_LE: return a <= b;
+		case CMP_GT: return a > b;
+		default:     return a >= b;	// CMP_GE
+	}
+}
+
+static uint8_t combine(const uint8_t opcode, const uint8_t a, const uint8_t b)
+{
+	const uint8_t dominant = (opcode == OP_AND) ? TRIT_FALSE : TRIT_TRUE;
+
+	return ((a == dominant) || (b == dominant)) ? dominant :
+		   ((a == TRIT_UNKNOWN) || (b == TRIT_UNKNOWN)) ? TRIT_UNKNOWN : (uint8_t)(dominant ^ 1U);
+}
+
+static trit_t evaluate(const snap_query_t *query, const view_t *view)
+{
+	uint8_t stack[SNAP_QUERY_MAX_DEPTH];
+	uint_fast8_t top = 0;
+	uint64_t value = 0;
+	state_t state = STATE_MISSING;
+
+	for(uint_fast16_t pc = 0; pc < query->length; pc++)
+	{
+		const snap_queryInstruction_t *instruction = &query->code[pc];
+
+		switch(instruction->opcode)
+		{
+			case OP_MASK:
+				value &= instruction->immediate;
+				break;
+			case OP_COMPARE:
+				stack[top++] = (state == STATE_KNOWN)   ? (uint8_t)compare(instruction->arg1, value, instruction->immediate) :
+							   (state == STATE_MISSING) ? TRIT_FALSE : TRIT_UNKNOWN;
+				break;
+			case OP_NOT:
+				if(stack[top - 1U] != TRIT_UNKNOWN) stack[top - 1U] ^= 1U;
+				break;
+			case OP_AND:
+			case OP_OR:
+				top--;
+				stack[top - 1U] = combine(instruction->opcode, stack[top - 1U], stack[top]);
+				break;
+			default:
+				state = loadField(view, instruction, &value);
+				break;
+		}
+	}
+
+	return (trit_t)stack[0];
+}
+
+
+/******************************************************************************/
+/*  Private Functions: Scanning                                               */
+/******************************************************************************/
+
+
+static trit_t compareRange(const uint8_t operation, const uint64_t min, const uint64_t max, const uint64_t value)
+{
+	bool always, never;
+
+	switch(operation)
+	{
+		case CMP_EQ: always = (min == value) && (max == value); never = (value < min) || (value > max); break;
+		case CMP_NE: always = (value < min) || (value > max); never = (min == value) && (max == value); break;
+		case CMP_LT: always = max < value;  never = min >= value; break;
+		case CMP_LE: always = max <= value; never = min > value;  break;
+		case CMP_GT: always = min > value;  never = max <= value; break;
+		default:     always = min >= value; never = max < value;  break;	// CMP_GE
+	}
+
+	return always ? TRIT_TRUE : never ? TRIT_FALSE : TRIT_UNKNOWN;
+}
+
+static trit_t compareBlock(const snap_indexBlock_t *block, const uint8_t opcode, const uint8_t operation, const uint64_t value)
+{
+	switch(opcode)
+	{
+		case OP_TIMESTAMP:
+			return compareRange(operation, block->minTimestamp, block->maxTimestamp, value);
+		case OP_CHANNEL:
+			return compareRange(operation, block->minChannel, block->maxChannel, value);
+		case OP_STATUS:
+		{
+			if((operation != CMP_EQ) && (operation != CMP_NE))
+			{
+				return TRIT_UNKNOWN;
+			}
+
+			const uint32_t count = (value == (uint8_t)SNAP_STATUS_VALID)          ? block->valid :
+								   (value == (uint8_t)SNAP_STATUS_ERROR_HASH)     ? block->hashErrors :
+								   (value == (uint8_t)SNAP_STATUS_ERROR_OVERFLOW) ? block->overflowErrors : 0;
+			const trit_t equal = (count == 0) ? TRIT_FALSE : (count == block->records) ? TRIT_TRUE : TRIT_UNKNOWN;
+
+			return ((operation == CMP_NE) && (equal != TRIT_UNKNOWN)) ? (trit_t)(equal ^ 1U) : equal;
+		}
+		case OP_DEST:
+		case OP_SOURCE:
+			if((operation == CMP_EQ) && ((value > 0xFFFFFFU) ||
+			   !snap_indexBloomContains((opcode == OP_DEST) ? block->destBloom : block->sourceBloom, (uint32_t)value)))
+			{
+				return TRIT_FALSE;
+			}
+			return TRIT_UNKNOWN;
+		default:
+			return TRIT_UNKNOWN;
+	}
+}
+
+/**
+ * @brief Scan the records of a capture file up to an offset.
+ * @retval 1  The offset was reached.
+ * @retval 0  Stopped by the callback.
+ * @retval -1 The capture file is truncated or corrupted (errno is set to EINVAL).
+ */
+static int scanRange(const snap_query_t *query, snap_captureReader_t *reader, const size_t end,
+					 const snap_queryCallback_t callback, void *context)
+{
+	snap_captureRecord_t records[SCAN_BATCH];
+	size_t offsets[SCAN_BATCH];
+	uint16_t headers[SCAN_BATCH];
+	uint16_t candidates[SCAN_BATCH];
+	int ret = 1;
+
+	while((ret > 0) && (reader->pos < end))
+	{
+		uint_fast16_t count = 0, selected = 0;
+
+		while((count < SCAN_BATCH) && (reader->pos < end) &&
+			  ((offsets[count] = reader->pos), (ret = snap_captureRead(reader, &records[count])) > 0))
+		{
+			// Frames without a complete header cannot be filtered by the bitmap: they are always evaluated
+			headers[count] = (records[count].size > SNAP_INDEX_HDB1) ?
+							 (uint16_t)((records[count].bytes[SNAP_INDEX_HDB2] << 8) | records[count].bytes[SNAP_INDEX_HDB1]) : 0;
+			count++;
+		}
+
+		for(uint_fast16_t i = 0; i < count; i++)
+		{
+			candidates[selected] = (uint16_t)i;
+			selected += (uint_fast16_t)((query->headers[headers[i] / 8U] >> (headers[i] % 8U)) & 1U) | (records[i].size <= SNAP_INDEX_HDB1);
+		}
+
+		for(uint_fast16_t i = 0; i < selected; i++)
+		{
+			const uint16_t index = candidates[i];
+
+			if(snap_queryMatch(query, &records[index]) && !callback(context, &records[index], offsets[index]))
+			{
+				return 0;
+			}
+		}
+	}
+
+	return (ret < 0) ? -1 : 1;
+}
+
+/**
+ * @brief Check if the first record of a block of the index is the one at its offset in the capture file.
+ * @details It moves the reader to the end of that record.
+ * @return Whether the record exists and has the hash stored in the block.
+ */
+static bool checkBlock(snap_captureReader_t *reader, const snap_indexBlock_t *block)
+{
+	snap_captureRecord_t record;
+
+	if((block->offset < SNAP_CAPTURE_SIZE_HEADER) || (block->offset >= reader->size))
+	{
+		return false;
+	}
+
+	reader->pos = (size_t)block->offset;
+	return (snap_captureRead(reader, &record) > 0) && (snap_indexRecordHash(&record) == block->firstHash);
+}
+
+/**
+ * @brief Check if an index belongs to a capture file (it was not left over from a previous capture at the same path).
+ * @details Only the first records of the first block and of the last block inside the file are compared, so that
+ *          the skipped blocks of a compressed capture are still not decompressed. The records have nanosecond
+ *          timestamps, so those of another capture do not match.
+ * @return Whether the index belongs to the capture file (an empty index belongs to any capture).
+ */
+static bool belongsTo(const snap_index_t *index, snap_captureReader_t *reader)
+{
+	snap_indexBlock_t block;
+	size_t last = index->blocks;
+	bool ret = true;
+
+	// The capture may be behind its index while they are both being written
+	while(last > 0)
+	{
+		snap_indexGetBlock(index, --last, &block);
+
+		if(block.end <= reader->size)
+		{
+			ret = checkBlock(reader, &block);
+			break;
+		}
+	}
+
+	if(ret && (index->blocks > 0))
+	{
+		snap_indexGetBlock(index, 0, &block);
+		ret = checkBlock(reader, &block);
+	}
+
+	reader->pos = SNAP_CAPTURE_SIZE_HEADER;
+	return ret;
+}
+
+/******************************************************************************/
+/*  Private Functions: Compilation                                            */
+/******************************************************************************/
+
+
+static bool fail(parser_t *parser, const char *message)
+{
+	if(parser->query->error == NULL)
+	{
+		parser->query->error = message;
+		parser->query->errorPosition = (size_t)(parser->p - parser->start);
+	}
+
+	return false;
+}
+
+static void skipSpaces(parser_t *parser)
+{
+	while(isspace((unsigned char)*parser->p))
+	{
+		parser->p++;
+	}
+}
+
+static bool accept(parser_t *parser, const char *token)
+{
+	const size_t size = strlen(token);
+
+	skipSpaces(parser);
+
+	if(strncmp(parser->p, token, size) != 0)
+	{
+		return false;
+	}
+
+	// "&" must not match "&&", "<" must not match "<=", etc.
+	if(((size == 1U) && (parser->p[1] == '=')) || ((strcmp(token, "&") == 0) && (parser->p[1] == '&')))
+	{
+		return false;
+	}
+
+	parser->p += size;
+	return true;
+}
+
+static bool emit(parser_t *parser, const uint8_t opcode, const uint8_t arg1, const uint8_t arg2, const uint64_t immediate)
+{
+	snap_query_t *query = parser->query;
+
+	if(query->length == SNAP_QUERY_MAX_CODE)
+	{
+		return fail(parser, "expression too long");
+	}
+
+	if(opcode == OP_COMPARE)
+	{
+		if(++parser->stack > SNAP_QUERY_MAX_DEPTH)
+		{
+			return fail(parser, "expression too deep");
+		}
+	}
+	else if((opcode == OP_AND) || (opcode == OP_OR))
+	{
+		parser->stack--;
+	}
+
+	query->code[query->length].opcode = opcode;
+	query->code[query->length].arg1 = arg1;
+	query->code[query->length].arg2 = arg2;
+	query->code[query->length].immediate = immediate;
+	query->length++;
+	return true;
+}
+
+static bool parseNumber(parser_t *parser, uint64_t *value)
+{
+	char *end;
+
+	skipSpaces(parser);
+
+	if(!isdigit((unsigned char)*parser->p))
+	{
+		return fail(parser, "number expected");
+	}
+
+	errno = 0;
+	*value = strtoull(parser->p, &end, 0);
+
+	if((errno != 0) || isalnum((unsigned char)*end) || (*end == '_'))
+	{
+		return fail(parser, "invalid number");
+	}
+
+	parser->p = end;
+	return true;
+}
+
+static bool parseValue(parser_t *parser, uint64_t *value)
+{
+	static const struct {const char *name; int8_t status;} statuses[] =
+	{
+		{"valid", SNAP_STATUS_VALID}, {"hash", SNAP_STATUS_ERROR_HASH}, {"overflow", SNAP_STATUS_ERROR_OVERFLOW}
+	};
+
+	skipSpaces(parser);
+
+	for(size_t i = 0; i < sizeof(statuses) / sizeof(statuses[0]); i++)
+	{
+		const size_t size = strlen(statuses[i].name);
+
+		if((strncmp(parser->p, statuses[i].name, size) == 0) && !isalnum((unsigned char)parser->p[size]) && (parser->p[size] != '_'))
+		{
+			parser->p += size;
+			*value = (uint8_t)statuses[i].status;
+			return true;
+		}
+	}
+
+	return parseNumber(parser, value);
+}
+
+static bool parseComparison(parser_t *parser)
+{
+	static const char *const operators[] = {"==", "!=", "<=", ">=", "<", ">"};
+	static const uint8_t operations[] = {CMP_EQ, CMP_NE, CMP_LE, CMP_GE, CMP_LT, CMP_GT};
+	const field_t *field = NULL;
+	uint64_t value, offset = 0, count = 1;
+
+	skipSpaces(parser);
+	size_t size = 0;
+
+	while(isalnum((unsigned char)parser->p[size]) || (parser->p[size] == '_'))
+	{
+		size++;
+	}
+
+	for(size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+	{
+		if((strlen(fields[i].name) == size) && (strncmp(parser->p, fields[i].name, size) == 0))
+		{
+			field = &fields[i];
+		}
+	}
+
+	if(field == NULL)
+	{
+		return fail(parser, "field expected");
+	}
+
+	parser->p += size;
+
+	if(field->opcode == OP_DATA)
+	{
+		if(!accept(parser, "[")) return fail(parser, "\"[\" expected");
+		if(!parseNumber(parser, &offset)) return false;
+		if(accept(parser, ":") && !parseNumber(parser, &count)) return false;
+		if(!accept(parser, "]")) return fail(parser, "\"]\" expected");
+
+		if((offset >= SNAP_MAX_SIZE_FRAME) || (count == 0) || (count > 8U))
+		{
+			return fail(parser, "invalid data range");
+		}
+	}
+
+	if(!emit(parser, field->opcode, (field->opcode == OP_DATA) ? (uint8_t)count : field->index, field->shift,
+			 (field->opcode == OP_DATA) ? offset : field->mask))
+	{
+		return false;
+	}
+
+	if(accept(parser, "&"))
+	{
+		if(!parseNumber(parser, &value) || !emit(parser, OP_MASK, 0, 0, value)) return false;
+	}
+
+	for(size_t i = 0; i < sizeof(operators) / sizeof(operators[0]); i++)
+	{
+		if(accept(parser, operators[i]))
+		{
+			return parseValue(parser, &value) && emit(parser, OP_COMPARE, operations[i], 0, value);
+		}
+	}
+
+	return emit(parser, OP_COMPARE, CMP_NE, 0, 0);
+}
+
+static bool parseExpression(parser_t *parser);
+
+static bool parseUnary(parser_t *parser)
+{
+	bool ok;
+
+	if(++parser->depth > SNAP_QUERY_MAX_DEPTH)
+	{
+		return fail(parser, "expression too deep");
+	}
+
+	if(accept(parser, "!"))
+	{
+		ok = parseUnary(parser) && emit(parser, OP_NOT, 0, 0, 0);
+	}
+	else if(accept(parser, "("))
+	{
+		ok = parseExpression(parser) && (accept(parser, ")") || fail(parser, "\")\" expected"));
+	}
+	else
+	{
+		ok = parseComparison(parser);
+	}
+
+	parser->depth--;
+	return ok;
+}
+
+static bool parseAnd(parser_t *parser)
+{
+	if(!parseUnary(parser))
+	{
+		return false;
+	}
+
+	while(accept(parser, "&&"))
+	{
+		if(!parseUnary(parser) || !emit(parser, OP_AND, 0, 0, 0))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool parseExpression(parser_t *parser)
+{
+	if(!parseAnd(parser))
+	{
+		return false;
+	}
+
+	while(accept(parser, "||"))
+	{
+		if(!parseAnd(parser) || !emit(parser, OP_OR, 0, 0, 0))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/******************************************************************************/
+/*  Public Functions                                                          */
+/******************************************************************************/
+
+
+/**
+ * @brief Compile a query expression.
+ * @details Besides the bytecode, the bitmap of the headers that can match is built (it takes a few milliseconds).
+ * @param[out] query      Pointer to the query structure.
+ * @param[in]  expression Expression (see the grammar in snap_query.h).
+ * @retval 0  Success.
+ * @retval -1 Syntax error (query->error and query->errorPosition describe it).
+ */
+int snap_queryCompile(snap_query_t *query, const char *expression)
+{
+	parser_t parser = {.query = query, .start = expression, .p = expression};
+
+	query->length = 0;
+	query->error = NULL;
+	query->errorPosition = 0;
+
+	if(!parseExpression(&parser))
+	{
+		return -1;
+	}
+
+	skipSpaces(&parser);
+
+	if(*parser.p != '\0')
+	{
+		fail(&parser, "unexpected characters");
+		return -1;
+	}
+
+	view_t view = {.record = NULL, .hasHeader = true};
+	view.header[SNAP_INDEX_SYNC] = SNAP_SYNC;
+
+	for(uint_fast32_t header = 0; header < 65536U; header++)
+	{
+		view.header[SNAP_INDEX_HDB2] = (uint8_t)(header >> 8);
+		view.header[SNAP_INDEX_HDB1] = (uint8_t)header;
+
+		if(evaluate(query, &view) != TRIT_FALSE)
+		{
+			query->headers[header / 8U] |= (uint8_t)(1U << (header % 8U));
+		}
+		else
+		{
+			query->headers[header / 8U] &= (uint8_t)~(1U << (header % 8U));
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Check if a record matches a query.
+ * @param[in] query  Pointer to the compiled query.
+ * @param[in] record Pointer to the record.
+ * @return true if the record matches.
+ */
+bool snap_queryMatch(const snap_query_t *query, const snap_captureRecord_t *record)
+{
+	view_t view = {.record = record, .hasHeader = (record->size > SNAP_INDEX_HDB1)};
+
+	if(view.hasHeader)
+	{
+		const uint_fast16_t header = (uint_fast16_t)((record->bytes[SNAP_INDEX_HDB2] << 8) | record->bytes[SNAP_INDEX_HDB1]);
+
+		if(!(query->headers[header / 8U] & (1U << (header % 8U))))
+		{
+			return false;
+		}
+
+		for(uint_fast8_t i = 0; i <= SNAP_INDEX_HDB1; i++)
+		{
+			view.header[i] = record->bytes[i];
+		}
+	}
+
+	return evaluate(query, &view) == TRIT_TRUE;
+}
+
+/**
+ * @brief Check if a block of records summarized in an index can contain a matching record.
+ * @details The comparisons with the timestamp, channel, status, destination and source addresses are decided
+ *          with the block summary when possible (ranges, status counts and Bloom filters); the others are
+ *          unknown.
+ * @param[in] query Pointer to the compiled query.
+ * @param[in] block Pointer to the block summary.
+ * @return false if no record of the block can match, true otherwise.
+ */
+bool snap_queryBlock(const snap_query_t *query, const snap_indexBlock_t *block)
+{
+	uint8_t stack[SNAP_QUERY_MAX_DEPTH];
+	uint_fast8_t top = 0;
+	const snap_queryInstruction_t *load = NULL;
+	bool masked = false;
+
+	for(uint_fast16_t pc = 0; pc < query->length; pc++)
+	{
+		const snap_queryInstruction_t *instruction = &query->code[pc];
+
+		switch(instruction->opcode)
+		{
+			case OP_MASK:
+				masked = true;
+				break;
+			case OP_COMPARE:
+				stack[top++] = masked ? (uint8_t)TRIT_UNKNOWN : (uint8_t)compareBlock(block, load->opcode, instruction->arg1, instruction->immediate);
+				break;
+			case OP_NOT:
+				if(stack[top - 1U] != TRIT_UNKNOWN) stack[top - 1U] ^= 1U;
+				break;
+			case OP_AND:
+			case OP_OR:
+				top--;
+				stack[top - 1U] = combine(instruction->opcode, stack[top - 1U], stack[top]);
+				break;
+			default:
+				load = instruction;
+				masked = false;
+				break;
+		}
+	}
+
+	return stack[0] != TRIT_FALSE;
+}
+
+/**
+ * @brief Scan the rest of a capture file and call a function for every matching record.
+ * @details The records are read in batches. The headers of a batch are tested against the header bitmap
+ *          first, and the bytecode runs only on the records that pass it.
+ * @param[in]     query    Pointer to the compiled query.
+ * @param[in,out] reader   Pointer to the capture reader.
+ * @param[in]     callback Function called for every matching record.
+ * @param[in]     context  Pointer passed to the callback.
+ * @retval 0  Success (end of the file, or stopped by the callback).
+ * @retval -1 The capture file is truncated or corrupted (errno is set to EINVAL).
+ */
+int snap_queryScan(const snap_query_t *query, snap_captureReader_t *reader, const snap_queryCallback_t callback, void *context)
+{
+	const int ret = scanRange(query, reader, reader->size, callback, context);
+	return (ret < 0) ? -1 : 0;
+}
+
+/**
+ * @brief Scan a whole capture file with the help of its index and call a function for every matching record.
+ * @details The blocks that cannot contain a matching record (see snap_queryBlock()) are skipped. The records
+ *          after the last block of the index (or all the records, if the index does not belong to the
+ *          capture, e.g. the capture was rewritten after the index was built) are scanned normally.
+ * @param[in]     query    Pointer to the compiled query.
+ * @param[in,out] reader   Pointer to the capture reader.
+ * @param[in]     index    Pointer to the index of the capture.
+ * @param[in]     callback Function called for every matching record.
+ * @param[in]     context  Pointer passed to the callback.
+ * @param[out]    skipped  Pointer to the variable that will store the number of blocks skipped (it can be NULL).
+ * @retval 0  Success (end of the file, or stopped by the callback).
+ * @retval -1 The capture file is truncated or corrupted (errno is set to EINVAL).
+ */
+int snap_queryScanIndex(const snap_query_t *query, snap_captureReader_t *reader, const snap_index_t *index,
+						const snap_queryCallback_t callback, void *context, size_t *skipped)
+{
+	snap_indexBlock_t block;
+	size_t count = 0;
+	const size_t blocks = belongsTo(index, reader) ? index->blocks : 0;
+	int ret = 1;
+
+	for(size_t i = 0; (ret > 0) && (i < blocks); i++)
+	{
+		snap_indexGetBlock(index, i, &block);
+
+		// The blocks must cover the capture contiguously; otherwise the rest is scanned without the index
+		if((block.offset != reader->pos) || (block.end <= block.offset) || (block.end > reader->size))
+		{
+			break;
+		}
+
+		if(snap_queryBlock(query, &block))
+		{
+			ret = scanRange(query, reader, (size_t)block.end, callback, context);
+		}
+		else
+		{
+			reader->pos = (size_t)block.end;
+			count++;
+		}
+	}
+
+	if(skipped != NULL)
+	{
+		*skipped = count;
+	}
+
+	if(ret > 0)
+	{
+		ret = scanRange(query, reader, reader->size, callback, context);
+	}
+
+	return (ret < 0) ? -1 : 0;
+}
+
+/**
+ * @brief Print the bytecode of a query (one instruction per line).
+ * @param[in] query  Pointer to the compiled query.
+ * @param[in] stream Output stream.
+ */
+void snap_queryPrint(const snap_query_t *query, FILE *stream)
+{
+	uint_fast32_t headers = 0;
+
+	for(uint_fast16_t pc = 0; pc < query->length; pc++)
+	{
+		const snap_queryInstruction_t *instruction = &query->code[pc];
+
+		fprintf(stream, "%3u  %-9s", (unsigned)pc, opcodeNames[instruction->opcode]);
+
+		switch(instruction->opcode)
+		{
+			case OP_HEADER:
+				fprintf(stream, " byte=%u shift=%u mask=0x%llX\n", instruction->arg1, instruction->arg2, (unsigned long long)instruction->immediate);
+				break;
+			case OP_DATA:
+				fprintf(stream, " offset=%llu count=%u\n", (unsigned long long)instruction->immediate, instruction->arg1);
+				break;
+			case OP_MASK:
+				fprintf(stream, " 0x%llX\n", (unsigned long long)instruction->immediate);
+				break;
+			case OP_COMPARE:
+				fprintf(stream, " %s 0x%llX\n", compareNames[instruction->arg1], (unsigned long long)instruction->immediate);
+				break;
+			default:
+				fputc('\n', stream);
+				break;
+		}
+	}
+
+	for(uint_fast32_t i = 0; i < sizeof(query->headers); i++)
+	{
+		headers += (uint_fast32_t)__builtin_popcount(query->headers[i]);
+	}
+
+	fprintf(stream, "headers that can match: %lu/65536\n", (unsigned long)headers);
+}
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,109 @@
+/**
+ * @file   snap_query.h
+ * @author Lucas Jadilo
+ * @brief  Capture queries: predicates over frame fields compiled to bytecode and evaluated on the raw frame bytes.
+ * @details Grammar of the expressions:
+ *          @code
+ *          expression := and { "||" and }
+ *          and        := unary { "&&" unary }
+ *          unary      := "!" unary | "(" expression ")" | comparison
+ *          comparison := operand [ ("==" | "!=" | "<" | "<=" | ">" | ">=") value ]	(no operator means "!= 0")
+ *          operand    := field [ "&" number ] | "data" "[" number [ ":" number ] "]" [ "&" number ]
+ *          field      := hdb2 | hdb1 | dab | sab | pfb | ack | cmd | edm | ndb | dest | source | flags | hash |
+ *                        size | data_size | status | channel | timestamp
+ *          value      := number | valid | hash | overflow
+ *          @endcode
+ *          @c data[i] is the data byte at offset @c i and @c data[i:n] is the big-endian value of @c n bytes
+ *          (1 to 8) starting at offset @c i. A comparison with a field that the frame does not have (e.g. @c dest
+ *          when DAB=0, or a data byte beyond the data size or the end of a truncated frame) is false.
+ *          Example: <tt>source == 0xB0B1 && ack == 1 && status == hash</tt>.
+ *
+ *          Every field is read straight from the frame bytes, at the offset given by the header bytes, so the
+ *          frames are never decoded. Besides the bytecode, the compiler evaluates the expression for the 65536
+ *          possible header values (HDB2, HDB1), with the other fields unknown, and stores in a bitmap the ones
+ *          that can match. Scans test that bitmap for a whole batch of records at once before running the
+ *          bytecode on the few records left. When the capture has an index (see snap_index.h), the blocks that
+ *          cannot contain a matching record are skipped without being read.
+ */
+
+#ifndef SNAP_QUERY_H_
+#define SNAP_QUERY_H_
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include "snap_index.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define SNAP_QUERY_MAX_CODE		(128U)	/**< @brief Maximum number of instructions of a query. */
+#define SNAP_QUERY_MAX_DEPTH	(32U)	/**< @brief Maximum nesting of logical operations. */
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+/**
+ * @brief Bytecode instruction.
+ */
+typedef struct snap_queryInstruction_t
+{
+	uint8_t  opcode;	/**< @brief Operation. */
+	uint8_t  arg1;		/**< @brief First argument (meaning depends on the operation). */
+	uint8_t  arg2;		/**< @brief Second argument (meaning depends on the operation). */
+	uint64_t immediate;	/**< @brief Immediate value (mask, offset or value compared). */
+} snap_queryInstruction_t;
+
+/**
+ * @brief Compiled query.
+ */
+typedef struct snap_query_t
+{
+	snap_queryInstruction_t code[SNAP_QUERY_MAX_CODE];	/**< @brief Bytecode. */
+	uint8_t                 headers[65536U / 8U];		/**< @brief Bit (HDB2 * 256 + HDB1) is set if a frame with that header can match. */
+	uint16_t                length;						/**< @brief Number of instructions. */
+	const char              *error;						/**< @brief Compilation error message (NULL if none). */
+	size_t                  errorPosition;				/**< @brief Position of the compilation error in the expression. */
+} snap_query_t;
+
+/**
+ * @brief Callback called by snap_queryScan() for every matching record.
+ * @param[in] context Pointer given to snap_queryScan().
+ * @param[in] record  Pointer to the record (valid only during the call).
+ * @param[in] offset  Offset of the record in the capture file.
+ * @retval true  Continue scanning.
+ * @retval false Stop scanning.
+ */
+typedef bool (*snap_queryCallback_t)(void *context, const snap_captureRecord_t *record, size_t offset);
+
+
+/******************************************************************************/
+/*  Function Declarations                                                     */
+/******************************************************************************/
+
+
+int snap_queryCompile(snap_query_t *query, const char *expression);
+
+bool snap_queryMatch(const snap_query_t *query, const snap_captureRecord_t *record);
+
+int snap_queryScan(const snap_query_t *query, snap_captureReader_t *reader, snap_queryCallback_t callback, void *context);
+
+bool snap_queryBlock(const snap_query_t *query, const snap_indexBlock_t *block);
+
+int snap_queryScanIndex(const snap_query_t *query, snap_captureReader_t *reader, const snap_index_t *index,
+						snap_queryCallback_t callback, void *context, size_t *skipped);
+
+void snap_queryPrint(const snap_query_t *query, FILE *stream);
+
+#endif	// SNAP_QUERY_H_
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,240 @@
+/**
+ * @file   snap_rcu.c
+ * @author Lucas Jadilo
+ * @brief  Configuration objects shared with worker threads through an RCU-like epoch scheme.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sys/mman.h>
+#include <time.h>
+#include "snap_rcu.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define WAIT_NS		(1000000L)	// Pause of a writer that waits for a free retire slot
+
+
+/******************************************************************************/
+/*  Private Functions                                                         */
+/******************************************************************************/
+
+
+static uint32_t reclaim(snap_rcu_t *rcu)
+{
+	uint64_t oldest = UINT64_MAX;
+
+	for(uint32_t i = 0; i < rcu->readerCount; i++)
+	{
+		const uint64_t epoch = __atomic_load_n(&rcu->readers[i].epoch, __ATOMIC_SEQ_CST);
+
+		if((epoch != 0) && (epoch < oldest))
+		{
+			oldest = epoch;
+		}
+	}
+
+	uint32_t kept = 0;
+
+	for(uint32_t i = 0; i < rcu->retiredCount; i++)
+	{
+		const snap_rcuRetired_t retired = rcu->retired[i];
+
+		if(retired.epoch <= oldest)
+		{
+			retired.free(retired.context, retired.object);
+		}
+		else
+		{
+			rcu->retired[kept++] = retired;
+		}
+	}
+
+	rcu->retiredCount = kept;
+
+	return kept;
+}
+
+static void retire(snap_rcu_t *rcu, void *object, const snap_rcuFree_t free, void *context)
+{
+	// Full: wait for the readers to move on (they must acquire or release regularly)
+	while(reclaim(rcu) == SNAP_RCU_MAX_RETIRED)
+	{
+		const struct timespec pause = {.tv_sec = 0, .tv_nsec = WAIT_NS};
+		nanosleep(&pause, NULL);
+	}
+
+	rcu->retired[rcu->retiredCount++] = (snap_rcuRetired_t){.object = object, .free = free, .context = context,
+															.epoch = __atomic_load_n(&rcu->epoch, __ATOMIC_SEQ_CST)};
+}
+
+
+/******************************************************************************/
+/*  Public Functions                                                          */
+/******************************************************************************/
+
+
+/**
+ * @brief Initialize the shared state with a first configuration.
+ * @param[out] rcu     Pointer to the shared state.
+ * @param[in]  readers Number of readers (1 to #SNAP_RCU_MAX_READERS), identified by 0, 1...
+ * @param[in]  config  Pointer to the first configuration.
+ * @param[in]  free    Function that frees a configuration once it is retired.
+ * @param[in]  context Pointer passed to the function.
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set).
+ */
+int snap_rcuInit(snap_rcu_t *rcu, const uint32_t readers, void *config, const snap_rcuFree_t free, void *context)
+{
+	if((readers == 0) || (readers > SNAP_RCU_MAX_READERS))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	rcu->readers = mmap(NULL, readers * sizeof(snap_rcuReader_t), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if(rcu->readers == MAP_FAILED)
+	{
+		rcu->readers = NULL;
+		return -1;
+	}
+
+	rcu->current = config;
+	rcu->epoch = 1;
+	rcu->readerCount = readers;
+	rcu->free = free;
+	rcu->context = context;
+	rcu->retiredCount = 0;
+	pthread_mutex_init(&rcu->lock, NULL);
+
+	return 0;
+}
+
+/**
+ * @brief Get the latest configuration (reader side).
+ * @details The configuration returned by the previous call of this reader may be freed afterwards, so the
+ *          reader must not use it anymore (call it between two frames). If nothing was published since
+ *          that call, the same pointer is returned at the cost of a single load.
+ * @param[in,out] rcu    Pointer to the shared state.
+ * @param[in]     reader Index of the reader (used by a single thread).
+ * @return Pointer to the configuration, valid until the next call of snap_rcuAcquire() or snap_rcuRelease() by this reader.
+ */
+const void *snap_rcuAcquire(snap_rcu_t *rcu, const uint32_t reader)
+{
+	snap_rcuReader_t *state = &rcu->readers[reader];
+	const uint64_t epoch = __atomic_load_n(&rcu->epoch, __ATOMIC_ACQUIRE);
+
+	if(epoch == __atomic_load_n(&state->epoch, __ATOMIC_RELAXED))
+	{
+		return state->config;
+	}
+
+	// The announcement must be visible before the pointer is read (see reclaim())
+	__atomic_store_n(&state->epoch, epoch, __ATOMIC_SEQ_CST);
+	state->config = __atomic_load_n(&rcu->current, __ATOMIC_SEQ_CST);
+
+	return state->config;
+}
+
+/**
+ * @brief Give up the configuration held by a reader (reader side), e.g. before blocking.
+ * @param[in,out] rcu    Pointer to the shared state.
+ * @param[in]     reader Index of the reader.
+ */
+void snap_rcuRelease(snap_rcu_t *rcu, const uint32_t reader)
+{
+	snap_rcuReader_t *state = &rcu->readers[reader];
+
+	state->config = NULL;
+	__atomic_store_n(&state->epoch, 0U, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Publish a new configuration (writer side); the previous one is retired.
+ * @details The new object must not be changed afterwards. The readers get it on their next call of
+ *          snap_rcuAcquire(). Call snap_rcuReclaim() later to free the retired objects.
+ * @param[in,out] rcu    Pointer to the shared state.
+ * @param[in]     config Pointer to the new configuration.
+ */
+void snap_rcuPublish(snap_rcu_t *rcu, void *config)
+{
+	pthread_mutex_lock(&rcu->lock);
+
+	void *old = (void *)__atomic_load_n(&rcu->current, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&rcu->current, config, __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&rcu->epoch, 1U, __ATOMIC_SEQ_CST);
+	retire(rcu, old, rcu->free, rcu->context);
+	reclaim(rcu);
+
+	pthread_mutex_unlock(&rcu->lock);
+}
+
+/**
+ * @brief Retire an object that was referenced by the configurations published so far (writer side).
+ * @details Call it after publishing a configuration that no longer references the object. It is freed
+ *          once no reader can hold an older configuration.
+ * @param[in,out] rcu     Pointer to the shared state.
+ * @param[in]     object  Pointer to the object.
+ * @param[in]     free    Function that frees it.
+ * @param[in]     context Pointer passed to the function.
+ */
+void snap_rcuRetire(snap_rcu_t *rcu, void *object, const snap_rcuFree_t free, void *context)
+{
+	pthread_mutex_lock(&rcu->lock);
+	retire(rcu, object, free, context);
+	pthread_mutex_unlock(&rcu->lock);
+}
+
+/**
+ * @brief Free the retired objects that no reader can hold anymore (writer side).
+ * @param[in,out] rcu Pointer to the shared state.
+ * @return Number of objects still waiting for their grace period.
+ */
+uint32_t snap_rcuReclaim(snap_rcu_t *rcu)
+{
+	pthread_mutex_lock(&rcu->lock);
+
+	const uint32_t pending = reclaim(rcu);
+
+	pthread_mutex_unlock(&rcu->lock);
+
+	return pending;
+}
+
+/**
+ * @brief Free the current configuration, the retired objects and the state of the readers.
+ * @details No reader may use the shared state anymore.
+ * @param[in,out] rcu Pointer to the shared state.
+ */
+void snap_rcuDestroy(snap_rcu_t *rcu)
+{
+	if(rcu->readers == NULL)
+	{
+		return;
+	}
+
+	for(uint32_t i = 0; i < rcu->retiredCount; i++)
+	{
+		rcu->retired[i].free(rcu->retired[i].context, rcu->retired[i].object);
+	}
+
+	rcu->free(rcu->context, (void *)rcu->current);
+	munmap(rcu->readers, rcu->readerCount * sizeof(snap_rcuReader_t));
+	rcu->readers = NULL;
+	rcu->retiredCount = 0;
+	pthread_mutex_destroy(&rcu->lock);
+}
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,116 @@
+/**
+ * @file   snap_rcu.h
+ * @author Lucas Jadilo
+ * @brief  Configuration objects shared with worker threads through an RCU-like epoch scheme.
+ * @details A configuration (channel table, routes, compiled filters...) is published as a pointer to an
+ *          immutable object. A worker thread (reader) picks up the latest one with snap_rcuAcquire() at a
+ *          point where it holds no reference to the previous one, typically between two frames, and keeps
+ *          using it until the next call: the frame in progress always completes with the configuration it
+ *          started with, and the swap costs one load of a shared counter while nothing changes. Readers take
+ *          no lock and never wait.
+ *
+ *          A writer builds a new object and publishes it with snap_rcuPublish(); the old one is retired and
+ *          freed by snap_rcuReclaim() once every reader has acquired a configuration since then (grace period).
+ *          Each acquisition announces the epoch (number of publications) seen by the reader, so the writer
+ *          knows which objects a reader may still hold. A reader that is about to block (e.g. in poll()) and
+ *          holds nothing calls snap_rcuRelease() so it does not delay the grace periods. Other objects
+ *          unlinked from a configuration (e.g. buffers referenced by it) can be retired with snap_rcuRetire().
+ *
+ *          Writers are serialized by a mutex. The free functions run on the writer that calls snap_rcuReclaim().
+ */
+
+#ifndef SNAP_RCU_H_
+#define SNAP_RCU_H_
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define SNAP_RCU_MAX_READERS	(64U)	/**< @brief Largest number of readers. */
+#define SNAP_RCU_MAX_RETIRED	(64U)	/**< @brief Objects waiting for their grace period (a writer waits when it is reached). */
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+/**
+ * @brief Function that frees a retired object.
+ * @param[in] context Pointer passed with the object.
+ * @param[in] object  Pointer to the object.
+ */
+typedef void (*snap_rcuFree_t)(void *context, void *object);
+
+/**
+ * @brief State of a reader, on its own cache line.
+ */
+typedef struct snap_rcuReader_t
+{
+	uint64_t   epoch;		/**< @brief Epoch announced by the reader (0 = holds nothing). Accessed with __atomic builtins. */
+	const void *config;		/**< @brief Configuration held by the reader (read by the reader only). */
+	uint8_t    padding[64U - sizeof(uint64_t) - sizeof(void *)];
+} snap_rcuReader_t;
+
+/**
+ * @brief Object waiting for its grace period.
+ */
+typedef struct snap_rcuRetired_t
+{
+	void           *object;		/**< @brief Pointer to the object. */
+	snap_rcuFree_t free;		/**< @brief Function that frees it. */
+	void           *context;	/**< @brief Pointer passed to the function. */
+	uint64_t       epoch;		/**< @brief The object can be freed once every reader that holds something has announced this epoch. */
+} snap_rcuRetired_t;
+
+/**
+ * @brief Published configuration and its readers.
+ */
+typedef struct snap_rcu_t
+{
+	const void        *current;							/**< @brief Latest configuration. Accessed with __atomic builtins. */
+	uint64_t          epoch;							/**< @brief Number of publications plus one. Accessed with __atomic builtins. */
+	snap_rcuReader_t  *readers;							/**< @brief State of each reader (cache line aligned). */
+	uint32_t          readerCount;						/**< @brief Number of readers. */
+	snap_rcuFree_t    free;								/**< @brief Function that frees a configuration. */
+	void              *context;							/**< @brief Pointer passed to it. */
+	snap_rcuRetired_t retired[SNAP_RCU_MAX_RETIRED];	/**< @brief Objects waiting for their grace period. */
+	uint32_t          retiredCount;						/**< @brief Number of them. */
+	pthread_mutex_t   lock;								/**< @brief Serializes the writers. */
+} snap_rcu_t;
+
+
+/******************************************************************************/
+/*  Function Declarations                                                     */
+/******************************************************************************/
+
+
+int snap_rcuInit(snap_rcu_t *rcu, uint32_t readers, void *config, snap_rcuFree_t free, void *context);
+
+const void *snap_rcuAcquire(snap_rcu_t *rcu, uint32_t reader);
+
+void snap_rcuRelease(snap_rcu_t *rcu, uint32_t reader);
+
+void snap_rcuPublish(snap_rcu_t *rcu, void *config);
+
+void snap_rcuRetire(snap_rcu_t *rcu, void *object, snap_rcuFree_t free, void *context);
+
+uint32_t snap_rcuReclaim(snap_rcu_t *rcu);
+
+void snap_rcuDestroy(snap_rcu_t *rcu);
+
+#endif	// SNAP_RCU_H_
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,117 @@
+/**
+ * @file   snap_tty.c
+ * @author Lucas Jadilo
+ * @brief  Serial port (tty/pty) helpers shared by the command-line tools.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <stddef.h>
+#include <termios.h>
+#include "snap_tty.h"
+
+
+/******************************************************************************/
+/*  Private Functions                                                         */
+/******************************************************************************/
+
+
+static speed_t baudToSpeed(const long baud)
+{
+	static const struct { long baud; speed_t speed; } table[] =
+	{
+		{1200, B1200}, {2400, B2400}, {4800, B4800}, {9600, B9600}, {19200, B19200}, {38400, B38400},
+		{57600, B57600}, {115200, B115200}, {230400, B230400}, {460800, B460800}, {921600, B921600}
+	};
+
+	for(size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++)
+	{
+		if(table[i].baud == baud)
+		{
+			return table[i].speed;
+		}
+	}
+
+	return B0;
+}
+
+
+/******************************************************************************/
+/*  Public Functions                                                          */
+/******************************************************************************/
+
+
+/**
+ * @brief Put a tty in raw mode (8N1, no echo, no line processing) and optionally set its baud rate.
+ * @param[in] fd   File descriptor of the tty.
+ * @param[in] baud Baud rate, or 0 to keep the current one.
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set; EINVAL means the baud rate is not supported).
+ */
+int snap_ttyConfigure(const int fd, const long baud)
+{
+	struct termios tty;
+
+	if(tcgetattr(fd, &tty) < 0)
+	{
+		return -1;
+	}
+
+	cfmakeraw(&tty);
+	tty.c_cc[VMIN] = 1;
+	tty.c_cc[VTIME] = 0;
+
+	if(baud)
+	{
+		const speed_t speed = baudToSpeed(baud);
+
+		if(speed == B0)
+		{
+			errno = EINVAL;
+			return -1;
+		}
+
+		cfsetispeed(&tty, speed);
+		cfsetospeed(&tty, speed);
+	}
+
+	return tcsetattr(fd, TCSANOW, &tty);
+}
+
+/**
+ * @brief Change the baud rate of a tty once the bytes already written to it have been sent.
+ * @details Unlike snap_ttyConfigure(), the other settings are kept and a frame being sent is not cut.
+ * @param[in] fd   File descriptor of the tty.
+ * @param[in] baud Baud rate.
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set; EINVAL means the baud rate is not supported).
+ */
+int snap_ttySetBaud(const int fd, const long baud)
+{
+	const speed_t speed = baudToSpeed(baud);
+	struct termios tty;
+
+	if(speed == B0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	if(tcgetattr(fd, &tty) < 0)
+	{
+		return -1;
+	}
+
+	cfsetispeed(&tty, speed);
+	cfsetospeed(&tty, speed);
+
+	return tcsetattr(fd, TCSADRAIN, &tty);
+}
+
+/******************************** END OF FILE *********************************/
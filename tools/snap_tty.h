@@ -0,0 +1,22 @@
+/**
+ * @file   snap_tty.h
+ * @author Lucas Jadilo
+ * @brief  Serial port (tty/pty) helpers shared by the command-line tools.
+ */
+
+#ifndef SNAP_TTY_H_
+#define SNAP_TTY_H_
+
+
+/******************************************************************************/
+/*  Function Declarations                                                     */
+/******************************************************************************/
+
+
+int snap_ttyConfigure(int fd, long baud);
+
+int snap_ttySetBaud(int fd, long baud);
+
+#endif	// SNAP_TTY_H_
+
+/******************************** END OF FILE *********************************/
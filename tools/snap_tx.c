@@ -0,0 +1,201 @@
+/**
+ * @file   snap_tx.c
+ * @author Lucas Jadilo
+ * @brief  Transmit ring: frames encapsulated directly into buffers owned by the transport.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include "snap_align.h"
+#include "snap_tx.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define SLOT_SIZE	(ALIGN((size_t)SNAP_MAX_SIZE_FRAME))
+#define MAX_SLOTS	(1U << 20)
+
+
+/******************************************************************************/
+/*  Public Functions                                                          */
+/******************************************************************************/
+
+
+/**
+ * @brief Create a transmit ring.
+ * @param[out] tx    Pointer to the ring structure.
+ * @param[in]  fd    File descriptor the frames will be written to (blocking or not).
+ * @param[in]  slots Number of slots (1 to 2^20, rounded up to a power of two), i.e. frames that can wait to be sent.
+ * @retval 0  Success.
+ * @retval -1 Error (errno is set).
+ */
+int snap_txInit(snap_tx_t *tx, const int fd, const uint32_t slots)
+{
+	if((slots == 0) || (slots > MAX_SLOTS))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	uint32_t count = 1;
+
+	while(count < slots)
+	{
+		count <<= 1;
+	}
+
+	const size_t framesSize = ALIGN(count * sizeof(snap_frame_t));
+
+	tx->memorySize = framesSize + count * SLOT_SIZE;
+	tx->memory = mmap(NULL, tx->memorySize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if(tx->memory == MAP_FAILED)
+	{
+		tx->memory = NULL;
+		return -1;
+	}
+
+	uint8_t *buffers = (uint8_t *)tx->memory + framesSize;
+
+	tx->fd = fd;
+	tx->frames = tx->memory;
+	tx->mask = count - 1U;
+	tx->head = 0;
+	tx->tail = 0;
+	tx->offset = 0;
+	tx->framesSent = 0;
+	tx->bytesSent = 0;
+	tx->calls = 0;
+
+	for(uint32_t i = 0; i < count; i++)
+	{
+		snap_init(&tx->frames[i], &buffers[i * SLOT_SIZE], SNAP_MAX_SIZE_FRAME);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Borrow the next free slot of the ring.
+ * @details It must be called by the producer only. The frame is reset (see snap_reset()) and its buffer
+ *          belongs to the ring: build the frame in it (e.g. with snap_encapsulate()) and then call
+ *          snap_txSubmit(). Until then, this function returns the same slot.
+ * @param[in,out] tx Pointer to the ring structure.
+ * @return Pointer to the frame of the slot, or NULL if every slot is waiting to be sent (call snap_txFlush()).
+ */
+snap_frame_t *snap_txAcquire(snap_tx_t *tx)
+{
+	const uint64_t tail = tx->tail;
+
+	if(tail - __atomic_load_n(&tx->head, __ATOMIC_ACQUIRE) > tx->mask)
+	{
+		return NULL;
+	}
+
+	snap_frame_t *frame = &tx->frames[tail & tx->mask];
+
+	snap_reset(frame);
+
+	return frame;
+}
+
+/**
+ * @brief Queue the slot returned by the last snap_txAcquire() call to be sent.
+ * @details It must be called by the producer only. The first frame->size bytes of the slot are sent, and
+ *          the slot must not be changed afterwards.
+ * @param[in,out] tx Pointer to the ring structure.
+ */
+void snap_txSubmit(snap_tx_t *tx)
+{
+	__atomic_store_n(&tx->tail, tx->tail + 1U, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Send every submitted slot, up to #SNAP_TX_MAX_BATCH frames per writev() call.
+ * @details It must be called by the transport only. A frame partially written is resumed on the next call.
+ * @param[in,out] tx Pointer to the ring structure.
+ * @retval 0  Every slot submitted before the call was sent.
+ * @retval -1 Error (errno is set; with a non-blocking descriptor, EAGAIN means that some slots are still waiting).
+ */
+int snap_txFlush(snap_tx_t *tx)
+{
+	const uint64_t tail = __atomic_load_n(&tx->tail, __ATOMIC_ACQUIRE);
+	uint64_t head = tx->head;
+
+	while(head != tail)
+	{
+		struct iovec vectors[SNAP_TX_MAX_BATCH];
+		int count = 0;
+
+		for(uint64_t i = head; (i != tail) && (count < (int)SNAP_TX_MAX_BATCH); i++, count++)
+		{
+			const snap_frame_t *frame = &tx->frames[i & tx->mask];
+			const size_t skip = (i == head) ? tx->offset : 0U;
+
+			vectors[count].iov_base = &frame->buffer[skip];
+			vectors[count].iov_len = frame->size - skip;
+		}
+
+		const ssize_t ret = writev(tx->fd, vectors, count);
+
+		if(ret < 0)
+		{
+			if(errno == EINTR) continue;
+			return -1;
+		}
+
+		size_t written = (size_t)ret;
+
+		tx->calls++;
+		tx->bytesSent += written;
+
+		for(int i = 0; (i < count) && (written >= vectors[i].iov_len); i++)
+		{
+			written -= vectors[i].iov_len;
+			tx->offset = 0;
+			tx->framesSent++;
+			head++;
+		}
+
+		tx->offset += written;
+		__atomic_store_n(&tx->head, head, __ATOMIC_RELEASE);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Get the number of slots waiting to be sent.
+ * @param[in] tx Pointer to the ring structure.
+ * @return Number of slots submitted and not completely written yet.
+ */
+uint32_t snap_txPending(const snap_tx_t *tx)
+{
+	return (uint32_t)(__atomic_load_n(&tx->tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&tx->head, __ATOMIC_ACQUIRE));
+}
+
+/**
+ * @brief Free the memory of a transmit ring (the file descriptor is not closed).
+ * @param[in,out] tx Pointer to the ring structure.
+ */
+void snap_txDestroy(snap_tx_t *tx)
+{
+	if(tx->memory != NULL)
+	{
+		munmap(tx->memory, tx->memorySize);
+		tx->memory = NULL;
+	}
+}
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,84 @@
+/**
+ * @file   snap_tx.h
+ * @author Lucas Jadilo
+ * @brief  Transmit ring: frames encapsulated directly into buffers owned by the transport.
+ * @details The usual send path encapsulates a frame into a local buffer and the transport copies it into its
+ *          own write buffer. Here the transport owns a ring of frame slots, in one mapping, and lends the next
+ *          free slot to the producer as a ready frame structure (see snap_init()): the producer encapsulates
+ *          into it (snap_encapsulate() or any in-place builder) and submits it, and the transport sends all
+ *          the submitted slots with a single writev() call, straight from the ring. A slot is free again once
+ *          its bytes are written, so the frame bytes are written once by the encoder and read once by the kernel.
+ *
+ *          The producer (snap_txAcquire(), snap_txSubmit()) and the transport (snap_txFlush()) may be different
+ *          threads: the ring is a single-producer single-consumer queue.
+ *
+ *          The slot buffers are contiguous and cache line aligned in a page aligned anonymous mapping, so the
+ *          whole area can also be registered as a fixed buffer of an io_uring instance, or the mapping replaced
+ *          by a shared memory one.
+ */
+
+#ifndef SNAP_TX_H_
+#define SNAP_TX_H_
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include <stddef.h>
+#include "snap.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define SNAP_TX_MAX_BATCH	(64U)	/**< @brief Largest number of frames sent by one writev() call. */
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+/**
+ * @brief Transmit ring.
+ */
+typedef struct snap_tx_t
+{
+	int          fd;			/**< @brief File descriptor the frames are written to. */
+	snap_frame_t *frames;		/**< @brief Frame structure of each slot (frames[i].buffer is in the mapping). */
+	uint32_t     mask;			/**< @brief Number of slots minus one (the number of slots is a power of two). */
+	uint64_t     head;			/**< @brief Number of slots sent (written by the transport). Accessed with __atomic builtins. */
+	uint64_t     tail;			/**< @brief Number of slots submitted (written by the producer). Accessed with __atomic builtins. */
+	size_t       offset;		/**< @brief Bytes of the head slot already written (partial write). */
+	uint64_t     framesSent;	/**< @brief Number of frames sent. */
+	uint64_t     bytesSent;		/**< @brief Number of bytes sent. */
+	uint64_t     calls;			/**< @brief Number of writev() calls. */
+	void         *memory;		/**< @brief Mapping that holds the frame structures and the slot buffers. */
+	size_t       memorySize;	/**< @brief Size of the mapping. */
+} snap_tx_t;
+
+
+/******************************************************************************/
+/*  Function Declarations                                                     */
+/******************************************************************************/
+
+
+int snap_txInit(snap_tx_t *tx, int fd, uint32_t slots);
+
+snap_frame_t *snap_txAcquire(snap_tx_t *tx);
+
+void snap_txSubmit(snap_tx_t *tx);
+
+int snap_txFlush(snap_tx_t *tx);
+
+uint32_t snap_txPending(const snap_tx_t *tx);
+
+void snap_txDestroy(snap_tx_t *tx);
+
+#endif	// SNAP_TX_H_
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,69 @@
+#!/bin/sh
+################################################################################
+# @file   snapbench-valgrind.sh
+# @author Lucas Jadilo
+# @brief  Instruction count and simulated cache misses per frame of each fixed
+#         workload of snapbench, measured under valgrind.
+# @details Each workload runs twice, with N and 2N frames, and the difference
+#          of the totals is divided by N, so the setup of the process (loader,
+#          libc, building the frame set) cancels out and the result is exactly
+#          the cost of N frames. The counts are deterministic: unlike the time,
+#          they do not depend on the host load, and a change of a single
+#          instruction per byte in snap_decode() shows up in decode-mixed.
+#
+#          Usage: snapbench-valgrind.sh [cachegrind|callgrind] [snapbench] [N]
+#          The output files of the 2N runs are kept in build/valgrind/ (e.g. for
+#          cg_annotate or callgrind_annotate).
+################################################################################
+
+set -e
+
+TOOL=${1:-cachegrind}
+BENCH=${2:-build/bin/snapbench}
+FRAMES=${3:-4096}
+OUT_DIR=build/valgrind
+
+case "$TOOL" in
+	cachegrind|callgrind) ;;
+	*) echo "usage: $0 [cachegrind|callgrind] [snapbench] [frames]" >&2; exit 2 ;;
+esac
+
+if ! command -v valgrind > /dev/null 2>&1; then
+	echo "$0: valgrind not found" >&2
+	exit 1
+fi
+
+mkdir -p "$OUT_DIR"
+
+# Print the totals of a valgrind output file as "Ir D1-misses LL-misses"
+totals()
+{
+	awk '
+		/^events:/ { for(i = 2; i <= NF; i++) name[i - 1] = $i }
+		/^(summary|totals):/ { for(i = 2; i <= NF; i++) value[name[i - 1]] = $i }
+		END {
+			printf "%d %d %d\n", value["Ir"], value["D1mr"] + value["D1mw"], value["ILmr"] + value["DLmr"] + value["DLmw"]
+		}' "$1"
+}
+
+run()
+{
+	if [ "$TOOL" = cachegrind ]; then
+		valgrind --tool=cachegrind --cache-sim=yes --cachegrind-out-file="$3" "$BENCH" -w "$1" -n "$2" > /dev/null 2>&1
+	else
+		valgrind --tool=callgrind --cache-sim=yes --callgrind-out-file="$3" "$BENCH" -w "$1" -n "$2" > /dev/null 2>&1
+	fi
+}
+
+printf "%-20s %12s %12s %12s\n" "workload" "Ir/frame" "D1miss/frame" "LLmiss/frame"
+
+for WORKLOAD in $("$BENCH" -l); do
+	run "$WORKLOAD" "$FRAMES" "$OUT_DIR/$TOOL.$WORKLOAD.1"
+	run "$WORKLOAD" $((FRAMES * 2)) "$OUT_DIR/$TOOL.$WORKLOAD"
+	set -- $(totals "$OUT_DIR/$TOOL.$WORKLOAD.1") $(totals "$OUT_DIR/$TOOL.$WORKLOAD")
+	rm -f "$OUT_DIR/$TOOL.$WORKLOAD.1"
+	awk -v name="$WORKLOAD" -v n="$FRAMES" -v ir1="$1" -v d1="$2" -v ll1="$3" -v ir2="$4" -v d2="$5" -v ll2="$6" \
+		'BEGIN { printf "%-20s %12.2f %12.3f %12.3f\n", name, (ir2 - ir1) / n, (d2 - d1) / n, (ll2 - ll1) / n }'
+done
+
+############################### END OF FILE ####################################
@@ -0,0 +1,442 @@
+/**
+ * @file   snapbench.c
+ * @author Lucas Jadilo
+ * @brief  snapbench: micro-benchmarks of the library functions, with optional hardware counters.
+ * @details Each benchmark runs a function of the library over a set of prebuilt frames (2-byte addresses,
+ *          1 flags byte and random data) and reports the time per frame: snap_decode() byte by byte,
+ *          snap_decodeBuffer(), snap_encapsulate(), snap_getField() (destination, source, flags and hash)
+ *          and snap_calculateHash() for each error detection method. With -c, the cycles, instructions,
+ *          branch misses and cache misses per frame are reported too (see snap_perf.h), which tells whether
+ *          a change in the time comes from mispredictions, cache misses or just more instructions.
+ *
+ *          With -w, a single fixed workload runs without any timing, so that its instruction count and
+ *          simulated cache misses can be measured under valgrind (see tools/snapbench-valgrind.sh). The
+ *          workloads are deterministic: the same binary always executes the same instructions.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "snap.h"
+#include "snap_perf.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define FRAMES		(256U)		// Frames of a set (they are used repeatedly)
+#define MAX_DATA	(512U)		// Largest data size of a frame
+#define MIXED		(-1)		// Data size of the workloads with frames of every format
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+typedef struct set_t
+{
+	snap_fields_t fields[FRAMES];
+	snap_frame_t  frames[FRAMES];
+	uint8_t       buffers[FRAMES][SNAP_MAX_SIZE_FRAME];
+	uint8_t       data[FRAMES][MAX_DATA];
+} set_t;
+
+typedef uint64_t (*benchmark_t)(set_t *set, uint64_t count);
+
+typedef struct workload_t
+{
+	const char      *name;
+	benchmark_t     benchmark;
+	int             dataSize;	// Data bytes per frame, or MIXED
+	snap_hdb1_edm_t edm;
+} workload_t;
+
+
+/******************************************************************************/
+/*  Global Variables                                                          */
+/******************************************************************************/
+
+
+static snap_perf_t perf;
+static bool counters = false;
+static uint64_t checksum = 0;	// Keeps the results from being optimized out
+
+
+/******************************************************************************/
+/*  Function Definitions                                                      */
+/******************************************************************************/
+
+
+static void usage(void)
+{
+	fputs("usage: snapbench [-n frames] [-d size] [-c] [-w workload | -l]\n"
+		  "  -n frames    frames processed by each benchmark (default: 1000000)\n"
+		  "  -d size      data bytes per frame, 0 to 512 (default: 64)\n"
+		  "  -c           also report hardware counters per frame (cycles, instructions, branch and cache misses)\n"
+		  "  -w workload  only run this fixed workload, without timing (e.g. under valgrind)\n"
+		  "  -l           list the fixed workloads\n",
+		  stderr);
+}
+
+static uint64_t monotonicNs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000U + (uint64_t)now.tv_nsec;
+}
+
+static void buildSet(set_t *set, const uint16_t dataSize, const snap_hdb1_edm_t edm)
+{
+	srand(1);
+
+	for(uint32_t i = 0; i < FRAMES; i++)
+	{
+		snap_fields_t *fields = &set->fields[i];
+
+		for(uint16_t j = 0; j < dataSize; j++)
+		{
+			set->data[i][j] = (uint8_t)rand();
+		}
+
+		memset(fields, 0, sizeof(*fields));
+		fields->data = set->data[i];
+		fields->dataSize = dataSize;
+		fields->paddingAfter = true;
+		fields->destAddress = (uint32_t)rand() & 0xFFFFU;
+		fields->sourceAddress = (uint32_t)rand() & 0xFFFFU;
+		fields->protocolFlags = (uint32_t)rand() & 0xFFU;
+		fields->header.dab = SNAP_HDB2_DAB_2BYTE_DEST_ADDRESS;
+		fields->header.sab = SNAP_HDB2_SAB_2BYTE_SOURCE_ADDRESS;
+		fields->header.pfb = SNAP_HDB2_PFB_1BYTE_PROTOCOL_FLAGS;
+		fields->header.edm = edm & SNAP_HDB1_EDM_MASK;
+
+		snap_init(&set->frames[i], set->buffers[i], SNAP_MAX_SIZE_FRAME);
+
+		snap_fields_t copy = *fields;
+		snap_encapsulate(&set->frames[i], &copy);
+	}
+}
+
+static void buildMixedSet(set_t *set)
+{
+	static const snap_hdb1_edm_t edms[] = {SNAP_HDB1_EDM_NO_ERROR_DETECTION, SNAP_HDB1_EDM_8BIT_CHECKSUM, SNAP_HDB1_EDM_8BIT_CRC,
+										   SNAP_HDB1_EDM_16BIT_CRC, SNAP_HDB1_EDM_32BIT_CRC, SNAP_HDB1_EDM_USER_SPECIFIED};
+
+	srand(1);
+
+	for(uint32_t i = 0; i < FRAMES; i++)
+	{
+		snap_fields_t *fields = &set->fields[i];
+		const uint16_t dataSize = snap_getDataSizeFromNdb((uint8_t)(rand() % 15));
+
+		for(uint16_t j = 0; j < dataSize; j++)
+		{
+			set->data[i][j] = (uint8_t)rand();
+		}
+
+		memset(fields, 0, sizeof(*fields));
+		fields->data = set->data[i];
+		fields->dataSize = dataSize;
+		fields->paddingAfter = (rand() % 2) != 0;
+		fields->destAddress = (uint32_t)rand() & 0xFFFFFFU;
+		fields->sourceAddress = (uint32_t)rand() & 0xFFFFFFU;
+		fields->protocolFlags = (uint32_t)rand() & 0xFFFFFFU;
+		fields->header.dab = (unsigned int)rand() & SNAP_HDB2_DAB_MASK;
+		fields->header.sab = (unsigned int)rand() & SNAP_HDB2_SAB_MASK;
+		fields->header.pfb = (unsigned int)rand() & SNAP_HDB2_PFB_MASK;
+		fields->header.ack = (unsigned int)rand() & SNAP_HDB2_ACK_MASK;
+		fields->header.cmd = (unsigned int)rand() & SNAP_HDB1_CMD_MASK;
+		fields->header.edm = edms[(unsigned int)rand() % (sizeof(edms) / sizeof(edms[0]))] & SNAP_HDB1_EDM_MASK;
+
+		snap_init(&set->frames[i], set->buffers[i], SNAP_MAX_SIZE_FRAME);
+
+		snap_fields_t copy = *fields;
+		snap_encapsulate(&set->frames[i], &copy);
+	}
+}
+
+static uint64_t benchDecode(set_t *set, const uint64_t count)
+{
+	uint8_t buffer[SNAP_MAX_SIZE_FRAME];
+	snap_frame_t frame;
+	uint64_t sum = 0;
+
+	snap_init(&frame, buffer, sizeof(buffer));
+
+	for(uint64_t i = 0; i < count; i++)
+	{
+		const snap_frame_t *input = &set->frames[i % FRAMES];
+
+		snap_reset(&frame);
+
+		for(uint16_t j = 0; j < input->size; j++)
+		{
+			snap_decode(&frame, input->buffer[j]);
+		}
+
+		sum += (uint64_t)(frame.status + frame.size);
+	}
+
+	return sum;
+}
+
+static uint64_t benchDecodeBuffer(set_t *set, const uint64_t count)
+{
+	uint8_t buffer[SNAP_MAX_SIZE_FRAME];
+	snap_frame_t frame;
+	uint64_t sum = 0;
+
+	snap_init(&frame, buffer, sizeof(buffer));
+
+	for(uint64_t i = 0; i < count; i++)
+	{
+		const snap_frame_t *input = &set->frames[i % FRAMES];
+
+		snap_reset(&frame);
+		sum += snap_decodeBuffer(&frame, input->buffer, input->size) + (uint64_t)frame.status;
+	}
+
+	return sum;
+}
+
+static uint64_t benchEncapsulate(set_t *set, const uint64_t count)
+{
+	uint8_t buffer[SNAP_MAX_SIZE_FRAME];
+	snap_frame_t frame;
+	uint64_t sum = 0;
+
+	snap_init(&frame, buffer, sizeof(buffer));
+
+	for(uint64_t i = 0; i < count; i++)
+	{
+		snap_fields_t fields = set->fields[i % FRAMES];
+
+		sum += (uint64_t)snap_encapsulate(&frame, &fields) + frame.size + buffer[frame.size - 1U];
+	}
+
+	return sum;
+}
+
+static uint64_t benchGetField(set_t *set, const uint64_t count)
+{
+	uint64_t sum = 0;
+
+	for(uint64_t i = 0; i < count; i++)
+	{
+		const snap_frame_t *frame = &set->frames[i % FRAMES];
+		uint32_t dest = 0, source = 0, flags = 0, hash = 0;
+
+		snap_getField(frame, &dest, SNAP_FIELD_DEST_ADDRESS);
+		snap_getField(frame, &source, SNAP_FIELD_SOURCE_ADDRESS);
+		snap_getField(frame, &flags, SNAP_FIELD_PROTOCOL_FLAGS);
+		snap_getField(frame, &hash, SNAP_FIELD_HASH);
+
+		sum += (uint64_t)dest + source + flags + hash;
+	}
+
+	return sum;
+}
+
+static uint64_t benchHash(set_t *set, const uint64_t count)
+{
+	uint64_t sum = 0;
+
+	for(uint64_t i = 0; i < count; i++)
+	{
+		uint32_t hash = 0;
+
+		snap_calculateHash(&set->frames[i % FRAMES], &hash);
+		sum += hash;
+	}
+
+	return sum;
+}
+
+static void measure(const char *name, const benchmark_t benchmark, set_t *set, const uint64_t count)
+{
+	snap_perfCounts_t counts;
+
+	checksum += benchmark(set, FRAMES);	// Warm up the caches and the branch predictors
+
+	if(counters) snap_perfStart(&perf);
+
+	const uint64_t start = monotonicNs();
+
+	checksum += benchmark(set, count);
+
+	const uint64_t elapsed = monotonicNs() - start;
+
+	if(counters) snap_perfStop(&perf, &counts);
+
+	printf("%-18s %9.1f", name, (double)elapsed / (double)count);
+
+	if(counters)
+	{
+		snap_perfPrint(stdout, &counts, count);
+	}
+
+	putchar('\n');
+}
+
+static const workload_t workloads[] =
+{
+	{"decode-mixed",       benchDecode,       MIXED, SNAP_HDB1_EDM_NO_ERROR_DETECTION},
+	{"decodeBuffer-mixed", benchDecodeBuffer, MIXED, SNAP_HDB1_EDM_NO_ERROR_DETECTION},
+	{"getField-mixed",     benchGetField,     MIXED, SNAP_HDB1_EDM_NO_ERROR_DETECTION},
+	{"encapsulate-0",      benchEncapsulate,  0,     SNAP_HDB1_EDM_16BIT_CRC},
+	{"encapsulate-1",      benchEncapsulate,  1,     SNAP_HDB1_EDM_16BIT_CRC},
+	{"encapsulate-2",      benchEncapsulate,  2,     SNAP_HDB1_EDM_16BIT_CRC},
+	{"encapsulate-3",      benchEncapsulate,  3,     SNAP_HDB1_EDM_16BIT_CRC},
+	{"encapsulate-4",      benchEncapsulate,  4,     SNAP_HDB1_EDM_16BIT_CRC},
+	{"encapsulate-5",      benchEncapsulate,  5,     SNAP_HDB1_EDM_16BIT_CRC},
+	{"encapsulate-6",      benchEncapsulate,  6,     SNAP_HDB1_EDM_16BIT_CRC},
+	{"encapsulate-7",      benchEncapsulate,  7,     SNAP_HDB1_EDM_16BIT_CRC},
+	{"encapsulate-8",      benchEncapsulate,  8,     SNAP_HDB1_EDM_16BIT_CRC},
+	{"encapsulate-16",     benchEncapsulate,  16,    SNAP_HDB1_EDM_16BIT_CRC},
+	{"encapsulate-32",     benchEncapsulate,  32,    SNAP_HDB1_EDM_16BIT_CRC},
+	{"encapsulate-64",     benchEncapsulate,  64,    SNAP_HDB1_EDM_16BIT_CRC},
+	{"encapsulate-128",    benchEncapsulate,  128,   SNAP_HDB1_EDM_16BIT_CRC},
+	{"encapsulate-256",    benchEncapsulate,  256,   SNAP_HDB1_EDM_16BIT_CRC},
+	{"encapsulate-512",    benchEncapsulate,  512,   SNAP_HDB1_EDM_16BIT_CRC},
+	{"hash-checksum",      benchHash,         64,    SNAP_HDB1_EDM_8BIT_CHECKSUM},
+	{"hash-crc8",          benchHash,         64,    SNAP_HDB1_EDM_8BIT_CRC},
+	{"hash-crc16",         benchHash,         64,    SNAP_HDB1_EDM_16BIT_CRC},
+	{"hash-crc32",         benchHash,         64,    SNAP_HDB1_EDM_32BIT_CRC},
+};
+
+static int runWorkload(set_t *set, const char *name, const uint64_t count)
+{
+	for(size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++)
+	{
+		const workload_t *workload = &workloads[i];
+
+		if(strcmp(workload->name, name) == 0)
+		{
+			if(workload->dataSize == MIXED)
+			{
+				buildMixedSet(set);
+			}
+			else
+			{
+				buildSet(set, (uint16_t)workload->dataSize, workload->edm);
+			}
+
+			checksum = workload->benchmark(set, count);
+			printf("%s frames=%llu checksum=%llu\n", name, (unsigned long long)count, (unsigned long long)checksum);
+
+			return 0;
+		}
+	}
+
+	fprintf(stderr, "snapbench: unknown workload '%s' (see -l)\n", name);
+
+	return 2;
+}
+
+int main(int argc, char **argv)
+{
+	static set_t set;
+	static const struct { const char *name; snap_hdb1_edm_t edm; } hashes[] =
+	{
+		{"hash checksum", SNAP_HDB1_EDM_8BIT_CHECKSUM},
+		{"hash crc8", SNAP_HDB1_EDM_8BIT_CRC},
+		{"hash crc16", SNAP_HDB1_EDM_16BIT_CRC},
+		{"hash crc32", SNAP_HDB1_EDM_32BIT_CRC},
+		{"hash user", SNAP_HDB1_EDM_USER_SPECIFIED},
+	};
+	unsigned long long count = 1000000, dataSize = 64;
+	const char *workload = NULL;
+	int opt;
+
+	while((opt = getopt(argc, argv, "n:d:cw:l")) != -1)
+	{
+		char *end;
+
+		switch(opt)
+		{
+			case 'n':
+				count = strtoull(optarg, &end, 0);
+				if((*end != '\0') || (count == 0)) { usage(); return 2; }
+				break;
+			case 'd':
+				dataSize = strtoull(optarg, &end, 0);
+				if((*end != '\0') || (*optarg == '\0') || (dataSize > MAX_DATA)) { usage(); return 2; }
+				break;
+			case 'c':
+				counters = true;
+				break;
+			case 'w':
+				workload = optarg;
+				break;
+			case 'l':
+				for(size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++)
+				{
+					puts(workloads[i].name);
+				}
+				return 0;
+			default:
+				usage();
+				return 2;
+		}
+	}
+
+	if(optind != argc)
+	{
+		usage();
+		return 2;
+	}
+
+	if(workload != NULL)
+	{
+		return runWorkload(&set, workload, count);
+	}
+
+	if(counters && (snap_perfOpen(&perf) < 0))
+	{
+		fprintf(stderr, "snapbench: hardware counters not available (%s), reporting time only\n", strerror(errno));
+		counters = false;
+	}
+
+	printf("frames=%llu data=%llu bytes\n%-18s %9s", count, dataSize, "benchmark", "ns/frame");
+
+	if(counters)
+	{
+		snap_perfPrintHeader(stdout);
+	}
+
+	putchar('\n');
+
+	buildSet(&set, (uint16_t)dataSize, SNAP_HDB1_EDM_16BIT_CRC);
+	measure("decode", benchDecode, &set, count);
+	measure("decodeBuffer", benchDecodeBuffer, &set, count);
+	measure("encapsulate", benchEncapsulate, &set, count);
+	measure("getField", benchGetField, &set, count);
+
+	for(size_t i = 0; i < sizeof(hashes) / sizeof(hashes[0]); i++)
+	{
+		buildSet(&set, (uint16_t)dataSize, hashes[i].edm);
+		measure(hashes[i].name, benchHash, &set, count);
+	}
+
+	if(counters)
+	{
+		snap_perfClose(&perf);
+	}
+
+	return (checksum != 0) ? 0 : 1;
+}
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,628 @@
+/**
+ * @file   snapcat.c
+ * @author Lucas Jadilo
+ * @brief  snapcat: decode a SNAP byte stream (file, pipe, tty or pty) and print the frames as text or JSON Lines.
+ * @details The input is read in large blocks straight into the stream decoder buffer, and the output is
+ *          formatted by hand into a large output buffer, so no memory is allocated per frame and no
+ *          stdio formatting is done in the hot path.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "snap_index.h"
+#include "snap_pcapng.h"
+#include "snap_stream.h"
+#include "snap_tty.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define INPUT_BUFFER_SIZE	(1U << 20)	// Bytes read from the input at once (at most)
+#define OUTPUT_BUFFER_SIZE	(1U << 20)	// Bytes written to the output at once (at most)
+#define MAX_LINE_SIZE		(2048U)		// Longest line: 1024 hex digits of payload plus the other fields
+
+#define STATUS_MASK_VALID		(0x01U)
+#define STATUS_MASK_HASH		(0x02U)
+#define STATUS_MASK_OVERFLOW	(0x04U)
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+typedef struct filter_t
+{
+	uint32_t destAddress;
+	uint32_t sourceAddress;
+	uint8_t  edm;
+	uint8_t  statusMask;
+	bool     checkDest;
+	bool     checkSource;
+	bool     checkEdm;
+} filter_t;
+
+typedef struct output_t
+{
+	char                 buffer[OUTPUT_BUFFER_SIZE];
+	size_t               length;
+	filter_t             filter;
+	snap_captureWriter_t capture;
+	snap_indexBuilder_t  index;
+	snap_pcapngWriter_t  pcapng;
+	uint64_t             timestamp;
+	uint16_t             channel;
+	bool                 capturing;
+	bool                 exporting;
+	bool                 quiet;
+	bool                 json;
+	bool                 failed;
+} output_t;
+
+
+/******************************************************************************/
+/*  Global Variables                                                          */
+/******************************************************************************/
+
+
+static volatile sig_atomic_t stop = 0;
+static uint8_t inputBuffer[INPUT_BUFFER_SIZE];
+static output_t output;
+
+
+/******************************************************************************/
+/*  Function Definitions                                                      */
+/******************************************************************************/
+
+
+static void handleSignal(const int signal)
+{
+	(void)signal;
+	stop = 1;
+}
+
+static void usage(void)
+{
+	fputs("usage: snapcat [-j] [-q] [-v] [-w capture] [-z block] [-p pcapng] [-c channel] [-b baud] [-d addr] [-s addr] [-e edm] [-S statuses] [file]\n"
+		  "  file        input file, tty or pty (default: standard input)\n"
+		  "  -j          print JSON Lines instead of text\n"
+		  "  -q          do not print the frames\n"
+		  "  -v          print a summary to stderr at the end\n"
+		  "  -w capture  record the frames into a capture file (timestamped when read) and its index (capture.idx)\n"
+		  "  -z block    compress the capture file in blocks of this size, in bytes (e.g. 262144)\n"
+		  "  -p pcapng   export the frames into a pcapng file (\"-\" = standard output, requires -q)\n"
+		  "  -c channel  channel number written in the capture and pcapng records (default: 0)\n"
+		  "  -b baud     set the baud rate (and raw mode) when the input is a tty\n"
+		  "  -d addr     only frames with this destination address\n"
+		  "  -s addr     only frames with this source address\n"
+		  "  -e edm      only frames with this error detection method (0-7)\n"
+		  "  -S statuses comma separated list of statuses to print: valid,hash,overflow (default: all)\n",
+		  stderr);
+}
+
+static bool writeAll(const int fd, const char *data, size_t size)
+{
+	while(size)
+	{
+		const ssize_t ret = write(fd, data, size);
+
+		if(ret < 0)
+		{
+			if(errno == EINTR) continue;
+			return false;
+		}
+
+		data += ret;
+		size -= (size_t)ret;
+	}
+
+	return true;
+}
+
+static void flushOutput(void)
+{
+	if(output.length && !output.failed)
+	{
+		output.failed = !writeAll(STDOUT_FILENO, output.buffer, output.length);
+	}
+
+	output.length = 0;
+}
+
+static char *putString(char *p, const char *string)
+{
+	while(*string)
+	{
+		*p++ = *string++;
+	}
+
+	return p;
+}
+
+static char *putDecimal(char *p, uint64_t value)
+{
+	char digits[20];
+	uint_fast8_t count = 0;
+
+	do
+	{
+		digits[count++] = (char)('0' + (value % 10));
+		value /= 10;
+	} while(value);
+
+	while(count)
+	{
+		*p++ = digits[--count];
+	}
+
+	return p;
+}
+
+static char *putHex(char *p, const uint32_t value, uint_fast8_t digits)
+{
+	static const char hex[] = "0123456789ABCDEF";
+
+	while(digits)
+	{
+		digits--;
+		*p++ = hex[(value >> (4 * digits)) & 0x0F];
+	}
+
+	return p;
+}
+
+static char *putHexBytes(char *p, const uint8_t *bytes, const uint_fast16_t size)
+{
+	for(uint_fast16_t i = 0; i < size; i++)
+	{
+		p = putHex(p, bytes[i], 2);
+	}
+
+	return p;
+}
+
+static const char *statusToString(const int8_t status)
+{
+	switch(status)
+	{
+		case SNAP_STATUS_VALID:          return "VALID";
+		case SNAP_STATUS_ERROR_HASH:     return "ERROR_HASH";
+		case SNAP_STATUS_ERROR_OVERFLOW: return "ERROR_OVERFLOW";
+		default:                         return "UNKNOWN";
+	}
+}
+
+static uint8_t statusToMask(const int8_t status)
+{
+	switch(status)
+	{
+		case SNAP_STATUS_VALID:      return STATUS_MASK_VALID;
+		case SNAP_STATUS_ERROR_HASH: return STATUS_MASK_HASH;
+		default:                     return STATUS_MASK_OVERFLOW;
+	}
+}
+
+static bool matchFilter(const filter_t *filter, const snap_frame_t *frame)
+{
+	uint32_t address;
+
+	if(!(filter->statusMask & statusToMask(frame->status)))
+	{
+		return false;
+	}
+
+	if(filter->checkEdm && (snap_getEdm(frame) != filter->edm))
+	{
+		return false;
+	}
+
+	if(filter->checkDest && ((snap_getField(frame, &address, SNAP_FIELD_DEST_ADDRESS) <= 0) || (address != filter->destAddress)))
+	{
+		return false;
+	}
+
+	if(filter->checkSource && ((snap_getField(frame, &address, SNAP_FIELD_SOURCE_ADDRESS) <= 0) || (address != filter->sourceAddress)))
+	{
+		return false;
+	}
+
+	return true;
+}
+
+static char *formatText(char *p, const snap_frame_t *frame, const uint64_t offset)
+{
+	uint32_t value;
+	int16_t size;
+
+	p = putString(p, "@");
+	p = putDecimal(p, offset);
+	p = putString(p, " ");
+	p = putString(p, statusToString(frame->status));
+	p = putString(p, " dab=");
+	p = putDecimal(p, snap_getDab(frame));
+	p = putString(p, " sab=");
+	p = putDecimal(p, snap_getSab(frame));
+	p = putString(p, " pfb=");
+	p = putDecimal(p, snap_getPfb(frame));
+	p = putString(p, " ack=");
+	p = putDecimal(p, snap_getAck(frame));
+	p = putString(p, " cmd=");
+	p = putDecimal(p, snap_getCmd(frame));
+	p = putString(p, " edm=");
+	p = putDecimal(p, snap_getEdm(frame));
+	p = putString(p, " ndb=");
+	p = putDecimal(p, snap_getNdb(frame));
+
+	if((size = snap_getField(frame, &value, SNAP_FIELD_DEST_ADDRESS)) > 0)
+	{
+		p = putString(p, " dest=");
+		p = putHex(p, value, (uint_fast8_t)(2 * size));
+	}
+
+	if((size = snap_getField(frame, &value, SNAP_FIELD_SOURCE_ADDRESS)) > 0)
+	{
+		p = putString(p, " src=");
+		p = putHex(p, value, (uint_fast8_t)(2 * size));
+	}
+
+	if((size = snap_getField(frame, &value, SNAP_FIELD_PROTOCOL_FLAGS)) > 0)
+	{
+		p = putString(p, " flags=");
+		p = putHex(p, value, (uint_fast8_t)(2 * size));
+	}
+
+	if((frame->status != SNAP_STATUS_ERROR_OVERFLOW) && snap_getDataSize(frame))
+	{
+		p = putString(p, " data=");
+		p = putHexBytes(p, snap_getDataPtr(frame), snap_getDataSize(frame));
+	}
+
+	if((size = snap_getField(frame, &value, SNAP_FIELD_HASH)) > 0)
+	{
+		p = putString(p, " hash=");
+		p = putHex(p, value, (uint_fast8_t)(2 * size));
+	}
+
+	return putString(p, "\n");
+}
+
+static char *formatJson(char *p, const snap_frame_t *frame, const uint64_t offset)
+{
+	uint32_t value;
+
+	p = putString(p, "{\"offset\":");
+	p = putDecimal(p, offset);
+	p = putString(p, ",\"status\":\"");
+	p = putString(p, statusToString(frame->status));
+	p = putString(p, "\",\"dab\":");
+	p = putDecimal(p, snap_getDab(frame));
+	p = putString(p, ",\"sab\":");
+	p = putDecimal(p, snap_getSab(frame));
+	p = putString(p, ",\"pfb\":");
+	p = putDecimal(p, snap_getPfb(frame));
+	p = putString(p, ",\"ack\":");
+	p = putDecimal(p, snap_getAck(frame));
+	p = putString(p, ",\"cmd\":");
+	p = putDecimal(p, snap_getCmd(frame));
+	p = putString(p, ",\"edm\":");
+	p = putDecimal(p, snap_getEdm(frame));
+	p = putString(p, ",\"ndb\":");
+	p = putDecimal(p, snap_getNdb(frame));
+
+	if(snap_getField(frame, &value, SNAP_FIELD_DEST_ADDRESS) > 0)
+	{
+		p = putString(p, ",\"dest\":");
+		p = putDecimal(p, value);
+	}
+
+	if(snap_getField(frame, &value, SNAP_FIELD_SOURCE_ADDRESS) > 0)
+	{
+		p = putString(p, ",\"source\":");
+		p = putDecimal(p, value);
+	}
+
+	if(snap_getField(frame, &value, SNAP_FIELD_PROTOCOL_FLAGS) > 0)
+	{
+		p = putString(p, ",\"flags\":");
+		p = putDecimal(p, value);
+	}
+
+	if((frame->status != SNAP_STATUS_ERROR_OVERFLOW) && snap_getDataSize(frame))
+	{
+		p = putString(p, ",\"data\":\"");
+		p = putHexBytes(p, snap_getDataPtr(frame), snap_getDataSize(frame));
+		p = putString(p, "\"");
+	}
+
+	if(snap_getField(frame, &value, SNAP_FIELD_HASH) > 0)
+	{
+		p = putString(p, ",\"hash\":");
+		p = putDecimal(p, value);
+	}
+
+	return putString(p, "}\n");
+}
+
+static void printFrame(void *context, const snap_frame_t *frame, const uint64_t offset)
+{
+	(void)context;
+
+	if(!matchFilter(&output.filter, frame))
+	{
+		return;
+	}
+
+	if(output.capturing)
+	{
+		const snap_captureRecord_t record = {output.timestamp, frame->buffer, output.channel, frame->size, frame->status};
+		const uint64_t recordOffset = output.capture.size;
+
+		if((snap_captureWrite(&output.capture, output.timestamp, output.channel, frame) < 0) ||
+		   (snap_indexAdd(&output.index, &record, recordOffset) < 0))
+		{
+			output.failed = true;
+		}
+	}
+
+	if(output.exporting && (snap_pcapngWrite(&output.pcapng, output.timestamp, output.channel, frame) < 0))
+	{
+		output.failed = true;
+	}
+
+	if(output.quiet)
+	{
+		return;
+	}
+
+	if(output.length > sizeof(output.buffer) - MAX_LINE_SIZE)
+	{
+		flushOutput();
+	}
+
+	char *start = &output.buffer[output.length];
+	char *end = output.json ? formatJson(start, frame, offset) : formatText(start, frame, offset);
+
+	output.length += (size_t)(end - start);
+}
+
+static bool parseStatuses(char *list, uint8_t *mask)
+{
+	*mask = 0;
+
+	for(char *token = strtok(list, ","); token != NULL; token = strtok(NULL, ","))
+	{
+		if(strcmp(token, "valid") == 0)         *mask |= STATUS_MASK_VALID;
+		else if(strcmp(token, "hash") == 0)     *mask |= STATUS_MASK_HASH;
+		else if(strcmp(token, "overflow") == 0) *mask |= STATUS_MASK_OVERFLOW;
+		else return false;
+	}
+
+	return *mask != 0;
+}
+
+static bool parseNumber(const char *string, const unsigned long max, unsigned long *value)
+{
+	char *end;
+
+	errno = 0;
+	*value = strtoul(string, &end, 0);
+
+	return (errno == 0) && (*string != '\0') && (*end == '\0') && (*value <= max);
+}
+
+int main(int argc, char **argv)
+{
+	filter_t *filter = &output.filter;
+	unsigned long value;
+	long baud = 0;
+	const char *capturePath = NULL;
+	const char *pcapngPath = NULL;
+	uint32_t blockSize = 0;
+	bool verbose = false;
+	int opt;
+
+	filter->statusMask = STATUS_MASK_VALID | STATUS_MASK_HASH | STATUS_MASK_OVERFLOW;
+
+	while((opt = getopt(argc, argv, "jqvw:z:p:c:b:d:s:e:S:")) != -1)
+	{
+		switch(opt)
+		{
+			case 'j':
+				output.json = true;
+				break;
+			case 'q':
+				output.quiet = true;
+				break;
+			case 'v':
+				verbose = true;
+				break;
+			case 'w':
+				capturePath = optarg;
+				break;
+			case 'z':
+				if(!parseNumber(optarg, SNAP_CAPTURE_MAX_BLOCK, &value) || (value == 0)) { usage(); return 2; }
+				blockSize = (uint32_t)value;
+				break;
+			case 'p':
+				pcapngPath = optarg;
+				break;
+			case 'c':
+				if(!parseNumber(optarg, UINT16_MAX, &value)) { usage(); return 2; }
+				output.channel = (uint16_t)value;
+				break;
+			case 'b':
+				if(!parseNumber(optarg, 4000000, &value) || (value == 0)) { usage(); return 2; }
+				baud = (long)value;
+				break;
+			case 'd':
+				if(!parseNumber(optarg, 0xFFFFFF, &value)) { usage(); return 2; }
+				filter->destAddress = (uint32_t)value;
+				filter->checkDest = true;
+				break;
+			case 's':
+				if(!parseNumber(optarg, 0xFFFFFF, &value)) { usage(); return 2; }
+				filter->sourceAddress = (uint32_t)value;
+				filter->checkSource = true;
+				break;
+			case 'e':
+				if(!parseNumber(optarg, SNAP_HDB1_EDM_MASK, &value)) { usage(); return 2; }
+				filter->edm = (uint8_t)value;
+				filter->checkEdm = true;
+				break;
+			case 'S':
+				if(!parseStatuses(optarg, &filter->statusMask)) { usage(); return 2; }
+				break;
+			default:
+				usage();
+				return 2;
+		}
+	}
+
+	if((argc - optind > 1) || ((pcapngPath != NULL) && (strcmp(pcapngPath, "-") == 0) && !output.quiet))
+	{
+		usage();
+		return 2;
+	}
+
+	int fd = STDIN_FILENO;
+
+	if(optind < argc)
+	{
+		fd = open(argv[optind], O_RDONLY | O_NOCTTY);
+
+		if(fd < 0)
+		{
+			perror(argv[optind]);
+			return 1;
+		}
+	}
+
+	if(isatty(fd) && (snap_ttyConfigure(fd, baud) < 0))
+	{
+		perror("tty");
+		return 1;
+	}
+
+	if(capturePath != NULL)
+	{
+		char indexPath[PATH_MAX];
+
+		if(((blockSize != 0) ? snap_captureWriterOpenCompressed(&output.capture, capturePath, blockSize) :
+			 snap_captureWriterOpen(&output.capture, capturePath)) < 0)
+		{
+			perror(capturePath);
+			return 1;
+		}
+
+		if((snprintf(indexPath, sizeof(indexPath), "%s.idx", capturePath) >= (int)sizeof(indexPath)) ||
+		   (snap_indexBuilderOpen(&output.index, indexPath, SNAP_INDEX_DEFAULT_BLOCK) < 0))
+		{
+			perror(capturePath);
+			return 1;
+		}
+
+		output.capturing = true;
+	}
+
+	if(pcapngPath != NULL)
+	{
+		const int pcapngFd = (strcmp(pcapngPath, "-") == 0) ? STDOUT_FILENO :
+							 open(pcapngPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+		if(pcapngFd < 0)
+		{
+			perror(pcapngPath);
+			return 1;
+		}
+
+		snap_pcapngWriterInit(&output.pcapng, pcapngFd);
+		output.exporting = true;
+	}
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = handleSignal;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+
+	snap_stream_t stream;
+	snap_streamInit(&stream, inputBuffer, sizeof(inputBuffer));
+
+	int status = 0;
+
+	while(!stop && !output.failed)
+	{
+		size_t space;
+		uint8_t *dest = snap_streamReserve(&stream, &space);
+		const ssize_t ret = read(fd, dest, space);
+
+		if(ret == 0)
+		{
+			output.timestamp = snap_captureTime();
+			snap_streamFinish(&stream, printFrame, NULL);	// Frames hidden by a false sync byte near the end
+			break;
+		}
+
+		if(ret < 0)
+		{
+			if(errno == EINTR) continue;
+			perror("read");
+			status = 1;
+			break;
+		}
+
+		output.timestamp = snap_captureTime();
+		snap_streamProcess(&stream, (size_t)ret, printFrame, NULL);
+		flushOutput();	// One write per block read: large batches at line rate, low latency on slow links
+
+		if(output.exporting && (snap_pcapngFlush(&output.pcapng) < 0))
+		{
+			output.failed = true;
+		}
+	}
+
+	flushOutput();
+
+	if(output.exporting && ((snap_pcapngFlush(&output.pcapng) < 0) || (close(output.pcapng.fd) < 0)))
+	{
+		output.failed = true;
+	}
+
+	if(output.capturing && ((snap_captureWriterClose(&output.capture) < 0) | (snap_indexBuilderClose(&output.index) < 0)))
+	{
+		output.failed = true;
+	}
+
+	if(output.failed)
+	{
+		perror("output");
+		status = 1;
+	}
+
+	if(verbose)
+	{
+		fprintf(stderr, "bytes=%llu valid=%llu hash_errors=%llu overflow_errors=%llu\n",
+				(unsigned long long)stream.stats.bytes, (unsigned long long)stream.stats.validFrames,
+				(unsigned long long)stream.stats.hashErrors, (unsigned long long)stream.stats.overflowErrors);
+	}
+
+	return status;
+}
+
+/******************************** END OF FILE *********************************/
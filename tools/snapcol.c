@@ -0,0 +1,452 @@
+/**
+ * @file   snapcol.c
+ * @author Lucas Jadilo
+ * @brief  snapcol: export SNAP frames to columnar files and aggregate them.
+ * @details Export mode converts a capture file (or, with -r, a raw byte stream decoded in large blocks) into
+ *          a columnar file. Aggregation mode counts the frames and errors per value of one column, reading
+ *          only that column and the status column. Info mode prints the size and encodings of each column.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "snap_capture.h"
+#include "snap_columnar.h"
+#include "snap_stream.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define INPUT_BUFFER_SIZE	(1U << 20)	// Bytes read from a raw input at once (at most)
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+typedef struct group_t
+{
+	uint64_t value;
+	uint64_t frames;
+	uint64_t hashErrors;
+	uint64_t overflowErrors;
+} group_t;
+
+typedef struct table_t
+{
+	group_t *groups;
+	bool    *used;
+	size_t  capacity;
+	size_t  count;
+} table_t;
+
+typedef struct exporter_t
+{
+	snap_columnarWriter_t writer;
+	uint64_t              timestamp;
+	uint16_t              channel;
+	bool                  failed;
+} exporter_t;
+
+
+/******************************************************************************/
+/*  Global Variables                                                          */
+/******************************************************************************/
+
+
+static uint8_t inputBuffer[INPUT_BUFFER_SIZE];
+
+
+/******************************************************************************/
+/*  Function Definitions                                                      */
+/******************************************************************************/
+
+
+static void usage(void)
+{
+	fputs("usage: snapcol [-r] [-g rows] [-c channel] input output\n"
+		  "       snapcol -a column file\n"
+		  "       snapcol -i file\n"
+		  "  -r          the input is a raw byte stream (file, pipe, tty or pty) instead of a capture file\n"
+		  "  -g rows     rows per group (default: 65536)\n"
+		  "  -c channel  channel number stored for a raw input (default: 0)\n"
+		  "  -a column   count the frames and errors per value of a column (e.g. source, dest, edm)\n"
+		  "  -i          print the size and encodings of each column\n",
+		  stderr);
+}
+
+static bool parseNumber(const char *string, const unsigned long max, unsigned long *value)
+{
+	char *end;
+
+	errno = 0;
+	*value = strtoul(string, &end, 0);
+
+	return (errno == 0) && (*string != '\0') && (*end == '\0') && (*value <= max);
+}
+
+static void exportFrame(void *context, const snap_frame_t *frame, const uint64_t offset)
+{
+	exporter_t *exporter = context;
+	(void)offset;
+
+	if(snap_columnarAppend(&exporter->writer, exporter->timestamp, exporter->channel, frame->status, frame->buffer, frame->size) < 0)
+	{
+		exporter->failed = true;
+	}
+}
+
+static int exportRaw(exporter_t *exporter, const char *path)
+{
+	const int fd = open(path, O_RDONLY | O_NOCTTY);
+
+	if(fd < 0)
+	{
+		perror(path);
+		return 1;
+	}
+
+	snap_stream_t stream;
+	snap_streamInit(&stream, inputBuffer, sizeof(inputBuffer));
+
+	while(!exporter->failed)
+	{
+		size_t space;
+		uint8_t *dest = snap_streamReserve(&stream, &space);
+		const ssize_t ret = read(fd, dest, space);
+
+		if(ret == 0)
+		{
+			exporter->timestamp = snap_captureTime();
+			snap_streamFinish(&stream, exportFrame, exporter);
+			break;
+		}
+
+		if(ret < 0)
+		{
+			if(errno == EINTR) continue;
+			perror(path);
+			close(fd);
+			return 1;
+		}
+
+		exporter->timestamp = snap_captureTime();
+		snap_streamProcess(&stream, (size_t)ret, exportFrame, exporter);
+	}
+
+	close(fd);
+	return 0;
+}
+
+static int exportCapture(exporter_t *exporter, const char *path)
+{
+	snap_captureReader_t reader;
+	snap_captureRecord_t record;
+	int ret;
+
+	if(snap_captureReaderOpen(&reader, path) < 0)
+	{
+		perror(path);
+		return 1;
+	}
+
+	while(!exporter->failed && ((ret = snap_captureRead(&reader, &record)) > 0))
+	{
+		if(snap_columnarAppend(&exporter->writer, record.timestamp, record.channel, record.status, record.bytes, record.size) < 0)
+		{
+			exporter->failed = true;
+		}
+	}
+
+	snap_captureReaderClose(&reader);
+
+	if(ret < 0)
+	{
+		perror(path);
+		return 1;
+	}
+
+	return 0;
+}
+
+static group_t *findGroup(table_t *table, const uint64_t value)
+{
+	if(2U * (table->count + 1U) > table->capacity)
+	{
+		table_t bigger = {.capacity = table->capacity ? 2U * table->capacity : 1024U};
+
+		bigger.groups = malloc(bigger.capacity * sizeof(bigger.groups[0]));
+		bigger.used = calloc(bigger.capacity, sizeof(bigger.used[0]));
+
+		if((bigger.groups == NULL) || (bigger.used == NULL))
+		{
+			free(bigger.groups);
+			free(bigger.used);
+			return NULL;
+		}
+
+		for(size_t i = 0; i < table->capacity; i++)
+		{
+			if(table->used[i])
+			{
+				*findGroup(&bigger, table->groups[i].value) = table->groups[i];
+			}
+		}
+
+		free(table->groups);
+		free(table->used);
+		*table = bigger;
+	}
+
+	size_t slot = (size_t)((value * 0x9E3779B97F4A7C15U) >> 32) & (table->capacity - 1U);
+
+	while(table->used[slot] && (table->groups[slot].value != value))
+	{
+		slot = (slot + 1U) & (table->capacity - 1U);
+	}
+
+	if(!table->used[slot])
+	{
+		table->used[slot] = true;
+		table->count++;
+		memset(&table->groups[slot], 0, sizeof(table->groups[slot]));
+		table->groups[slot].value = value;
+	}
+
+	return &table->groups[slot];
+}
+
+static int compareGroups(const void *a, const void *b)
+{
+	const uint64_t x = ((const group_t *)a)->value;
+	const uint64_t y = ((const group_t *)b)->value;
+	return (x > y) - (x < y);
+}
+
+static int aggregate(const char *path, const char *columnName)
+{
+	snap_columnarReader_t reader;
+	snap_column_t column = SNAP_COLUMN_COUNT;
+	table_t table = {0};
+	int status = 0;
+
+	for(uint_fast8_t i = 0; i < SNAP_COLUMN_COUNT; i++)
+	{
+		if(strcmp(columnName, snap_columnName((snap_column_t)i)) == 0)
+		{
+			column = (snap_column_t)i;
+		}
+	}
+
+	if(column == SNAP_COLUMN_COUNT)
+	{
+		fprintf(stderr, "%s: unknown column\n", columnName);
+		return 2;
+	}
+
+	if(snap_columnarReaderOpen(&reader, path) < 0)
+	{
+		perror(path);
+		return 1;
+	}
+
+	uint64_t *keys = malloc(reader.rowsPerGroup * sizeof(keys[0]));
+	uint64_t *statuses = malloc(reader.rowsPerGroup * sizeof(statuses[0]));
+
+	for(uint32_t g = 0; (status == 0) && (g < reader.groupCount); g++)
+	{
+		const int rows = (keys && statuses) ? snap_columnarReadColumn(&reader, g, column, keys) : -1;
+
+		if((rows < 0) || (snap_columnarReadColumn(&reader, g, SNAP_COLUMN_STATUS, statuses) != rows))
+		{
+			perror(path);
+			status = 1;
+			break;
+		}
+
+		for(int i = 0; i < rows; i++)
+		{
+			group_t *group = findGroup(&table, keys[i]);
+
+			if(group == NULL)
+			{
+				perror("aggregate");
+				status = 1;
+				break;
+			}
+
+			group->frames++;
+			group->hashErrors += (statuses[i] == (uint8_t)SNAP_STATUS_ERROR_HASH);
+			group->overflowErrors += (statuses[i] == (uint8_t)SNAP_STATUS_ERROR_OVERFLOW);
+		}
+	}
+
+	if(status == 0)
+	{
+		size_t count = 0;
+
+		for(size_t i = 0; i < table.capacity; i++)
+		{
+			if(table.used[i])
+			{
+				table.groups[count++] = table.groups[i];
+			}
+		}
+
+		qsort(table.groups, count, sizeof(table.groups[0]), compareGroups);
+		printf("%-12s %14s %14s %14s %10s\n", columnName, "frames", "hash_errors", "overflows", "error_rate");
+
+		for(size_t i = 0; i < count; i++)
+		{
+			const group_t *group = &table.groups[i];
+			const double rate = (double)(group->hashErrors + group->overflowErrors) / (double)group->frames;
+
+			printf("0x%-10llX %14llu %14llu %14llu %10.6f\n", (unsigned long long)group->value, (unsigned long long)group->frames,
+				   (unsigned long long)group->hashErrors, (unsigned long long)group->overflowErrors, rate);
+		}
+	}
+
+	free(keys);
+	free(statuses);
+	free(table.groups);
+	free(table.used);
+	snap_columnarReaderClose(&reader);
+	return status;
+}
+
+static int info(const char *path)
+{
+	static const char *encodings[] = {"plain", "rle", "dict", "delta"};
+	snap_columnarReader_t reader;
+	snap_columnarGroup_t group;
+	uint64_t sizes[SNAP_COLUMN_COUNT] = {0};
+	uint64_t uses[SNAP_COLUMN_COUNT][4] = {{0}};
+	uint64_t rows = 0;
+
+	if(snap_columnarReaderOpen(&reader, path) < 0)
+	{
+		perror(path);
+		return 1;
+	}
+
+	for(uint32_t g = 0; g < reader.groupCount; g++)
+	{
+		if(snap_columnarGetGroup(&reader, g, &group) < 0)
+		{
+			perror(path);
+			snap_columnarReaderClose(&reader);
+			return 1;
+		}
+
+		rows += group.rows;
+
+		for(uint_fast8_t c = 0; c < SNAP_COLUMN_COUNT; c++)
+		{
+			sizes[c] += group.chunks[c].size;
+			uses[c][group.chunks[c].encoding]++;
+		}
+	}
+
+	printf("rows=%llu groups=%u rows_per_group=%u size=%zu\n", (unsigned long long)rows, reader.groupCount, reader.rowsPerGroup, reader.size);
+
+	for(uint_fast8_t c = 0; c < SNAP_COLUMN_COUNT; c++)
+	{
+		printf("%-10s %12llu bytes %8.3f bytes/row ", snap_columnName((snap_column_t)c), (unsigned long long)sizes[c],
+			   rows ? (double)sizes[c] / (double)rows : 0.0);
+
+		for(uint_fast8_t e = 0; e < 4U; e++)
+		{
+			if(uses[c][e]) printf(" %s=%llu", encodings[e], (unsigned long long)uses[c][e]);
+		}
+
+		putchar('\n');
+	}
+
+	snap_columnarReaderClose(&reader);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static exporter_t exporter;
+	unsigned long value;
+	unsigned long rowsPerGroup = SNAP_COLUMNAR_MAX_ROWS;
+	const char *columnName = NULL;
+	bool raw = false, showInfo = false;
+	int opt;
+
+	while((opt = getopt(argc, argv, "rg:c:a:i")) != -1)
+	{
+		switch(opt)
+		{
+			case 'r':
+				raw = true;
+				break;
+			case 'g':
+				if(!parseNumber(optarg, SNAP_COLUMNAR_MAX_ROWS, &rowsPerGroup) || (rowsPerGroup == 0)) { usage(); return 2; }
+				break;
+			case 'c':
+				if(!parseNumber(optarg, UINT16_MAX, &value)) { usage(); return 2; }
+				exporter.channel = (uint16_t)value;
+				break;
+			case 'a':
+				columnName = optarg;
+				break;
+			case 'i':
+				showInfo = true;
+				break;
+			default:
+				usage();
+				return 2;
+		}
+	}
+
+	if((columnName != NULL) || showInfo)
+	{
+		if((argc - optind != 1) || ((columnName != NULL) && showInfo))
+		{
+			usage();
+			return 2;
+		}
+
+		return showInfo ? info(argv[optind]) : aggregate(argv[optind], columnName);
+	}
+
+	if(argc - optind != 2)
+	{
+		usage();
+		return 2;
+	}
+
+	if(snap_columnarWriterOpen(&exporter.writer, argv[optind + 1], (uint32_t)rowsPerGroup) < 0)
+	{
+		perror(argv[optind + 1]);
+		return 1;
+	}
+
+	int status = raw ? exportRaw(&exporter, argv[optind]) : exportCapture(&exporter, argv[optind]);
+
+	if((snap_columnarWriterClose(&exporter.writer) < 0) || exporter.failed)
+	{
+		perror(argv[optind + 1]);
+		status = 1;
+	}
+
+	return status;
+}
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,889 @@
+/**
+ * @file   snapd.c
+ * @author Lucas Jadilo
+ * @brief  snapd: daemon that owns the ports of a bus and serves their frames to local clients.
+ * @details Each port is serviced by its own thread (a shard of the decode and encode work): it reads the port
+ *          into a stream decoder (see snap_stream.h), matches every valid frame against the compiled
+ *          subscriptions of the clients (see snap_filter.h) and copies it into the shared memory ring of each
+ *          subscriber (see snap_ipc.h). So every byte is decoded once, whatever the number of clients, and a
+ *          slow client loses its own frames without slowing down the port or the other clients. The frames
+ *          sent by the clients are queued by the main thread on the transmit ring of the port (see snap_tx.h),
+ *          and written by the port thread, so the encoding and the writes of a port stay on its thread too.
+ *
+ *          The main thread accepts the clients on a SOCK_SEQPACKET Unix socket (see snap_client.h). When a client
+ *          comes or goes, it compiles the subscriptions of each port into new tables and publishes them (see
+ *          snap_rcu.h): a port thread picks up the latest tables for each block it reads, without a lock, and the
+ *          old tables, as well as the rings of a client that left, are freed once no port thread can use them.
+ *
+ *          With -m, the counters of each port are served in the Prometheus text format (see snap_metrics.h).
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "snap_filter.h"
+#include "snap_ipc.h"
+#include "snap_metrics.h"
+#include "snap_rcu.h"
+#include "snap_stream.h"
+#include "snap_tty.h"
+#include "snap_tx.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define MAX_CLIENTS		(64U)										// Largest number of clients
+#define READ_SIZE		(4096U)										// Bytes per read() call
+#define BUFFER_SIZE		(READ_SIZE + SNAP_STREAM_MIN_SIZE_BUFFER)	// Stream decoder buffer of each port
+#define TX_SLOTS		(256U)										// Frames waiting to be sent on each port
+#define POLL_MS			(100)										// Longest wait before the stop flag is checked
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+typedef struct daemon_t daemon_t;
+
+typedef struct client_t
+{
+	int                 socket;			// -1 once disconnected (the slot is free if it is not subscribed either)
+	bool                subscribed;		// Rings allocated (until freed, after the grace period of its removal)
+	bool                removed;		// Left, but maybe still in the published tables
+	bool                retired;		// Left the published tables, waiting for the grace period
+	uint32_t            portMask;
+	snap_ipcSubscribe_t message;		// Holds the lists of the subscription
+	snap_subscription_t subscription;
+	snap_ipc_t          ipc;			// Daemon side of the rings, with the eventfd of the client
+} client_t;
+
+typedef struct tables_t
+{
+	snap_filter_t filters[SNAP_IPC_MAX_PORTS];					// Subscriptions of each port
+	snap_ipc_t    *targets[SNAP_IPC_MAX_PORTS][MAX_CLIENTS];	// Rings of each subscription
+} tables_t;
+
+typedef struct port_t
+{
+	daemon_t              *daemon;
+	uint32_t              index;
+	const char            *path;
+	int                   fd;
+	int                   wakeFd;						// Signaled by the main thread (new frame to send, stop)
+	pthread_t             thread;
+	snap_tx_t             tx;							// Produced by the main thread, flushed by the port thread
+	const tables_t        *tables;						// Port thread only from here on (valid while a block is processed)
+	uint64_t              blockNs;
+	uint64_t              forwarded;
+	uint64_t              dropped;
+	uint64_t              txDropped;					// Written by the main thread. Accessed with __atomic builtins.
+	snap_metricsChannel_t *metrics;						// NULL without -m
+} port_t;
+
+struct daemon_t
+{
+	port_t          ports[SNAP_IPC_MAX_PORTS];
+	uint32_t        portCount;
+	client_t        clients[MAX_CLIENTS];	// Main thread only
+	bool            changed;				// The clients changed since the tables were published
+	snap_rcu_t      rcu;					// Tables published to the port threads (one reader per port)
+	uint32_t        slots;					// Default number of slots of a ring
+	uint32_t        stop;					// Accessed with __atomic builtins.
+};
+
+
+/******************************************************************************/
+/*  Global Variables                                                          */
+/******************************************************************************/
+
+
+static volatile sig_atomic_t stop = 0;
+
+
+/******************************************************************************/
+/*  Function Definitions                                                      */
+/******************************************************************************/
+
+
+static void handleSignal(const int signal)
+{
+	(void)signal;
+	stop = 1;
+}
+
+static void usage(void)
+{
+	fputs("usage: snapd [-b baud] [-s slots] [-m socket] -l socket port...\n"
+		  "  port       ttys, ptys or files of the bus (ports 0, 1, ...; up to 32)\n"
+		  "  -l socket  Unix socket the clients connect to\n"
+		  "  -b baud    set the baud rate (and raw mode) of the ports that are ttys\n"
+		  "  -s slots   default frames per client ring, 1 to 65536 (default: 1024)\n"
+		  "  -m socket  serve metrics in the Prometheus text format on this Unix socket\n",
+		  stderr);
+}
+
+static uint64_t monotonicNs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000U + (uint64_t)now.tv_nsec;
+}
+
+static uint32_t roundSlots(uint32_t slots)
+{
+	uint32_t count = 1;
+
+	slots = (slots < SNAP_IPC_MAX_SLOTS) ? slots : SNAP_IPC_MAX_SLOTS;	// Bounds the loop (count cannot overflow)
+
+	while(count < slots)
+	{
+		count <<= 1;
+	}
+
+	return count;
+}
+
+static void wakePort(const port_t *port)
+{
+	const uint64_t one = 1;
+
+	if(write(port->wakeFd, &one, sizeof(one)) < 0)
+	{
+		// Already signaled: the counter cannot overflow in practice
+	}
+}
+
+static void wakePorts(const daemon_t *daemon)
+{
+	for(uint32_t i = 0; i < daemon->portCount; i++)
+	{
+		wakePort(&daemon->ports[i]);
+	}
+}
+
+/*** Port threads *************************************************************/
+
+static void deliverFrame(void *context, const snap_frame_t *frame, const uint64_t offset)
+{
+	port_t *port = context;
+	uint64_t matches[SNAP_FILTER_WORDS(MAX_CLIENTS)];
+
+	(void)offset;
+
+	if((frame->status != SNAP_STATUS_VALID) || (snap_filterMatch(&port->tables->filters[port->index], frame, matches) == 0))
+	{
+		return;
+	}
+
+	for(uint32_t i = 0; i < SNAP_FILTER_WORDS(MAX_CLIENTS); i++)
+	{
+		for(uint64_t set = matches[i]; set != 0; set &= set - 1U)
+		{
+			const uint32_t subscriber = i * 64U + (uint32_t)__builtin_ctzll(set);
+
+			if(snap_ipcPush(port->tables->targets[port->index][subscriber], port->index, frame, port->blockNs))
+			{
+				port->forwarded++;
+			}
+			else
+			{
+				port->dropped++;
+			}
+		}
+	}
+}
+
+static void publishMetrics(port_t *port, const snap_stream_t *stream)
+{
+	snap_metricsSet(port->metrics, SNAP_METRICS_BYTES, stream->stats.bytes);
+	snap_metricsSet(port->metrics, SNAP_METRICS_VALID, stream->stats.validFrames);
+	snap_metricsSet(port->metrics, SNAP_METRICS_HASH_ERRORS, stream->stats.hashErrors);
+	snap_metricsSet(port->metrics, SNAP_METRICS_OVERFLOW_ERRORS, stream->stats.overflowErrors);
+	snap_metricsSet(port->metrics, SNAP_METRICS_FORWARDED, port->forwarded);
+	snap_metricsSet(port->metrics, SNAP_METRICS_DROPPED, port->dropped + __atomic_load_n(&port->txDropped, __ATOMIC_RELAXED));
+	snap_metricsSetQueueDepth(port->metrics, snap_txPending(&port->tx));
+}
+
+static int readPort(port_t *port, snap_stream_t *stream)
+{
+	size_t space;
+	uint8_t *dest = snap_streamReserve(stream, &space);
+	const ssize_t ret = read(port->fd, dest, (space < READ_SIZE) ? space : READ_SIZE);
+
+	if(ret > 0)
+	{
+		port->blockNs = monotonicNs();
+		snap_streamProcess(stream, (size_t)ret, deliverFrame, port);
+		return 0;
+	}
+
+	if((ret < 0) && ((errno == EAGAIN) || (errno == EINTR)))
+	{
+		return 0;
+	}
+
+	if((ret == 0) || (errno == EIO))	// End of file, or pty closed on the other side
+	{
+		port->blockNs = monotonicNs();
+		snap_streamFinish(stream, deliverFrame, port);
+		fprintf(stderr, "snapd: %s: end of input\n", port->path);
+	}
+	else
+	{
+		fprintf(stderr, "snapd: %s: read: %s\n", port->path, strerror(errno));
+	}
+
+	return -1;
+}
+
+static void *servicePort(void *argument)
+{
+	port_t *port = argument;
+	snap_stream_t *stream = malloc(sizeof(snap_stream_t));	// Allocated (and touched) by the port thread
+	uint8_t *buffer = malloc(BUFFER_SIZE);
+
+	if((stream == NULL) || (buffer == NULL))
+	{
+		fprintf(stderr, "snapd: %s: %s\n", port->path, strerror(ENOMEM));
+		free(stream);
+		free(buffer);
+		return NULL;
+	}
+
+	snap_streamInit(stream, buffer, BUFFER_SIZE);
+
+	// The port thread holds no tables while it waits, so it never delays the grace periods
+	while(!__atomic_load_n(&port->daemon->stop, __ATOMIC_ACQUIRE))
+	{
+		struct pollfd fds[2] = {{.fd = port->fd, .events = (short)(POLLIN | ((snap_txPending(&port->tx) > 0) ? POLLOUT : 0))},
+								{.fd = port->wakeFd, .events = POLLIN}};
+
+		if(poll(fds, 2, POLL_MS) < 0)
+		{
+			continue;	// EINTR
+		}
+
+		if((fds[1].revents & POLLIN) != 0)
+		{
+			uint64_t count;
+
+			if(read(port->wakeFd, &count, sizeof(count)) < 0)
+			{
+				// Already cleared
+			}
+		}
+
+		if((fds[0].revents & (POLLIN | POLLHUP | POLLERR)) != 0)
+		{
+			port->tables = snap_rcuAcquire(&port->daemon->rcu, port->index);
+
+			const int ret = readPort(port, stream);
+
+			snap_rcuRelease(&port->daemon->rcu, port->index);
+
+			if(ret < 0)
+			{
+				break;
+			}
+		}
+
+		if((snap_txPending(&port->tx) > 0) && (snap_txFlush(&port->tx) < 0) && (errno != EAGAIN))
+		{
+			fprintf(stderr, "snapd: %s: write: %s\n", port->path, strerror(errno));
+			break;
+		}
+
+		if(port->metrics != NULL)
+		{
+			publishMetrics(port, stream);
+		}
+	}
+
+	if(port->metrics != NULL)
+	{
+		publishMetrics(port, stream);
+	}
+
+	fprintf(stderr, "port %u (%s): bytes=%llu valid=%llu hash-errors=%llu overflow-errors=%llu forwarded=%llu dropped=%llu sent=%llu\n",
+			port->index, port->path, (unsigned long long)stream->stats.bytes, (unsigned long long)stream->stats.validFrames,
+			(unsigned long long)stream->stats.hashErrors, (unsigned long long)stream->stats.overflowErrors,
+			(unsigned long long)port->forwarded, (unsigned long long)(port->dropped + __atomic_load_n(&port->txDropped, __ATOMIC_RELAXED)),
+			(unsigned long long)port->tx.framesSent);
+
+	free(stream);
+	free(buffer);
+
+	return NULL;
+}
+
+/*** Main thread **************************************************************/
+
+static void freeTables(void *context, void *object)
+{
+	const daemon_t *daemon = context;
+	tables_t *tables = object;
+
+	for(uint32_t i = 0; i < daemon->portCount; i++)
+	{
+		snap_filterDestroy(&tables->filters[i]);
+	}
+
+	free(tables);
+}
+
+static void freeClient(void *context, void *object)
+{
+	client_t *client = object;
+
+	(void)context;
+	snap_ipcDetach(&client->ipc);
+	client->subscribed = false;
+	client->removed = false;
+	client->retired = false;
+}
+
+static tables_t *buildTables(daemon_t *daemon)
+{
+	tables_t *tables = malloc(sizeof(tables_t));
+	uint32_t port = 0;
+
+	if(tables == NULL)
+	{
+		return NULL;
+	}
+
+	for(; port < daemon->portCount; port++)
+	{
+		snap_subscription_t subscriptions[MAX_CLIENTS];
+		uint32_t count = 0;
+
+		for(uint32_t i = 0; i < MAX_CLIENTS; i++)
+		{
+			client_t *client = &daemon->clients[i];
+
+			if(client->subscribed && !client->removed && (((client->portMask >> port) & 1U) != 0))
+			{
+				subscriptions[count] = client->subscription;
+				tables->targets[port][count] = &client->ipc;
+				count++;
+			}
+		}
+
+		if(snap_filterCompile(&tables->filters[port], subscriptions, count) < 0)
+		{
+			break;
+		}
+	}
+
+	if(port < daemon->portCount)
+	{
+		for(uint32_t i = 0; i < port; i++)
+		{
+			snap_filterDestroy(&tables->filters[i]);
+		}
+
+		free(tables);
+		return NULL;
+	}
+
+	return tables;
+}
+
+static void updateTables(daemon_t *daemon)
+{
+	if(daemon->changed)
+	{
+		tables_t *tables = buildTables(daemon);
+
+		if(tables == NULL)
+		{
+			return;	// The old tables stay in use, and the clients that left are not freed (retried later)
+		}
+
+		snap_rcuPublish(&daemon->rcu, tables);
+		daemon->changed = false;
+
+		// The new tables do not reference the clients that left: free them after the grace period
+		for(uint32_t i = 0; i < MAX_CLIENTS; i++)
+		{
+			client_t *client = &daemon->clients[i];
+
+			if(client->removed && !client->retired)
+			{
+				client->retired = true;
+				snap_rcuRetire(&daemon->rcu, client, freeClient, NULL);
+			}
+		}
+	}
+
+	snap_rcuReclaim(&daemon->rcu);
+}
+
+static void removeClient(daemon_t *daemon, client_t *client)
+{
+	close(client->socket);
+	client->socket = -1;
+
+	if(client->subscribed)
+	{
+		client->removed = true;
+		daemon->changed = true;
+	}
+}
+
+static snap_subscription_t makeSubscription(const snap_ipcSubscribe_t *message)
+{
+	return (snap_subscription_t){.hdb2Mask = message->hdb2Mask, .hdb2Value = message->hdb2Value,
+								 .hdb1Mask = message->hdb1Mask, .hdb1Value = message->hdb1Value,
+								 .flagsMask = message->flagsMask, .flagsValue = message->flagsValue,
+								 .destAddresses = message->destAddresses, .destCount = message->destCount,
+								 .sourceAddresses = message->sourceAddresses, .sourceCount = message->sourceCount,
+								 .commands = message->commands, .commandCount = message->commandCount};
+}
+
+static int validateSubscription(const daemon_t *daemon, const snap_ipcSubscribe_t *message, const size_t size)
+{
+	const uint32_t allPorts = (daemon->portCount == 32U) ? UINT32_MAX : ((1U << daemon->portCount) - 1U);
+
+	if((size != sizeof(*message)) || ((message->portMask & allPorts) == 0) || (message->slots > SNAP_IPC_MAX_SLOTS) ||
+	   (message->destCount > SNAP_IPC_MAX_LIST) || (message->sourceCount > SNAP_IPC_MAX_LIST) || (message->commandCount > SNAP_IPC_MAX_LIST))
+	{
+		return EINVAL;
+	}
+
+	// Trial compile: a subscription accepted here must never make buildTables() fail later
+	const snap_subscription_t subscription = makeSubscription(message);
+	snap_filter_t filter;
+
+	if(snap_filterCompile(&filter, &subscription, 1) < 0)
+	{
+		return errno;
+	}
+
+	snap_filterDestroy(&filter);
+	return 0;
+}
+
+static int sendReply(const int socket, const snap_ipcReply_t *reply, const int memFd, const int eventFd)
+{
+	union
+	{
+		struct cmsghdr header;
+		uint8_t        space[CMSG_SPACE(2U * sizeof(int))];
+	} control;
+	struct iovec vector = {.iov_base = (void *)reply, .iov_len = sizeof(*reply)};
+	struct msghdr message = {.msg_iov = &vector, .msg_iovlen = 1};
+
+	if(reply->error == 0)
+	{
+		const int fds[2] = {memFd, eventFd};
+
+		memset(&control, 0, sizeof(control));
+		message.msg_control = &control;
+		message.msg_controllen = sizeof(control);
+
+		struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+
+		header->cmsg_level = SOL_SOCKET;
+		header->cmsg_type = SCM_RIGHTS;
+		header->cmsg_len = CMSG_LEN(sizeof(fds));
+		memcpy(CMSG_DATA(header), fds, sizeof(fds));
+	}
+
+	return (sendmsg(socket, &message, MSG_NOSIGNAL) < 0) ? -1 : 0;
+}
+
+static void subscribeClient(daemon_t *daemon, client_t *client, const snap_ipcSubscribe_t *message, const size_t size)
+{
+	snap_ipcReply_t reply = {.type = SNAP_IPC_REPLY, .ports = daemon->portCount};
+	int memFd = -1;
+
+	reply.error = validateSubscription(daemon, message, size);
+
+	// The message is only read once it is known to be complete and valid
+	if(reply.error == 0)
+	{
+		reply.slots = roundSlots((message->slots != 0) ? message->slots : daemon->slots);
+	}
+
+	if((reply.error == 0) && (snap_ipcCreate(&client->ipc, daemon->portCount, reply.slots, &memFd) < 0))
+	{
+		reply.error = errno;
+	}
+
+	if((reply.error == 0) && ((client->ipc.eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0))
+	{
+		reply.error = errno;
+		close(memFd);
+		snap_ipcDetach(&client->ipc);
+	}
+
+	const int ret = sendReply(client->socket, &reply, memFd, client->ipc.eventFd);
+
+	if(reply.error != 0)
+	{
+		removeClient(daemon, client);
+		return;
+	}
+
+	close(memFd);	// The mapping stays
+
+	if(ret < 0)
+	{
+		snap_ipcDetach(&client->ipc);
+		removeClient(daemon, client);
+		return;
+	}
+
+	client->message = *message;
+	client->portMask = message->portMask;
+	client->subscription = makeSubscription(&client->message);
+	client->subscribed = true;
+	daemon->changed = true;
+}
+
+static bool transmitFrame(daemon_t *daemon, const snap_ipcSend_t *message, const size_t size)
+{
+	if((size <= offsetof(snap_ipcSend_t, bytes)) || (message->port >= daemon->portCount) ||
+	   (message->size != size - offsetof(snap_ipcSend_t, bytes)))
+	{
+		return false;
+	}
+
+	port_t *port = &daemon->ports[message->port];
+	snap_frame_t *frame = snap_txAcquire(&port->tx);
+
+	if(frame == NULL)
+	{
+		__atomic_store_n(&port->txDropped, port->txDropped + 1U, __ATOMIC_RELAXED);
+		return true;
+	}
+
+	memcpy(frame->buffer, message->bytes, message->size);
+	frame->size = message->size;
+	snap_txSubmit(&port->tx);
+	wakePort(port);
+
+	return true;
+}
+
+static void serviceClient(daemon_t *daemon, client_t *client)
+{
+	union
+	{
+		uint32_t            type;
+		snap_ipcSubscribe_t subscribe;
+		snap_ipcSend_t      send;
+	} message;
+
+	const ssize_t ret = recv(client->socket, &message, sizeof(message), MSG_DONTWAIT);
+
+	if((ret < 0) && ((errno == EAGAIN) || (errno == EINTR)))
+	{
+		return;
+	}
+
+	if((ret >= (ssize_t)sizeof(message.type)) && (message.type == SNAP_IPC_SUBSCRIBE) && !client->subscribed)
+	{
+		subscribeClient(daemon, client, &message.subscribe, (size_t)ret);
+	}
+	else if((ret >= (ssize_t)sizeof(message.type)) && (message.type == SNAP_IPC_SEND) && client->subscribed &&
+			transmitFrame(daemon, &message.send, (size_t)ret))
+	{
+		// Queued (or counted as dropped)
+	}
+	else
+	{
+		removeClient(daemon, client);	// Disconnected, or protocol error
+	}
+}
+
+static void acceptClient(daemon_t *daemon, const int listenFd)
+{
+	const int socket = accept4(listenFd, NULL, NULL, SOCK_CLOEXEC);
+
+	if(socket < 0)
+	{
+		return;
+	}
+
+	for(uint32_t i = 0; i < MAX_CLIENTS; i++)
+	{
+		client_t *client = &daemon->clients[i];
+
+		if((client->socket < 0) && !client->subscribed)
+		{
+			client->socket = socket;
+			return;
+		}
+	}
+
+	close(socket);	// Table full
+}
+
+static int openListener(const char *path)
+{
+	struct sockaddr_un address = {.sun_family = AF_UNIX};
+	struct stat info;
+
+	if(strlen(path) >= sizeof(address.sun_path))
+	{
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	strcpy(address.sun_path, path);
+
+	if((lstat(path, &info) == 0) && S_ISSOCK(info.st_mode))
+	{
+		unlink(path);
+	}
+
+	const int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+
+	if((fd < 0) || (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0) || (listen(fd, 16) < 0))
+	{
+		const int error = errno;
+
+		if(fd >= 0) close(fd);
+		errno = error;
+		return -1;
+	}
+
+	return fd;
+}
+
+static int openPort(port_t *port, const long baud)
+{
+	port->fd = open(port->path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+
+	if((port->fd < 0) || (isatty(port->fd) && (snap_ttyConfigure(port->fd, baud) < 0)) ||
+	   ((port->wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0) || (snap_txInit(&port->tx, port->fd, TX_SLOTS) < 0))
+	{
+		perror(port->path);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static daemon_t daemon = {.slots = 1024};
+	const char *listenPath = NULL, *metricsPath = NULL;
+	snap_metrics_t metrics;
+	long baud = 0;
+	int opt;
+
+	while((opt = getopt(argc, argv, "b:s:m:l:")) != -1)
+	{
+		char *end;
+		unsigned long value;
+
+		switch(opt)
+		{
+			case 'b':
+				baud = strtol(optarg, &end, 0);
+				if((*end != '\0') || (baud <= 0)) { usage(); return 2; }
+				break;
+			case 's':
+				value = strtoul(optarg, &end, 0);
+				if((*end != '\0') || (value == 0) || (value > SNAP_IPC_MAX_SLOTS)) { usage(); return 2; }
+				daemon.slots = (uint32_t)value;
+				break;
+			case 'm':
+				metricsPath = optarg;
+				break;
+			case 'l':
+				listenPath = optarg;
+				break;
+			default:
+				usage();
+				return 2;
+		}
+	}
+
+	const int portCount = argc - optind;
+
+	if((listenPath == NULL) || (portCount < 1) || (portCount > (int)SNAP_IPC_MAX_PORTS))
+	{
+		usage();
+		return 2;
+	}
+
+	daemon.portCount = (uint32_t)portCount;
+
+	for(uint32_t i = 0; i < MAX_CLIENTS; i++)
+	{
+		daemon.clients[i].socket = -1;
+	}
+
+	for(uint32_t i = 0; i < daemon.portCount; i++)
+	{
+		port_t *port = &daemon.ports[i];
+
+		port->daemon = &daemon;
+		port->index = i;
+		port->path = argv[optind + (int)i];
+
+		if(openPort(port, baud) < 0)
+		{
+			return 1;
+		}
+	}
+
+	tables_t *tables = buildTables(&daemon);
+
+	if((tables == NULL) || (snap_rcuInit(&daemon.rcu, daemon.portCount, tables, freeTables, &daemon) < 0))
+	{
+		perror("snapd");
+		return 1;
+	}
+
+	const int listenFd = openListener(listenPath);
+
+	if(listenFd < 0)
+	{
+		perror(listenPath);
+		return 1;
+	}
+
+	// The other threads do not take the signals, so they interrupt the poll() of the main thread
+	sigset_t signals, previous;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, &previous);
+
+	if(metricsPath != NULL)
+	{
+		if((snap_metricsInit(&metrics, daemon.portCount) < 0) || (snap_metricsStart(&metrics, metricsPath) < 0))
+		{
+			perror(metricsPath);
+			unlink(listenPath);
+			return 1;
+		}
+
+		for(uint32_t i = 0; i < daemon.portCount; i++)
+		{
+			daemon.ports[i].metrics = snap_metricsAddChannel(&metrics, daemon.ports[i].path);
+		}
+	}
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = handleSignal;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+
+	int status = 0;
+	uint32_t started = 0;
+
+	for(; started < daemon.portCount; started++)
+	{
+		const int error = pthread_create(&daemon.ports[started].thread, NULL, servicePort, &daemon.ports[started]);
+
+		if(error != 0)
+		{
+			fprintf(stderr, "snapd: pthread_create: %s\n", strerror(error));
+			stop = 1;
+			status = 1;
+			break;
+		}
+	}
+
+	pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+	while(!stop)
+	{
+		struct pollfd fds[1U + MAX_CLIENTS];
+		client_t *polled[MAX_CLIENTS];
+		nfds_t count = 1;
+
+		fds[0] = (struct pollfd){.fd = listenFd, .events = POLLIN};
+
+		for(uint32_t i = 0; i < MAX_CLIENTS; i++)
+		{
+			if(daemon.clients[i].socket >= 0)
+			{
+				polled[count - 1U] = &daemon.clients[i];
+				fds[count++] = (struct pollfd){.fd = daemon.clients[i].socket, .events = POLLIN};
+			}
+		}
+
+		if(poll(fds, count, POLL_MS) > 0)
+		{
+			for(nfds_t i = 1; i < count; i++)
+			{
+				if(fds[i].revents != 0)
+				{
+					serviceClient(&daemon, polled[i - 1U]);
+				}
+			}
+
+			if((fds[0].revents & POLLIN) != 0)
+			{
+				acceptClient(&daemon, listenFd);
+			}
+		}
+
+		updateTables(&daemon);
+	}
+
+	__atomic_store_n(&daemon.stop, 1U, __ATOMIC_RELEASE);
+	wakePorts(&daemon);
+
+	for(uint32_t i = 0; i < started; i++)
+	{
+		pthread_join(daemon.ports[i].thread, NULL);
+	}
+
+	close(listenFd);
+	unlink(listenPath);
+
+	snap_rcuDestroy(&daemon.rcu);	// Frees the tables and the rings of the clients that left
+
+	for(uint32_t i = 0; i < MAX_CLIENTS; i++)
+	{
+		if(daemon.clients[i].socket >= 0) close(daemon.clients[i].socket);
+		if(daemon.clients[i].subscribed) snap_ipcDetach(&daemon.clients[i].ipc);
+	}
+
+	if(metricsPath != NULL)
+	{
+		snap_metricsDestroy(&metrics);
+	}
+
+	for(uint32_t i = 0; i < daemon.portCount; i++)
+	{
+		snap_txDestroy(&daemon.ports[i].tx);
+		close(daemon.ports[i].wakeFd);
+		close(daemon.ports[i].fd);
+	}
+
+	return status;
+}
+
+/******************************** END OF FILE *********************************/
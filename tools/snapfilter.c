@@ -0,0 +1,297 @@
+/**
+ * @file   snapfilter.c
+ * @author Lucas Jadilo
+ * @brief  snapfilter: benchmark of the compiled subscription filters against testing each subscription.
+ * @details Random subscriptions (by destination and source address, command byte, protocol flags and ACK
+ *          bits) are compiled with snap_filterCompile() and applied to random frames, first to check that
+ *          snap_filterMatch() finds exactly the subscriptions accepted by snap_filterTest(), then to measure
+ *          the cost per frame of both ways. With -c, the hardware counters per frame are reported too
+ *          (see snap_perf.h).
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "snap_filter.h"
+#include "snap_perf.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define FRAMES			(4096U)		// Frames generated (they are matched repeatedly)
+#define ADDRESSES		(1024U)		// Addresses used by the frames and the subscriptions
+#define MAX_LIST		(16U)		// Largest number of addresses or commands of a subscription
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+typedef struct list_t
+{
+	uint32_t dest[MAX_LIST];
+	uint32_t source[MAX_LIST];
+	uint8_t  commands[MAX_LIST];
+} list_t;
+
+
+/******************************************************************************/
+/*  Function Definitions                                                      */
+/******************************************************************************/
+
+
+static void usage(void)
+{
+	fputs("usage: snapfilter [-s subscriptions] [-n frames] [-l size] [-c]\n"
+		  "  -s subscriptions  number of subscriptions, 1 to 4096 (default: 64)\n"
+		  "  -n frames         frames matched by each method (default: 1000000)\n"
+		  "  -l size           addresses or commands listed by a subscription, 1 to 16 (default: 4)\n"
+		  "  -c                also report hardware counters per frame (cycles, instructions, branch and cache misses)\n",
+		  stderr);
+}
+
+static uint64_t monotonicNs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000U + (uint64_t)now.tv_nsec;
+}
+
+static void makeSubscription(snap_subscription_t *subscription, list_t *list, const unsigned int size)
+{
+	memset(subscription, 0, sizeof(*subscription));
+
+	for(unsigned int i = 0; i < size; i++)
+	{
+		list->dest[i] = (uint32_t)rand() % ADDRESSES;
+		list->source[i] = (uint32_t)rand() % ADDRESSES;
+		list->commands[i] = (uint8_t)rand();
+	}
+
+	switch(rand() % 5)
+	{
+		case 0:		// Commands sent to some nodes
+			subscription->commands = list->commands;
+			subscription->commandCount = size;
+			// fall through
+		case 1:		// Frames sent to some nodes
+			subscription->destAddresses = list->dest;
+			subscription->destCount = size;
+			break;
+		case 2:		// Frames sent by some nodes that request an ACK
+			subscription->sourceAddresses = list->source;
+			subscription->sourceCount = size;
+			subscription->hdb2Mask = SNAP_HDB2_ACK_MASK << SNAP_HDB2_ACK_POS;
+			subscription->hdb2Value = SNAP_HDB2_ACK_REQUESTED << SNAP_HDB2_ACK_POS;
+			break;
+		case 3:		// Frames with a protocol flag set
+			subscription->flagsMask = 1U << (rand() % 8);
+			subscription->flagsValue = subscription->flagsMask;
+			subscription->destAddresses = list->dest;
+			subscription->destCount = size;
+			break;
+		default:	// Command frames with some command bytes
+			subscription->commands = list->commands;
+			subscription->commandCount = size;
+			subscription->hdb1Mask = SNAP_HDB1_CMD_MASK << SNAP_HDB1_CMD_POS;
+			subscription->hdb1Value = SNAP_HDB1_CMD_MODE_ENABLED << SNAP_HDB1_CMD_POS;
+			break;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long long subscriptionCount = 64, frameCount = 1000000, listSize = 4;
+	bool counters = false;
+	int opt;
+
+	while((opt = getopt(argc, argv, "s:n:l:c")) != -1)
+	{
+		char *end;
+		const unsigned long long value = (optarg != NULL) ? strtoull(optarg, &end, 0) : 0;
+
+		if((optarg != NULL) && ((*end != '\0') || (*optarg == '\0')))
+		{
+			usage();
+			return 2;
+		}
+
+		switch(opt)
+		{
+			case 's':
+				subscriptionCount = value;
+				if((subscriptionCount == 0) || (subscriptionCount > SNAP_FILTER_MAX_SUBSCRIPTIONS)) { usage(); return 2; }
+				break;
+			case 'n':
+				frameCount = value;
+				if(frameCount == 0) { usage(); return 2; }
+				break;
+			case 'l':
+				listSize = value;
+				if((listSize == 0) || (listSize > MAX_LIST)) { usage(); return 2; }
+				break;
+			case 'c':
+				counters = true;
+				break;
+			default:
+				usage();
+				return 2;
+		}
+	}
+
+	if(optind != argc)
+	{
+		usage();
+		return 2;
+	}
+
+	srand(1);
+
+	snap_subscription_t *subscriptions = malloc(subscriptionCount * sizeof(snap_subscription_t));
+	list_t *lists = malloc(subscriptionCount * sizeof(list_t));
+	snap_frame_t *frames = malloc(FRAMES * sizeof(snap_frame_t));
+	uint8_t *buffers = malloc(FRAMES * SNAP_MAX_SIZE_FRAME);
+	uint64_t matches[SNAP_FILTER_WORDS(SNAP_FILTER_MAX_SUBSCRIPTIONS)];
+	snap_perfCounts_t compiledCounts, linearCounts;
+	snap_filter_t filter;
+	snap_perf_t perf;
+
+	if((subscriptions == NULL) || (lists == NULL) || (frames == NULL) || (buffers == NULL))
+	{
+		perror("snapfilter");
+		return 1;
+	}
+
+	for(uint32_t i = 0; i < subscriptionCount; i++)
+	{
+		makeSubscription(&subscriptions[i], &lists[i], (unsigned int)listSize);
+	}
+
+	// Frames with 2-byte addresses, 1 flags byte, a command byte and some data
+	for(uint32_t i = 0; i < FRAMES; i++)
+	{
+		uint8_t data[16];
+		const bool command = (rand() % 2) != 0;
+		snap_fields_t fields = {.data = data, .dataSize = 16, .paddingAfter = true,
+					.destAddress = (uint32_t)rand() % ADDRESSES, .sourceAddress = (uint32_t)rand() % ADDRESSES,
+					.protocolFlags = (uint32_t)rand() & 0xFFU,
+					.header = {.dab = SNAP_HDB2_DAB_2BYTE_DEST_ADDRESS, .sab = SNAP_HDB2_SAB_2BYTE_SOURCE_ADDRESS,
+						   .pfb = SNAP_HDB2_PFB_1BYTE_PROTOCOL_FLAGS, .ack = (snap_hdb2_ack_t)(rand() % 4),
+						   .cmd = command ? SNAP_HDB1_CMD_MODE_ENABLED : SNAP_HDB1_CMD_MODE_DISABLED,
+						   .edm = SNAP_HDB1_EDM_8BIT_CRC}};
+
+		for(unsigned int j = 0; j < sizeof(data); j++)
+		{
+			data[j] = (uint8_t)rand();
+		}
+
+		snap_init(&frames[i], &buffers[i * SNAP_MAX_SIZE_FRAME], SNAP_MAX_SIZE_FRAME);
+		snap_encapsulate(&frames[i], &fields);
+	}
+
+	uint64_t start = monotonicNs();
+
+	if(snap_filterCompile(&filter, subscriptions, (uint32_t)subscriptionCount) < 0)
+	{
+		perror("snapfilter: compile");
+		return 1;
+	}
+
+	const uint64_t compileNs = monotonicNs() - start;
+	uint64_t matched = 0;
+
+	// Check against the subscriptions tested one by one
+	for(uint32_t i = 0; i < FRAMES; i++)
+	{
+		matched += snap_filterMatch(&filter, &frames[i], matches);
+
+		for(uint32_t j = 0; j < subscriptionCount; j++)
+		{
+			if(snap_filterTest(&subscriptions[j], &frames[i]) != (((matches[j / 64U] >> (j % 64U)) & 1U) != 0))
+			{
+				fprintf(stderr, "snapfilter: frame %u, subscription %u: mismatch\n", i, j);
+				return 1;
+			}
+		}
+	}
+
+	uint64_t checksum = 0;
+
+	if(counters && (snap_perfOpen(&perf) < 0))
+	{
+		fprintf(stderr, "snapfilter: hardware counters not available (%s), reporting time only\n", strerror(errno));
+		counters = false;
+	}
+
+	if(counters) snap_perfStart(&perf);
+
+	start = monotonicNs();
+
+	for(uint64_t i = 0; i < frameCount; i++)
+	{
+		checksum += snap_filterMatch(&filter, &frames[i % FRAMES], matches);
+	}
+
+	const double compiledNs = (double)(monotonicNs() - start) / (double)frameCount;
+
+	if(counters) snap_perfStop(&perf, &compiledCounts);
+	if(counters) snap_perfStart(&perf);
+
+	start = monotonicNs();
+
+	for(uint64_t i = 0; i < frameCount; i++)
+	{
+		for(uint32_t j = 0; j < subscriptionCount; j++)
+		{
+			checksum += snap_filterTest(&subscriptions[j], &frames[i % FRAMES]);
+		}
+	}
+
+	const double linearNs = (double)(monotonicNs() - start) / (double)frameCount;
+
+	if(counters) snap_perfStop(&perf, &linearCounts);
+
+	printf("subscriptions=%llu frames=%llu matches/frame=%.2f compile=%.1f us (checksum %llu)\n",
+		   subscriptionCount, frameCount, (double)matched / FRAMES, (double)compileNs / 1e3, (unsigned long long)checksum);
+
+	if(counters)
+	{
+		printf("%-9s %9s", "method", "ns/frame");
+		snap_perfPrintHeader(stdout);
+		printf("\n%-9s %9.1f", "compiled", compiledNs);
+		snap_perfPrint(stdout, &compiledCounts, frameCount);
+		printf("\n%-9s %9.1f", "linear", linearNs);
+		snap_perfPrint(stdout, &linearCounts, frameCount);
+		putchar('\n');
+		snap_perfClose(&perf);
+	}
+	else
+	{
+		printf("compiled: %.1f ns/frame\n", compiledNs);
+		printf("linear:   %.1f ns/frame\n", linearNs);
+	}
+
+	snap_filterDestroy(&filter);
+	free(subscriptions);
+	free(lists);
+	free(frames);
+	free(buffers);
+
+	return 0;
+}
+
+/******************************** END OF FILE *********************************/
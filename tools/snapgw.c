@@ -0,0 +1,895 @@
+/**
+ * @file   snapgw.c
+ * @author Lucas Jadilo
+ * @brief  snapgw: gateway that forwards the frames received on one port to other ports, by destination address.
+ * @details The input is decoded with the cut-through forwarder (see snap_cutProcess()): by default, the bytes
+ *          of a frame are written to its output port as soon as they are read, once the header and the
+ *          destination address have been received, and a frame with a wrong hash goes out with a wrong hash
+ *          too. With -s, each frame is written only once it is complete and valid. Chaining gateways shows
+ *          the difference in multi-hop latency, e.g. with snaplat at both ends of a chain of ptys.
+ *
+ *          With -m, the counters of the input and of each output port are served in the Prometheus text
+ *          format on a Unix socket (see snap_metrics.h), with the queue depth of the output ttys (bytes not
+ *          sent yet) and a histogram of the time between the routing decision of each frame and its last
+ *          byte, i.e. how long the output port is held by the frame.
+ *
+ *          With -c, the output ports, the routes and the baud rates are read from a file, which is read again
+ *          on SIGHUP while the gateway keeps running: a control thread opens the new ports and publishes the
+ *          new configuration (see snap_rcu.h), and the forwarding loop picks it up between two frames, so the
+ *          frame in progress completes on its output port and no frame is lost. The forwarding loop also sets
+ *          the baud rates that changed at that point, once the bytes already written to an output have been
+ *          sent. Ports kept across a reload stay open, and the ports removed are closed once the forwarding
+ *          loop no longer uses them. If the input stalls inside a frame, the rest of the frame goes to a
+ *          duplicate of its output port, so the old configurations can still be freed meanwhile. Lines:
+ *
+ *              baud <baud>              baud rate of the ttys (input, and outputs without their own)
+ *              output <path> [baud]     next output port (0, 1, ...)
+ *              route <address> <port>   route the frames sent to this destination address to this port
+ *              default <port>           port of the other frames, or -1 to drop them (default: 0)
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+#include "snap_cut.h"
+#include "snap_metrics.h"
+#include "snap_rcu.h"
+#include "snap_tty.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define MAX_OUTPUTS		(16U)			// Largest number of output ports
+#define MAX_ROUTES		(256U)			// Largest number of -r options
+#define READ_SIZE		(4096U)			// Bytes per read() call
+#define MAX_CHANNELS	(64U)			// Largest number of output paths used over the life of the gateway
+#define SIZE_LINE		(512U)			// Longest line of the configuration file
+#define RECLAIM_MS		(100U)			// Period of the control thread, which frees the old configurations
+#define STALL_MS		(100)			// Silence inside a frame after which the forwarding loop releases its configuration
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+typedef struct route_t
+{
+	uint32_t address;
+	int16_t  port;
+} route_t;
+
+typedef struct channel_t	// Counters of an output path, kept across configurations
+{
+	char                  path[SIZE_LINE];
+	uint64_t              frames;		// Forwarding loop only
+	uint64_t              bytes;		// Forwarding loop only
+	long                  baud;			// Baud rate set by the forwarding loop (0: the one set when opened)
+	snap_metricsChannel_t *metrics;		// NULL without -m
+} channel_t;
+
+typedef struct output_t
+{
+	int       fd;						// Owned by the configuration (a port kept by a reload is dup()ed)
+	long      baud;
+	channel_t *channel;
+} output_t;
+
+typedef struct config_t		// Immutable once published
+{
+	output_t     outputs[MAX_OUTPUTS];
+	int          outputCount;
+	route_t      routes[MAX_ROUTES];
+	unsigned int routeCount;
+	int16_t      defaultPort;
+	long         baud;					// Input (and default output) baud rate
+	uint32_t     generation;			// Incremented by each reload
+} config_t;
+
+typedef struct gateway_t
+{
+	const config_t        *config;							// Configuration used by the forwarding loop
+	uint32_t              generation;						// Generation of the configuration whose baud rates are set (forwarding loop only)
+	long                  inputBaud;						// Baud rate of the input (forwarding loop only)
+	bool                  stalled;							// The frame in progress no longer uses the configuration
+	output_t              held;								// Duplicate of the output port of a stalled frame (fd -1 otherwise)
+	snap_rcu_t            rcu;								// Published configuration (the forwarding loop is reader 0)
+	channel_t             channels[MAX_CHANNELS];			// Written by the control thread, before the configuration that uses them is published
+	uint32_t              channelCount;
+	int                   input;
+	int                   error;
+	snap_metrics_t        metrics;
+	snap_metricsChannel_t *inputMetrics;					// NULL without -m
+	uint64_t              blockNs;							// Time the current block was read (with -m)
+	uint64_t              routeNs;							// Time the current frame was routed (with -m)
+	const char            *configPath;						// NULL without -c
+	const config_t        *published;						// Latest configuration (control thread, once started)
+	pthread_t             control;
+} gateway_t;
+
+
+/******************************************************************************/
+/*  Global Variables                                                          */
+/******************************************************************************/
+
+
+static volatile sig_atomic_t stop = 0;
+static uint32_t stopControl = 0;	// Accessed with __atomic builtins
+
+
+/******************************************************************************/
+/*  Function Definitions                                                      */
+/******************************************************************************/
+
+
+static void handleSignal(const int signal)
+{
+	(void)signal;
+	stop = 1;
+}
+
+static void usage(void)
+{
+	fputs("usage: snapgw [-s] [-b baud] [-r address:port]... [-d port] [-m socket] input output...\n"
+		  "       snapgw [-s] [-m socket] -c config input\n"
+		  "  input            tty, pty or file the frames are read from\n"
+		  "  output           ttys, ptys or files the frames are written to (ports 0, 1, ...; up to 16)\n"
+		  "  -s               store and forward: write only complete and valid frames (default: cut-through)\n"
+		  "  -b baud          set the baud rate (and raw mode) of the ports that are ttys\n"
+		  "  -r address:port  route the frames sent to this destination address to this port\n"
+		  "  -d port          port of the other frames, or -1 to drop them (default: 0)\n"
+		  "  -m socket        serve metrics in the Prometheus text format on this Unix socket\n"
+		  "  -c config        read the outputs, routes and baud rates from this file, again on SIGHUP\n",
+		  stderr);
+}
+
+static uint64_t monotonicNs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000U + (uint64_t)now.tv_nsec;
+}
+
+static int16_t routeFrame(void *context, const snap_frame_t *frame)
+{
+	gateway_t *gateway = context;
+	const config_t *config = gateway->config;
+	uint32_t address = 0;
+
+	gateway->routeNs = gateway->blockNs;
+
+	if(snap_getField(frame, &address, SNAP_FIELD_DEST_ADDRESS) < 0)
+	{
+		return config->defaultPort;	// No destination address (broadcast)
+	}
+
+	for(unsigned int i = 0; i < config->routeCount; i++)
+	{
+		if(config->routes[i].address == address)
+		{
+			return config->routes[i].port;
+		}
+	}
+
+	return config->defaultPort;
+}
+
+static const output_t *getOutput(const gateway_t *gateway, const int16_t port)
+{
+	return gateway->stalled ? &gateway->held : &gateway->config->outputs[port];
+}
+
+/**
+ * Acquire the latest configuration at a frame boundary, and set the baud rates that it changes. The outputs
+ * are changed once the bytes already written to them have been sent, so the previous frame is not cut.
+ */
+static void acquireConfig(gateway_t *gateway)
+{
+	const config_t *config = snap_rcuAcquire(&gateway->rcu, 0);
+
+	gateway->config = config;
+
+	if(config->generation == gateway->generation)
+	{
+		return;
+	}
+
+	gateway->generation = config->generation;
+
+	if((config->baud != 0) && (config->baud != gateway->inputBaud) && isatty(gateway->input) && (snap_ttySetBaud(gateway->input, config->baud) < 0))
+	{
+		perror("snapgw: input");
+	}
+
+	gateway->inputBaud = config->baud;
+
+	for(int i = 0; i < config->outputCount; i++)
+	{
+		const output_t *output = &config->outputs[i];
+
+		if((output->baud != 0) && (output->baud != output->channel->baud) && isatty(output->fd) && (snap_ttySetBaud(output->fd, output->baud) < 0))
+		{
+			perror(output->channel->path);
+		}
+
+		output->channel->baud = output->baud;
+	}
+}
+
+/**
+ * Let the frame in progress go on without the configuration: its output port is duplicated (if it has one).
+ * If that fails, the configuration stays held until the end of the frame.
+ */
+static void holdOutput(gateway_t *gateway, const int16_t port)
+{
+	if(port >= 0)
+	{
+		const output_t *output = &gateway->config->outputs[port];
+
+		if((gateway->held.fd = dup(output->fd)) < 0)
+		{
+			return;
+		}
+
+		gateway->held.baud = output->baud;
+		gateway->held.channel = output->channel;
+	}
+
+	gateway->stalled = true;
+}
+
+static void writePort(void *context, const int16_t port, const uint8_t *data, size_t size)
+{
+	gateway_t *gateway = context;
+	const output_t *output = getOutput(gateway, port);
+
+	while((size > 0) && (gateway->error == 0))
+	{
+		const ssize_t ret = write(output->fd, data, size);
+
+		if(ret < 0)
+		{
+			if(errno != EINTR) gateway->error = errno;
+			continue;
+		}
+
+		data += ret;
+		size -= (size_t)ret;
+		output->channel->bytes += (size_t)ret;
+	}
+}
+
+static void countFrame(void *context, const snap_frame_t *frame, const int16_t port)
+{
+	gateway_t *gateway = context;
+
+	if(port >= 0)
+	{
+		getOutput(gateway, port)->channel->frames++;
+	}
+
+	if((gateway->inputMetrics != NULL) && (frame->status == SNAP_STATUS_VALID) && (port >= 0))
+	{
+		snap_metricsObserve(gateway->inputMetrics, gateway->blockNs - gateway->routeNs);
+	}
+
+	if(gateway->held.fd >= 0)
+	{
+		close(gateway->held.fd);
+		gateway->held.fd = -1;
+	}
+
+	// Frame boundary: the next frame is routed with the latest configuration
+	gateway->stalled = false;
+	acquireConfig(gateway);
+}
+
+static void publishMetrics(gateway_t *gateway, const snap_cut_t *cut)
+{
+	const config_t *config = gateway->config;
+	const uint64_t frames = cut->stats.validFrames + cut->stats.hashErrors + cut->stats.overflowErrors;
+
+	snap_metricsSet(gateway->inputMetrics, SNAP_METRICS_BYTES, cut->stats.bytes);
+	snap_metricsSet(gateway->inputMetrics, SNAP_METRICS_VALID, cut->stats.validFrames);
+	snap_metricsSet(gateway->inputMetrics, SNAP_METRICS_HASH_ERRORS, cut->stats.hashErrors);
+	snap_metricsSet(gateway->inputMetrics, SNAP_METRICS_OVERFLOW_ERRORS, cut->stats.overflowErrors);
+	snap_metricsSet(gateway->inputMetrics, SNAP_METRICS_FORWARDED, cut->stats.forwardedFrames);
+	snap_metricsSet(gateway->inputMetrics, SNAP_METRICS_DROPPED, frames - cut->stats.forwardedFrames);
+
+	for(int i = 0; i < config->outputCount; i++)
+	{
+		const output_t *output = &config->outputs[i];
+		int pending = 0;
+
+		snap_metricsSet(output->channel->metrics, SNAP_METRICS_BYTES, output->channel->bytes);
+		snap_metricsSet(output->channel->metrics, SNAP_METRICS_FORWARDED, output->channel->frames);
+
+		if(isatty(output->fd) && (ioctl(output->fd, TIOCOUTQ, &pending) == 0))
+		{
+			snap_metricsSetQueueDepth(output->channel->metrics, pending);
+		}
+	}
+}
+
+static int openPort(const char *path, const int flags, const long baud)
+{
+	const int fd = open(path, flags | O_NOCTTY, 0644);
+
+	if(fd < 0)
+	{
+		perror(path);
+		return -1;
+	}
+
+	if(isatty(fd) && (snap_ttyConfigure(fd, baud) < 0))
+	{
+		perror(path);
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/*** Configurations ***********************************************************/
+
+static void freeConfig(void *context, void *object)
+{
+	config_t *config = object;
+
+	(void)context;
+
+	for(int i = 0; i < config->outputCount; i++)
+	{
+		if(config->outputs[i].fd >= 0)
+		{
+			close(config->outputs[i].fd);
+		}
+	}
+
+	free(config);
+}
+
+static channel_t *getChannel(gateway_t *gateway, const char *path)
+{
+	for(uint32_t i = 0; i < gateway->channelCount; i++)
+	{
+		if(strcmp(gateway->channels[i].path, path) == 0)
+		{
+			return &gateway->channels[i];
+		}
+	}
+
+	if((gateway->channelCount == MAX_CHANNELS) || (strlen(path) >= SIZE_LINE))
+	{
+		fprintf(stderr, "snapgw: %s: too many output paths\n", path);
+		return NULL;
+	}
+
+	channel_t *channel = &gateway->channels[gateway->channelCount];
+
+	strcpy(channel->path, path);
+
+	if(gateway->inputMetrics != NULL)
+	{
+		channel->metrics = snap_metricsAddChannel(&gateway->metrics, path);
+	}
+
+	gateway->channelCount++;
+
+	return channel;
+}
+
+/**
+ * Open the output ports of a new configuration: the paths already open in the previous one are dup()ed, so
+ * their frames in progress are not disturbed (the forwarding loop changes their baud rate if needed).
+ */
+static int openOutputs(gateway_t *gateway, config_t *config, const char **paths, const config_t *previous)
+{
+	for(int i = 0; i < config->outputCount; i++)
+	{
+		output_t *output = &config->outputs[i];
+		const output_t *kept = NULL;
+
+		for(int j = 0; (previous != NULL) && (j < previous->outputCount); j++)
+		{
+			if(strcmp(previous->outputs[j].channel->path, paths[i]) == 0)
+			{
+				kept = &previous->outputs[j];
+			}
+		}
+
+		if((output->channel = getChannel(gateway, paths[i])) == NULL)
+		{
+			return -1;
+		}
+
+		if(kept == NULL)
+		{
+			output->fd = openPort(paths[i], O_WRONLY | O_CREAT | O_TRUNC, output->baud);
+		}
+		else if((output->fd = dup(kept->fd)) < 0)
+		{
+			perror(paths[i]);
+		}
+
+		if(output->fd < 0)
+		{
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static bool parseLine(config_t *config, char *line, const char **paths, long *baud)
+{
+	char *save, *end;
+	const char *keyword = strtok_r(line, " \t\r\n", &save);
+	const char *first = (keyword != NULL) ? strtok_r(NULL, " \t\r\n", &save) : NULL;
+	const char *second = (first != NULL) ? strtok_r(NULL, " \t\r\n", &save) : NULL;
+	long value;
+
+	if((keyword == NULL) || (keyword[0] == '#'))
+	{
+		return true;
+	}
+
+	if((first == NULL) || ((second != NULL) && (strtok_r(NULL, " \t\r\n", &save) != NULL)))
+	{
+		return false;
+	}
+
+	if((strcmp(keyword, "baud") == 0) && (second == NULL))
+	{
+		*baud = strtol(first, &end, 0);
+		return (*end == '\0') && (*baud > 0);
+	}
+
+	if((strcmp(keyword, "output") == 0) && (config->outputCount < (int)MAX_OUTPUTS))
+	{
+		value = (second != NULL) ? strtol(second, &end, 0) : 0;
+
+		if((second != NULL) && ((*end != '\0') || (value <= 0)))
+		{
+			return false;
+		}
+
+		paths[config->outputCount] = first;
+		config->outputs[config->outputCount].baud = value;	// 0: the default baud rate, set at the end
+		config->outputCount++;
+		return true;
+	}
+
+	if((strcmp(keyword, "route") == 0) && (second != NULL) && (config->routeCount < MAX_ROUTES))
+	{
+		const unsigned long long address = strtoull(first, &end, 0);
+
+		if((*end != '\0') || (*first == '\0') || (address > UINT32_MAX))
+		{
+			return false;
+		}
+
+		value = strtol(second, &end, 0);
+
+		if((*end != '\0') || (*second == '\0') || (value < 0) || (value >= (long)MAX_OUTPUTS))
+		{
+			return false;
+		}
+
+		config->routes[config->routeCount].address = (uint32_t)address;
+		config->routes[config->routeCount].port = (int16_t)value;
+		config->routeCount++;
+		return true;
+	}
+
+	if((strcmp(keyword, "default") == 0) && (second == NULL))
+	{
+		value = strtol(first, &end, 0);
+		config->defaultPort = (int16_t)value;
+		return (*end == '\0') && (value >= SNAP_CUT_NO_PORT) && (value < (long)MAX_OUTPUTS);
+	}
+
+	return false;
+}
+
+/**
+ * Read a configuration file. The paths of the outputs point into lines, which must stay until they are opened.
+ */
+static config_t *readConfig(const char *path, char (*lines)[SIZE_LINE], const char **paths)
+{
+	FILE *file = fopen(path, "r");
+	config_t *config = calloc(1, sizeof(config_t));
+	bool valid = (file != NULL) && (config != NULL);
+	unsigned int count = 0;
+	long baud = 0;
+
+	if(!valid)
+	{
+		perror(path);
+	}
+
+	while(valid && (fgets(lines[count], SIZE_LINE, file) != NULL))
+	{
+		count++;
+
+		if(!parseLine(config, lines[count - 1U], paths, &baud) || (count == MAX_OUTPUTS + MAX_ROUTES + 16U))
+		{
+			fprintf(stderr, "snapgw: %s:%u: invalid line\n", path, count);
+			valid = false;
+		}
+	}
+
+	for(unsigned int i = 0; valid && (i < config->routeCount); i++)
+	{
+		valid = (config->routes[i].port < config->outputCount);
+	}
+
+	if(valid && ((config->outputCount == 0) || (config->defaultPort >= config->outputCount)))
+	{
+		fprintf(stderr, "snapgw: %s: no output, or route to a missing output\n", path);
+		valid = false;
+	}
+
+	if(file != NULL)
+	{
+		fclose(file);
+	}
+
+	if(!valid)
+	{
+		free(config);
+		return NULL;
+	}
+
+	config->baud = baud;
+
+	for(int i = 0; i < config->outputCount; i++)
+	{
+		config->outputs[i].fd = -1;
+		config->outputs[i].baud = (config->outputs[i].baud != 0) ? config->outputs[i].baud : baud;
+	}
+
+	return config;
+}
+
+/**
+ * Build the configuration of the file, with the ports of the previous configuration that are kept. On error,
+ * the previous configuration stays in use.
+ */
+static config_t *loadConfig(gateway_t *gateway, const config_t *previous)
+{
+	static char lines[MAX_OUTPUTS + MAX_ROUTES + 16U][SIZE_LINE];	// Control thread only
+	const char *paths[MAX_OUTPUTS];
+	config_t *config = readConfig(gateway->configPath, lines, paths);
+
+	if((config != NULL) && (openOutputs(gateway, config, paths, previous) < 0))
+	{
+		freeConfig(NULL, config);
+		return NULL;
+	}
+
+	return config;
+}
+
+static void *controlGateway(void *argument)
+{
+	gateway_t *gateway = argument;
+	const config_t *current = gateway->published;
+	sigset_t signals;
+
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGHUP);
+
+	while(!__atomic_load_n(&stopControl, __ATOMIC_ACQUIRE))
+	{
+		const struct timespec timeout = {.tv_sec = 0, .tv_nsec = RECLAIM_MS * 1000000L};
+
+		if(sigtimedwait(&signals, NULL, &timeout) == SIGHUP)
+		{
+			config_t *config = loadConfig(gateway, current);
+
+			if(config != NULL)
+			{
+				config->generation = current->generation + 1U;
+				snap_rcuPublish(&gateway->rcu, config);
+				current = config;
+				fprintf(stderr, "snapgw: %s: %d outputs, %u routes\n", gateway->configPath, config->outputCount, config->routeCount);
+			}
+		}
+
+		snap_rcuReclaim(&gateway->rcu);
+	}
+
+	return NULL;
+}
+
+/*** Main *********************************************************************/
+
+int main(int argc, char **argv)
+{
+	static gateway_t gateway;
+	static config_t arguments;
+	snap_cutMode_t mode = SNAP_CUT_MODE_CUT_THROUGH;
+	const char *metricsPath = NULL;
+	long baud = 0;
+	int opt;
+
+	while((opt = getopt(argc, argv, "sb:r:d:m:c:")) != -1)
+	{
+		char *end;
+		long value;
+
+		switch(opt)
+		{
+			case 's':
+				mode = SNAP_CUT_MODE_STORE_AND_FORWARD;
+				break;
+			case 'b':
+				baud = strtol(optarg, &end, 0);
+				if((*end != '\0') || (baud <= 0)) { usage(); return 2; }
+				break;
+			case 'r':
+				if(arguments.routeCount == MAX_ROUTES) { usage(); return 2; }
+				const unsigned long long address = strtoull(optarg, &end, 0);
+				if((end == optarg) || (*end != ':') || (address > UINT32_MAX)) { usage(); return 2; }
+				value = strtol(end + 1, &end, 0);
+				if((*end != '\0') || (value < 0) || (value >= (long)MAX_OUTPUTS)) { usage(); return 2; }
+				arguments.routes[arguments.routeCount].address = (uint32_t)address;
+				arguments.routes[arguments.routeCount].port = (int16_t)value;
+				arguments.routeCount++;
+				break;
+			case 'd':
+				value = strtol(optarg, &end, 0);
+				if((*end != '\0') || (*optarg == '\0') || (value < SNAP_CUT_NO_PORT) || (value >= (long)MAX_OUTPUTS)) { usage(); return 2; }
+				arguments.defaultPort = (int16_t)value;
+				break;
+			case 'm':
+				metricsPath = optarg;
+				break;
+			case 'c':
+				gateway.configPath = optarg;
+				break;
+			default:
+				usage();
+				return 2;
+		}
+	}
+
+	arguments.outputCount = argc - optind - 1;
+	arguments.baud = baud;
+
+	if(gateway.configPath != NULL)
+	{
+		// The file replaces the options of the outputs
+		if((arguments.outputCount != 0) || (baud != 0) || (arguments.routeCount != 0) || (arguments.defaultPort != 0))
+		{
+			usage();
+			return 2;
+		}
+	}
+	else if((arguments.outputCount < 1) || (arguments.outputCount > (int)MAX_OUTPUTS) || (arguments.defaultPort >= arguments.outputCount))
+	{
+		usage();
+		return 2;
+	}
+
+	for(unsigned int i = 0; i < arguments.routeCount; i++)
+	{
+		if(arguments.routes[i].port >= arguments.outputCount) { usage(); return 2; }
+	}
+
+	if(argc - optind < 1)
+	{
+		usage();
+		return 2;
+	}
+
+	// Threads started from here on do not take the signals: SIGHUP is only taken by the control thread
+	// (sigtimedwait()), and SIGINT and SIGTERM interrupt the read() of the forwarding loop
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGHUP);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+	if(metricsPath != NULL)
+	{
+		if((snap_metricsInit(&gateway.metrics, MAX_CHANNELS + 1U) < 0) || (snap_metricsStart(&gateway.metrics, metricsPath) < 0))
+		{
+			perror(metricsPath);
+			return 1;
+		}
+
+		gateway.inputMetrics = snap_metricsAddChannel(&gateway.metrics, argv[optind]);
+	}
+
+	config_t *config = NULL;
+
+	if(gateway.configPath != NULL)
+	{
+		config = loadConfig(&gateway, NULL);
+	}
+	else if((config = malloc(sizeof(config_t))) != NULL)
+	{
+		const char *paths[MAX_OUTPUTS];
+
+		*config = arguments;
+
+		for(int i = 0; i < config->outputCount; i++)
+		{
+			paths[i] = argv[optind + 1 + i];
+			config->outputs[i].fd = -1;
+			config->outputs[i].baud = baud;
+		}
+
+		if(openOutputs(&gateway, config, paths, NULL) < 0)
+		{
+			freeConfig(NULL, config);
+			config = NULL;
+		}
+	}
+
+	gateway.input = (config != NULL) ? openPort(argv[optind], O_RDONLY, config->baud) : -1;
+
+	if((gateway.input < 0) || (snap_rcuInit(&gateway.rcu, 1, config, freeConfig, NULL) < 0))
+	{
+		return 1;
+	}
+
+	gateway.published = config;
+	gateway.inputBaud = config->baud;
+	gateway.held.fd = -1;
+
+	for(int i = 0; i < config->outputCount; i++)
+	{
+		config->outputs[i].channel->baud = config->outputs[i].baud;
+	}
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = handleSignal;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+
+	const int error = (gateway.configPath != NULL) ? pthread_create(&gateway.control, NULL, controlGateway, &gateway) : 0;
+
+	sigdelset(&signals, SIGHUP);
+	pthread_sigmask(SIG_UNBLOCK, &signals, NULL);
+
+	if(error != 0)
+	{
+		fprintf(stderr, "snapgw: pthread_create: %s\n", strerror(error));
+		return 1;
+	}
+
+	static snap_cut_t cut;
+	uint8_t buffer[READ_SIZE];
+	int status = 0;
+
+	snap_cutInit(&cut, mode, routeFrame, writePort, countFrame, &gateway);
+	gateway.config = snap_rcuAcquire(&gateway.rcu, 0);
+
+	while(!stop && (gateway.error == 0))
+	{
+		if(cut.routed && !gateway.stalled)
+		{
+			struct pollfd input = {.fd = gateway.input, .events = POLLIN};
+			const int ready = poll(&input, 1, STALL_MS);
+
+			if(ready < 0)
+			{
+				continue;	// EINTR
+			}
+
+			if(ready == 0)
+			{
+				holdOutput(&gateway, cut.port);
+			}
+		}
+
+		// The forwarding loop holds no configuration while it waits, between frames or inside a stalled frame
+		const bool waiting = !cut.routed || gateway.stalled;
+
+		if(waiting)
+		{
+			snap_rcuRelease(&gateway.rcu, 0);
+		}
+
+		const ssize_t ret = read(gateway.input, buffer, sizeof(buffer));
+
+		if(waiting && cut.routed)
+		{
+			gateway.config = snap_rcuAcquire(&gateway.rcu, 0);	// Only for the metrics until the end of the frame
+		}
+		else if(waiting)
+		{
+			acquireConfig(&gateway);
+		}
+
+		if(ret == 0)
+		{
+			break;
+		}
+
+		if(ret < 0)
+		{
+			if(errno == EINTR) continue;
+			perror("read");
+			status = 1;
+			break;
+		}
+
+		if(gateway.inputMetrics != NULL)
+		{
+			gateway.blockNs = monotonicNs();
+			snap_cutProcess(&cut, buffer, (size_t)ret);
+			publishMetrics(&gateway, &cut);
+		}
+		else
+		{
+			snap_cutProcess(&cut, buffer, (size_t)ret);
+		}
+	}
+
+	snap_rcuRelease(&gateway.rcu, 0);
+
+	if(gateway.configPath != NULL)
+	{
+		__atomic_store_n(&stopControl, 1U, __ATOMIC_RELEASE);
+		pthread_join(gateway.control, NULL);
+	}
+
+	if(gateway.error != 0)
+	{
+		fprintf(stderr, "write: %s\n", strerror(gateway.error));
+		status = 1;
+	}
+
+	fprintf(stderr, "mode=%s bytes=%llu valid=%llu hash-errors=%llu overflow-errors=%llu forwarded=%llu poisoned=%llu\n",
+			(mode == SNAP_CUT_MODE_CUT_THROUGH) ? "cut-through" : "store-and-forward",
+			(unsigned long long)cut.stats.bytes, (unsigned long long)cut.stats.validFrames,
+			(unsigned long long)cut.stats.hashErrors, (unsigned long long)cut.stats.overflowErrors,
+			(unsigned long long)cut.stats.forwardedFrames, (unsigned long long)cut.stats.poisonedFrames);
+
+	const config_t *last = snap_rcuAcquire(&gateway.rcu, 0);
+
+	for(int i = 0; i < last->outputCount; i++)
+	{
+		const channel_t *channel = last->outputs[i].channel;
+		fprintf(stderr, "port %d (%s): %llu frames\n", i, channel->path, (unsigned long long)channel->frames);
+	}
+
+	snap_rcuRelease(&gateway.rcu, 0);
+
+	if(metricsPath != NULL)
+	{
+		snap_metricsDestroy(&gateway.metrics);
+	}
+
+	snap_rcuDestroy(&gateway.rcu);	// Closes the outputs
+	close(gateway.input);
+
+	return status;
+}
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,728 @@
+/**
+ * @file   snaplat.c
+ * @author Lucas Jadilo
+ * @brief  snaplat: end-to-end latency benchmark of frames sent through pty pairs.
+ * @details For each pty pair, a sender thread builds frames with snap_encapsulate() and writes them into
+ *          the master side at a fixed rate, and a receiver thread reads the slave side (raw mode) and decodes
+ *          it with the stream decoder. Each frame carries its sequence number in the first data bytes, and
+ *          the latency is the time between the start of its write() and the return of the read() that
+ *          completed it, so it includes the kernel tty layer and the decoder, as felt by an application.
+ *          At the end, the latency distribution and the throughput of all pairs are reported.
+ *
+ *          With subscribers (-s), each decoded frame is copied once into a pool frame and published to that
+ *          many subscriber threads through the reference-counted dispatcher (snap_dispatch.h), and the latency
+ *          is measured by each subscriber when it receives the frame, so the cost of the fan-out is included.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/uio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "snap_dispatch.h"
+#include "snap_gather.h"
+#include "snap_tx.h"
+#include "snap_tty.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define MAX_PAIRS			(64U)
+#define HISTOGRAM_SIZE		(100000U)		// Latency histogram: 1 us buckets up to 100 ms
+#define DRAIN_TIMEOUT_MS	(1000)			// Time the receiver waits for missing frames after the sender is done
+#define STREAM_SIZE			(1U << 16)
+#define POOL_FRAMES			(4096U)			// Frames of the pool of each pair (fan-out only)
+#define QUEUE_SIZE			(1024U)			// Frames of the queue of each subscriber (fan-out only)
+#define RING_SLOTS			(64U)			// Slots of the transmit ring of each sender (-t only)
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+typedef struct latency_t
+{
+	uint64_t histogram[HISTOGRAM_SIZE + 1];
+	uint64_t samples;
+	uint64_t sumNs;
+	uint64_t maxNs;
+} latency_t;
+
+typedef struct pair_t pair_t;
+
+typedef struct subscriber_t
+{
+	pair_t    *pair;
+	uint32_t  number;
+	pthread_t thread;
+	uint64_t  received;
+	uint64_t  lastTime;					// Time of the last frame received
+	latency_t latency;
+} subscriber_t;
+
+struct pair_t
+{
+	unsigned int  index;
+	int           master;
+	int           slave;
+	pthread_t     sender;
+	pthread_t     receiver;
+	uint64_t      *sendTimes;			// Start of the write() of each frame, indexed by sequence number
+	uint64_t      received;
+	uint64_t      bytes;
+	uint64_t      errors;				// Frames received with a hash or overflow error, or an unknown sequence number
+	uint64_t      readTime;				// Return of the last read()
+	bool          senderDone;			// Accessed with __atomic builtins
+	int           senderError;
+	int           receiverError;
+	snap_stream_t stream;
+	uint8_t       streamBuffer[STREAM_SIZE];
+	latency_t     latency;
+	bool          receiverDone;			// Accessed with __atomic builtins
+	uint64_t      poolEmpty;			// Frames not published because the pool was empty
+	snap_pool_t       pool;
+	snap_dispatcher_t dispatcher;
+	subscriber_t      *subscribers;
+};
+
+typedef struct config_t
+{
+	uint64_t     frames;
+	double       rate;
+	uint16_t     dataSize;
+	uint8_t      edm;
+	long         baud;
+	unsigned int pairs;
+	uint32_t     subscribers;
+	bool         gather;
+	bool         ring;
+} config_t;
+
+
+/******************************************************************************/
+/*  Global Variables                                                          */
+/******************************************************************************/
+
+
+static config_t config = {.frames = 10000, .rate = 1000.0, .dataSize = 16, .edm = SNAP_HDB1_EDM_16BIT_CRC, .baud = 0, .pairs = 1, .subscribers = 0, .gather = false, .ring = false};
+
+
+/******************************************************************************/
+/*  Function Definitions                                                      */
+/******************************************************************************/
+
+
+static void usage(void)
+{
+	fputs("usage: snaplat [-n frames] [-r rate] [-d size] [-e edm] [-p pairs] [-s subscribers] [-g | -t] [-b baud]\n"
+		  "  -n frames  frames sent through each pair (default: 10000)\n"
+		  "  -r rate    frames per second sent through each pair (0 = as fast as possible; default: 1000)\n"
+		  "  -d size    data bytes per frame, 4 to 512 (default: 16)\n"
+		  "  -e edm     error detection method, 0 to 5 (default: 4 = 16-bit CRC)\n"
+		  "  -p pairs   number of pty pairs, each with its own sender and receiver threads (default: 1)\n"
+		  "  -s subscribers  publish each frame to this many subscriber threads, 0 to 32 (default: 0)\n"
+		  "  -g         send the frames with snap_gatherEncode() and writev(), without copying the data\n"
+		  "  -t         encapsulate the frames into the slots of a transmit ring (snap_tx.h) and send them\n"
+		  "             in batches with writev() (when the rate is 0, a batch is sent when the ring is full)\n"
+		  "  -b baud    baud rate set on the ptys (default: keep)\n",
+		  stderr);
+}
+
+static uint64_t monotonicNs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000U + (uint64_t)now.tv_nsec;
+}
+
+static void sleepUntil(const uint64_t deadline)
+{
+	const struct timespec spec = {.tv_sec = (time_t)(deadline / 1000000000U), .tv_nsec = (long)(deadline % 1000000000U)};
+
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &spec, NULL) == EINTR);
+}
+
+static void recordLatency(latency_t *latency, const uint64_t ns)
+{
+	const uint64_t bucket = ns / 1000U;
+
+	latency->histogram[(bucket < HISTOGRAM_SIZE) ? bucket : HISTOGRAM_SIZE]++;
+	latency->samples++;
+	latency->sumNs += ns;
+
+	if(ns > latency->maxNs)
+	{
+		latency->maxNs = ns;
+	}
+}
+
+static void mergeLatency(latency_t *total, const latency_t *latency)
+{
+	for(uint64_t i = 0; i <= HISTOGRAM_SIZE; i++)
+	{
+		total->histogram[i] += latency->histogram[i];
+	}
+
+	total->samples += latency->samples;
+	total->sumNs += latency->sumNs;
+	total->maxNs = (latency->maxNs > total->maxNs) ? latency->maxNs : total->maxNs;
+}
+
+static uint64_t latencyPercentileUs(const latency_t *latency, const double percentile)
+{
+	const uint64_t rank = (uint64_t)(percentile * (double)latency->samples);
+	uint64_t count = 0;
+
+	for(uint64_t i = 0; i <= HISTOGRAM_SIZE; i++)
+	{
+		count += latency->histogram[i];
+
+		if(count > rank)
+		{
+			return i;
+		}
+	}
+
+	return HISTOGRAM_SIZE;
+}
+
+static int openPair(pair_t *pair)
+{
+	char name[64];
+
+	pair->master = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+
+	if((pair->master < 0) || (grantpt(pair->master) < 0) || (unlockpt(pair->master) < 0) ||
+	   (ptsname_r(pair->master, name, sizeof(name)) != 0))
+	{
+		return -1;
+	}
+
+	pair->slave = open(name, O_RDWR | O_NOCTTY | O_CLOEXEC);
+
+	if((pair->slave < 0) || (snap_ttyConfigure(pair->slave, config.baud) < 0))
+	{
+		return -1;
+	}
+
+	return 0;
+}
+
+static int writePieces(const int fd, const snap_gather_t *gather)
+{
+	struct iovec vectors[SNAP_GATHER_MAX_PIECES];
+	struct iovec *vector = vectors;
+	int count = gather->count;
+
+	for(int i = 0; i < count; i++)
+	{
+		vectors[i].iov_base = (void *)gather->pieces[i].base;
+		vectors[i].iov_len = gather->pieces[i].length;
+	}
+
+	while(count)
+	{
+		ssize_t ret = writev(fd, vector, count);
+
+		if(ret < 0)
+		{
+			if(errno == EINTR) continue;
+			return -1;
+		}
+
+		for(; count && ((size_t)ret >= vector->iov_len); vector++, count--)
+		{
+			ret -= (ssize_t)vector->iov_len;
+		}
+
+		if(count)
+		{
+			vector->iov_base = (uint8_t *)vector->iov_base + ret;
+			vector->iov_len -= (size_t)ret;
+		}
+	}
+
+	return 0;
+}
+
+static void *stopSender(pair_t *pair, const int error)
+{
+	pair->senderError = error;
+	__atomic_store_n(&pair->senderDone, true, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+static void *sendRing(pair_t *pair, snap_fields_t *fields, uint8_t *data, const uint64_t period, const uint64_t start)
+{
+	snap_tx_t tx;
+
+	if(snap_txInit(&tx, pair->master, RING_SLOTS) < 0)
+	{
+		return stopSender(pair, errno);
+	}
+
+	for(uint64_t sequence = 0; sequence < config.frames; sequence++)
+	{
+		if(period)
+		{
+			sleepUntil(start + sequence * period);
+		}
+
+		for(unsigned int i = 0; i < 4; i++)
+		{
+			data[i] = (uint8_t)(sequence >> (8U * i));
+		}
+
+		snap_frame_t *slot = snap_txAcquire(&tx);
+
+		if((slot == NULL) && ((snap_txFlush(&tx) < 0) || ((slot = snap_txAcquire(&tx)) == NULL)))
+		{
+			const int error = errno;
+
+			snap_txDestroy(&tx);
+			return stopSender(pair, error);
+		}
+
+		snap_encapsulate(slot, fields);
+		__atomic_store_n(&pair->sendTimes[sequence], monotonicNs(), __ATOMIC_RELEASE);
+		snap_txSubmit(&tx);
+
+		if((period || (sequence + 1U == config.frames)) && (snap_txFlush(&tx) < 0))
+		{
+			const int error = errno;
+
+			snap_txDestroy(&tx);
+			return stopSender(pair, error);
+		}
+	}
+
+	snap_txDestroy(&tx);
+	return stopSender(pair, 0);
+}
+
+static void *sendFrames(void *argument)
+{
+	pair_t *pair = argument;
+	uint8_t buffer[SNAP_MAX_SIZE_FRAME], data[SNAP_MAX_SIZE_FRAME];
+	snap_frame_t frame;
+	snap_gather_t gather;
+	snap_fields_t fields =
+	{
+		.data = data, .destAddress = pair->index, .sourceAddress = 0xFF, .dataSize = config.dataSize, .paddingAfter = true,
+		.header = {.dab = SNAP_HDB2_DAB_1BYTE_DEST_ADDRESS, .sab = SNAP_HDB2_SAB_1BYTE_SOURCE_ADDRESS, .edm = config.edm & SNAP_HDB1_EDM_MASK}
+	};
+	const uint64_t period = (config.rate > 0.0) ? (uint64_t)(1e9 / config.rate) : 0;
+	const uint64_t start = monotonicNs();
+
+	snap_init(&frame, buffer, sizeof(buffer));
+
+	for(uint16_t i = 4; i < config.dataSize; i++)
+	{
+		data[i] = (uint8_t)(i * 37U);
+	}
+
+	if(config.ring)
+	{
+		return sendRing(pair, &fields, data, period, start);
+	}
+
+	for(uint64_t sequence = 0; sequence < config.frames; sequence++)
+	{
+		if(period)
+		{
+			sleepUntil(start + sequence * period);
+		}
+
+		for(unsigned int i = 0; i < 4; i++)
+		{
+			data[i] = (uint8_t)(sequence >> (8U * i));
+		}
+
+		if(config.gather)
+		{
+			snap_gatherEncode(&gather, &fields);
+			__atomic_store_n(&pair->sendTimes[sequence], monotonicNs(), __ATOMIC_RELEASE);
+
+			if(writePieces(pair->master, &gather) < 0)
+			{
+				return stopSender(pair, errno);
+			}
+
+			continue;
+		}
+
+		snap_encapsulate(&frame, &fields);
+
+		const uint8_t *bytes = frame.buffer;
+		size_t size = frame.size;
+
+		__atomic_store_n(&pair->sendTimes[sequence], monotonicNs(), __ATOMIC_RELEASE);
+
+		while(size)
+		{
+			const ssize_t ret = write(pair->master, bytes, size);
+
+			if(ret < 0)
+			{
+				if(errno == EINTR) continue;
+				return stopSender(pair, errno);
+			}
+
+			bytes += ret;
+			size -= (size_t)ret;
+		}
+	}
+
+	return stopSender(pair, 0);
+}
+
+static bool getSendTime(const pair_t *pair, const snap_frame_t *frame, uint64_t *sendTime)
+{
+	uint32_t sequence = 0;
+
+	if((frame->status != SNAP_STATUS_VALID) || (SNAP_SIZE_DATA(frame->buffer) < 4U))
+	{
+		return false;
+	}
+
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		sequence |= (uint32_t)frame->buffer[SNAP_INDEX_DATA(frame->buffer) + i] << (8U * i);
+	}
+
+	*sendTime = (sequence < config.frames) ? __atomic_load_n(&pair->sendTimes[sequence], __ATOMIC_ACQUIRE) : 0;
+
+	return *sendTime != 0;
+}
+
+static void receiveFrame(void *context, const snap_frame_t *frame, const uint64_t offset)
+{
+	pair_t *pair = context;
+	uint64_t sent;
+
+	(void)offset;
+
+	if(!getSendTime(pair, frame, &sent) || (sent > pair->readTime))
+	{
+		pair->errors++;
+		return;
+	}
+
+	pair->received++;
+	pair->bytes += frame->size;
+
+	if(config.subscribers == 0)
+	{
+		recordLatency(&pair->latency, pair->readTime - sent);
+		return;
+	}
+
+	snap_frame_t *copy = snap_poolGet(&pair->pool);
+
+	if(copy == NULL)
+	{
+		pair->poolEmpty++;
+		return;
+	}
+
+	memcpy(copy->buffer, frame->buffer, frame->size);
+	copy->size = frame->size;
+	copy->status = frame->status;
+	snap_dispatchPublish(&pair->dispatcher, copy);
+}
+
+static void *consumeFrames(void *argument)
+{
+	subscriber_t *subscriber = argument;
+	pair_t *pair = subscriber->pair;
+
+	while(true)
+	{
+		const bool receiverDone = __atomic_load_n(&pair->receiverDone, __ATOMIC_ACQUIRE);
+		const snap_frame_t *frame = snap_dispatchReceive(&pair->dispatcher, subscriber->number);
+
+		if(frame == NULL)
+		{
+			if(receiverDone) break;
+			sched_yield();
+			continue;
+		}
+
+		const uint64_t now = monotonicNs();
+		uint64_t sent;
+
+		if(getSendTime(pair, frame, &sent))
+		{
+			recordLatency(&subscriber->latency, now - sent);
+			subscriber->received++;
+			subscriber->lastTime = now;
+		}
+
+		snap_dispatchRelease(&pair->dispatcher, frame);
+	}
+
+	return NULL;
+}
+
+static void *receiveFrames(void *argument)
+{
+	pair_t *pair = argument;
+	struct pollfd poller = {.fd = pair->slave, .events = POLLIN};
+
+	snap_streamInit(&pair->stream, pair->streamBuffer, sizeof(pair->streamBuffer));
+
+	while(pair->received + pair->errors < config.frames)
+	{
+		const bool senderDone = __atomic_load_n(&pair->senderDone, __ATOMIC_ACQUIRE);
+		const int ready = poll(&poller, 1, senderDone ? DRAIN_TIMEOUT_MS : 100);
+
+		if(ready < 0)
+		{
+			if(errno == EINTR) continue;
+			pair->receiverError = errno;
+			break;
+		}
+
+		if(ready == 0)
+		{
+			if(senderDone) break;	// The missing frames are counted as lost
+			continue;
+		}
+
+		size_t space;
+		uint8_t *dest = snap_streamReserve(&pair->stream, &space);
+		const ssize_t ret = read(pair->slave, dest, space);
+
+		pair->readTime = monotonicNs();
+
+		if(ret <= 0)
+		{
+			if((ret < 0) && (errno == EINTR)) continue;
+			pair->receiverError = (ret < 0) ? errno : EIO;
+			break;
+		}
+
+		snap_streamProcess(&pair->stream, (size_t)ret, receiveFrame, pair);
+	}
+
+	__atomic_store_n(&pair->receiverDone, true, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+static bool parseArguments(int argc, char **argv)
+{
+	int opt;
+
+	while((opt = getopt(argc, argv, "n:r:d:e:p:s:gtb:")) != -1)
+	{
+		char *end;
+		unsigned long long value = 0;
+
+		if((optarg != NULL) && (opt != 'r'))
+		{
+			value = strtoull(optarg, &end, 0);
+			if((*end != '\0') || (*optarg == '\0')) return false;
+		}
+
+		switch(opt)
+		{
+			case 'n':
+				if((value == 0) || (value > UINT32_MAX)) return false;
+				config.frames = value;
+				break;
+			case 'r':
+				config.rate = strtod(optarg, &end);
+				if((*end != '\0') || !(config.rate >= 0.0)) return false;
+				break;
+			case 'd':
+				if((value < 4U) || (value > 512U)) return false;
+				config.dataSize = (uint16_t)value;
+				break;
+			case 'e':
+				if(value > SNAP_HDB1_EDM_32BIT_CRC) return false;
+				config.edm = (uint8_t)value;
+				break;
+			case 'p':
+				if((value == 0) || (value > MAX_PAIRS)) return false;
+				config.pairs = (unsigned int)value;
+				break;
+			case 's':
+				if(value > SNAP_DISPATCH_MAX_SUBSCRIBERS) return false;
+				config.subscribers = (uint32_t)value;
+				break;
+			case 'g':
+				config.gather = true;
+				break;
+			case 't':
+				config.ring = true;
+				break;
+			case 'b':
+				config.baud = (long)value;
+				break;
+			default:
+				return false;
+		}
+	}
+
+	return (optind == argc) && !(config.gather && config.ring);
+}
+
+int main(int argc, char **argv)
+{
+	if(!parseArguments(argc, argv))
+	{
+		usage();
+		return 2;
+	}
+
+	pair_t *pairs = calloc(config.pairs, sizeof(pair_t));
+	static latency_t total;
+	uint64_t received = 0, bytes = 0, errors = 0, delivered = 0, dropped = 0;
+	int status = 0;
+
+	if(pairs == NULL)
+	{
+		perror("snaplat");
+		return 1;
+	}
+
+	for(unsigned int i = 0; i < config.pairs; i++)
+	{
+		pairs[i].index = i;
+		pairs[i].sendTimes = calloc(config.frames, sizeof(uint64_t));
+
+		if((pairs[i].sendTimes == NULL) || (openPair(&pairs[i]) < 0))
+		{
+			perror("pty");
+			return 1;
+		}
+
+		if(config.subscribers)
+		{
+			pairs[i].subscribers = calloc(config.subscribers, sizeof(subscriber_t));
+
+			if((pairs[i].subscribers == NULL) || (snap_poolInit(&pairs[i].pool, POOL_FRAMES, SNAP_MAX_SIZE_FRAME, -1) < 0) ||
+			   (snap_dispatchInit(&pairs[i].dispatcher, &pairs[i].pool, config.subscribers, QUEUE_SIZE) < 0))
+			{
+				perror("snaplat");
+				return 1;
+			}
+		}
+	}
+
+	const uint64_t start = monotonicNs();
+
+	for(unsigned int i = 0; i < config.pairs; i++)
+	{
+		for(uint32_t j = 0; j < config.subscribers; j++)
+		{
+			subscriber_t *subscriber = &pairs[i].subscribers[j];
+
+			subscriber->pair = &pairs[i];
+			subscriber->number = j;
+
+			if(pthread_create(&subscriber->thread, NULL, consumeFrames, subscriber) != 0)
+			{
+				fputs("snaplat: cannot create threads\n", stderr);
+				return 1;
+			}
+		}
+
+		if((pthread_create(&pairs[i].receiver, NULL, receiveFrames, &pairs[i]) != 0) ||
+		   (pthread_create(&pairs[i].sender, NULL, sendFrames, &pairs[i]) != 0))
+		{
+			fputs("snaplat: cannot create threads\n", stderr);
+			return 1;
+		}
+	}
+
+	uint64_t end = start;
+
+	for(unsigned int i = 0; i < config.pairs; i++)
+	{
+		pair_t *pair = &pairs[i];
+
+		pthread_join(pair->sender, NULL);
+		pthread_join(pair->receiver, NULL);
+
+		for(uint32_t j = 0; j < config.subscribers; j++)
+		{
+			subscriber_t *subscriber = &pair->subscribers[j];
+
+			pthread_join(subscriber->thread, NULL);
+			mergeLatency(&total, &subscriber->latency);
+			delivered += subscriber->received;
+			dropped += pair->dispatcher.subscribers[j].dropped + pair->poolEmpty;
+			end = (subscriber->lastTime > end) ? subscriber->lastTime : end;
+		}
+
+		if(pair->senderError || pair->receiverError)
+		{
+			fprintf(stderr, "snaplat: pair %u: %s\n", i, strerror(pair->senderError ? pair->senderError : pair->receiverError));
+			status = 1;
+		}
+
+		mergeLatency(&total, &pair->latency);
+		received += pair->received;
+		bytes += pair->bytes;
+		errors += pair->errors;
+		end = (pair->readTime > end) ? pair->readTime : end;
+
+		close(pair->master);
+		close(pair->slave);
+		free(pair->sendTimes);
+
+		if(config.subscribers)
+		{
+			snap_dispatchDestroy(&pair->dispatcher);
+			snap_poolDestroy(&pair->pool);
+			free(pair->subscribers);
+		}
+	}
+
+	const uint64_t sent = config.frames * config.pairs;
+	const double seconds = (double)(end - start) / 1e9;
+
+	printf("pairs=%u frames=%llu received=%llu errors=%llu lost=%llu bytes=%llu elapsed=%.3f s\n",
+		   config.pairs, (unsigned long long)sent, (unsigned long long)received, (unsigned long long)errors,
+		   (unsigned long long)(sent - received - errors), (unsigned long long)bytes, seconds);
+	printf("throughput: %.0f frames/s (%.0f bytes/s)\n",
+		   (seconds > 0.0) ? (double)received / seconds : 0.0, (seconds > 0.0) ? (double)bytes / seconds : 0.0);
+
+	if(config.subscribers)
+	{
+		printf("fan-out: subscribers=%u delivered=%llu dropped=%llu\n",
+			   config.subscribers, (unsigned long long)delivered, (unsigned long long)dropped);
+	}
+
+	if(total.samples)
+	{
+		printf("latency: mean=%.1f us p50=%llu us p99=%llu us p99.9=%llu us max=%.1f us\n",
+			   (double)total.sumNs / (double)total.samples / 1e3,
+			   (unsigned long long)latencyPercentileUs(&total, 0.5), (unsigned long long)latencyPercentileUs(&total, 0.99),
+			   (unsigned long long)latencyPercentileUs(&total, 0.999), (double)total.maxNs / 1e3);
+	}
+
+	free(pairs);
+
+	return (status || (received != sent)) ? 1 : 0;
+}
+
+/******************************** END OF FILE *********************************/
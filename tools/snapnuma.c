@@ -0,0 +1,258 @@
+/**
+ * @file   snapnuma.c
+ * @author Lucas Jadilo
+ * @brief  snapnuma: benchmark of local vs remote NUMA access by the decoder and the frame pools.
+ * @details For each pair of nodes, a channel (stream decoder and frame pool) is created on the first node,
+ *          and a thread pinned to the second node decodes a synthetic stream with it: every frame is copied
+ *          into a pool frame, which is later read back (as a consumer would) and returned to the pool. The
+ *          frames are recycled in FIFO order, so the working set is the whole pool and does not fit in the
+ *          caches. The cost per frame is reported for each pair; the diagonal is local access.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "snap_pool.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define STREAM_CAPACITY		(1U << 16)
+#define STREAM_FRAMES		(4096U)		// Frames in the synthetic stream (it is decoded repeatedly)
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+typedef struct run_t
+{
+	snap_channel_t *channel;
+	snap_frame_t   **ring;			// Frames in use, oldest first
+	uint32_t       ringHead;
+	uint32_t       ringCount;
+	uint64_t       frames;
+	uint64_t       bytes;
+	uint64_t       checksum;		// Keeps the consumer reads from being optimized out
+} run_t;
+
+
+/******************************************************************************/
+/*  Function Definitions                                                      */
+/******************************************************************************/
+
+
+static void usage(void)
+{
+	fputs("usage: snapnuma [-n frames] [-d size] [-f frames]\n"
+		  "  -n frames  frames decoded for each pair of nodes (default: 1000000)\n"
+		  "  -d size    data bytes per frame, 0 to 512 (default: 64)\n"
+		  "  -f frames  frames in each pool (default: 65536)\n",
+		  stderr);
+}
+
+static uint64_t monotonicNs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000U + (uint64_t)now.tv_nsec;
+}
+
+static void consume(run_t *run, snap_frame_t *frame)
+{
+	uint64_t sum = 0;
+
+	for(uint16_t i = 0; i < frame->size; i++)
+	{
+		sum += frame->buffer[i];
+	}
+
+	run->checksum += sum;
+	snap_poolPut(&run->channel->pool, frame);
+}
+
+static void storeFrame(void *context, const snap_frame_t *frame, const uint64_t offset)
+{
+	run_t *run = context;
+	const uint32_t count = run->channel->pool.count;
+	snap_frame_t *copy = snap_poolGet(&run->channel->pool);
+
+	(void)offset;
+
+	if(copy == NULL)	// Pool exhausted: the oldest frame is consumed first
+	{
+		consume(run, run->ring[run->ringHead]);
+		run->ringHead = (run->ringHead + 1U) % count;
+		run->ringCount--;
+		copy = snap_poolGet(&run->channel->pool);
+	}
+
+	memcpy(copy->buffer, frame->buffer, frame->size);
+	copy->size = frame->size;
+	copy->status = frame->status;
+
+	run->ring[(run->ringHead + run->ringCount) % count] = copy;
+	run->ringCount++;
+	run->frames++;
+	run->bytes += frame->size;
+}
+
+static double measure(snap_channel_t *channel, snap_frame_t **ring, const uint8_t *stream, const size_t streamSize, const uint64_t frames)
+{
+	run_t run = {.channel = channel, .ring = ring};
+	const uint64_t start = monotonicNs();
+	size_t position = 0;
+
+	while(run.frames < frames)
+	{
+		size_t space;
+		uint8_t *dest = snap_streamReserve(channel->stream, &space);
+		const size_t count = (streamSize - position < space) ? streamSize - position : space;
+
+		memcpy(dest, &stream[position], count);
+		snap_streamProcess(channel->stream, count, storeFrame, &run);
+		position = (position + count) % streamSize;
+	}
+
+	const uint64_t elapsed = monotonicNs() - start;
+
+	while(run.ringCount)
+	{
+		consume(&run, run.ring[run.ringHead]);
+		run.ringHead = (run.ringHead + 1U) % channel->pool.count;
+		run.ringCount--;
+	}
+
+	if(run.checksum == 0)
+	{
+		fputs("snapnuma: unexpected checksum\n", stderr);
+	}
+
+	return (double)elapsed / (double)run.frames;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long long frames = 1000000, dataSize = 64, poolFrames = 65536;
+	int opt;
+
+	while((opt = getopt(argc, argv, "n:d:f:")) != -1)
+	{
+		char *end;
+		const unsigned long long value = (optarg != NULL) ? strtoull(optarg, &end, 0) : 0;
+
+		if((optarg != NULL) && ((*end != '\0') || (*optarg == '\0')))
+		{
+			usage();
+			return 2;
+		}
+
+		switch(opt)
+		{
+			case 'n':
+				frames = value;
+				if(frames == 0) { usage(); return 2; }
+				break;
+			case 'd':
+				dataSize = value;
+				if(dataSize > 512U) { usage(); return 2; }
+				break;
+			case 'f':
+				poolFrames = value;
+				if((poolFrames == 0) || (poolFrames > (1U << 24))) { usage(); return 2; }
+				break;
+			default:
+				usage();
+				return 2;
+		}
+	}
+
+	if(optind != argc)
+	{
+		usage();
+		return 2;
+	}
+
+	// Synthetic stream: frames with 2-byte addresses, 32-bit CRC and varying data
+	static uint8_t data[512], buffer[SNAP_MAX_SIZE_FRAME];
+	snap_fields_t fields = {.data = data, .dataSize = (uint16_t)dataSize, .paddingAfter = true,
+							.header = {.dab = SNAP_HDB2_DAB_2BYTE_DEST_ADDRESS, .sab = SNAP_HDB2_SAB_2BYTE_SOURCE_ADDRESS, .edm = SNAP_HDB1_EDM_32BIT_CRC}};
+	snap_frame_t frame;
+	uint8_t *stream = malloc(STREAM_FRAMES * SNAP_MAX_SIZE_FRAME);
+	snap_frame_t **ring = malloc(poolFrames * sizeof(snap_frame_t *));
+	size_t streamSize = 0;
+
+	if((stream == NULL) || (ring == NULL))
+	{
+		perror("snapnuma");
+		return 1;
+	}
+
+	snap_init(&frame, buffer, sizeof(buffer));
+
+	for(uint32_t i = 0; i < STREAM_FRAMES; i++)
+	{
+		for(size_t j = 0; j < dataSize; j++)
+		{
+			data[j] = (uint8_t)(i + j);
+		}
+
+		fields.destAddress = i & 0xFFFFU;
+		fields.sourceAddress = (i * 7U) & 0xFFFFU;
+		snap_encapsulate(&frame, &fields);
+		memcpy(&stream[streamSize], frame.buffer, frame.size);
+		streamSize += frame.size;
+	}
+
+	const int nodes = snap_numaNodeCount();
+
+	printf("nodes=%d frames=%llu frame size=%u bytes pool=%llu frames\n", nodes, frames, frame.size, poolFrames);
+
+	for(int memoryNode = 0; memoryNode < nodes; memoryNode++)
+	{
+		snap_channel_t channel;
+
+		if(snap_channelInit(&channel, memoryNode, STREAM_CAPACITY, (uint32_t)poolFrames) < 0)
+		{
+			fprintf(stderr, "snapnuma: node %d: %s\n", memoryNode, strerror(errno));
+			continue;	// e.g. a node without CPUs
+		}
+
+		for(int threadNode = 0; threadNode < nodes; threadNode++)
+		{
+			if(snap_numaBindThread(threadNode) < 0)
+			{
+				continue;
+			}
+
+			const double ns = measure(&channel, ring, stream, streamSize, frames);
+
+			printf("memory node %d, thread node %d%s: %.1f ns/frame (%.0f MB/s)\n",
+				   memoryNode, threadNode, (memoryNode == threadNode) ? " (local)" : " (remote)",
+				   ns, (double)frame.size / ns * 1e3);
+		}
+
+		snap_channelDestroy(&channel);
+	}
+
+	free(stream);
+	free(ring);
+
+	return 0;
+}
+
+/******************************** END OF FILE *********************************/
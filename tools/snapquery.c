@@ -0,0 +1,251 @@
+/**
+ * @file   snapquery.c
+ * @author Lucas Jadilo
+ * @brief  snapquery: search capture files for the frames that match an expression.
+ * @details The expression is compiled once (see snap_query.h) and evaluated straight on the bytes of the
+ *          memory-mapped capture files, so the frames are never decoded. The blocks of records that cannot
+ *          match are skipped when the capture has an index (<capture>.idx, written by snapcat -w or by -I).
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "snap_query.h"
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+typedef struct results_t
+{
+	const char *path;
+	uint64_t   matches;
+	uint64_t   limit;
+	bool       count;
+} results_t;
+
+
+/******************************************************************************/
+/*  Function Definitions                                                      */
+/******************************************************************************/
+
+
+static void usage(void)
+{
+	fputs("usage: snapquery [-c] [-d] [-v] [-N] [-n limit] expression capture...\n"
+		  "       snapquery -I [-B size] capture...\n"
+		  "  -c        print only the number of matching frames\n"
+		  "  -d        print the compiled bytecode\n"
+		  "  -v        print the scan time to stderr\n"
+		  "  -n limit  stop after this number of matching frames\n"
+		  "  -N        do not use the capture indexes (<capture>.idx)\n"
+		  "  -I        build the index of each capture file (<capture>.idx)\n"
+		  "  -B size   minimum size of an index block, in capture bytes (default: 262144)\n"
+		  "  example:  snapquery 'source == 0xB0B1 && ack == 1 && status == hash' frames.cap\n",
+		  stderr);
+}
+
+static const char *statusName(const int8_t status)
+{
+	switch(status)
+	{
+		case SNAP_STATUS_VALID:          return "VALID";
+		case SNAP_STATUS_ERROR_HASH:     return "ERROR_HASH";
+		case SNAP_STATUS_ERROR_OVERFLOW: return "ERROR_OVERFLOW";
+		default:                         return "UNKNOWN";
+	}
+}
+
+static bool printRecord(void *context, const snap_captureRecord_t *record, const size_t offset)
+{
+	results_t *results = context;
+
+	if(!results->count)
+	{
+		printf("%s@%zu %llu.%09llu ch=%u %s ", results->path, offset, (unsigned long long)(record->timestamp / 1000000000U),
+			   (unsigned long long)(record->timestamp % 1000000000U), record->channel, statusName(record->status));
+
+		for(uint_fast16_t i = 0; i < record->size; i++)
+		{
+			printf("%02X", record->bytes[i]);
+		}
+
+		putchar('\n');
+	}
+
+	return ++results->matches != results->limit;
+}
+
+static bool indexPath(char *path, const char *capturePath)
+{
+	return snprintf(path, PATH_MAX, "%s.idx", capturePath) < PATH_MAX;
+}
+
+static int buildIndexes(char **paths, const int count, const uint32_t blockSize)
+{
+	char path[PATH_MAX];
+	int status = 0;
+
+	for(int i = 0; i < count; i++)
+	{
+		if(!indexPath(path, paths[i]) || (snap_indexBuild(paths[i], path, blockSize) < 0))
+		{
+			perror(paths[i]);
+			status = 1;
+		}
+	}
+
+	return status;
+}
+
+int main(int argc, char **argv)
+{
+	static snap_query_t query;
+	results_t results = {.limit = UINT64_MAX};
+	bool disassemble = false, verbose = false, useIndex = true, build = false;
+	unsigned long blockSize = SNAP_INDEX_DEFAULT_BLOCK;
+	char path[PATH_MAX];
+	int opt, status = 0;
+
+	while((opt = getopt(argc, argv, "cdvn:NIB:")) != -1)
+	{
+		switch(opt)
+		{
+			case 'c':
+				results.count = true;
+				break;
+			case 'd':
+				disassemble = true;
+				break;
+			case 'v':
+				verbose = true;
+				break;
+			case 'N':
+				useIndex = false;
+				break;
+			case 'I':
+				build = true;
+				break;
+			case 'B':
+			{
+				char *end;
+				errno = 0;
+				blockSize = strtoul(optarg, &end, 0);
+				if((errno != 0) || (*optarg == '\0') || (*end != '\0') || (blockSize == 0) || (blockSize > UINT32_MAX)) { usage(); return 2; }
+				break;
+			}
+			case 'n':
+			{
+				char *end;
+				errno = 0;
+				results.limit = strtoull(optarg, &end, 0);
+				if((errno != 0) || (*optarg == '\0') || (*end != '\0') || (results.limit == 0)) { usage(); return 2; }
+				break;
+			}
+			default:
+				usage();
+				return 2;
+		}
+	}
+
+	if(build)
+	{
+		if(argc - optind < 1)
+		{
+			usage();
+			return 2;
+		}
+
+		return buildIndexes(&argv[optind], argc - optind, (uint32_t)blockSize);
+	}
+
+	if(argc - optind < 2)
+	{
+		usage();
+		return 2;
+	}
+
+	if(snap_queryCompile(&query, argv[optind]) < 0)
+	{
+		fprintf(stderr, "%s\n%*s^ %s\n", argv[optind], (int)query.errorPosition, "", query.error);
+		return 2;
+	}
+
+	if(disassemble)
+	{
+		snap_queryPrint(&query, stderr);
+	}
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	size_t bytes = 0, blocks = 0, skipped = 0;
+
+	for(int i = optind + 1; (i < argc) && (results.matches != results.limit); i++)
+	{
+		snap_captureReader_t reader;
+
+		if(snap_captureReaderOpen(&reader, argv[i]) < 0)
+		{
+			perror(argv[i]);
+			status = 1;
+			continue;
+		}
+
+		snap_index_t index;
+		int ret;
+
+		results.path = argv[i];
+		bytes += reader.size;
+
+		if(useIndex && indexPath(path, argv[i]) && (snap_indexOpen(&index, path) == 0))
+		{
+			size_t count;
+			ret = snap_queryScanIndex(&query, &reader, &index, printRecord, &results, &count);
+			blocks += index.blocks;
+			skipped += count;
+			snap_indexClose(&index);
+		}
+		else
+		{
+			ret = snap_queryScan(&query, &reader, printRecord, &results);
+		}
+
+		if(ret < 0)
+		{
+			perror(argv[i]);
+			status = 1;
+		}
+
+		snap_captureReaderClose(&reader);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	if(results.count)
+	{
+		printf("%llu\n", (unsigned long long)results.matches);
+	}
+
+	if(verbose)
+	{
+		const double elapsed = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) * 1e-9;
+		fprintf(stderr, "matches=%llu bytes=%zu blocks=%zu skipped=%zu elapsed=%.3fs rate=%.1fMB/s\n", (unsigned long long)results.matches,
+				bytes, blocks, skipped, elapsed, (elapsed > 0) ? (double)bytes / elapsed * 1e-6 : 0.0);
+	}
+
+	return status;
+}
+
+/******************************** END OF FILE *********************************/
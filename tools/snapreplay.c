@@ -0,0 +1,482 @@
+/**
+ * @file   snapreplay.c
+ * @author Lucas Jadilo
+ * @brief  snapreplay: replay a capture file into a tty/pty/file or a UDP tunnel, with the original timing or scaled speed.
+ * @details Each frame is sent when its (scaled) capture timestamp is reached. The process sleeps on a
+ *          timerfd until shortly before that instant and busy-waits the rest, which keeps the timing error
+ *          well under 100 us on an idle host. When running flat-out (speed 0), frames are batched into large
+ *          writes (or sendmmsg() calls) instead. At the end, the achieved rate and the timing error are reported.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#include "snap_capture.h"
+#include "snap_tty.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define SPIN_NS				(200000U)	// Busy-wait window before each deadline
+#define BATCH_SIZE			(1U << 16)	// Bytes coalesced per write when running flat-out
+#define BATCH_DATAGRAMS		(64U)		// Datagrams per sendmmsg() when running flat-out
+#define HISTOGRAM_SIZE		(10000U)	// Timing error histogram: 1 us buckets up to 10 ms
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+typedef struct output_t
+{
+	int     fd;
+	bool    datagram;
+	uint8_t batch[BATCH_SIZE];
+	size_t  batchLength;
+	struct  mmsghdr messages[BATCH_DATAGRAMS];
+	struct  iovec vectors[BATCH_DATAGRAMS];
+	unsigned int batchDatagrams;
+} output_t;
+
+typedef struct timing_t
+{
+	uint64_t histogram[HISTOGRAM_SIZE + 1];
+	uint64_t samples;
+	uint64_t sumNs;
+	uint64_t maxNs;
+} timing_t;
+
+
+/******************************************************************************/
+/*  Global Variables                                                          */
+/******************************************************************************/
+
+
+static volatile sig_atomic_t stop = 0;
+static output_t output;
+static timing_t timing;
+
+
+/******************************************************************************/
+/*  Function Definitions                                                      */
+/******************************************************************************/
+
+
+static void handleSignal(const int signal)
+{
+	(void)signal;
+	stop = 1;
+}
+
+static void usage(void)
+{
+	fputs("usage: snapreplay [-x speed] [-e] [-c channel] [-b baud] [-s record] (-o path | -u host:port) capture\n"
+		  "  capture      capture file to replay\n"
+		  "  -o path      write the frames into a tty, pty or file\n"
+		  "  -u host:port send each frame as a UDP datagram\n"
+		  "  -x speed     speed factor (e.g. 10 = ten times faster, 0 = as fast as possible; default: 1)\n"
+		  "  -e           also replay frames recorded with hash or overflow errors\n"
+		  "  -c channel   only replay the frames of this channel\n"
+		  "  -b baud      set the baud rate (and raw mode) when the output is a tty\n"
+		  "  -s record    start at this record number (0 = first)\n",
+		  stderr);
+}
+
+static uint64_t monotonicNs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000U + (uint64_t)now.tv_nsec;
+}
+
+static void waitUntil(const int timerFd, const uint64_t deadline)
+{
+	uint64_t now = monotonicNs();
+
+	if(deadline > now + SPIN_NS)
+	{
+		const uint64_t wakeup = deadline - SPIN_NS;
+		const struct itimerspec spec = {.it_value = {.tv_sec = (time_t)(wakeup / 1000000000U), .tv_nsec = (long)(wakeup % 1000000000U)}};
+		uint64_t expirations;
+
+		timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, NULL);
+
+		if(read(timerFd, &expirations, sizeof(expirations)) < 0)
+		{
+			return;	// Interrupted by a signal
+		}
+	}
+
+	while(monotonicNs() < deadline);
+}
+
+static void recordTiming(const uint64_t deadline, const uint64_t actual)
+{
+	const uint64_t error = (actual > deadline) ? (actual - deadline) : 0;
+	const uint64_t bucket = error / 1000U;
+
+	timing.histogram[(bucket < HISTOGRAM_SIZE) ? bucket : HISTOGRAM_SIZE]++;
+	timing.samples++;
+	timing.sumNs += error;
+
+	if(error > timing.maxNs)
+	{
+		timing.maxNs = error;
+	}
+}
+
+static uint64_t timingPercentileUs(const double percentile)
+{
+	const uint64_t rank = (uint64_t)(percentile * (double)timing.samples);
+	uint64_t count = 0;
+
+	for(uint64_t i = 0; i <= HISTOGRAM_SIZE; i++)
+	{
+		count += timing.histogram[i];
+
+		if(count > rank)
+		{
+			return i;
+		}
+	}
+
+	return HISTOGRAM_SIZE;
+}
+
+static bool writeAll(const int fd, const uint8_t *data, size_t size)
+{
+	while(size)
+	{
+		const ssize_t ret = write(fd, data, size);
+
+		if(ret < 0)
+		{
+			if(errno == EINTR) continue;
+			return false;
+		}
+
+		data += ret;
+		size -= (size_t)ret;
+	}
+
+	return true;
+}
+
+static bool flushBatch(void)
+{
+	bool ok = true;
+
+	if(output.datagram)
+	{
+		unsigned int sent = 0;
+
+		while(ok && (sent < output.batchDatagrams))
+		{
+			const int ret = sendmmsg(output.fd, &output.messages[sent], output.batchDatagrams - sent, 0);
+
+			if(ret < 0)
+			{
+				ok = (errno == EINTR);
+			}
+			else
+			{
+				sent += (unsigned int)ret;
+			}
+		}
+	}
+	else
+	{
+		ok = writeAll(output.fd, output.batch, output.batchLength);
+	}
+
+	output.batchLength = 0;
+	output.batchDatagrams = 0;
+	return ok;
+}
+
+static bool sendFrame(const uint8_t *bytes, const uint16_t size, const bool batched)
+{
+	if(!batched)
+	{
+		if(output.datagram)
+		{
+			return send(output.fd, bytes, size, 0) == (ssize_t)size;
+		}
+
+		return writeAll(output.fd, bytes, size);
+	}
+
+	if(output.datagram)
+	{
+		if((output.batchDatagrams == BATCH_DATAGRAMS) || (output.batchLength + size > sizeof(output.batch)))
+		{
+			if(!flushBatch()) return false;
+		}
+
+		uint8_t *dest = &output.batch[output.batchLength];
+		memcpy(dest, bytes, size);
+
+		output.vectors[output.batchDatagrams].iov_base = dest;
+		output.vectors[output.batchDatagrams].iov_len = size;
+		output.messages[output.batchDatagrams].msg_hdr.msg_iov = &output.vectors[output.batchDatagrams];
+		output.messages[output.batchDatagrams].msg_hdr.msg_iovlen = 1;
+		output.batchDatagrams++;
+		output.batchLength += size;
+		return true;
+	}
+
+	if(output.batchLength + size > sizeof(output.batch))
+	{
+		if(!flushBatch()) return false;
+	}
+
+	memcpy(&output.batch[output.batchLength], bytes, size);
+	output.batchLength += size;
+	return true;
+}
+
+static int openUdp(char *destination)
+{
+	char *colon = strrchr(destination, ':');
+
+	if(colon == NULL)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	*colon = '\0';
+
+	const struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_DGRAM};
+	struct addrinfo *list;
+
+	if(getaddrinfo(destination, colon + 1, &hints, &list) != 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	int fd = -1;
+
+	for(struct addrinfo *info = list; info != NULL; info = info->ai_next)
+	{
+		fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+
+		if(fd < 0) continue;
+		if(connect(fd, info->ai_addr, info->ai_addrlen) == 0) break;
+
+		close(fd);
+		fd = -1;
+	}
+
+	freeaddrinfo(list);
+	return fd;
+}
+
+int main(int argc, char **argv)
+{
+	char *udpDestination = NULL;
+	const char *outputPath = NULL;
+	double speed = 1.0;
+	long channel = -1, baud = 0;
+	unsigned long long first = 0;
+	bool replayErrors = false;
+	int opt;
+
+	while((opt = getopt(argc, argv, "o:u:x:ec:b:s:")) != -1)
+	{
+		char *end;
+
+		switch(opt)
+		{
+			case 'o':
+				outputPath = optarg;
+				break;
+			case 'u':
+				udpDestination = optarg;
+				break;
+			case 'x':
+				speed = strtod(optarg, &end);
+				if((*end != '\0') || !(speed >= 0.0)) { usage(); return 2; }
+				break;
+			case 'e':
+				replayErrors = true;
+				break;
+			case 'c':
+				channel = strtol(optarg, &end, 0);
+				if((*end != '\0') || (channel < 0) || (channel > UINT16_MAX)) { usage(); return 2; }
+				break;
+			case 'b':
+				baud = strtol(optarg, &end, 0);
+				if((*end != '\0') || (baud <= 0)) { usage(); return 2; }
+				break;
+			case 's':
+				first = strtoull(optarg, &end, 0);
+				if((*end != '\0') || (*optarg == '\0')) { usage(); return 2; }
+				break;
+			default:
+				usage();
+				return 2;
+		}
+	}
+
+	if((optind != argc - 1) || ((outputPath == NULL) == (udpDestination == NULL)))
+	{
+		usage();
+		return 2;
+	}
+
+	snap_captureReader_t reader;
+
+	if((snap_captureReaderOpen(&reader, argv[optind]) < 0) || (snap_captureSeek(&reader, first) < 0))
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+
+	if(outputPath != NULL)
+	{
+		output.fd = open(outputPath, O_WRONLY | O_CREAT | O_TRUNC | O_NOCTTY, 0644);
+
+		if(output.fd < 0)
+		{
+			perror(outputPath);
+			return 1;
+		}
+
+		if(isatty(output.fd) && (snap_ttyConfigure(output.fd, baud) < 0))
+		{
+			perror("tty");
+			return 1;
+		}
+	}
+	else
+	{
+		output.fd = openUdp(udpDestination);
+		output.datagram = true;
+
+		if(output.fd < 0)
+		{
+			perror("udp");
+			return 1;
+		}
+	}
+
+	const int timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+
+	if(timerFd < 0)
+	{
+		perror("timerfd");
+		return 1;
+	}
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = handleSignal;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+
+	const bool flatOut = (speed == 0.0);
+	snap_captureRecord_t record;
+	uint64_t firstTimestamp = 0, lastDeadline = 0, frames = 0, bytes = 0;
+	const uint64_t start = monotonicNs();
+	int ret = 0, status = 0;
+
+	while(!stop && ((ret = snap_captureRead(&reader, &record)) > 0))
+	{
+		if((channel >= 0) && (record.channel != channel)) continue;
+		if(!replayErrors && (record.status != SNAP_STATUS_VALID)) continue;
+
+		if(!flatOut)
+		{
+			if(frames == 0)
+			{
+				firstTimestamp = record.timestamp;
+			}
+
+			const uint64_t elapsed = (record.timestamp > firstTimestamp) ? (record.timestamp - firstTimestamp) : 0;
+			uint64_t deadline = start + (uint64_t)((double)elapsed / speed);
+
+			if(deadline < lastDeadline)
+			{
+				deadline = lastDeadline;	// Out-of-order timestamps (e.g. merged channels) are sent in file order
+			}
+
+			waitUntil(timerFd, deadline);
+			lastDeadline = deadline;
+
+			if(stop) break;
+
+			if(!sendFrame(record.bytes, record.size, false))
+			{
+				perror("output");
+				status = 1;
+				break;
+			}
+
+			recordTiming(deadline, monotonicNs());
+		}
+		else if(!sendFrame(record.bytes, record.size, true))
+		{
+			perror("output");
+			status = 1;
+			break;
+		}
+
+		frames++;
+		bytes += record.size;
+	}
+
+	if(ret < 0)
+	{
+		fputs("snapreplay: capture file is truncated or corrupted\n", stderr);
+		status = 1;
+	}
+
+	if(flatOut && !flushBatch())
+	{
+		perror("output");
+		status = 1;
+	}
+
+	const double seconds = (double)(monotonicNs() - start) / 1e9;
+
+	fprintf(stderr, "frames=%llu bytes=%llu elapsed=%.3f s rate=%.0f frames/s (%.0f bytes/s)\n",
+			(unsigned long long)frames, (unsigned long long)bytes, seconds,
+			(seconds > 0.0) ? (double)frames / seconds : 0.0, (seconds > 0.0) ? (double)bytes / seconds : 0.0);
+
+	if(timing.samples)
+	{
+		fprintf(stderr, "timing error: mean=%.1f us p50=%llu us p99=%llu us p99.9=%llu us max=%.1f us\n",
+				(double)timing.sumNs / (double)timing.samples / 1e3,
+				(unsigned long long)timingPercentileUs(0.5), (unsigned long long)timingPercentileUs(0.99),
+				(unsigned long long)timingPercentileUs(0.999), (double)timing.maxNs / 1e3);
+	}
+
+	snap_captureReaderClose(&reader);
+	close(output.fd);
+	close(timerFd);
+
+	return status;
+}
+
+/******************************** END OF FILE *********************************/
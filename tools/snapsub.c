@@ -0,0 +1,313 @@
+/**
+ * @file   snapsub.c
+ * @author Lucas Jadilo
+ * @brief  snapsub: example client of the SNAP daemon (snapd).
+ * @details It subscribes to the frames of some ports, by destination or source address and command byte
+ *          (see snap_client.h), and prints each frame received as a line with the port, the time since the
+ *          daemon read it and the frame bytes in hexadecimal. With -t, it sends instead the frames found in
+ *          its standard input (a raw byte stream) on a port, through the daemon.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "snap_client.h"
+#include "snap_stream.h"
+
+
+/******************************************************************************/
+/*  Macros                                                                    */
+/******************************************************************************/
+
+
+#define READ_SIZE		(4096U)			// Bytes per read() call of the standard input
+#define WAIT_MS			(100)			// Longest wait before the stop flag is checked
+#define MAX_ADDRESS		(0xFFFFFFU)		// Largest address (three bytes)
+
+
+/******************************************************************************/
+/*  Types                                                                     */
+/******************************************************************************/
+
+
+typedef struct sender_t
+{
+	snap_client_t *client;
+	uint32_t      port;
+	uint64_t      frames;
+	int           error;
+} sender_t;
+
+
+/******************************************************************************/
+/*  Global Variables                                                          */
+/******************************************************************************/
+
+
+static volatile sig_atomic_t stop = 0;
+
+
+/******************************************************************************/
+/*  Function Definitions                                                      */
+/******************************************************************************/
+
+
+static void handleSignal(const int signal)
+{
+	(void)signal;
+	stop = 1;
+}
+
+static void usage(void)
+{
+	fputs("usage: snapsub [-p port]... [-d address]... [-s address]... [-c command]... [-r slots] [-n frames] socket\n"
+		  "       snapsub -t port socket < frames\n"
+		  "  socket      Unix socket of the daemon\n"
+		  "  -p port     receive the frames of this port (default: every port)\n"
+		  "  -d address  receive the frames sent to this address (up to 16; default: any)\n"
+		  "  -s address  receive the frames sent by this address (up to 16; default: any)\n"
+		  "  -c command  receive the frames whose first data byte is this command (up to 16; default: any)\n"
+		  "  -r slots    frames that can wait in each ring (default: set by the daemon)\n"
+		  "  -n frames   exit after this number of frames\n"
+		  "  -t port     send the frames of the standard input on this port instead\n",
+		  stderr);
+}
+
+static uint64_t monotonicNs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000U + (uint64_t)now.tv_nsec;
+}
+
+static void sendFrame(void *context, const snap_frame_t *frame, const uint64_t offset)
+{
+	sender_t *sender = context;
+
+	(void)offset;
+
+	if((frame->status == SNAP_STATUS_VALID) && (sender->error == 0))
+	{
+		if(snap_clientSend(sender->client, sender->port, frame) < 0)
+		{
+			sender->error = errno;
+		}
+		else
+		{
+			sender->frames++;
+		}
+	}
+}
+
+static int sendFrames(snap_client_t *client, const uint32_t port)
+{
+	static uint8_t buffer[READ_SIZE + SNAP_STREAM_MIN_SIZE_BUFFER];
+	sender_t sender = {.client = client, .port = port};
+	snap_stream_t stream;
+
+	snap_streamInit(&stream, buffer, sizeof(buffer));
+
+	while(!stop && (sender.error == 0))
+	{
+		size_t space;
+		uint8_t *dest = snap_streamReserve(&stream, &space);
+		const ssize_t ret = read(STDIN_FILENO, dest, (space < READ_SIZE) ? space : READ_SIZE);
+
+		if(ret == 0)
+		{
+			snap_streamFinish(&stream, sendFrame, &sender);
+			break;
+		}
+
+		if(ret < 0)
+		{
+			if(errno == EINTR) continue;
+			perror("read");
+			return 1;
+		}
+
+		snap_streamProcess(&stream, (size_t)ret, sendFrame, &sender);
+	}
+
+	if(sender.error != 0)
+	{
+		fprintf(stderr, "snapsub: send: %s\n", strerror(sender.error));
+		return 1;
+	}
+
+	fprintf(stderr, "sent=%llu\n", (unsigned long long)sender.frames);
+
+	return 0;
+}
+
+static int receiveFrames(snap_client_t *client, const unsigned long long limit)
+{
+	uint8_t buffer[SNAP_MAX_SIZE_FRAME];
+	snap_frame_t frame;
+	uint64_t received = 0;
+	int status = 0;
+
+	snap_init(&frame, buffer, sizeof(buffer));
+
+	while(!stop && ((limit == 0) || (received < limit)))
+	{
+		uint64_t timestamp;
+		uint32_t port;
+		const int ret = snap_clientReceive(client, &frame, &port, &timestamp, WAIT_MS);
+
+		if(ret < 0)
+		{
+			if(errno == EINTR) continue;
+			perror("snapsub: receive");
+			status = 1;
+			break;
+		}
+
+		if(ret == 0)
+		{
+			continue;
+		}
+
+		received++;
+		printf("port %u +%lluus:", port, (unsigned long long)((monotonicNs() - timestamp) / 1000U));
+
+		for(uint16_t i = 0; i < frame.size; i++)
+		{
+			printf(" %02X", frame.buffer[i]);
+		}
+
+		putchar('\n');
+	}
+
+	fprintf(stderr, "received=%llu dropped=%llu\n", (unsigned long long)received, (unsigned long long)snap_clientDropped(client));
+
+	return status;
+}
+
+static bool parseList(uint32_t *list, size_t *count, const char *text, const unsigned long long max)
+{
+	char *end;
+	const unsigned long long value = strtoull(text, &end, 0);
+
+	if((*end != '\0') || (*text == '\0') || (value > max) || (*count == SNAP_IPC_MAX_LIST))
+	{
+		return false;
+	}
+
+	list[(*count)++] = (uint32_t)value;
+
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t destAddresses[SNAP_IPC_MAX_LIST], sourceAddresses[SNAP_IPC_MAX_LIST], commandList[SNAP_IPC_MAX_LIST], ports[SNAP_IPC_MAX_PORTS];
+	uint8_t commands[SNAP_IPC_MAX_LIST];
+	snap_subscription_t subscription = {.destAddresses = destAddresses, .sourceAddresses = sourceAddresses, .commands = commands};
+	size_t portCount = 0;
+	unsigned long long limit = 0, slots = 0, sendPort = UINT32_MAX;
+	int opt;
+
+	while((opt = getopt(argc, argv, "p:d:s:c:r:n:t:")) != -1)
+	{
+		char *end;
+		const unsigned long long value = (optarg != NULL) ? strtoull(optarg, &end, 0) : 0;
+		bool valid = (optarg != NULL) && (*end == '\0') && (*optarg != '\0');
+
+		switch(opt)
+		{
+			case 'p':
+				valid = (portCount < SNAP_IPC_MAX_PORTS) && parseList(ports, &portCount, optarg, SNAP_IPC_MAX_PORTS - 1U);
+				break;
+			case 'd':
+				valid = parseList(destAddresses, &subscription.destCount, optarg, MAX_ADDRESS);
+				break;
+			case 's':
+				valid = parseList(sourceAddresses, &subscription.sourceCount, optarg, MAX_ADDRESS);
+				break;
+			case 'c':
+				valid = parseList(commandList, &subscription.commandCount, optarg, UINT8_MAX);
+				break;
+			case 'r':
+				slots = value;
+				valid = valid && (slots > 0) && (slots <= SNAP_IPC_MAX_SLOTS);
+				break;
+			case 'n':
+				limit = value;
+				break;
+			case 't':
+				sendPort = value;
+				valid = valid && (sendPort < SNAP_IPC_MAX_PORTS);
+				break;
+			default:
+				valid = false;
+				break;
+		}
+
+		if(!valid)
+		{
+			usage();
+			return 2;
+		}
+	}
+
+	if(optind != argc - 1)
+	{
+		usage();
+		return 2;
+	}
+
+	uint32_t portMask = (portCount == 0) ? SNAP_CLIENT_ALL_PORTS : 0U;
+
+	for(size_t i = 0; i < portCount; i++)
+	{
+		portMask |= 1U << ports[i];
+	}
+
+	for(size_t i = 0; i < subscription.commandCount; i++)
+	{
+		commands[i] = (uint8_t)commandList[i];
+	}
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = handleSignal;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+
+	// A sender reads nothing: its single slot ring only receives the frames of its port, which it drops
+	if(sendPort != UINT32_MAX)
+	{
+		portMask = 1U << sendPort;
+		slots = 1;
+	}
+
+	snap_client_t client;
+
+	if(snap_clientConnect(&client, argv[optind], &subscription, portMask, (uint32_t)slots) < 0)
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+
+	setvbuf(stdout, NULL, _IOLBF, 0);
+
+	const int status = (sendPort != UINT32_MAX) ? sendFrames(&client, (uint32_t)sendPort) : receiveFrames(&client, limit);
+
+	snap_clientClose(&client);
+
+	return status;
+}
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,33 @@
+/**
+ * @file   user_hash.c
+ * @author Lucas Jadilo
+ * @brief  User hash function shared by the command-line tools.
+ */
+
+
+/******************************************************************************/
+/*  Includes                                                                  */
+/******************************************************************************/
+
+
+#include "snap.h"
+
+
+/******************************************************************************/
+/*  Function Definitions                                                      */
+/******************************************************************************/
+
+
+/**
+ * @brief Dummy function definition to avoid "undefined reference" error when
+ *        compiling with `-D SNAP_DISABLE_WEAK` and `-D SNAP_OVERRIDE_USER_HASH`.
+ *        Replace it to decode frames that use a user-defined hash (EDM = 7).
+ */
+uint32_t snap_calculateUserHash(const uint8_t *data, const uint16_t size)
+{
+	(void)data;
+	(void)size;
+	return 0;
+}
+
+/******************************** END OF FILE *********************************/
@@ -0,0 +1,16 @@
+/**
+ * @file   user_hash.h
+ * @author Lucas Jadilo
+ * @brief  Size of the user hash (EDM = 7) of the command-line tools and of the Python module.
+ * @details Both builds force-include this file (`-include tools/user_hash.h`) before snap.h, so the size is
+ *          defined in one place. It must match the hash computed by snap_calculateUserHash() (see user_hash.c).
+ */
+
+#ifndef USER_HASH_H_
+#define USER_HASH_H_
+
+#define SNAP_SIZE_USER_HASH	(3U)	// Size of the user hash, in bytes (0 to 4)
+
+#endif	// USER_HASH_H_
+
+/******************************** END OF FILE *********************************/